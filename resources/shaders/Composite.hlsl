@@ -0,0 +1,80 @@
+// Fullscreen composite of the raytracing output into the back buffer. The
+// output is read directly as a UAV when the device supports typed UAV loads of
+// its format, so it can stay in the UNORDERED_ACCESS state across frames.
+// Otherwise COMPOSITE_READ_SRV is defined and it is read through a SRV.
+#ifdef COMPOSITE_READ_SRV
+Texture2D< float4 > gInput : register(t0);
+#else
+RWTexture2D< float4 > gInput : register(u0);
+#endif
+
+// Must match Dx12Api::CompositeSettings
+cbuffer CompositeConstants : register(b0)
+{
+	float exposure;
+	uint tonemapOperator;
+	uint encodeSrgb;
+};
+
+#define TONEMAP_NONE 0
+#define TONEMAP_REINHARD 1
+#define TONEMAP_ACES 2
+
+struct PSInput
+{
+	float4 position : SV_POSITION;
+};
+
+// A single triangle covering the whole viewport, generated from the vertex ID:
+// no vertex buffer is needed
+PSInput VSMain(uint vertexId : SV_VertexID)
+{
+	PSInput result;
+
+	float2 uv = float2((vertexId << 1) & 2, vertexId & 2);
+	result.position = float4(uv * float2(2.f, -2.f) + float2(-1.f, 1.f), 0.f, 1.f);
+
+	return result;
+}
+
+// Narkowicz's fit of the ACES filmic curve
+float3 TonemapAces(float3 color)
+{
+	const float a = 2.51f;
+	const float b = 0.03f;
+	const float c = 2.43f;
+	const float d = 0.59f;
+	const float e = 0.14f;
+	return saturate((color * (a * color + b)) / (color * (c * color + d) + e));
+}
+
+float3 LinearToSrgb(float3 color)
+{
+	float3 low = color * 12.92f;
+	float3 high = 1.055f * pow(color, 1.f / 2.4f) - 0.055f;
+	return color <= 0.0031308f ? low : high;
+}
+
+float4 PSMain(PSInput input) : SV_TARGET
+{
+	// The viewport matches the raytracing output, so the pixel position is
+	// directly the texel to read
+	float3 color = gInput[uint2(input.position.xy)].rgb * exposure;
+
+	if (tonemapOperator == TONEMAP_REINHARD)
+	{
+		color = color / (1.f + color);
+	}
+	else if (tonemapOperator == TONEMAP_ACES)
+	{
+		color = TonemapAces(color);
+	}
+
+	color = saturate(color);
+	if (encodeSrgb)
+	{
+		color = LinearToSrgb(color);
+	}
+
+	return float4(color, 1.f);
+}
@@ -14,3 +14,42 @@ struct Attributes
 {
   float2 bary;
 };
+
+// Payload of the shadow rays, which only need to know whether anything was hit
+struct ShadowHitInfo
+{
+  bool isHit;
+};
+
+// Ray types. Each ray type has its own miss shader, and its own hit group for
+// every geometry: the hit group record of a geometry is found at
+// InstanceContributionToHitGroupIndex + GeometryIndex * RAY_TYPE_COUNT + ray type
+// in the SBT, and the miss record at the ray type index. Must match the ray types
+// declared in Dx12Api
+#define RAY_TYPE_RADIANCE 0
+#define RAY_TYPE_SHADOW 1
+#define RAY_TYPE_COUNT 2
+
+// Direction towards the light, a directional light above and in front of the scene
+static const float3 kLightDirection = normalize(float3(0.5f, 0.5f, 1.0f));
+
+// Shading of the surfaces hidden from the light
+static const float kShadowFactor = 0.3f;
+
+// Trace an occlusion ray. The ray is assumed occluded: the traversal stops at
+// the first hit without running any closest hit shader, the shadow hit group
+// being empty, and only the shadow miss shader clears the payload
+bool IsOccluded(RaytracingAccelerationStructure scene, float3 origin, float3 direction, float tMax)
+{
+  RayDesc ray;
+  ray.Origin = origin;
+  ray.Direction = direction;
+  ray.TMin = 0.001f;
+  ray.TMax = tMax;
+
+  ShadowHitInfo payload;
+  payload.isHit = true;
+  TraceRay(scene, RAY_FLAG_ACCEPT_FIRST_HIT_AND_END_SEARCH | RAY_FLAG_SKIP_CLOSEST_HIT_SHADER,
+           0xFF, RAY_TYPE_SHADOW, RAY_TYPE_COUNT, RAY_TYPE_SHADOW, ray, payload);
+  return payload.isHit;
+}
@@ -7,6 +7,7 @@ struct STriVertex
 };
 
 StructuredBuffer<STriVertex> BTriVertex : register(t0);
+RaytracingAccelerationStructure SceneBVH : register(t1);
 
 [shader("closesthit")] 
 void ClosestHit(inout HitInfo payload, Attributes attrib) 
@@ -19,5 +20,12 @@ void ClosestHit(inout HitInfo payload, Attributes attrib)
         BTriVertex[vertId + 1].color * barycentrics.y +
         BTriVertex[vertId + 2].color * barycentrics.z;
 
+    // The hit point is darkened when another surface hides it from the light
+    float3 hitPoint = WorldRayOrigin() + RayTCurrent() * WorldRayDirection();
+    if (IsOccluded(SceneBVH, hitPoint, kLightDirection, 100000))
+    {
+        hitColor *= kShadowFactor;
+    }
+
     payload.colorAndDistance = float4(hitColor, RayTCurrent());
 }
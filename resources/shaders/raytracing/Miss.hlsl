@@ -8,4 +8,10 @@ void Miss(inout HitInfo payload : SV_RayPayload)
 
 	float ramp = launchIndex.y / dims.y;
 	payload.colorAndDistance = float4(0.0f, 0.2f, 0.7f - 0.3f * ramp, -1.0f);
-}
\ No newline at end of file
+}
+
+[shader("miss")]
+void ShadowMiss(inout ShadowHitInfo payload : SV_RayPayload)
+{
+	payload.isHit = false;
+}
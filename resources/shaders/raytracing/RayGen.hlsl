@@ -55,24 +55,25 @@ void RayGen() {
 		// Depending on the type of ray, a given object can have several hit groups attached
 		// (ie. what to do when hitting to compute regular shading, and what to do when hitting
 		// to compute shadows). Those hit groups are specified sequentially in the SBT, so the value
-		// below indicates which offset (on 4 bits) to apply to the hit groups for this ray. In this
-		// sample we only have one hit group per object, hence an offset of 0.
-		0,
+		// below indicates which offset (on 4 bits) to apply to the hit groups for this ray: the
+		// index of the ray type.
+		RAY_TYPE_RADIANCE,
 
 		// Parameter name: MultiplierForGeometryContributionToHitGroupIndex
 		// The offsets in the SBT can be computed from the object ID, its instance ID, but also simply
 		// by the order the objects have been pushed in the acceleration structure. This allows the
 		// application to group shaders in the SBT in the same order as they are added in the AS, in
 		// which case the value below represents the stride (4 bits representing the number of hit
-		// groups) between two consecutive objects.
-		0,
+		// groups) between two consecutive objects: one hit group per ray type.
+		RAY_TYPE_COUNT,
 
 		// Parameter name: MissShaderIndex
 		// Index of the miss shader to use in case several consecutive miss shaders are present in the
 		// SBT. This allows to change the behavior of the program when no geometry have been hit, for
 		// example one to return a sky color for regular rendering, and another returning a full
-		// visibility value for shadow rays. This sample has only one miss shader, hence an index 0
-		0,
+		// visibility value for shadow rays. There is one miss shader per ray type, in the order of
+		// the ray types
+		RAY_TYPE_RADIANCE,
 
 		// Parameter name: Ray
 		// Ray information to trace
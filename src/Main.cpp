@@ -13,11 +13,56 @@
 #include "stdafx.h"
 #include "RaytracingSample.h"
 #include "Win32Application.h"
+#include "dx12/ShaderArchiveBuilder.h"
 #include <dxgidebug.h>
 
+// Path given with -buildshaderarchive, or an empty string to run the sample
+static std::wstring GetShaderArchiveBuildPath()
+{
+	std::wstring path;
+	int argc;
+	LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+	for (int i = 1; i + 1 < argc; ++i)
+	{
+		if (_wcsicmp(argv[i], L"-buildshaderarchive") == 0 || _wcsicmp(argv[i], L"/buildshaderarchive") == 0)
+		{
+			path = argv[i + 1];
+		}
+	}
+	LocalFree(argv);
+	return path;
+}
+
+// Compile the shaders of the sample into an archive, without creating any window or device.
+// Run by the build, so the errors go to the standard error of the build as well as to the
+// debugger
+static int BuildShaderArchive(const std::wstring& path)
+{
+	std::string errors;
+	if (RaytracingImplementation::BuildShaderArchive(RaytracingImplementation::RaytracingSample::GetShaderManifest(), path, errors))
+	{
+		return 0;
+	}
+
+	OutputDebugStringA(errors.c_str());
+	HANDLE errorOutput = GetStdHandle(STD_ERROR_HANDLE);
+	if (errorOutput != nullptr && errorOutput != INVALID_HANDLE_VALUE)
+	{
+		DWORD written;
+		WriteFile(errorOutput, errors.data(), static_cast<DWORD>(errors.size()), &written, nullptr);
+	}
+	return 1;
+}
+
 _Use_decl_annotations_
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow)
 {
+	const std::wstring shaderArchivePath = GetShaderArchiveBuildPath();
+	if (!shaderArchivePath.empty())
+	{
+		return BuildShaderArchive(shaderArchivePath);
+	}
+
 	int returnValue = 0;
 
 	{
@@ -13,10 +13,50 @@
 #include "RaytracingSample.h"
 #include "dx12/dxr/nv_helpers_dx12/RootSignatureGenerator.h"
 #include "Win32Application.h"
+#include "dx12/BvhAnalyzer.h"
+#include "dx12/Profiler.h"
+#include "dx12/TraversalHeatmap.h"
+#include <algorithm>
 #include <array>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
 
 namespace RaytracingImplementation
 {
+	namespace
+	{
+		std::vector<TriangleBvh::Vector3> GetPositions(const Vertex* vertices, size_t vertexCount)
+		{
+			std::vector<TriangleBvh::Vector3> positions(vertexCount);
+			for (size_t i = 0; i < vertexCount; i++)
+			{
+				positions[i] = { vertices[i].position.x, vertices[i].position.y, vertices[i].position.z };
+			}
+			return positions;
+		}
+
+		// Last GPU time of a pass, or 0 if it has not been timed yet
+		double GetLastPassMilliseconds(const GpuPassTimer& timer, const char* name)
+		{
+			for (const GpuPassTimer::PassTiming& timing : timer.GetPassTimings())
+			{
+				if (std::strcmp(timing.name, name) == 0)
+				{
+					return timing.lastMilliseconds;
+				}
+			}
+			return 0.0;
+		}
+
+		// Primary ray of a pixel, as traced by RayGen.hlsl
+		TriangleBvh::Ray GetPrimaryRay(UINT x, UINT y, UINT width, UINT height)
+		{
+			const float dx = (float(x) + 0.5f) / float(width) * 2.0f - 1.0f;
+			const float dy = (float(y) + 0.5f) / float(height) * 2.0f - 1.0f;
+			return { { dx, -dy, 1.0f }, { 0.0f, 0.0f, -1.0f }, 0.0f, 100000.0f };
+		}
+	}
 
 	RaytracingSample::RaytracingSample(UINT width, UINT height, std::wstring name) :
 		gpu{ width, height },
@@ -30,6 +70,9 @@ namespace RaytracingImplementation
 
 	void RaytracingSample::OnInit()
 	{
+		Profiler::SetThreadName("Main");
+		PROFILE_ZONE("RaytracingSample::OnInit");
+
 		SetUpPipeline();
 
 		LoadAssets();
@@ -56,13 +99,14 @@ namespace RaytracingImplementation
 
 			// Create the shader binding table and indicating which shaders
 			// are invoked for each instance in the  AS
-			gpu.CreateShaderBindingTable(m_vertexBuffer);
+			gpu.CreateShaderBindingTable();
 		}
 	}
 
 	// Load the rendering pipeline dependencies.
 	void RaytracingSample::SetUpPipeline()
 	{
+		PROFILE_ZONE("RaytracingSample::SetUpPipeline");
 		D3D12_COMMAND_QUEUE_DESC queueDesc = {};
 		queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
 		queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
@@ -87,13 +131,12 @@ namespace RaytracingImplementation
 	// Load the sample assets.
 	void RaytracingSample::LoadAssets()
 	{
+		PROFILE_ZONE("RaytracingSample::LoadAssets");
 
 		//Describe an empty root signature.
 		CD3DX12_ROOT_SIGNATURE_DESC rootSignatureDesc;
 		rootSignatureDesc.Init(0, nullptr, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
-		const wchar_t* shaderFilePath = L"resources/shaders/shaders.hlsl";
-
 		//Define the vertex input layout.
 		std::array< D3D12_INPUT_ELEMENT_DESC, 2> inputElementDescs;
 		inputElementDescs.at(0) = { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
@@ -112,8 +155,8 @@ namespace RaytracingImplementation
 		psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
 		psoDesc.SampleDesc.Count = 1;
 
-		gpu.CreatePipelineState(rootSignatureDesc, psoDesc, shaderFilePath, 
-			shaderFilePath, inputElementDescs);
+		gpu.CreatePipelineState(rootSignatureDesc, psoDesc, kShaderFilePath, 
+			kShaderFilePath, inputElementDescs);
 
 		Vertex triangleVertices[] = {
 		{{0.0f, 0.25f * m_windowAspectRatio, 0.0f}, {1.0f, 1.0f, 0.0f, 1.0f}},
@@ -125,19 +168,183 @@ namespace RaytracingImplementation
 		gpu.CreateVertexBuffer(vertexBufferSize, m_vertexBuffer, m_vertexBufferView, 
 			triangleVertices, sizeof(triangleVertices));
 
+		if (!m_traversalStatisticsPath.empty())
+		{
+			WriteTraversalStatistics(triangleVertices, _countof(triangleVertices));
+		}
+		if (!m_bvhReportPath.empty())
+		{
+			WriteBvhReport(triangleVertices, _countof(triangleVertices));
+		}
+
 	}
 
 	// Update frame-based values.
-	void RaytracingSample::OnUpdate() {}
+	void RaytracingSample::OnUpdate()
+	{
+		PROFILE_ZONE("RaytracingSample::OnUpdate");
+		// Pick up the edits of the raytracing shaders without restarting
+		if (gpu.GetRaytracingSupport())
+		{
+			gpu.ReloadModifiedShaders();
+
+			// With -refit, the top-level AS is refitted every frame with the transform
+			// the instance was built with, so that the cost of the refits and their
+			// overlap with the rendering can be measured on an unchanged image
+			if (m_refitEveryFrame && !gpu.raster)
+			{
+				gpu.UpdateTopLevelAS({ DirectX::XMMatrixIdentity() });
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The rays are the ones of RayGen.hlsl, one per pixel. The DXR traversal is
+	// opaque to the shaders, so the CPU BVH stands for the bottom-level AS
+	//
+	void RaytracingSample::WriteTraversalStatistics(const Vertex* vertices, size_t vertexCount) const
+	{
+		PROFILE_ZONE("RaytracingSample::WriteTraversalStatistics");
+		const TriangleBvh bvh(GetPositions(vertices, vertexCount), TriangleBvh::BuildOptions{});
+
+		TraversalHeatmap heatmap(m_windowWidth, m_windowHeight);
+		for (UINT y = 0; y < m_windowHeight; y++)
+		{
+			for (UINT x = 0; x < m_windowWidth; x++)
+			{
+				TriangleBvh::Hit hit;
+				TraversalStatistics statistics;
+				bvh.Intersect(GetPrimaryRay(x, y, m_windowWidth, m_windowHeight), hit, statistics);
+				heatmap.Record(x, y, statistics.counters);
+			}
+		}
+
+		const std::filesystem::path directory(m_traversalStatisticsPath);
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		bool written = heatmap.WriteCsv(directory / "traversal.csv");
+		for (UINT counter = 0; counter < TraversalHeatmap::kCounterCount; counter++)
+		{
+			const TraversalHeatmap::Counter heatmapCounter = TraversalHeatmap::Counter(counter);
+			written = heatmap.WriteImage(heatmapCounter,
+				directory / (std::string(TraversalHeatmap::GetCounterName(heatmapCounter)) + ".bmp")) && written;
+		}
+		if (!written)
+		{
+			OutputDebugStringW((L"Cannot write the traversal statistics to " + m_traversalStatisticsPath + L"\n").c_str());
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The builders are compared on the primary rays of the raytracing pass, the
+	// rays the bottom-level AS is built for
+	//
+	void RaytracingSample::WriteBvhReport(const Vertex* vertices, size_t vertexCount) const
+	{
+		PROFILE_ZONE("RaytracingSample::WriteBvhReport");
+		std::vector<TriangleBvh::Ray> rays;
+		rays.reserve(size_t(m_windowWidth) * m_windowHeight);
+		for (UINT y = 0; y < m_windowHeight; y++)
+		{
+			for (UINT x = 0; x < m_windowWidth; x++)
+			{
+				rays.push_back(GetPrimaryRay(x, y, m_windowWidth, m_windowHeight));
+			}
+		}
+
+		const std::vector<BvhQuality> qualities = BvhAnalyzer::CompareBuilders(GetPositions(vertices, vertexCount),
+			rays, TriangleBvh::BuildOptions{});
+		if (!BvhAnalyzer::WriteCsv(qualities, m_bvhReportPath))
+		{
+			OutputDebugStringW((L"Cannot write the BVH report to " + m_bvhReportPath + L"\n").c_str());
+		}
+	}
 
 	// Render the scene.
 	void RaytracingSample::OnRender()
 	{
+		PROFILE_ZONE("RaytracingSample::OnRender");
 		gpu.PopulateCommandList(m_vertexBufferView);
 		gpu.Swap();
+		UpdateFrameStatistics();
+
+		if (m_benchmarkFrameCount != 0 && m_frameCount == m_benchmarkFrameCount)
+		{
+			PostQuitMessage(0);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The frame time is measured between consecutive presents, so it includes
+	// any wait on the GPU or on the swap chain. The ray throughput is measured
+	// on the GPU time of the DispatchRays pass instead, which does not depend on
+	// the presentation. Only the primary rays, one per pixel, are counted: each
+	// primary ray hitting the scene traces a shadow ray from its closest hit,
+	// whose number is not known on the CPU. The memory is only queried once per
+	// interval
+	//
+	void RaytracingSample::UpdateFrameStatistics()
+	{
+		PROFILE_ZONE("RaytracingSample::UpdateFrameStatistics");
+		const auto now = std::chrono::steady_clock::now();
+		if (m_frameCount++ == 0)
+		{
+			m_startTime = now;
+			m_lastFrameTime = now;
+			return;
+		}
+
+		const double frameMilliseconds = std::chrono::duration<double, std::milli>(now - m_lastFrameTime).count();
+		m_lastFrameTime = now;
+		m_frameStatistics.Record(FrameStatistics::kFrameTime, frameMilliseconds);
+		// The GPU timings are read back a few frames late, and none may be available yet
+		const double gpuMilliseconds = gpu.GetGpuTimer().GetLastSubmissionMilliseconds();
+		if (gpuMilliseconds > 0.0)
+		{
+			m_frameStatistics.Record(FrameStatistics::kGpuTime, gpuMilliseconds);
+		}
+		const double dispatchMilliseconds = GetLastPassMilliseconds(gpu.GetGpuTimer(), "DispatchRays");
+		if (!gpu.raster && dispatchMilliseconds > 0.0)
+		{
+			const double rayCount = double(m_windowWidth) * double(m_windowHeight);
+			m_frameStatistics.Record(FrameStatistics::kMegaraysPerSecond, rayCount / (dispatchMilliseconds * 1000.0));
+		}
+
+		if (!m_frameStatistics.Advance(std::chrono::duration<double>(now - m_startTime).count()))
+		{
+			return;
+		}
+		m_frameStatistics.Record(FrameStatistics::kMemoryUsage, double(gpu.GetVideoMemoryUsage()) / (1024.0 * 1024.0));
+
+		const FrameStatistics::Summary frameTime = m_frameStatistics.GetRecentSummary(FrameStatistics::kFrameTime);
+		const FrameStatistics::Summary gpuTime = m_frameStatistics.GetRecentSummary(FrameStatistics::kGpuTime);
+		const FrameStatistics::Summary megarays = m_frameStatistics.GetRecentSummary(FrameStatistics::kMegaraysPerSecond);
+		const FrameStatistics::Summary memory = m_frameStatistics.GetRecentSummary(FrameStatistics::kMemoryUsage);
+		std::wostringstream text;
+		text << std::fixed << std::setprecision(2) << L"frame " << frameTime.p50 << L"/" << frameTime.p95 << L"/" <<
+			frameTime.p99 << L" ms (p50/p95/p99), GPU " << gpuTime.p50 << L"/" << gpuTime.p95 << L"/" << gpuTime.p99 << L" ms";
+		if (megarays.count != 0)
+		{
+			text << L", " << std::setprecision(0) << megarays.p50 << L" Mrays/s";
+		}
+		text << L", " << std::setprecision(0) << memory.max << L" MB";
+		SetCustomWindowText(text.str().c_str());
 	}
 
-	void RaytracingSample::OnDestroy() {}
+	void RaytracingSample::OnDestroy()
+	{
+		if (!m_profilePath.empty() && !Profiler::WriteChromeTrace(m_profilePath))
+		{
+			OutputDebugStringW((L"Cannot write the profile to " + m_profilePath + L"\n").c_str());
+		}
+		if (!m_statisticsPath.empty() && !m_frameStatistics.WriteCsv(m_statisticsPath))
+		{
+			OutputDebugStringW((L"Cannot write the frame statistics to " + m_statisticsPath + L"\n").c_str());
+		}
+	}
 
 	void RaytracingSample::OnKeyDown(UINT8) {}
 
@@ -177,9 +384,68 @@ namespace RaytracingImplementation
 				gpu.useWarpDevice = true;
 				m_title = m_title + L" (WARP)";
 			}
+			else if ((_wcsnicmp(argv[i], L"-frames", wcslen(argv[i])) == 0 ||
+				_wcsnicmp(argv[i], L"/frames", wcslen(argv[i])) == 0) && i + 1 < argc)
+			{
+				// Number of frames in flight, clamped to the supported range
+				const int frames = _wtoi(argv[++i]);
+				gpu.SetFramesInFlight(static_cast<UINT>(std::min<int>(std::max<int>(frames,
+					FramePacer::kMinFrameCount), FramePacer::kMaxFrameCount)));
+			}
+			else if ((_wcsnicmp(argv[i], L"-profile", wcslen(argv[i])) == 0 ||
+				_wcsnicmp(argv[i], L"/profile", wcslen(argv[i])) == 0) && i + 1 < argc)
+			{
+				// Record the CPU zones from the start, and write them as a Chrome
+				// trace on exit
+				m_profilePath = argv[++i];
+				Profiler::SetEnabled(true);
+			}
+			else if ((_wcsnicmp(argv[i], L"-stats", wcslen(argv[i])) == 0 ||
+				_wcsnicmp(argv[i], L"/stats", wcslen(argv[i])) == 0) && i + 1 < argc)
+			{
+				// Write the percentiles of the whole run as CSV on exit
+				m_statisticsPath = argv[++i];
+			}
+			else if ((_wcsnicmp(argv[i], L"-benchmark", wcslen(argv[i])) == 0 ||
+				_wcsnicmp(argv[i], L"/benchmark", wcslen(argv[i])) == 0) && i + 1 < argc)
+			{
+				// Exit after a number of frames, writing the statistics for unattended
+				// runs
+				m_benchmarkFrameCount = static_cast<UINT64>(std::max<int>(_wtoi(argv[++i]), 1));
+				if (m_statisticsPath.empty())
+				{
+					m_statisticsPath = L"frame_statistics.csv";
+				}
+			}
+			else if (_wcsnicmp(argv[i], L"-refit", wcslen(argv[i])) == 0 ||
+				_wcsnicmp(argv[i], L"/refit", wcslen(argv[i])) == 0)
+			{
+				m_refitEveryFrame = true;
+			}
+			else if ((_wcsnicmp(argv[i], L"-raystats", wcslen(argv[i])) == 0 ||
+				_wcsnicmp(argv[i], L"/raystats", wcslen(argv[i])) == 0) && i + 1 < argc)
+			{
+				// Write the traversal heatmaps of the CPU BVH to a directory on start
+				m_traversalStatisticsPath = argv[++i];
+			}
+			else if ((_wcsnicmp(argv[i], L"-bvhreport", wcslen(argv[i])) == 0 ||
+				_wcsnicmp(argv[i], L"/bvhreport", wcslen(argv[i])) == 0) && i + 1 < argc)
+			{
+				// Compare the CPU BVH builders on the sample geometry, written as CSV
+				// on start
+				m_bvhReportPath = argv[++i];
+			}
 		}
 	}
 
+	std::vector<ShaderRequest> RaytracingSample::GetShaderManifest()
+	{
+		std::vector<ShaderRequest> manifest = Dx12Api::GetShaderManifest();
+		manifest.push_back(ShaderCompileService::GetShaderRequest(kShaderFilePath, "VSMain", "vs_5_0", Dx12Api::kShaderCompileFlags));
+		manifest.push_back(ShaderCompileService::GetShaderRequest(kShaderFilePath, "PSMain", "ps_5_0", Dx12Api::kShaderCompileFlags));
+		return manifest;
+	}
+
 	// Helper function for setting the window's title text.
 	void RaytracingSample::SetCustomWindowText(LPCWSTR text)
 	{
@@ -16,6 +16,8 @@
 
 #include "IApplication.h"
 #include "dx12/Dx12Api.h"
+#include "dx12/FrameStatistics.h"
+#include <chrono>
 
 namespace RaytracingImplementation
 {
@@ -41,17 +43,47 @@ namespace RaytracingImplementation
 
 		virtual void ParseCommandLineArgs(_In_reads_(argc) WCHAR* argv[], int argc);
 
+		// Shaders of the sample, to be built into the shader archive
+		static std::vector<ShaderRequest> GetShaderManifest();
+
 	private:
+		static constexpr const wchar_t* kShaderFilePath = L"resources/shaders/shaders.hlsl";
 
 		void SetUpPipeline();
 		void LoadAssets();
 		void SetCustomWindowText(LPCWSTR text);
+		// Record the statistics of the frame just presented, and refresh the title
+		// with the recent percentiles
+		void UpdateFrameStatistics();
+		// Trace the primary rays of the raytracing pass through a CPU BVH of the
+		// triangles, and write the traversal heatmaps and their aggregates
+		void WriteTraversalStatistics(const Vertex* vertices, size_t vertexCount) const;
+		// Build the triangles with every CPU BVH builder, and write their quality
+		// and trace speed side by side
+		void WriteBvhReport(const Vertex* vertices, size_t vertexCount) const;
 
 		// Window vars
 		std::wstring m_title;
 		UINT m_windowWidth;
 		UINT m_windowHeight;
 		float m_windowAspectRatio;
+		// Chrome trace written on exit, given with -profile
+		std::wstring m_profilePath;
+		// Frame statistics written on exit as CSV, given with -stats
+		std::wstring m_statisticsPath;
+		// Frames rendered before exiting, given with -benchmark, or 0 to run until closed
+		UINT64 m_benchmarkFrameCount = 0;
+		// Directory of the CPU traversal statistics written on start, given with -raystats
+		std::wstring m_traversalStatisticsPath;
+		// Comparison of the BVH builders written on start as CSV, given with -bvhreport
+		std::wstring m_bvhReportPath;
+
+		FrameStatistics m_frameStatistics;
+		std::chrono::steady_clock::time_point m_startTime;
+		std::chrono::steady_clock::time_point m_lastFrameTime;
+		UINT64 m_frameCount = 0;
+		// Refit the top-level AS every frame, given with -refit
+		bool m_refitEveryFrame = false;
 
 		// App resources.
 		static const UINT FrameCount = 2;
@@ -0,0 +1,111 @@
+#include "stdafx.h"
+#include <algorithm>
+#include "BottomLevelASBuildScheduler.h"
+#include "dx12/dxr/DXRHelper.h"
+
+namespace RaytracingImplementation
+{
+
+	BottomLevelASBuildScheduler::BottomLevelASBuildScheduler(UINT64 scratchBudgetInBytes) :
+		m_scratchBudget(scratchBudgetInBytes)
+	{
+	}
+
+	void BottomLevelASBuildScheduler::SetScratchBudget(UINT64 scratchBudgetInBytes)
+	{
+		m_scratchBudget = scratchBudgetInBytes;
+	}
+
+	void BottomLevelASBuildScheduler::Enqueue(const NvHelpers::BottomLevelASGenerator& generator,
+		UINT64 scratchSizeInBytes, const Microsoft::WRL::ComPtr<ID3D12Resource>& resultBuffer)
+	{
+		m_pending.push_back({ generator, scratchSizeInBytes, resultBuffer });
+	}
+
+	std::vector<BottomLevelASBuildScheduler::Batch> BottomLevelASBuildScheduler::PlanBatches(
+		const std::vector<UINT64>& scratchSizes, UINT64 budget)
+	{
+		return PlanScratchBatches(scratchSizes, budget, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+	}
+
+	void BottomLevelASBuildScheduler::Flush(ID3D12Device5* device, ID3D12GraphicsCommandList4* commandList)
+	{
+		if (m_pending.empty())
+		{
+			m_lastBatchCount = 0;
+			return;
+		}
+
+		std::vector<UINT64> scratchSizes;
+		scratchSizes.reserve(m_pending.size());
+		for (const Request& request : m_pending)
+		{
+			scratchSizes.push_back(request.scratchSizeInBytes);
+		}
+
+		std::vector<Batch> batches = PlanBatches(scratchSizes, m_scratchBudget);
+
+		// A single scratch buffer, large enough for the largest batch, is shared by
+		// all of them
+		UINT64 requiredScratch = 0;
+		for (const Batch& batch : batches)
+		{
+			requiredScratch = std::max<UINT64>(requiredScratch, batch.scratchSizeInBytes);
+		}
+		ReserveScratch(device, requiredScratch);
+
+		const D3D12_GPU_VIRTUAL_ADDRESS scratchAddress = m_scratch->GetGPUVirtualAddress();
+		for (const Batch& batch : batches)
+		{
+			// The builds of a batch use disjoint scratch regions and results, so
+			// they can overlap on the GPU
+			for (size_t i = 0; i < batch.requests.size(); i++)
+			{
+				Request& request = m_pending[batch.requests[i]];
+				request.generator.GenerateUnsynchronized(commandList,
+					scratchAddress + batch.scratchOffsets[i], request.result.Get());
+			}
+
+			// Wait for the whole batch before reusing the scratch regions, and before
+			// the results are consumed. A null UAV barrier covers both the scratch
+			// buffer and all the results written by the batch
+			D3D12_RESOURCE_BARRIER uavBarrier = {};
+			uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+			uavBarrier.UAV.pResource = nullptr;
+			uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+			commandList->ResourceBarrier(1, &uavBarrier);
+		}
+
+		m_lastBatchCount = batches.size();
+		m_pending.clear();
+	}
+
+	void BottomLevelASBuildScheduler::ReleaseScratch()
+	{
+		m_scratch.Reset();
+		m_retiredScratch.clear();
+		m_scratchSize = 0;
+	}
+
+	void BottomLevelASBuildScheduler::ReserveScratch(ID3D12Device5* device, UINT64 sizeInBytes)
+	{
+		if (m_scratch && m_scratchSize >= sizeInBytes)
+		{
+			return;
+		}
+
+		// The previous scratch buffer, if any, may still be referenced by a command
+		// list which has not been executed yet: the command list keeps no reference
+		// on it, so it is only released by ReleaseScratch
+		if (m_scratch)
+		{
+			m_retiredScratch.push_back(m_scratch);
+		}
+
+		m_scratch.Attach(NvHelpers::CreateBuffer(
+			device, sizeInBytes,
+			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+			NvHelpers::kDefaultHeapProps));
+		m_scratchSize = sizeInBytes;
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef BOTTOM_LEVEL_AS_BUILD_SCHEDULER_GUARD
+#define BOTTOM_LEVEL_AS_BUILD_SCHEDULER_GUARD
+
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <vector>
+#include "ScratchBatchPlanner.h"
+#include "dx12/dxr/nv_helpers_dx12/BottomLevelASGenerator.h"
+
+namespace RaytracingImplementation
+{
+	// Collects bottom-level AS build requests and records them in batches sharing a
+	// single scratch buffer. Requests are sorted by decreasing scratch size and
+	// packed into batches whose total scratch footprint stays under a configurable
+	// budget. The builds of a batch run concurrently on the GPU, each in its own
+	// region of the scratch buffer; a single UAV barrier separates two batches, after
+	// which the scratch regions are reused. Hundreds of meshes can then be built with
+	// a fixed amount of scratch memory, in a single command list and without any CPU
+	// synchronization between the builds.
+	class BottomLevelASBuildScheduler
+	{
+	public:
+		// A batch as planned by PlanBatches: the requests it contains, in build order,
+		// and the offset of each request in the scratch buffer
+		using Batch = ScratchBatch;
+
+		explicit BottomLevelASBuildScheduler(UINT64 scratchBudgetInBytes = kDefaultScratchBudget);
+
+		BottomLevelASBuildScheduler(const BottomLevelASBuildScheduler&) = delete;
+		BottomLevelASBuildScheduler& operator = (const BottomLevelASBuildScheduler&) = delete;
+
+		// Maximum amount of scratch memory used by a batch. A single request larger
+		// than the budget is built alone, with a scratch buffer of its own size.
+		void SetScratchBudget(UINT64 scratchBudgetInBytes);
+		inline UINT64 GetScratchBudget() const { return m_scratchBudget; }
+
+		// Queue the build of a bottom-level AS. ComputeASBufferSizes must have been
+		// called on the generator, and the result buffer allocated accordingly.
+		void Enqueue(const NvHelpers::BottomLevelASGenerator& generator, UINT64 scratchSizeInBytes,
+			const Microsoft::WRL::ComPtr<ID3D12Resource>& resultBuffer);
+
+		// Record all the pending builds on the command list. The results can be used
+		// right after this call in the same command list, e.g. to build a top-level AS.
+		void Flush(ID3D12Device5* device, ID3D12GraphicsCommandList4* commandList);
+
+		// Release the scratch buffer. This must only be called once the command list
+		// passed to the last Flush has completed execution on the GPU.
+		void ReleaseScratch();
+
+		inline size_t GetPendingCount() const { return m_pending.size(); }
+		// Number of batches recorded by the last Flush
+		inline size_t GetLastBatchCount() const { return m_lastBatchCount; }
+
+		// Sort the requests by decreasing scratch size and pack them into batches of
+		// at most budget bytes of scratch memory, each region being aligned on the
+		// AS alignment requirement. See PlanScratchBatches
+		static std::vector<Batch> PlanBatches(const std::vector<UINT64>& scratchSizes, UINT64 budget);
+
+		static constexpr UINT64 kDefaultScratchBudget = 32ull * 1024 * 1024;
+
+	private:
+		struct Request
+		{
+			NvHelpers::BottomLevelASGenerator generator;
+			UINT64 scratchSizeInBytes;
+			Microsoft::WRL::ComPtr<ID3D12Resource> result;
+		};
+
+		// Make sure the scratch buffer holds at least the given size
+		void ReserveScratch(ID3D12Device5* device, UINT64 sizeInBytes);
+
+		std::vector<Request> m_pending;
+		UINT64 m_scratchBudget;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_scratch;
+		UINT64 m_scratchSize = 0;
+		// Smaller scratch buffers replaced by a larger one, kept alive until
+		// ReleaseScratch since pending command lists may still reference them
+		std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> m_retiredScratch;
+
+		size_t m_lastBatchCount = 0;
+	};
+}
+
+#endif // !BOTTOM_LEVEL_AS_BUILD_SCHEDULER_GUARD
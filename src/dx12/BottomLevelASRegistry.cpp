@@ -0,0 +1,68 @@
+#include "BottomLevelASRegistry.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		bool IsSameGeometry(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b)
+		{
+			return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size()) == 0);
+		}
+	}
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> BottomLevelASRegistry::Acquire(uint64_t key, const std::vector<uint8_t>& geometry)
+	{
+		auto range = m_entries.equal_range(key);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (IsSameGeometry(it->second.geometry, geometry))
+			{
+				m_hits++;
+				it->second.refCount++;
+				return it->second.bottomLevelAS;
+			}
+		}
+
+		m_misses++;
+		return nullptr;
+	}
+
+	void BottomLevelASRegistry::Register(uint64_t key, const std::vector<uint8_t>& geometry,
+		const Microsoft::WRL::ComPtr<ID3D12Resource>& bottomLevelAS)
+	{
+		auto range = m_entries.equal_range(key);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (IsSameGeometry(it->second.geometry, geometry))
+			{
+				throw std::logic_error("A bottom-level AS is already registered for this geometry");
+			}
+		}
+		m_entries.emplace(key, Entry{ geometry, bottomLevelAS, 1 });
+	}
+
+	void BottomLevelASRegistry::Release(uint64_t key, ID3D12Resource* bottomLevelAS)
+	{
+		auto range = m_entries.equal_range(key);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second.bottomLevelAS.Get() != bottomLevelAS)
+			{
+				continue;
+			}
+
+			if (--it->second.refCount == 0)
+			{
+				m_entries.erase(it);
+			}
+			return;
+		}
+	}
+
+	void BottomLevelASRegistry::Clear()
+	{
+		m_entries.clear();
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef BOTTOM_LEVEL_AS_REGISTRY_GUARD
+#define BOTTOM_LEVEL_AS_REGISTRY_GUARD
+
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Registry of the bottom-level acceleration structures, keyed by a hash of the geometry they
+	// were built from (vertex/index content, layout and build flags). Identical geometry resolves to
+	// a single structure, which can then be referenced by any number of top-level instances. The
+	// description of the geometry is kept along with each structure and compared on a hash match,
+	// so that a hash collision never shares a structure between different geometries. The
+	// registry keeps a reference count per structure and drops it once the last user released it.
+	class BottomLevelASRegistry
+	{
+	public:
+		// Return the structure registered for the geometry and add a reference to it, or nullptr
+		// if no such structure exists. The key is the hash of the geometry description
+		Microsoft::WRL::ComPtr<ID3D12Resource> Acquire(uint64_t key, const std::vector<uint8_t>& geometry);
+
+		// Register a newly built structure for the geometry, with a reference count of 1
+		void Register(uint64_t key, const std::vector<uint8_t>& geometry,
+			const Microsoft::WRL::ComPtr<ID3D12Resource>& bottomLevelAS);
+
+		// Remove a reference to the structure, which is dropped from the registry once unused
+		void Release(uint64_t key, ID3D12Resource* bottomLevelAS);
+
+		// Drop all the structures, regardless of their reference count
+		void Clear();
+
+		// Statistics
+		inline size_t GetUniqueCount() const { return m_entries.size(); }
+		inline UINT64 GetHitCount() const { return m_hits; }
+		inline UINT64 GetMissCount() const { return m_misses; }
+
+	private:
+		struct Entry
+		{
+			std::vector<uint8_t> geometry;
+			Microsoft::WRL::ComPtr<ID3D12Resource> bottomLevelAS;
+			UINT refCount;
+		};
+
+		// Geometries with the same hash are kept side by side
+		std::unordered_multimap<uint64_t, Entry> m_entries;
+		UINT64 m_hits = 0;
+		UINT64 m_misses = 0;
+	};
+}
+
+#endif // !BOTTOM_LEVEL_AS_REGISTRY_GUARD
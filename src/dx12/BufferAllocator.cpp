@@ -0,0 +1,186 @@
+#include "stdafx.h"
+#include <algorithm>
+#include "BufferAllocator.h"
+
+namespace RaytracingImplementation
+{
+
+	BufferAllocator::BufferAllocator(UINT64 heapSizeInBytes) :
+		m_heapSize(ROUND_UP(heapSizeInBytes, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT))
+	{
+	}
+
+	BufferAllocator::~BufferAllocator()
+	{
+		// Drop the references on the buffers before their heaps
+		m_pendingFrees.clear();
+		m_allocations.clear();
+		m_heaps.clear();
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// Place the buffer in the first heap of the requested type with enough room,
+	// creating a new heap if none has. Returning nullptr lets CreateBuffer fall back
+	// to a committed resource.
+	//
+	ID3D12Resource* BufferAllocator::CreateBuffer(ID3D12Device* device, uint64_t size,
+		D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initState, const D3D12_HEAP_PROPERTIES& heapProps)
+	{
+		if (heapProps.Type == D3D12_HEAP_TYPE_CUSTOM)
+		{
+			return nullptr;
+		}
+
+		D3D12_RESOURCE_DESC bufDesc = {};
+		bufDesc.Alignment = 0;
+		bufDesc.DepthOrArraySize = 1;
+		bufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		bufDesc.Flags = flags;
+		bufDesc.Format = DXGI_FORMAT_UNKNOWN;
+		bufDesc.Height = 1;
+		bufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+		bufDesc.MipLevels = 1;
+		bufDesc.SampleDesc.Count = 1;
+		bufDesc.SampleDesc.Quality = 0;
+		bufDesc.Width = size;
+
+		// The device gives the size and alignment the buffer takes in a heap
+		const D3D12_RESOURCE_ALLOCATION_INFO info = device->GetResourceAllocationInfo(0, 1, &bufDesc);
+		if (info.SizeInBytes == UINT64_MAX || info.SizeInBytes > m_heapSize)
+		{
+			return nullptr;
+		}
+		const UINT64 alignment = std::max<UINT64>(info.Alignment, TlsfAllocator::kMinAlignment);
+
+		Heap* target = nullptr;
+		UINT64 offset = TlsfAllocator::kInvalidOffset;
+		for (const std::unique_ptr<Heap>& heap : m_heaps)
+		{
+			if (heap->type != heapProps.Type)
+			{
+				continue;
+			}
+			offset = heap->allocator->Allocate(info.SizeInBytes, alignment);
+			if (offset != TlsfAllocator::kInvalidOffset)
+			{
+				target = heap.get();
+				break;
+			}
+		}
+		if (!target)
+		{
+			target = &CreateHeap(device, heapProps.Type);
+			offset = target->allocator->Allocate(info.SizeInBytes, alignment);
+		}
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+		HRESULT hr = device->CreatePlacedResource(target->heap.Get(), offset, &bufDesc, initState,
+			nullptr, IID_PPV_ARGS(&buffer));
+		if (FAILED(hr))
+		{
+			target->allocator->Free(offset);
+			ThrowIfFailed(hr);
+		}
+
+		m_allocations.push_back({ buffer, target, offset });
+
+		// The caller owns the returned reference, as with a committed resource
+		return buffer.Detach();
+	}
+
+	BufferAllocator::Heap& BufferAllocator::CreateHeap(ID3D12Device* device, D3D12_HEAP_TYPE type)
+	{
+		D3D12_HEAP_DESC heapDesc = {};
+		heapDesc.SizeInBytes = m_heapSize;
+		heapDesc.Properties.Type = type;
+		heapDesc.Properties.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+		heapDesc.Properties.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+		heapDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+		// Resource heap tier 1 requires the buffers to live in heaps of their own
+		heapDesc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+
+		std::unique_ptr<Heap> heap = std::make_unique<Heap>();
+		heap->type = type;
+		ThrowIfFailed(device->CreateHeap(&heapDesc, IID_PPV_ARGS(&heap->heap)));
+		heap->allocator = std::make_unique<TlsfAllocator>(m_heapSize);
+
+		m_heaps.push_back(std::move(heap));
+		return *m_heaps.back();
+	}
+
+	void BufferAllocator::Close(uint64_t fenceValue)
+	{
+		// A buffer whose only reference is the one held here is no longer used by the
+		// application, but may still be by the submissions up to this fence value
+		size_t kept = 0;
+		for (size_t i = 0; i < m_allocations.size(); i++)
+		{
+			Allocation& allocation = m_allocations[i];
+			allocation.resource->AddRef();
+			if (allocation.resource->Release() > 1)
+			{
+				if (kept != i)
+				{
+					m_allocations[kept] = std::move(allocation);
+				}
+				kept++;
+			}
+			else
+			{
+				m_pendingFrees.push_back({ std::move(allocation), fenceValue });
+			}
+		}
+		m_allocations.resize(kept);
+	}
+
+	void BufferAllocator::Retire(uint64_t completedFenceValue)
+	{
+		if (m_pendingFrees.empty() || m_pendingFrees.front().fenceValue > completedFenceValue)
+		{
+			return;
+		}
+
+		while (!m_pendingFrees.empty() && m_pendingFrees.front().fenceValue <= completedFenceValue)
+		{
+			Allocation& allocation = m_pendingFrees.front().allocation;
+			allocation.resource.Reset();
+			allocation.heap->allocator->Free(allocation.offset);
+			m_pendingFrees.pop_front();
+		}
+
+		// Keep one heap per type around to avoid recreating it on the next allocation
+		std::vector<D3D12_HEAP_TYPE> keptTypes;
+		auto empty = std::remove_if(m_heaps.begin(), m_heaps.end(),
+			[&keptTypes](const std::unique_ptr<Heap>& heap)
+			{
+				if (!heap->allocator->IsEmpty())
+				{
+					return false;
+				}
+				if (std::find(keptTypes.begin(), keptTypes.end(), heap->type) == keptTypes.end())
+				{
+					keptTypes.push_back(heap->type);
+					return false;
+				}
+				return true;
+			});
+		m_heaps.erase(empty, m_heaps.end());
+	}
+
+	TlsfAllocator::Statistics BufferAllocator::GetStatistics() const
+	{
+		TlsfAllocator::Statistics total;
+		for (const std::unique_ptr<Heap>& heap : m_heaps)
+		{
+			const TlsfAllocator::Statistics stats = heap->allocator->GetStatistics();
+			total.totalSize += stats.totalSize;
+			total.usedSize += stats.usedSize;
+			total.freeSize += stats.freeSize;
+			total.largestFreeBlock = std::max<uint64_t>(total.largestFreeBlock, stats.largestFreeBlock);
+			total.allocationCount += stats.allocationCount;
+			total.freeBlockCount += stats.freeBlockCount;
+		}
+		return total;
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef BUFFER_ALLOCATOR_GUARD
+#define BUFFER_ALLOCATOR_GUARD
+
+#pragma once
+
+#include <d3d12.h>
+#include <wrl/client.h>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "TlsfAllocator.h"
+#include "dx12/dxr/DXRHelper.h"
+
+namespace RaytracingImplementation
+{
+	// Places the buffers created through NvHelpers::CreateBuffer in large heaps instead of
+	// creating one committed resource per buffer. Each heap is managed by a TLSF allocator,
+	// and the buffers are placed on the alignment reported by the device for them. Buffers
+	// larger than a heap, or in heaps of custom type, still get a committed resource.
+	//
+	// The allocator keeps a reference on every placed buffer. Close, called with the fence
+	// value signaled after a submission, tags the buffers no longer referenced anywhere else
+	// with that value; Retire releases the tagged buffers whose fence value has been reached
+	// and returns their memory to the heap, as UploadRing and DescriptorAllocator do with
+	// their regions. Releases are detected by looking at the reference count of every placed
+	// buffer, which is cheap for the few large buffers the heaps are meant for.
+	class BufferAllocator : public NvHelpers::IBufferAllocator
+	{
+	public:
+		explicit BufferAllocator(UINT64 heapSizeInBytes = kDefaultHeapSize);
+		~BufferAllocator() override;
+
+		BufferAllocator(const BufferAllocator&) = delete;
+		BufferAllocator& operator = (const BufferAllocator&) = delete;
+
+		ID3D12Resource* CreateBuffer(ID3D12Device* device, uint64_t size, D3D12_RESOURCE_FLAGS flags,
+			D3D12_RESOURCE_STATES initState, const D3D12_HEAP_PROPERTIES& heapProps) override;
+
+		// Tag the buffers only referenced by the allocator with the fence value signaled
+		// after the last submission which may use them
+		void Close(uint64_t fenceValue);
+
+		// Free the memory of the tagged buffers whose fence value is lower than or equal to
+		// the completed one, and the heaps left empty apart from the first one of each type
+		void Retire(uint64_t completedFenceValue);
+
+		// Statistics summed over all the heaps
+		TlsfAllocator::Statistics GetStatistics() const;
+		inline size_t GetHeapCount() const { return m_heaps.size(); }
+
+		static constexpr UINT64 kDefaultHeapSize = 64ull * 1024 * 1024;
+
+	private:
+		struct Heap
+		{
+			D3D12_HEAP_TYPE type;
+			Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+			std::unique_ptr<TlsfAllocator> allocator;
+		};
+
+		struct Allocation
+		{
+			Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+			Heap* heap;
+			UINT64 offset;
+		};
+
+		struct PendingFree
+		{
+			Allocation allocation;
+			uint64_t fenceValue;
+		};
+
+		Heap& CreateHeap(ID3D12Device* device, D3D12_HEAP_TYPE type);
+
+		UINT64 m_heapSize;
+		std::vector<std::unique_ptr<Heap>> m_heaps;
+		std::vector<Allocation> m_allocations;
+		// Released buffers, by increasing fence value
+		std::deque<PendingFree> m_pendingFrees;
+	};
+}
+
+#endif // !BUFFER_ALLOCATOR_GUARD
@@ -0,0 +1,278 @@
+#include "BvhAnalyzer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		using Vector3 = TriangleBvh::Vector3;
+		using Node = TriangleBvh::Node;
+
+		inline float GetAxis(const Vector3& vector, uint32_t axis)
+		{
+			return axis == 0 ? vector.x : axis == 1 ? vector.y : vector.z;
+		}
+
+		inline Vector3 Subtract(const Vector3& a, const Vector3& b)
+		{
+			return { a.x - b.x, a.y - b.y, a.z - b.z };
+		}
+
+		inline Vector3 Cross(const Vector3& a, const Vector3& b)
+		{
+			return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		inline double GetLength(const Vector3& vector)
+		{
+			return std::sqrt(double(vector.x) * vector.x + double(vector.y) * vector.y + double(vector.z) * vector.z);
+		}
+
+		double GetSurfaceArea(const Node& node)
+		{
+			const double dx = double(node.boundsMax.x) - node.boundsMin.x;
+			const double dy = double(node.boundsMax.y) - node.boundsMin.y;
+			const double dz = double(node.boundsMax.z) - node.boundsMin.z;
+			return 2.0 * (dx * dy + dy * dz + dz * dx);
+		}
+
+		bool Overlap(const Node& a, const Node& b)
+		{
+			return a.boundsMin.x <= b.boundsMax.x && b.boundsMin.x <= a.boundsMax.x &&
+				a.boundsMin.y <= b.boundsMax.y && b.boundsMin.y <= a.boundsMax.y &&
+				a.boundsMin.z <= b.boundsMax.z && b.boundsMin.z <= a.boundsMax.z;
+		}
+
+		// Clipping a triangle by the 6 planes of a box adds at most one vertex per plane
+		constexpr uint32_t kMaxClippedVertexCount = 9;
+
+		// Area of the part of a triangle inside a box, clipping it plane by plane
+		double GetClippedArea(const TriangleBvh::Triangle& triangle, const Node& box)
+		{
+			Vector3 polygons[2][kMaxClippedVertexCount] = { { triangle.v0, triangle.v1, triangle.v2 } };
+			uint32_t vertexCount = 3;
+			uint32_t current = 0;
+			for (uint32_t plane = 0; plane < 6 && vertexCount != 0; plane++)
+			{
+				const uint32_t axis = plane / 2;
+				const bool isMax = (plane % 2) != 0;
+				const float bound = GetAxis(isMax ? box.boundsMax : box.boundsMin, axis);
+				// Signed distance to the plane, positive inside the box
+				const auto getDistance = [&](const Vector3& vertex)
+				{
+					return isMax ? bound - GetAxis(vertex, axis) : GetAxis(vertex, axis) - bound;
+				};
+
+				const Vector3* input = polygons[current];
+				Vector3* output = polygons[1 - current];
+				uint32_t outputCount = 0;
+				for (uint32_t i = 0; i < vertexCount; i++)
+				{
+					const Vector3& a = input[i];
+					const Vector3& b = input[(i + 1) % vertexCount];
+					const float distanceA = getDistance(a);
+					const float distanceB = getDistance(b);
+					if (distanceA >= 0.0f)
+					{
+						output[outputCount++] = a;
+					}
+					if ((distanceA >= 0.0f) != (distanceB >= 0.0f))
+					{
+						const float t = distanceA / (distanceA - distanceB);
+						output[outputCount++] = { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+					}
+				}
+				vertexCount = outputCount;
+				current = 1 - current;
+			}
+
+			const Vector3* polygon = polygons[current];
+			Vector3 normal = { 0.0f, 0.0f, 0.0f };
+			for (uint32_t i = 1; i + 1 < vertexCount; i++)
+			{
+				const Vector3 cross = Cross(Subtract(polygon[i], polygon[0]), Subtract(polygon[i + 1], polygon[0]));
+				normal = { normal.x + cross.x, normal.y + cross.y, normal.z + cross.z };
+			}
+			return 0.5 * GetLength(normal);
+		}
+
+		// Area of the triangles outside the subtree of a node which overlap its box
+		double GetOverlappingArea(const TriangleBvh& bvh, uint32_t nodeIndex)
+		{
+			const std::vector<Node>& nodes = bvh.GetNodes();
+			const Node& box = nodes[nodeIndex];
+			double area = 0.0;
+			std::vector<uint32_t> stack = { 0 };
+			while (!stack.empty())
+			{
+				const uint32_t index = stack.back();
+				stack.pop_back();
+				const Node& node = nodes[index];
+				if (index == nodeIndex || !Overlap(node, box))
+				{
+					continue;
+				}
+				if (node.count == 0)
+				{
+					stack.push_back(node.firstIndex);
+					stack.push_back(node.firstIndex + 1);
+					continue;
+				}
+				for (uint32_t i = node.firstIndex; i < node.firstIndex + node.count; i++)
+				{
+					area += GetClippedArea(bvh.GetTriangles()[i], box);
+				}
+			}
+			return area;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The SAH cost sums the cost of each node weighted by the probability that a
+	// ray hitting the root hits its box, the ratio of their surface areas. The
+	// end-point overlap weights the same costs by the area of the foreign
+	// triangles inside each box over the area of all the triangles
+	//
+	BvhQuality BvhAnalyzer::Measure(const TriangleBvh& bvh)
+	{
+		BvhQuality quality;
+		const std::vector<Node>& nodes = bvh.GetNodes();
+		quality.nodeCount = nodes.size();
+		quality.memorySize = nodes.size() * sizeof(Node) +
+			bvh.GetTriangleCount() * (sizeof(TriangleBvh::Triangle) + sizeof(uint32_t));
+		if (nodes.empty())
+		{
+			return quality;
+		}
+
+		double triangleArea = 0.0;
+		for (const TriangleBvh::Triangle& triangle : bvh.GetTriangles())
+		{
+			triangleArea += 0.5 * GetLength(Cross(Subtract(triangle.v1, triangle.v0), Subtract(triangle.v2, triangle.v0)));
+		}
+
+		const double rootArea = GetSurfaceArea(nodes[0]);
+		double sahCost = 0.0;
+		double endPointOverlap = 0.0;
+		// Nodes with their depth, the root being at depth 1
+		std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 1 } };
+		while (!stack.empty())
+		{
+			const auto [index, depth] = stack.back();
+			stack.pop_back();
+			const Node& node = nodes[index];
+			quality.depth = std::max<uint32_t>(quality.depth, depth);
+
+			double cost = TriangleBvh::kTraversalCost;
+			if (node.count == 0)
+			{
+				stack.push_back({ node.firstIndex, depth + 1 });
+				stack.push_back({ node.firstIndex + 1, depth + 1 });
+			}
+			else
+			{
+				cost = double(TriangleBvh::kIntersectionCost) * node.count;
+				quality.leafCount++;
+				if (quality.leafSizes.size() <= node.count)
+				{
+					quality.leafSizes.resize(size_t(node.count) + 1, 0);
+				}
+				quality.leafSizes[node.count]++;
+			}
+
+			if (rootArea > 0.0)
+			{
+				sahCost += cost * GetSurfaceArea(node) / rootArea;
+			}
+			if (triangleArea > 0.0 && index != 0)
+			{
+				endPointOverlap += cost * GetOverlappingArea(bvh, index) / triangleArea;
+			}
+		}
+		quality.sahCost = sahCost;
+		quality.endPointOverlap = endPointOverlap;
+		quality.meanLeafSize = double(bvh.GetTriangleCount()) / double(quality.leafCount);
+		return quality;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The rays are traced twice: once without statistics for the speed, and once
+	// with them for the work per ray
+	//
+	std::vector<BvhQuality> BvhAnalyzer::CompareBuilders(const std::vector<TriangleBvh::Vector3>& vertices,
+		const std::vector<TriangleBvh::Ray>& rays, const TriangleBvh::BuildOptions& options)
+	{
+		std::vector<BvhQuality> qualities;
+		for (uint32_t builder = 0; builder < uint32_t(TriangleBvh::Builder::kCount); builder++)
+		{
+			TriangleBvh::BuildOptions builderOptions = options;
+			builderOptions.builder = TriangleBvh::Builder(builder);
+
+			const auto buildStart = std::chrono::steady_clock::now();
+			const TriangleBvh bvh(vertices, builderOptions);
+			const auto buildEnd = std::chrono::steady_clock::now();
+
+			BvhQuality quality = Measure(bvh);
+			quality.builder = builderOptions.builder;
+			quality.buildMilliseconds = std::chrono::duration<double, std::milli>(buildEnd - buildStart).count();
+			if (rays.empty())
+			{
+				qualities.push_back(std::move(quality));
+				continue;
+			}
+
+			TriangleBvh::Hit hit;
+			const auto traceStart = std::chrono::steady_clock::now();
+			for (const TriangleBvh::Ray& ray : rays)
+			{
+				bvh.Intersect(ray, hit);
+			}
+			const double traceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - traceStart).count();
+			if (traceSeconds > 0.0)
+			{
+				quality.megaraysPerSecond = double(rays.size()) / (traceSeconds * 1e6);
+			}
+
+			TraversalStatistics statistics;
+			for (const TriangleBvh::Ray& ray : rays)
+			{
+				bvh.Intersect(ray, hit, statistics);
+			}
+			quality.nodesVisitedPerRay = double(statistics.counters.nodesVisited) / double(rays.size());
+			quality.trianglesTestedPerRay = double(statistics.counters.trianglesTested) / double(rays.size());
+			qualities.push_back(std::move(quality));
+		}
+		return qualities;
+	}
+
+	bool BvhAnalyzer::WriteCsv(const std::vector<BvhQuality>& qualities, const std::filesystem::path& path)
+	{
+		std::ofstream file(path, std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		file << "builder,build_ms,nodes,leaves,depth,memory_bytes,sah_cost,epo,mean_leaf_size,"
+			"mrays_per_s,nodes_per_ray,triangles_per_ray,leaf_sizes\n";
+		for (const BvhQuality& quality : qualities)
+		{
+			file << TriangleBvh::GetBuilderName(quality.builder) << ',' << quality.buildMilliseconds << ',' <<
+				quality.nodeCount << ',' << quality.leafCount << ',' << quality.depth << ',' << quality.memorySize << ',' <<
+				quality.sahCost << ',' << quality.endPointOverlap << ',' << quality.meanLeafSize << ',' <<
+				quality.megaraysPerSecond << ',' << quality.nodesVisitedPerRay << ',' << quality.trianglesTestedPerRay << ',';
+			// Counts of the leaves of 0, 1, 2... triangles, separated by spaces to stay in a
+			// single column
+			for (size_t size = 0; size < quality.leafSizes.size(); size++)
+			{
+				file << (size == 0 ? "" : " ") << quality.leafSizes[size];
+			}
+			file << '\n';
+		}
+		return static_cast<bool>(file);
+	}
+}
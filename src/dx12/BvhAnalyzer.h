@@ -0,0 +1,64 @@
+#ifndef BVH_ANALYZER_GUARD
+#define BVH_ANALYZER_GUARD
+
+#pragma once
+
+#include "TriangleBvh.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Quality of a hierarchy. The SAH cost and the end-point overlap are relative to the
+	// cost of a ray intersecting the root, with the costs of TriangleBvh
+	struct BvhQuality
+	{
+		TriangleBvh::Builder builder = TriangleBvh::Builder::kBinnedSah;
+		double buildMilliseconds = 0.0;
+
+		uint64_t nodeCount = 0;
+		uint64_t leafCount = 0;
+		uint32_t depth = 0;
+		// Nodes, triangles and their indices
+		uint64_t memorySize = 0;
+
+		// Expected cost of a random ray hitting the root, by the surface area heuristic
+		double sahCost = 0.0;
+		// Expected cost of the nodes a ray visits although it hits a triangle they do not
+		// contain, as the surface of the triangles overlapping their boxes
+		double endPointOverlap = 0.0;
+
+		// Number of leaves holding each number of triangles, indexed by that number
+		std::vector<uint64_t> leafSizes;
+		double meanLeafSize = 0.0;
+
+		// Measured by tracing rays, when some are given
+		double megaraysPerSecond = 0.0;
+		double nodesVisitedPerRay = 0.0;
+		double trianglesTestedPerRay = 0.0;
+	};
+
+	// Compares the builders of TriangleBvh on a triangle list, to choose the build of a
+	// bottom-level AS from measurements: the binned SAH builder stands for the fast-trace
+	// build flag and the median ones for the fast-build flag. It does not depend on any
+	// platform header.
+	class BvhAnalyzer
+	{
+	public:
+		// Measure the structure of a hierarchy. The end-point overlap clips the triangles to
+		// the boxes they overlap, found through the hierarchy itself
+		static BvhQuality Measure(const TriangleBvh& bvh);
+
+		// Build the triangles, given by 3 consecutive vertices each, with every builder and
+		// measure each hierarchy, tracing the rays through it
+		static std::vector<BvhQuality> CompareBuilders(const std::vector<TriangleBvh::Vector3>& vertices,
+			const std::vector<TriangleBvh::Ray>& rays, const TriangleBvh::BuildOptions& options);
+
+		// Write one line per hierarchy, with the leaf sizes as a list of counts
+		static bool WriteCsv(const std::vector<BvhQuality>& qualities, const std::filesystem::path& path);
+	};
+}
+
+#endif // !BVH_ANALYZER_GUARD
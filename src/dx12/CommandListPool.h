@@ -0,0 +1,131 @@
+#ifndef COMMAND_LIST_POOL_GUARD
+#define COMMAND_LIST_POOL_GUARD
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Thread-safe pool of command lists and their allocators. Workers acquire an entry to
+	// record into and own it until it is released along with the fence value signaled after
+	// its submission; the entry is only handed out again, after being reset, once that fence
+	// value has completed.
+	//
+	// The entry type and the way entries are created and reset are provided by the user, so
+	// the pool does not depend on any platform header and can be driven by a stand-in device.
+	template <class Entry>
+	class CommandListPool
+	{
+	public:
+		// Create a new entry, ready for recording
+		using Factory = std::function<Entry()>;
+		// Make a retired entry ready for recording again
+		using Resetter = std::function<void(Entry&)>;
+
+		CommandListPool(Factory create, Resetter reset) :
+			m_create(std::move(create)),
+			m_reset(std::move(reset))
+		{
+		}
+
+		CommandListPool(const CommandListPool&) = delete;
+		CommandListPool& operator = (const CommandListPool&) = delete;
+
+		// Return an entry ready for recording: a retired entry whose fence value has
+		// completed, or a new one
+		Entry& Acquire(uint64_t completedFenceValue)
+		{
+			Slot* slot = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				for (const std::unique_ptr<Slot>& candidate : m_slots)
+				{
+					if (!candidate->inUse && candidate->fenceValue <= completedFenceValue)
+					{
+						slot = candidate.get();
+						break;
+					}
+				}
+				if (slot)
+				{
+					slot->inUse = true;
+				}
+			}
+
+			// Resetting and creating are done outside of the lock, so that workers
+			// do not serialize on them. A slot whose reset failed is handed back to
+			// the pool, to be reset again by a later Acquire
+			if (slot)
+			{
+				try
+				{
+					m_reset(slot->entry);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					slot->inUse = false;
+					throw;
+				}
+				return slot->entry;
+			}
+
+			std::unique_ptr<Slot> created(new Slot{ m_create(), 0, true });
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_slots.push_back(std::move(created));
+			return m_slots.back()->entry;
+		}
+
+		// Give an entry back to the pool. It becomes available once the fence value,
+		// signaled after its last submission, has completed; 0 if it was never submitted
+		void Release(const Entry& entry, uint64_t fenceValue)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (const std::unique_ptr<Slot>& slot : m_slots)
+			{
+				if (&slot->entry == &entry)
+				{
+					if (!slot->inUse)
+					{
+						throw std::logic_error("Command list released twice");
+					}
+					slot->inUse = false;
+					slot->fenceValue = fenceValue;
+					return;
+				}
+			}
+			throw std::logic_error("Command list not allocated by this pool");
+		}
+
+		// Number of entries created so far
+		size_t GetSize() const
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_slots.size();
+		}
+
+	private:
+		struct Slot
+		{
+			Entry entry;
+			uint64_t fenceValue;
+			bool inUse;
+		};
+
+		Factory m_create;
+		Resetter m_reset;
+
+		mutable std::mutex m_mutex;
+		// Slots are allocated individually so that the entries never move
+		std::vector<std::unique_ptr<Slot>> m_slots;
+	};
+}
+
+#endif // !COMMAND_LIST_POOL_GUARD
@@ -0,0 +1,174 @@
+#ifndef COMMAND_PASS_GRAPH_GUARD
+#define COMMAND_PASS_GRAPH_GUARD
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "CommandListPool.h"
+
+namespace RaytracingImplementation
+{
+	// Set of passes, each recorded into its own command list, and of the dependencies between
+	// them. Record runs all the passes in parallel, one worker per pass, and returns their
+	// command lists in an order where every pass comes after the passes it depends on, ready
+	// to be submitted with a single ExecuteCommandLists. Passes without dependencies between
+	// them keep the order in which they were added.
+	template <class Entry>
+	class CommandPassGraph
+	{
+	public:
+		using PassId = size_t;
+		using RecordFunction = std::function<void(Entry&)>;
+
+		PassId AddPass(std::string name, RecordFunction record)
+		{
+			m_passes.push_back({ std::move(name), std::move(record) });
+			return m_passes.size() - 1;
+		}
+
+		// The commands of the pass before must execute before the ones of the pass after
+		void AddDependency(PassId before, PassId after)
+		{
+			if (before >= m_passes.size() || after >= m_passes.size() || before == after)
+			{
+				throw std::logic_error("Invalid pass dependency");
+			}
+			m_dependencies.push_back({ before, after });
+		}
+
+		inline size_t GetPassCount() const { return m_passes.size(); }
+		inline const std::string& GetPassName(PassId pass) const { return m_passes[pass].name; }
+
+		void Clear()
+		{
+			m_passes.clear();
+			m_dependencies.clear();
+		}
+
+		// Submission order of the passes: a stable topological sort of the dependencies
+		std::vector<PassId> GetSubmissionOrder() const
+		{
+			const size_t passCount = m_passes.size();
+			std::vector<size_t> pendingDependencies(passCount, 0);
+			for (const Dependency& dependency : m_dependencies)
+			{
+				pendingDependencies[dependency.after]++;
+			}
+
+			std::vector<PassId> order;
+			order.reserve(passCount);
+			std::vector<bool> scheduled(passCount, false);
+			while (order.size() < passCount)
+			{
+				// First pass in insertion order whose dependencies are all scheduled
+				PassId next = passCount;
+				for (PassId pass = 0; pass < passCount; pass++)
+				{
+					if (!scheduled[pass] && pendingDependencies[pass] == 0)
+					{
+						next = pass;
+						break;
+					}
+				}
+				if (next == passCount)
+				{
+					throw std::logic_error("Cyclic dependency between command passes");
+				}
+
+				scheduled[next] = true;
+				order.push_back(next);
+				for (const Dependency& dependency : m_dependencies)
+				{
+					if (dependency.before == next)
+					{
+						pendingDependencies[dependency.after]--;
+					}
+				}
+			}
+			return order;
+		}
+
+		// Record every pass into an entry acquired from the pool, in parallel, and return
+		// the entries in submission order. The entries are owned by the caller, who releases
+		// them to the pool once submitted. An exception thrown by a pass is rethrown here,
+		// after all the workers have completed and their entries have been released.
+		std::vector<Entry*> Record(CommandListPool<Entry>& pool, uint64_t completedFenceValue) const
+		{
+			// Validate the graph before starting any work
+			const std::vector<PassId> order = GetSubmissionOrder();
+
+			std::vector<Entry*> entries(m_passes.size(), nullptr);
+			std::vector<std::future<void>> workers;
+			workers.reserve(m_passes.size());
+			for (PassId pass = 0; pass < m_passes.size(); pass++)
+			{
+				workers.push_back(std::async(std::launch::async,
+					[this, pass, &pool, &entries, completedFenceValue]()
+					{
+						Entry& entry = pool.Acquire(completedFenceValue);
+						entries[pass] = &entry;
+						m_passes[pass].record(entry);
+					}));
+			}
+
+			std::exception_ptr error;
+			for (std::future<void>& worker : workers)
+			{
+				try
+				{
+					worker.get();
+				}
+				catch (...)
+				{
+					if (!error)
+					{
+						error = std::current_exception();
+					}
+				}
+			}
+			if (error)
+			{
+				for (Entry* entry : entries)
+				{
+					if (entry)
+					{
+						pool.Release(*entry, 0);
+					}
+				}
+				std::rethrow_exception(error);
+			}
+
+			std::vector<Entry*> ordered;
+			ordered.reserve(order.size());
+			for (PassId pass : order)
+			{
+				ordered.push_back(entries[pass]);
+			}
+			return ordered;
+		}
+
+	private:
+		struct Pass
+		{
+			std::string name;
+			RecordFunction record;
+		};
+
+		struct Dependency
+		{
+			PassId before;
+			PassId after;
+		};
+
+		std::vector<Pass> m_passes;
+		std::vector<Dependency> m_dependencies;
+	};
+}
+
+#endif // !COMMAND_PASS_GRAPH_GUARD
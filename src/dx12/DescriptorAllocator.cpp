@@ -0,0 +1,125 @@
+#include "DescriptorAllocator.h"
+#include <iterator>
+#include <stdexcept>
+
+namespace RaytracingImplementation
+{
+	DescriptorAllocator::DescriptorAllocator(uint32_t persistentCount, uint32_t transientCount) :
+		m_persistentCount(persistentCount),
+		m_transientRing(transientCount)
+	{
+		if (uint64_t(persistentCount) + transientCount > kInvalidIndex)
+		{
+			throw std::logic_error("Too many descriptors for the allocator");
+		}
+		if (m_persistentCount != 0)
+		{
+			m_freeRanges.emplace(0, m_persistentCount);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// First fit: the persistent allocations are few and long-lived, and taking the
+	// lowest free range keeps the used descriptors packed at the start of the heap
+	//
+	uint32_t DescriptorAllocator::AllocatePersistent(uint32_t count)
+	{
+		if (count == 0)
+		{
+			return kInvalidIndex;
+		}
+
+		for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it)
+		{
+			if (it->second < count)
+			{
+				continue;
+			}
+
+			const uint32_t index = it->first;
+			const uint32_t remaining = it->second - count;
+			m_freeRanges.erase(it);
+			if (remaining != 0)
+			{
+				m_freeRanges.emplace(index + count, remaining);
+			}
+
+			m_allocations.emplace(index, count);
+			m_persistentUsedCount += count;
+			return index;
+		}
+		return kInvalidIndex;
+	}
+
+	void DescriptorAllocator::FreePersistent(uint32_t index)
+	{
+		auto allocation = m_allocations.find(index);
+		if (allocation == m_allocations.end())
+		{
+			throw std::logic_error("Freeing descriptors which are not allocated");
+		}
+
+		m_pendingFrees.push_back({ index, allocation->second, kOpenFenceValue });
+		m_allocations.erase(allocation);
+	}
+
+	uint32_t DescriptorAllocator::AllocateTransient(uint32_t count)
+	{
+		const uint64_t offset = m_transientRing.Allocate(count, 1);
+		if (offset == UploadRing::kInvalidOffset)
+		{
+			return kInvalidIndex;
+		}
+		return m_persistentCount + static_cast<uint32_t>(offset);
+	}
+
+	void DescriptorAllocator::Close(uint64_t fenceValue)
+	{
+		if (fenceValue <= m_lastFenceValue)
+		{
+			throw std::logic_error("Descriptor allocator fence values must be increasing");
+		}
+		m_lastFenceValue = fenceValue;
+
+		for (auto it = m_pendingFrees.rbegin(); it != m_pendingFrees.rend() && it->fenceValue == kOpenFenceValue; ++it)
+		{
+			it->fenceValue = fenceValue;
+		}
+		m_transientRing.Close(fenceValue);
+	}
+
+	void DescriptorAllocator::Retire(uint64_t completedFenceValue)
+	{
+		// The open releases are at the back and are never reached, their fence value
+		// being greater than any completed value
+		while (!m_pendingFrees.empty() && m_pendingFrees.front().fenceValue <= completedFenceValue)
+		{
+			const PendingFree& pending = m_pendingFrees.front();
+			InsertFreeRange(pending.index, pending.count);
+			m_persistentUsedCount -= pending.count;
+			m_pendingFrees.pop_front();
+		}
+		m_transientRing.Retire(completedFenceValue);
+	}
+
+	void DescriptorAllocator::InsertFreeRange(uint32_t index, uint32_t count)
+	{
+		auto next = m_freeRanges.lower_bound(index);
+		if (next != m_freeRanges.end() && index + count == next->first)
+		{
+			count += next->second;
+			next = m_freeRanges.erase(next);
+		}
+		if (next != m_freeRanges.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == index)
+			{
+				previous->second += count;
+				return;
+			}
+		}
+		m_freeRanges.emplace_hint(next, index, count);
+	}
+}
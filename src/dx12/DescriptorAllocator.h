@@ -0,0 +1,97 @@
+#ifndef DESCRIPTOR_ALLOCATOR_GUARD
+#define DESCRIPTOR_ALLOCATOR_GUARD
+
+#pragma once
+
+#include "UploadRing.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <unordered_map>
+
+namespace RaytracingImplementation
+{
+	// Allocator of the descriptor indices of a single large shader-visible heap. The heap is
+	// split into two regions:
+	// - the persistent region, at the beginning of the heap, holds the descriptors living as
+	//   long as their resource, such as the ones of the meshes of a scene. Its free ranges are
+	//   kept sorted by index, allocation takes the first one large enough and neighbouring
+	//   ranges are merged on release;
+	// - the transient region, at the end of the heap, holds the descriptors written for a
+	//   single frame. It is a ring whose space is reclaimed once the fence of the frame has
+	//   been reached, like the upload ring.
+	// A persistent range may still be read by the frames in flight when it is released, so it
+	// only returns to the free list once the fence of the following Close has been reached.
+	//
+	// Descriptors keep the same index as long as they are allocated, so the shaders can index
+	// the heap directly instead of going through a table per object. The allocator only
+	// manipulates indices and fence values, it does not depend on any platform header.
+	class DescriptorAllocator
+	{
+	public:
+		static constexpr uint32_t kInvalidIndex = ~0u;
+
+		DescriptorAllocator(uint32_t persistentCount, uint32_t transientCount);
+
+		DescriptorAllocator(const DescriptorAllocator&) = delete;
+		DescriptorAllocator& operator = (const DescriptorAllocator&) = delete;
+
+		// Allocate count contiguous persistent descriptors. Returns kInvalidIndex if no free
+		// range is large enough.
+		uint32_t AllocatePersistent(uint32_t count);
+
+		// Release a range returned by AllocatePersistent
+		void FreePersistent(uint32_t index);
+
+		// Allocate count contiguous descriptors for the frame being recorded. Returns
+		// kInvalidIndex if the ring has not enough free space left, in which case older
+		// frames have to be retired first.
+		uint32_t AllocateTransient(uint32_t count);
+
+		// Tag the transient allocations and the persistent releases made since the previous
+		// call with the fence value signaled after their submission. Fence values must be
+		// increasing.
+		void Close(uint64_t fenceValue);
+
+		// Reclaim the descriptors of all the submissions whose fence value is lower than or
+		// equal to the completed value
+		void Retire(uint64_t completedFenceValue);
+
+		inline uint32_t GetPersistentCount() const { return m_persistentCount; }
+		inline uint32_t GetTransientCount() const { return static_cast<uint32_t>(m_transientRing.GetCapacity()); }
+		// Total number of descriptors of the heap
+		inline uint32_t GetCount() const { return GetPersistentCount() + GetTransientCount(); }
+		// Persistent descriptors allocated, including the released ones still in flight
+		inline uint32_t GetPersistentUsedCount() const { return m_persistentUsedCount; }
+		inline uint32_t GetTransientUsedCount() const { return static_cast<uint32_t>(m_transientRing.GetUsedSize()); }
+
+	private:
+		// Return a range to the free list, merging it with its neighbours
+		void InsertFreeRange(uint32_t index, uint32_t count);
+
+		struct PendingFree
+		{
+			uint32_t index;
+			uint32_t count;
+			uint64_t fenceValue;
+		};
+		// Fence value of the releases made since the last Close
+		static constexpr uint64_t kOpenFenceValue = ~0ull;
+
+		uint32_t m_persistentCount;
+		uint32_t m_persistentUsedCount = 0;
+		// Free ranges of the persistent region, count by first index
+		std::map<uint32_t, uint32_t> m_freeRanges;
+		// Count of the allocated ranges, by first index
+		std::unordered_map<uint32_t, uint32_t> m_allocations;
+		// Released ranges waiting for the GPU, the open ones last
+		std::deque<PendingFree> m_pendingFrees;
+		uint64_t m_lastFenceValue = 0;
+
+		// Offsets in the ring are relative to the start of the transient region
+		UploadRing m_transientRing;
+	};
+}
+
+#endif // !DESCRIPTOR_ALLOCATOR_GUARD
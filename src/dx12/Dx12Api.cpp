@@ -10,8 +10,11 @@
 //*********************************************************
 
 #include "stdafx.h"
+#include <algorithm>
 #include <array>
 #include "Dx12Api.h"
+#include "Hash.h"
+#include "Profiler.h"
 #include "dx12/dxr/nv_helpers_dx12/RaytracingPipelineGenerator.h"   
 #include "dx12/dxr/nv_helpers_dx12/RootSignatureGenerator.h"
 #include "Win32Application.h"
@@ -26,7 +29,21 @@ namespace RaytracingImplementation
 		m_viewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height)),
 		m_scissorRect(0, 0, static_cast<LONG>(width), static_cast<LONG>(height)),
 		m_rtvDescriptorSize(0),
-		m_frameIndex(0)
+		m_frameIndex(0),
+		m_commandListPool(
+			[this]()
+			{
+				// Passes set their own pipeline state
+				PooledCommandList list;
+				ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&list.commandAllocator)));
+				ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, list.commandAllocator.Get(), nullptr, IID_PPV_ARGS(&list.commandList)));
+				return list;
+			},
+			[](PooledCommandList& list)
+			{
+				ThrowIfFailed(list.commandAllocator->Reset());
+				ThrowIfFailed(list.commandList->Reset(list.commandAllocator.Get(), nullptr));
+			})
 	{
 		WCHAR assetsPath[512];
 		GetAssetsPath(assetsPath, _countof(assetsPath));
@@ -42,6 +59,13 @@ namespace RaytracingImplementation
 		WaitForPreviousFrame();
 
 		CloseHandle(m_fenceEvent);
+
+		NvHelpers::SetBufferAllocator(nullptr);
+
+		for (const auto& reference : m_bottomLevelASReferences)
+		{
+			m_bottomLevelASRegistry.Release(reference.first, reference.second.Get());
+		}
 	}
 
 	// Helper function for resolving the full path of assets.
@@ -84,6 +108,7 @@ namespace RaytracingImplementation
 	void Dx12Api::Init(
 		D3D12_COMMAND_QUEUE_DESC& queueDesc, DXGI_SWAP_CHAIN_DESC1& swapChainDesc, D3D12_DESCRIPTOR_HEAP_DESC& rtvHeapDesc)
 	{
+		PROFILE_ZONE("Dx12Api::Init");
 		EnableDebugLayer();
 
 		ThrowIfFailed(CreateDXGIFactory2(dxgiFactoryFlags, IID_PPV_ARGS(&factory)));
@@ -111,66 +136,158 @@ namespace RaytracingImplementation
 			));
 		}
 
+		// From now on, the buffers created by the helpers are placed in shared heaps
+		NvHelpers::SetBufferAllocator(&m_bufferAllocator);
+
+		// Shaders built offline are used instead of compiling them, when available
+		auto shaderArchive = std::make_shared<ShaderArchive>();
+		if (shaderArchive->Open(GetAssetFullPath(kShaderArchivePath)))
+		{
+			m_shaderArchive = shaderArchive;
+			m_shaderCompiler.SetArchive(m_shaderArchive);
+		}
+
 		// Check the raytracing capabilities of the device
 		m_raytracing_support = CheckRaytracingSupport();
 
 		CreateCommandQueue(queueDesc);
+		CreateComputeQueue();
+
+		// The GPU timings of the passes are also shown along the CPU zones when
+		// profiling
+		m_gpuTimestamps.Create(m_device.Get(), m_commandQueue.Get(), m_gpuTimer);
+		m_computeTimestamps.Create(m_device.Get(), m_computeQueue.Get(), m_computeTimer);
+		if (Profiler::IsEnabled())
+		{
+			m_gpuTimer.SetProfilerTrack(Profiler::CreateTrack("GPU direct queue"));
+			m_computeTimer.SetProfilerTrack(Profiler::CreateTrack("GPU compute queue"));
+		}
 
 		CreateSwapChain(swapChainDesc);
 
 		CreateRtvResources(rtvHeapDesc);
 
-		ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
+		// One command allocator per frame context, so that a frame can be recorded
+		// while the previous ones are still executing
+		for (UINT frame = 0; frame < m_framePacer.GetFrameCount(); frame++)
+		{
+			ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocators[frame])));
+		}
+
+		// Create synchronization objects.
+		ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+		m_fenceValue = 1;
+
+		// Create an event handle to use for frame synchronization.
+		m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		if (m_fenceEvent == nullptr)
+		{
+			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+		}
+
+		// The upload buffer stays mapped for the lifetime of the application, the
+		// ring decides which parts of it can be overwritten
+		m_uploadBuffer.Attach(NvHelpers::CreateBuffer(
+			m_device.Get(), kUploadBufferSize, D3D12_RESOURCE_FLAG_NONE,
+			D3D12_RESOURCE_STATE_GENERIC_READ, NvHelpers::kUploadHeapProps));
+		CD3DX12_RANGE readRange(0, 0);		// We do not intend to read from this resource on the CPU.
+		ThrowIfFailed(m_uploadBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_uploadBufferData)));
 	}
 
 	void Dx12Api::CreateVertexBuffer(
 		const UINT vertexBufferSize, Microsoft::WRL::ComPtr<ID3D12Resource>& m_vertexBuffer,
 		D3D12_VERTEX_BUFFER_VIEW& m_vertexBufferView, const void* const data, const size_t size)
 	{
-		// Note: using upload heaps to transfer static data like vert buffers is not 
-		// recommended. Every time the GPU needs it, the upload heap will be marshalled 
-		// over. Please read up on Default Heap usage. An upload heap is used here for 
-		// code simplicity and because there are very few verts to actually transfer.
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&m_vertexBuffer)));
+		// The vertex buffer lives in the default heap, so that the GPU does not read it
+		// over the bus every time it is used. Its content is staged through the upload
+		// ring and copied on the GPU.
+		m_vertexBuffer.Attach(NvHelpers::CreateBuffer(
+			m_device.Get(), vertexBufferSize, D3D12_RESOURCE_FLAG_NONE,
+			D3D12_RESOURCE_STATE_COPY_DEST, NvHelpers::kDefaultHeapProps));
 
 		// Copy the triangle data to the vertex buffer.
-		UINT8* pVertexDataBegin;
-		CD3DX12_RANGE readRange(0, 0);		// We do not intend to read from this resource on the CPU.
-		ThrowIfFailed(m_vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-		memcpy(pVertexDataBegin, data, size);
-		m_vertexBuffer->Unmap(0, nullptr);
+		UploadToBuffer(m_vertexBuffer.Get(), 0, data, size);
+
+		// The buffer is read both as vertex buffer by the rasterizer and as shader
+		// resource by the acceleration structure builds and the hit shader
+		m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(
+			m_vertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST,
+			D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+
+		// Remember the content of the buffer, so that acceleration structures
+		// built from identical geometry can be shared
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		m_vertexBufferContents[m_vertexBuffer.Get()] =
+			VertexBufferContent{ m_vertexBuffer, std::vector<uint8_t>(bytes, bytes + size), HashBytes(data, size) };
 
 		// Initialize the vertex buffer view.
 		m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
 		m_vertexBufferView.StrideInBytes = sizeof(Vertex);
 		m_vertexBufferView.SizeInBytes = vertexBufferSize;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// Execute the setup commands recorded so far, such as the upload copies,
+	// without waiting for them: the work reading the copied buffers is ordered
+	// after them on the GPU, and the ring space they used is retired at the frame
+	// boundaries once the fence signaled here has been reached
+	//
+	void Dx12Api::ExecuteSetupCommands()
+	{
+		ThrowIfFailed(m_commandList->Close());
+		ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
+		m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 
-		WaitUploadVertexBuffer();
+		const UINT64 fence = m_fenceValue;
+		ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fence));
+		m_fenceValue++;
+		m_queueSync.Signal(kDirectQueue, fence);
+		m_uploadRing.Close(fence);
 	}
 
-	void Dx12Api::WaitUploadVertexBuffer()
+	void Dx12Api::SubmitUploads()
 	{
-		// Create synchronization objects and wait until assets have been uploaded to the GPU.
-		ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
-		m_fenceValue = 1;
+		ExecuteSetupCommands();
 
-		// Create an event handle to use for frame synchronization.
-		m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-		if (m_fenceEvent == nullptr)
+		// The list is reopened for the rest of the setup on the same allocator,
+		// which is not reset while the GPU may still execute its commands
+		ThrowIfFailed(m_commandList->Reset(GetCommandAllocator(), m_pipelineState.Get()));
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// Copy data into a buffer through the upload ring. The copy is recorded on the
+	// command list, and the space in the ring is reclaimed once the fence signaled
+	// after its execution has been reached.
+	//
+	void Dx12Api::UploadToBuffer(ID3D12Resource* destination, UINT64 destinationOffset, const void* data, size_t size)
+	{
+		if (size > kUploadBufferSize)
 		{
-			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+			throw std::logic_error("Upload larger than the upload ring");
 		}
 
-		// Wait for the command list to execute; we are reusing the same command 
-		// list in our main loop but for now, we just want to wait for setup to 
-		// complete before continuing.
-		WaitForPreviousFrame();
+		UINT64 offset = m_uploadRing.Allocate(size, kUploadAlignment);
+		if (offset == UploadRing::kInvalidOffset)
+		{
+			// Reclaim the space of the uploads the GPU is done with
+			m_uploadRing.Retire(m_fence->GetCompletedValue());
+			offset = m_uploadRing.Allocate(size, kUploadAlignment);
+		}
+		if (offset == UploadRing::kInvalidOffset)
+		{
+			// The ring is filled by the copies recorded in the current command list,
+			// execute them and wait for them to make room. This is the only case
+			// where an upload stalls the CPU
+			SubmitUploads();
+			WaitForFenceValue(m_fence.Get(), m_queueSync.GetLastSignaled(kDirectQueue));
+			m_uploadRing.Retire(m_fence->GetCompletedValue());
+			offset = m_uploadRing.Allocate(size, kUploadAlignment);
+		}
+
+		memcpy(m_uploadBufferData + offset, data, size);
+		m_commandList->CopyBufferRegion(destination, destinationOffset, m_uploadBuffer.Get(), offset, size);
 	}
 
 	bool Dx12Api::CheckRaytracingSupport()
@@ -189,6 +306,184 @@ namespace RaytracingImplementation
 		ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue)));
 	}
 
+	//-----------------------------------------------------------------------------
+	//
+	// The acceleration structures are built and refitted on a compute queue, so
+	// that this work can run alongside the rendering of the direct queue. The
+	// direct queue only waits for it where the top-level AS is consumed.
+	//
+	void Dx12Api::CreateComputeQueue()
+	{
+		D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+		queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+		queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+		ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_computeQueue)));
+
+		for (auto& allocator : m_computeCommandAllocators)
+		{
+			ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS(&allocator)));
+		}
+		ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE, m_computeCommandAllocators[0].Get(), nullptr, IID_PPV_ARGS(&m_computeCommandList)));
+		ThrowIfFailed(m_computeCommandList->Close());
+
+		ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_computeFence)));
+		m_computeFenceValue = 0;
+	}
+
+	void Dx12Api::BeginComputeCommands(const char* passName)
+	{
+		// The next allocator can only be reset once the work recorded with it has
+		// completed. It usually has by the time new work is recorded, the refits
+		// of the frames in flight being recorded with the other ones
+		m_computeAllocatorIndex = (m_computeAllocatorIndex + 1) % FramePacer::kMaxFrameCount;
+		ID3D12CommandAllocator* allocator = m_computeCommandAllocators[m_computeAllocatorIndex].Get();
+		WaitForFenceValue(m_computeFence.Get(), m_computeAllocatorFenceValues[m_computeAllocatorIndex]);
+		RetireComputeWork();
+
+		ThrowIfFailed(allocator->Reset());
+		ThrowIfFailed(m_computeCommandList->Reset(allocator, nullptr));
+
+		m_computeTimer.ResetSet(0);
+		m_computeTimerQuery = m_computeTimer.AddPass(0, passName);
+		m_computeTimestamps.WriteTimestamp(m_computeCommandList.Get(), m_computeTimerQuery);
+	}
+
+	void Dx12Api::SubmitComputeCommands(UINT64 directFenceValue)
+	{
+		// The timestamps are resolved at the end of the list itself. The work is
+		// not timed when all the readback slots are still in flight
+		uint32_t timerSlot = GpuPassTimer::kInvalidIndex;
+		if (m_computeTimestamps.IsValid())
+		{
+			m_computeTimestamps.WriteTimestamp(m_computeCommandList.Get(), m_computeTimerQuery + 1);
+			timerSlot = m_computeTimer.AcquireSlot();
+			if (timerSlot != GpuPassTimer::kInvalidIndex)
+			{
+				m_computeTimestamps.Resolve(m_computeCommandList.Get(), m_computeTimer.GetSetFirstQuery(0),
+					m_computeTimer.GetSetQueryCount(0), timerSlot);
+			}
+		}
+		ThrowIfFailed(m_computeCommandList->Close());
+
+		// The inputs of the AS work, such as the vertex uploads, and the frames
+		// reading the top-level AS version it overwrites were submitted on the
+		// direct queue. The frames submitted since keep running alongside
+		InsertQueueWait(kComputeQueue, kDirectQueue, directFenceValue);
+
+		ID3D12CommandList* ppCommandLists[] = { m_computeCommandList.Get() };
+		m_computeQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+
+		m_computeFenceValue++;
+		ThrowIfFailed(m_computeQueue->Signal(m_computeFence.Get(), m_computeFenceValue));
+		m_queueSync.Signal(kComputeQueue, m_computeFenceValue);
+		m_computeAllocatorFenceValues[m_computeAllocatorIndex] = m_computeFenceValue;
+		if (timerSlot != GpuPassTimer::kInvalidIndex)
+		{
+			m_computeTimer.Submit(timerSlot, 0, m_computeFenceValue);
+		}
+	}
+
+	void Dx12Api::RetireComputeWork()
+	{
+		// The scratch memory of the bottom-level builds is returned once they
+		// have completed
+		if (m_bottomLevelASScratchFenceValue != 0 &&
+			m_computeFence->GetCompletedValue() >= m_bottomLevelASScratchFenceValue)
+		{
+			m_bottomLevelASBuildScheduler.ReleaseScratch();
+			m_bottomLevelASScratchFenceValue = 0;
+		}
+
+		if (m_computeTimestamps.IsValid())
+		{
+			m_computeTimer.Collect(m_computeFence->GetCompletedValue(), m_computeTimestamps);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The readback buffer is small and stays mapped: the CPU only reads a slot
+	// once the fence of the submission which resolved into it has completed
+	//
+	void Dx12Api::QueueTimestamps::Create(ID3D12Device* device, ID3D12CommandQueue* queue, const GpuPassTimer& timer)
+	{
+		if (FAILED(queue->GetTimestampFrequency(&m_frequency)) || m_frequency == 0)
+		{
+			return;
+		}
+		m_queue = queue;
+		m_slotQueryCount = timer.GetSlotQueryCount();
+
+		D3D12_QUERY_HEAP_DESC heapDesc = {};
+		heapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+		heapDesc.Count = timer.GetQueryCount();
+		ThrowIfFailed(device->CreateQueryHeap(&heapDesc, IID_PPV_ARGS(&m_heap)));
+
+		const CD3DX12_HEAP_PROPERTIES readbackHeapProps(D3D12_HEAP_TYPE_READBACK);
+		const CD3DX12_RESOURCE_DESC readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(
+			UINT64(timer.GetSlotCount()) * m_slotQueryCount * sizeof(uint64_t));
+		ThrowIfFailed(device->CreateCommittedResource(&readbackHeapProps, D3D12_HEAP_FLAG_NONE,
+			&readbackDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&m_readback)));
+		ThrowIfFailed(m_readback->Map(0, nullptr, reinterpret_cast<void**>(&m_readbackData)));
+	}
+
+	void Dx12Api::QueueTimestamps::WriteTimestamp(ID3D12GraphicsCommandList* commandList, uint32_t query) const
+	{
+		if (m_heap && query != GpuPassTimer::kInvalidIndex)
+		{
+			commandList->EndQuery(m_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, query);
+		}
+	}
+
+	void Dx12Api::QueueTimestamps::Resolve(ID3D12GraphicsCommandList* commandList, uint32_t firstQuery,
+		uint32_t count, uint32_t slot) const
+	{
+		if (m_heap && count != 0 && slot != GpuPassTimer::kInvalidIndex)
+		{
+			commandList->ResolveQueryData(m_heap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, firstQuery, count,
+				m_readback.Get(), UINT64(slot) * m_slotQueryCount * sizeof(uint64_t));
+		}
+	}
+
+	void Dx12Api::QueueTimestamps::Read(uint32_t slot, uint32_t count, uint64_t* timestamps)
+	{
+		memcpy(timestamps, m_readbackData + size_t(slot) * m_slotQueryCount, count * sizeof(uint64_t));
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The profiler timestamp is taken right after the queue calibration, the
+	// delay between both is negligible next to the durations of the passes
+	//
+	bool Dx12Api::QueueTimestamps::GetCalibration(uint64_t& timestamp, uint64_t& profilerTimestamp)
+	{
+		UINT64 cpuTimestamp;
+		if (!m_queue || FAILED(m_queue->GetClockCalibration(&timestamp, &cpuTimestamp)))
+		{
+			return false;
+		}
+		profilerTimestamp = Profiler::GetTimestamp();
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// Make a queue wait on the GPU until another one has reached a fence value,
+	// unless an earlier wait already covers it.
+	//
+	void Dx12Api::InsertQueueWait(size_t consumer, size_t producer, UINT64 value)
+	{
+		if (!m_queueSync.NeedsWait(consumer, producer, value))
+		{
+			return;
+		}
+
+		ID3D12CommandQueue* queue = consumer == kDirectQueue ? m_commandQueue.Get() : m_computeQueue.Get();
+		ID3D12Fence* fence = producer == kDirectQueue ? m_fence.Get() : m_computeFence.Get();
+		ThrowIfFailed(queue->Wait(fence, value));
+		m_queueSync.Wait(consumer, producer, value);
+	}
+
 	void Dx12Api::CreateSwapChain(DXGI_SWAP_CHAIN_DESC1& swapChainDesc)
 	{
 		Microsoft::WRL::ComPtr<IDXGISwapChain1> swapChain;
@@ -206,6 +501,7 @@ namespace RaytracingImplementation
 
 		ThrowIfFailed(swapChain.As(&m_swapChain));
 		m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+		m_backBufferFormat = swapChainDesc.Format;
 	}
 
 	void Dx12Api::CreateRtvResources(D3D12_DESCRIPTOR_HEAP_DESC& rtvHeapDesc)
@@ -250,6 +546,7 @@ namespace RaytracingImplementation
 
 	void Dx12Api::WaitForPreviousFrame()
 	{
+		PROFILE_ZONE("Dx12Api::WaitForPreviousFrame");
 		// WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
 		// This is code implemented as such for simplicity. The sample illustrates 
 		//how to use fences for efficient resource usage and to maximize GPU utilization.
@@ -258,6 +555,12 @@ namespace RaytracingImplementation
 		const UINT64 fence = m_fenceValue;
 		ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fence));
 		m_fenceValue++;
+		m_queueSync.Signal(kDirectQueue, fence);
+
+		// The uploads recorded so far have been submitted before this signal
+		m_uploadRing.Close(fence);
+		m_descriptorAllocator.Close(fence);
+		m_bufferAllocator.Close(fence);
 
 		// Wait until the previous frame is finished.
 		if (m_fence->GetCompletedValue() < fence)
@@ -266,6 +569,16 @@ namespace RaytracingImplementation
 			WaitForSingleObject(m_fenceEvent, INFINITE);
 		}
 
+		// Drain the AS work of the compute queue as well
+		WaitForFenceValue(m_computeFence.Get(), m_computeFenceValue);
+		RetireComputeWork();
+
+		// The GPU is idle, the memory of the buffers released since the last frame
+		// can be reused, as well as the upload space
+		m_bufferAllocator.Retire(m_fence->GetCompletedValue());
+		m_uploadRing.Retire(m_fence->GetCompletedValue());
+		m_descriptorAllocator.Retire(m_fence->GetCompletedValue());
+
 		m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
 	}
 
@@ -273,34 +586,27 @@ namespace RaytracingImplementation
 		D3D12_GRAPHICS_PIPELINE_STATE_DESC& psoDesc, const wchar_t* vertexShaderPath, const wchar_t* pixelShaderPath,
 		std::array< D3D12_INPUT_ELEMENT_DESC,2>& inputElementDescs)
 	{
-
-		Microsoft::WRL::ComPtr<ID3DBlob> signature;
-		Microsoft::WRL::ComPtr<ID3DBlob> error;
-		ThrowIfFailed(D3D12SerializeRootSignature(&rootSignatureDesc, D3D_ROOT_SIGNATURE_VERSION_1, &signature, &error));
-		ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature)));
-
+		PROFILE_ZONE("Dx12Api::CreatePipelineState");
 		// Create the pipeline state, which includes compiling and loading shaders.
-		Microsoft::WRL::ComPtr<ID3DBlob> vertexShader;
-		Microsoft::WRL::ComPtr<ID3DBlob> pixelShader;
+		// The shaders compile on the workers while the root signature is created.
+		auto vertexShaderJob = m_shaderCompiler.CompileShader(GetAssetFullPath(vertexShaderPath), "VSMain", "vs_5_0", kShaderCompileFlags);
+		auto pixelShaderJob = m_shaderCompiler.CompileShader(GetAssetFullPath(pixelShaderPath), "PSMain", "ps_5_0", kShaderCompileFlags);
 
-#if defined(_DEBUG)
-		// Enable better shader debugging with the graphics debugging tools.
-		UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-		UINT compileFlags = 0;
-#endif
+		m_rootSignature.Attach(m_rootSignatureCache.GetOrCreate(m_device.Get(), rootSignatureDesc));
 
-		ThrowIfFailed(D3DCompileFromFile(GetAssetFullPath(vertexShaderPath).c_str(), nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, nullptr));
-		ThrowIfFailed(D3DCompileFromFile(GetAssetFullPath(pixelShaderPath).c_str(), nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, nullptr));
+		Microsoft::WRL::ComPtr<ID3DBlob> vertexShader = vertexShaderJob.get();
+		Microsoft::WRL::ComPtr<ID3DBlob> pixelShader = pixelShaderJob.get();
 
 		psoDesc.pRootSignature = m_rootSignature.Get();
 		psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
 		psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
 
 		ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
+		// The recorded frames use the previous pipeline state
+		InvalidateRecordedCommandLists();
 
 		// Create the command list.
-		ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocator.Get(), m_pipelineState.Get(), IID_PPV_ARGS(&m_commandList)));
+		ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, GetCommandAllocator(), m_pipelineState.Get(), IID_PPV_ARGS(&m_commandList)));
 	}
 
 	//-----------------------------------------------------------------------------
@@ -318,18 +624,24 @@ namespace RaytracingImplementation
 			  D3D12_DESCRIPTOR_RANGE_TYPE_SRV /*Top-level acceleration structure*/,
 			  1} });
 
-		return rsc.Generate(m_device.Get(), true);
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> signature;
+		signature.Attach(rsc.Generate(m_device.Get(), true, &m_rootSignatureCache));
+		return signature;
 	}
 
 	//-----------------------------------------------------------------------------
-	// The hit shader communicates only through the ray payload, and therefore does
-	// not require any resources
+	// The hit shader reads the vertex buffer of its geometry (t0) to interpolate
+	// the colors, and traces shadow rays through the top-level acceleration
+	// structure (t1). Both are root SRVs, given by the hit group record
 	//
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> Dx12Api::CreateHitSignature()
 	{
 		NvHelpers::RootSignatureGenerator rsc;
-		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV);
-		return rsc.Generate(m_device.Get(), true);
+		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 0 /*t0*/);
+		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV, 1 /*t1*/);
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> signature;
+		signature.Attach(rsc.Generate(m_device.Get(), true, &m_rootSignatureCache));
+		return signature;
 	}
 
 	//-----------------------------------------------------------------------------
@@ -339,7 +651,9 @@ namespace RaytracingImplementation
 	Microsoft::WRL::ComPtr<ID3D12RootSignature> Dx12Api::CreateMissSignature()
 	{
 		NvHelpers::RootSignatureGenerator rsc;
-		return rsc.Generate(m_device.Get(), true);
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> signature;
+		signature.Attach(rsc.Generate(m_device.Get(), true, &m_rootSignatureCache));
+		return signature;
 	}
 
 	//-----------------------------------------------------------------------------
@@ -351,29 +665,131 @@ namespace RaytracingImplementation
 	//
 	void Dx12Api::CreateRaytracingPipeline()
 	{
-		NvHelpers::RayTracingPipelineGenerator pipeline(m_device.Get());
-
+		PROFILE_ZONE("Dx12Api::CreateRaytracingPipeline");
 		// The pipeline contains the DXIL code of all the shaders potentially executed
 		// during the raytracing process. This section compiles the HLSL code into a
 		// set of DXIL libraries. We chose to separate the code in several libraries
 		// by semantic (ray generation, hit, miss) for clarity. Any code layout can be
-		// used.
-		m_rayGenLibrary = NvHelpers::CompileShaderLibrary(L"resources/shaders/raytracing/RayGen.hlsl");
-		m_missLibrary = NvHelpers::CompileShaderLibrary(L"resources/shaders/raytracing/Miss.hlsl");
-		m_hitLibrary = NvHelpers::CompileShaderLibrary(L"resources/shaders/raytracing/Hit.hlsl");
+		// used. The libraries are compiled concurrently, and only when their sources
+		// changed since the last run.
 		// In a way similar to DLLs, each library is associated with a number of
-		// exported symbols. This
-		// has to be done explicitly in the lines below. Note that a single library
-		// can contain an arbitrary number of symbols, whose semantic is given in HLSL
-		// using the [shader("xxx")] syntax
-		pipeline.AddLibrary(m_rayGenLibrary.Get(), { L"RayGen" });
-		pipeline.AddLibrary(m_missLibrary.Get(), { L"Miss" });
-		pipeline.AddLibrary(m_hitLibrary.Get(), { L"ClosestHit" });
+		// exported symbols. Note that a single library can contain an arbitrary
+		// number of symbols, whose semantic is given in HLSL using the
+		// [shader("xxx")] syntax
+		m_shaderLibraries = GetRaytracingLibraries();
+
+		std::vector<std::future<Microsoft::WRL::ComPtr<IDxcBlob>>> compilations;
+		for (const ShaderLibrary& library : m_shaderLibraries)
+		{
+			compilations.push_back(m_shaderCompiler.CompileLibrary(library.fileName));
+		}
+		for (size_t i = 0; i < m_shaderLibraries.size(); i++)
+		{
+			// The raytracing cannot start without its libraries, the compiler messages
+			// are shown before giving up. Failed reloads only log them
+			try
+			{
+				m_shaderLibraries[i].blob = compilations[i].get();
+			}
+			catch (const std::exception& e)
+			{
+				MessageBoxA(nullptr, e.what(), "Error!", MB_OK);
+				throw;
+			}
+			m_shaderWatcher.Watch(m_shaderLibraries[i].fileName);
+		}
+		m_shaderWatcher.Watch(GetAssetFullPath(kCompositeShaderPath));
+		ValidateLibraryExports();
+
 		// To be used, each DX12 shader needs a root signature defining which
 		// parameters and buffers will be accessed.
 		m_rayGenSignature = CreateRayGenSignature();
 		m_missSignature = CreateMissSignature();
 		m_hitSignature = CreateHitSignature();
+
+		CreateRaytracingStateObject();
+
+		// Allocate the buffer storing the raytracing output, with the same dimensions
+		// as the target image
+		CreateRaytracingOutputBuffer();
+		CreateCompositePipeline();
+	}
+
+	std::vector<Dx12Api::ShaderLibrary> Dx12Api::GetRaytracingLibraries()
+	{
+		return {
+			{ L"resources/shaders/raytracing/RayGen.hlsl", { L"RayGen" } },
+			{ L"resources/shaders/raytracing/Miss.hlsl", { L"Miss", L"ShadowMiss" } },
+			{ L"resources/shaders/raytracing/Hit.hlsl", { L"ClosestHit" } } };
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The composite shader is listed in both its variants, as the variant used
+	// depends on the formats supported by the device
+	//
+	std::vector<ShaderRequest> Dx12Api::GetShaderManifest()
+	{
+		std::vector<ShaderRequest> manifest;
+		for (const ShaderLibrary& library : GetRaytracingLibraries())
+		{
+			manifest.push_back(ShaderCompileService::GetLibraryRequest(library.fileName));
+		}
+		for (const std::vector<ShaderCompileService::Define>& defines :
+			{ std::vector<ShaderCompileService::Define>{}, std::vector<ShaderCompileService::Define>{ { "COMPOSITE_READ_SRV", "1" } } })
+		{
+			manifest.push_back(ShaderCompileService::GetShaderRequest(kCompositeShaderPath, "VSMain", "vs_5_0", kShaderCompileFlags, defines));
+			manifest.push_back(ShaderCompileService::GetShaderRequest(kCompositeShaderPath, "PSMain", "ps_5_0", kShaderCompileFlags, defines));
+		}
+		return manifest;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// A shader missing from a library would only be reported by the creation of
+	// the state object, as an invalid argument. The exports recorded by the
+	// archive name the culprit instead
+	//
+	void Dx12Api::ValidateLibraryExports() const
+	{
+		if (!m_shaderArchive)
+		{
+			return;
+		}
+
+		for (const ShaderLibrary& library : m_shaderLibraries)
+		{
+			// Libraries compiled from modified sources may export other shaders
+			ShaderArchive::Shader archived;
+			if (!m_shaderArchive->Find(ShaderCompileService::GetLibraryRequest(library.fileName), archived) ||
+				library.blob->GetBufferPointer() != archived.data)
+			{
+				continue;
+			}
+			for (const std::wstring& name : library.exports)
+			{
+				if (std::find(archived.exports.begin(), archived.exports.end(), name) == archived.exports.end())
+				{
+					throw std::logic_error("Shader library does not export a shader of the pipeline");
+				}
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// Assemble the state object from the compiled libraries and the root
+	// signatures. Only this step is repeated when shaders are reloaded
+	//
+	void Dx12Api::CreateRaytracingStateObject()
+	{
+		PROFILE_ZONE("Dx12Api::CreateRaytracingStateObject");
+		NvHelpers::RayTracingPipelineGenerator pipeline(m_device.Get(), m_shaderSymbols, &m_rootSignatureCache);
+		for (const ShaderLibrary& library : m_shaderLibraries)
+		{
+			pipeline.AddLibrary(library.blob.Get(), library.exports);
+		}
+
 		// 3 different shaders can be invoked to obtain an intersection: an
 		// intersection shader is called
 		// when hitting the bounding box of non-triangular geometry. This is beyond
@@ -389,16 +805,20 @@ namespace RaytracingImplementation
 		// exported symbols are defined above the shaders can be simply referred to by
 		// name.
 
-		// Hit group for the triangles, with a shader simply interpolating vertex
-		// colors
+		// Hit group for the triangles, with a shader interpolating vertex colors and
+		// tracing a shadow ray towards the light
 		pipeline.AddHitGroup(L"HitGroup", L"ClosestHit");
+		// Hit group of the shadow rays, which only need to know whether there is an
+		// occluder. It has no shader: the rays skip the closest hit and end at the
+		// first hit, leaving the payload set, and only the shadow miss clears it
+		pipeline.AddHitGroup(L"ShadowHitGroup", L"");
 		// The following section associates the root signature to each shader. Note
 		// that we can explicitly show that some shaders share the same root signature
 		// (eg. Miss and ShadowMiss). Note that the hit shaders are now only referred
 		// to as hit groups, meaning that the underlying intersection, any-hit and
 		// closest-hit shaders share the same root signature.
 		pipeline.AddRootSignatureAssociation(m_rayGenSignature.Get(), { L"RayGen" });
-		pipeline.AddRootSignatureAssociation(m_missSignature.Get(), { L"Miss" });
+		pipeline.AddRootSignatureAssociation(m_missSignature.Get(), { L"Miss", L"ShadowMiss", L"ShadowHitGroup" });
 		pipeline.AddRootSignatureAssociation(m_hitSignature.Get(), { L"HitGroup" });
 		// The payload size defines the maximum size of the data carried by the rays,
 		// ie. the the data
@@ -414,21 +834,127 @@ namespace RaytracingImplementation
 		pipeline.SetMaxAttributeSize(2 * sizeof(float)); // barycentric coordinates
 
 		// The raytracing process can shoot rays from existing hit points, resulting
-		// in nested TraceRay calls. Our sample code traces only primary rays, which
-		// then requires a trace depth of 1. Note that this recursion depth should be
-		// kept to a minimum for best performance. Path tracing algorithms can be
-		// easily flattened into a simple loop in the ray generation.
-		pipeline.SetMaxRecursionDepth(1);
+		// in nested TraceRay calls. Our sample traces primary rays, and a shadow ray
+		// from the closest hit of each of them, which then requires a trace depth of
+		// 2. Note that this recursion depth should be kept to a minimum for best
+		// performance. Path tracing algorithms can be easily flattened into a simple
+		// loop in the ray generation.
+		pipeline.SetMaxRecursionDepth(2);
 		// Compile the pipeline for execution on the GPU
 		m_rtStateObject = pipeline.Generate();
 
 		// Cast the state object into a properties object, allowing to later access
 		// the shader pointers by name
 		ThrowIfFailed(m_rtStateObject->QueryInterface(IID_PPV_ARGS(&m_rtStateObjectProps)));
+		// The recorded frames bind the previous state object
+		InvalidateRecordedCommandLists();
+	}
 
-		// Allocate the buffer storing the raytracing output, with the same dimensions
-		// as the target image
-		CreateRaytracingOutputBuffer();
+	//-----------------------------------------------------------------------------
+	//
+	// Only the libraries affected by the modified files are compiled again, and
+	// the state object is assembled from the new and the unchanged libraries. A
+	// state object cannot be patched, and the identifiers of its shaders may
+	// change, but the SBT keeps its layout and root arguments and only the
+	// changed identifiers are written. Geometry and acceleration structures are
+	// not touched.
+	// If a compilation fails the current pipeline is kept, until the next change
+	// of the file
+	//
+	bool Dx12Api::ReloadModifiedShaders()
+	{
+		PROFILE_ZONE("Dx12Api::ReloadModifiedShaders");
+		const auto now = std::chrono::steady_clock::now();
+		if (now - m_lastShaderPoll < kShaderPollInterval)
+		{
+			return false;
+		}
+		m_lastShaderPoll = now;
+
+		const std::vector<std::filesystem::path> modified = m_shaderWatcher.Poll();
+		if (modified.empty())
+		{
+			return false;
+		}
+
+		std::vector<size_t> libraries;
+		std::vector<std::future<Microsoft::WRL::ComPtr<IDxcBlob>>> compilations;
+		bool compositeModified = false;
+		for (const std::filesystem::path& file : modified)
+		{
+			for (size_t i = 0; i < m_shaderLibraries.size(); i++)
+			{
+				if (file == std::filesystem::path(m_shaderLibraries[i].fileName).lexically_normal())
+				{
+					libraries.push_back(i);
+					compilations.push_back(m_shaderCompiler.CompileLibrary(m_shaderLibraries[i].fileName));
+				}
+			}
+			compositeModified |= file == std::filesystem::path(GetAssetFullPath(kCompositeShaderPath)).lexically_normal();
+		}
+
+		std::vector<Microsoft::WRL::ComPtr<IDxcBlob>> blobs;
+		try
+		{
+			for (auto& compilation : compilations)
+			{
+				blobs.push_back(compilation.get());
+			}
+		}
+		catch (const std::exception& e)
+		{
+			OutputDebugStringA(e.what());
+			OutputDebugStringA("\nShader reload failed, the current pipeline is kept\n");
+			return false;
+		}
+
+		// The frames in flight use the current state object and read the SBT
+		// records which are about to be rewritten
+		WaitForPreviousFrame();
+
+		if (!libraries.empty())
+		{
+			// The state object creation also validates the libraries against each
+			// other, and fails without replacing the current one
+			for (size_t i = 0; i < libraries.size(); i++)
+			{
+				std::swap(m_shaderLibraries[libraries[i]].blob, blobs[i]);
+			}
+			try
+			{
+				CreateRaytracingStateObject();
+			}
+			catch (const std::exception& e)
+			{
+				for (size_t i = 0; i < libraries.size(); i++)
+				{
+					std::swap(m_shaderLibraries[libraries[i]].blob, blobs[i]);
+				}
+				OutputDebugStringA(e.what());
+				OutputDebugStringA("\nRaytracing pipeline reload failed, the current pipeline is kept\n");
+				return false;
+			}
+			for (TopLevelASVersion& version : m_topLevelAS)
+			{
+				if (version.sbtStorage)
+				{
+					version.sbtHelper.UpdateShaderIdentifiers(m_rtStateObjectProps.Get());
+				}
+			}
+		}
+		if (compositeModified)
+		{
+			try
+			{
+				CreateCompositePipeline();
+			}
+			catch (const std::exception& e)
+			{
+				OutputDebugStringA(e.what());
+				OutputDebugStringA("\nComposite shader reload failed\n");
+			}
+		}
+		return true;
 	}
 
 	//-----------------------------------------------------------------------------
@@ -441,10 +967,10 @@ namespace RaytracingImplementation
 		D3D12_RESOURCE_DESC resDesc = {};
 		resDesc.DepthOrArraySize = 1;
 		resDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
-		// The backbuffer is actually DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, but sRGB
-		// formats cannot be used with UAVs. For accuracy we should convert to sRGB
-		// ourselves in the shader
-		resDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		// The output is not copied into the back buffer but drawn by the composite
+		// pass, so it does not need to share its format. A float format keeps the
+		// radiance unclamped until the tonemapping
+		resDesc.Format = kRaytracingOutputFormat;
 
 		resDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 		resDesc.Width = GetViewportWidth();
@@ -454,26 +980,130 @@ namespace RaytracingImplementation
 		resDesc.SampleDesc.Count = 1;
 		ThrowIfFailed(m_device->CreateCommittedResource(
 			&NvHelpers::kDefaultHeapProps, D3D12_HEAP_FLAG_NONE, &resDesc,
-			D3D12_RESOURCE_STATE_COPY_SOURCE, nullptr,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr,
 			IID_PPV_ARGS(&m_outputResource)));
+		// The recorded frames write to the previous output buffer
+		InvalidateRecordedCommandLists();
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The composite pass draws a fullscreen triangle into the back buffer, reading
+	// one texel of the raytracing output per pixel. When the device supports typed
+	// UAV loads of the output format, the pass reads the output UAV directly: the
+	// output then never changes state, and only a UAV barrier separates the ray
+	// dispatch from the composite.
+	//
+	void Dx12Api::CreateCompositePipeline()
+	{
+		PROFILE_ZONE("Dx12Api::CreateCompositePipeline");
+		D3D12_FEATURE_DATA_FORMAT_SUPPORT formatSupport = {
+			kRaytracingOutputFormat, D3D12_FORMAT_SUPPORT1_NONE, D3D12_FORMAT_SUPPORT2_NONE };
+		m_compositeReadsUav = SUCCEEDED(m_device->CheckFeatureSupport(
+			D3D12_FEATURE_FORMAT_SUPPORT, &formatSupport, sizeof(formatSupport))) &&
+			(formatSupport.Support2 & D3D12_FORMAT_SUPPORT2_UAV_TYPED_LOAD) != 0;
+
+		// The output descriptor, followed by the settings as root constants
+		NvHelpers::RootSignatureGenerator rsc;
+		if (m_compositeReadsUav)
+		{
+			rsc.AddHeapRangesParameter({ {0 /*u0*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0} });
+		}
+		else
+		{
+			rsc.AddHeapRangesParameter({ {0 /*t0*/, 1, 0, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0} });
+		}
+		rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, 0 /*b0*/, 0,
+			sizeof(CompositeSettings) / sizeof(UINT));
+		m_compositeSignature.Attach(rsc.Generate(m_device.Get(), false, &m_rootSignatureCache));
+
+		std::vector<ShaderCompileService::Define> defines;
+		if (!m_compositeReadsUav)
+		{
+			defines.push_back({ "COMPOSITE_READ_SRV", "1" });
+		}
+
+		const std::wstring shaderPath = GetAssetFullPath(kCompositeShaderPath);
+		auto vertexShaderJob = m_shaderCompiler.CompileShader(shaderPath, "VSMain", "vs_5_0", kShaderCompileFlags, defines);
+		auto pixelShaderJob = m_shaderCompiler.CompileShader(shaderPath, "PSMain", "ps_5_0", kShaderCompileFlags, defines);
+		Microsoft::WRL::ComPtr<ID3DBlob> vertexShader = vertexShaderJob.get();
+		Microsoft::WRL::ComPtr<ID3DBlob> pixelShader = pixelShaderJob.get();
+
+		// No input layout: the vertices are generated from their index
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+		psoDesc.pRootSignature = m_compositeSignature.Get();
+		psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
+		psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
+		psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+		psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+		psoDesc.DepthStencilState.DepthEnable = FALSE;
+		psoDesc.DepthStencilState.StencilEnable = FALSE;
+		psoDesc.SampleMask = UINT_MAX;
+		psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		psoDesc.NumRenderTargets = 1;
+		psoDesc.RTVFormats[0] = m_backBufferFormat;
+		psoDesc.SampleDesc.Count = 1;
+		ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_compositePipelineState)));
+
+		// The recorded frames use the previous composite pipeline
+		InvalidateRecordedCommandLists();
+	}
+
+	void Dx12Api::SetCompositeSettings(const CompositeSettings& settings)
+	{
+		m_compositeSettings = settings;
+		// The settings are recorded as root constants in the frame command lists
+		InvalidateRecordedCommandLists();
 	}
 
 	//-----------------------------------------------------------------------------
 	//
 	// Create the main heap used by the shaders, which will give access to the
-	// raytracing output and the top-level acceleration structure
+	// raytracing output and the top-level acceleration structure. The heap is
+	// large enough for the descriptors of a whole scene, so that it never has to
+	// be switched while recording and every descriptor has a stable index.
 	//
 	void Dx12Api::CreateShaderResourceHeap() 
 	{
-		// Create a SRV/UAV/CBV descriptor heap. We need 2 entries - 1 UAV for the
-		// raytracing output and 1 SRV for the TLAS
-		m_srvUavHeap = NvHelpers::CreateDescriptorHeap(
-			m_device.Get(), 2, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
+		PROFILE_ZONE("Dx12Api::CreateShaderResourceHeap");
+		if (!m_srvUavHeap)
+		{
+			m_srvUavHeap = NvHelpers::CreateDescriptorHeap(m_device.Get(),
+				m_descriptorAllocator.GetCount(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, true);
+			m_srvUavDescriptorSize = m_device->GetDescriptorHandleIncrementSize(
+				D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		}
+
+		// Each version of the TLAS has its own descriptors, the frames of a back
+		// buffer only reading the version of that back buffer
+		for (TopLevelASVersion& version : m_topLevelAS)
+		{
+			CreateRaytracingDescriptors(version);
+		}
+
+		// The recorded frames bind the previous descriptors
+		InvalidateRecordedCommandLists();
+	}
+
+	void Dx12Api::CreateRaytracingDescriptors(TopLevelASVersion& version)
+	{
+		// The descriptors of the previous output and TLAS may still be read by the
+		// frames in flight, they are reclaimed once those are done. We need 3
+		// entries - 1 UAV for the raytracing output, 1 SRV for the TLAS and 1 SRV
+		// for the composite pass to read the output when it cannot use the UAV
+		if (version.descriptors != DescriptorAllocator::kInvalidIndex)
+		{
+			m_descriptorAllocator.FreePersistent(version.descriptors);
+		}
+		version.descriptors = m_descriptorAllocator.AllocatePersistent(kOutputSrvHeapSlot + 1);
+		if (version.descriptors == DescriptorAllocator::kInvalidIndex)
+		{
+			throw std::logic_error("Shader-visible descriptor heap is full");
+		}
 
 		// Get a handle to the heap memory on the CPU side, to be able to write the
 		// descriptors directly
-		D3D12_CPU_DESCRIPTOR_HANDLE srvHandle =
-			m_srvUavHeap->GetCPUDescriptorHandleForHeapStart();
+		D3D12_CPU_DESCRIPTOR_HANDLE srvHandle = GetCpuDescriptorHandle(version.descriptors);
 
 		// Create the UAV. Based on the root signature we created it is the first
 		// entry. The Create*View methods write the view information directly into
@@ -484,17 +1114,72 @@ namespace RaytracingImplementation
 			srvHandle);
 
 		// Add the Top Level AS SRV right after the raytracing output buffer
-		srvHandle.ptr += m_device->GetDescriptorHandleIncrementSize(
-			D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		srvHandle.ptr += m_srvUavDescriptorSize;
 
 		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc;
 		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 		srvDesc.RaytracingAccelerationStructure.Location =
-			m_topLevelASBuffers.pResult->GetGPUVirtualAddress();
+			version.buffers.pResult->GetGPUVirtualAddress();
 		// Write the acceleration structure view in the heap
 		m_device->CreateShaderResourceView(nullptr, &srvDesc, srvHandle);
+
+		// And the raytracing output SRV last
+		srvHandle.ptr += m_srvUavDescriptorSize;
+
+		D3D12_SHADER_RESOURCE_VIEW_DESC outputSrvDesc = {};
+		outputSrvDesc.Format = kRaytracingOutputFormat;
+		outputSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		outputSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		outputSrvDesc.Texture2D.MipLevels = 1;
+		m_device->CreateShaderResourceView(m_outputResource.Get(), &outputSrvDesc, srvHandle);
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// Same as UploadToBuffer: reclaim the descriptors of the frames the GPU is done
+	// with, then wait for the frames in flight if the ring is still full
+	//
+	UINT Dx12Api::AllocateFrameDescriptors(UINT count)
+	{
+		if (count > kTransientDescriptorCount)
+		{
+			throw std::logic_error("Allocation larger than the transient descriptor region");
+		}
+
+		UINT index = m_descriptorAllocator.AllocateTransient(count);
+		if (index == DescriptorAllocator::kInvalidIndex)
+		{
+			m_descriptorAllocator.Retire(m_fence->GetCompletedValue());
+			index = m_descriptorAllocator.AllocateTransient(count);
+		}
+		if (index == DescriptorAllocator::kInvalidIndex)
+		{
+			WaitForFenceValue(m_fence.Get(), m_fenceValue - 1);
+			m_descriptorAllocator.Retire(m_fence->GetCompletedValue());
+			index = m_descriptorAllocator.AllocateTransient(count);
+		}
+		if (index == DescriptorAllocator::kInvalidIndex)
+		{
+			// Only the descriptors of the frame being recorded are left
+			throw std::logic_error("Transient descriptor region is full");
+		}
+		return index;
+	}
+
+	D3D12_CPU_DESCRIPTOR_HANDLE Dx12Api::GetCpuDescriptorHandle(UINT index) const
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE handle = m_srvUavHeap->GetCPUDescriptorHandleForHeapStart();
+		handle.ptr += SIZE_T(index) * m_srvUavDescriptorSize;
+		return handle;
+	}
+
+	D3D12_GPU_DESCRIPTOR_HANDLE Dx12Api::GetGpuDescriptorHandle(UINT index) const
+	{
+		D3D12_GPU_DESCRIPTOR_HANDLE handle = m_srvUavHeap->GetGPUDescriptorHandleForHeapStart();
+		handle.ptr += UINT64(index) * m_srvUavDescriptorSize;
+		return handle;
 	}
 
 	//-----------------------------------------------------------------------------
@@ -506,53 +1191,82 @@ namespace RaytracingImplementation
 	// contains the ray generation shader, the miss shaders, then the hit groups.
 	// Using the helper class, those can be specified in arbitrary order.
 	//
-	void Dx12Api::CreateShaderBindingTable(Microsoft::WRL::ComPtr<ID3D12Resource>& m_vertexBuffer)
+	void Dx12Api::CreateShaderBindingTable()
 	{
+		PROFILE_ZONE("Dx12Api::CreateShaderBindingTable");
+		// Each version of the TLAS has its own table, the records pointing to the
+		// structure and to its descriptors. All of them share the same layout
+		for (TopLevelASVersion& version : m_topLevelAS)
+		{
+			CreateShaderBindingTable(version);
+		}
+		// The recorded frames dispatch rays from the previous tables
+		InvalidateRecordedCommandLists();
+	}
+
+	void Dx12Api::CreateShaderBindingTable(TopLevelASVersion& version)
+	{
+		NvHelpers::ShaderBindingTableGenerator& sbtHelper = version.sbtHelper;
 		// The SBT helper class collects calls to Add*Program.  If called several
 		// times, the helper must be emptied before re-adding shaders.
-		m_sbtHelper.Reset();
-		m_sbtHelper.AddHitGroup(L"HitGroup", { (void*)(m_vertexBuffer->GetGPUVirtualAddress()) });
-		// The pointer to the beginning of the heap is the only parameter required by
-		// shaders without root parameters
+		sbtHelper.Reset();
+		// The pointer to the raytracing descriptors in the heap is the only parameter
+		// required by shaders without root parameters
 		D3D12_GPU_DESCRIPTOR_HANDLE srvUavHeapHandle =
-			m_srvUavHeap->GetGPUDescriptorHandleForHeapStart();
+			GetGpuDescriptorHandle(version.descriptors);
 		// The helper treats both root parameter pointers and heap pointers as void*,
 		// while DX12 uses the
 		// D3D12_GPU_DESCRIPTOR_HANDLE to define heap pointers. The pointer in this
 		// struct is a UINT64, which then has to be reinterpreted as a pointer.
 		auto heapPointer = reinterpret_cast<UINT64*>(srvUavHeapHandle.ptr);
 		// The ray generation only uses heap data
-		m_sbtHelper.AddRayGenerationProgram(L"RayGen", { heapPointer });
-
-		// The miss and hit shaders do not access any external resources: instead they
-		// communicate their results through the ray payload
-		m_sbtHelper.AddMissProgram(L"Miss", {});
-
-		// Adding the triangle hit shader
-		m_sbtHelper.AddHitGroup(L"HitGroup", {});
+		sbtHelper.AddRayGenerationProgram(L"RayGen", { heapPointer });
+
+		// The miss shaders do not access any external resources: instead they
+		// communicate their results through the ray payload. There is one miss shader
+		// per ray type, indexed by the ray type
+		sbtHelper.AddMissProgram(L"Miss", {});
+		sbtHelper.AddMissProgram(L"ShadowMiss", {});
+
+		// Hit groups, laid out so that the record of a hit is found at the instance
+		// offset + geometry index * ray type count + ray type. The radiance hit group
+		// interpolates the colors of the vertex buffer of its geometry and traces
+		// shadow rays through the top-level AS, while the shadow hit group needs no
+		// resources
+		const NvHelpers::ShaderSymbol hitGroup = m_shaderSymbols.Intern(L"HitGroup");
+		const NvHelpers::ShaderSymbol shadowHitGroup = m_shaderSymbols.Intern(L"ShadowHitGroup");
+		void* topLevelAS = (void*)(version.buffers.pResult->GetGPUVirtualAddress());
+		for (const auto& geometries : m_instanceGeometries)
+		{
+			for (const auto& vertexBuffer : geometries)
+			{
+				sbtHelper.AddHitGroup(hitGroup, { (void*)(vertexBuffer->GetGPUVirtualAddress()), topLevelAS });
+				sbtHelper.AddHitGroup(shadowHitGroup, {});
+			}
+		}
 		// Compute the size of the SBT given the number of shaders and their
 		// parameters
-		uint32_t sbtSize = m_sbtHelper.ComputeSBTSize();
+		uint32_t sbtSize = sbtHelper.ComputeSBTSize();
 
 		// Create the SBT on the upload heap. This is required as the helper will use
 		// mapping to write the SBT contents. After the SBT compilation it could be
 		// copied to the default heap for performance.
-		m_sbtStorage = NvHelpers::CreateBuffer(
+		version.sbtStorage.Attach(NvHelpers::CreateBuffer(
 			m_device.Get(), sbtSize, D3D12_RESOURCE_FLAG_NONE,
-			D3D12_RESOURCE_STATE_GENERIC_READ, NvHelpers::kUploadHeapProps);
-		if (!m_sbtStorage) {
+			D3D12_RESOURCE_STATE_GENERIC_READ, NvHelpers::kUploadHeapProps));
+		if (!version.sbtStorage) {
 			throw std::logic_error("Could not allocate the shader binding table");
 		}
 		// Compile the SBT from the shader and parameters info
-		m_sbtHelper.Generate(m_sbtStorage.Get(), m_rtStateObjectProps.Get());
+		sbtHelper.Generate(version.sbtStorage.Get(), m_rtStateObjectProps.Get());
 	}
 
 	void Dx12Api::CloseCommandList()
 	{
-		// Command lists are created in the recording state, but there is
-		// nothing to record yet. The main loop expects it to be closed, so
-		// close it now.
-		ThrowIfFailed(m_commandList->Close());
+		// Command lists are created in the recording state. The main loop
+		// expects the setup list to be closed, so execute the setup commands
+		// left in it and close it now.
+		ExecuteSetupCommands();
 	}
 
 	//Bootleg temporary "draw"
@@ -560,129 +1274,381 @@ namespace RaytracingImplementation
 
 	void Dx12Api::PopulateCommandList(D3D12_VERTEX_BUFFER_VIEW& m_vertexBufferView)
 	{
-		// Command list allocators can only be reset when the associated 
-		// command lists have finished execution on the GPU; apps should use 
-		// fences to determine GPU execution progress.
-		ThrowIfFailed(m_commandAllocator->Reset());
+		PROFILE_ZONE("Dx12Api::PopulateCommandList");
+		// The commands of a frame only depend on the back buffer and on the mode, as
+		// long as the pipelines, the SBT and the resources do not change. They are
+		// recorded once per combination, and replayed as-is on the following frames
+		if (memcmp(&m_vertexBufferView, &m_recordedVertexBufferView, sizeof(D3D12_VERTEX_BUFFER_VIEW)) != 0)
+		{
+			InvalidateRecordedCommandLists();
+			m_recordedVertexBufferView = m_vertexBufferView;
+		}
 
-		// However, when ExecuteCommandList() is called on a particular command 
-		// list, that command list can then be reset at any time and must be before 
-		// re-recording.
-		ThrowIfFailed(m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
+		RecordedCommandList& recorded = m_recordedCommandLists[m_frameIndex][raster ? 0 : 1];
+		if (!recorded.valid)
+		{
+			// The previous lists go back to the pool, which hands them out again
+			// once the last frame which executed them has completed
+			for (PooledCommandList* list : recorded.commandLists)
+			{
+				m_commandListPool.Release(*list, recorded.fenceValue);
+			}
+
+			// Each recorded frame times its passes with its own queries
+			recorded.timerSet = m_frameIndex * 2 + (raster ? 0 : 1);
+			m_gpuTimer.ResetSet(recorded.timerSet);
 
-		// Set necessary state.
-		m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
-		m_commandList->RSSetViewports(1, &m_viewport);
-		m_commandList->RSSetScissorRects(1, &m_scissorRect);
+			CommandPassGraph<PooledCommandList> graph;
+			AddFramePasses(graph, m_frameIndex, raster, m_vertexBufferView, recorded.timerSet);
+			recorded.commandLists = graph.Record(m_commandListPool, m_fence->GetCompletedValue());
 
-		// Indicate that the back buffer will be used as a render target.
-		m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+			recorded.submission.clear();
+			for (PooledCommandList* list : recorded.commandLists)
+			{
+				recorded.submission.push_back(list->commandList.Get());
+			}
+			recorded.raytracing = !raster;
+			recorded.valid = true;
+		}
 
-		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
-		m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+		// There is no per-frame dynamic work yet, so the frame only consists of the
+		// recorded lists
+		m_frameCommandList = &recorded;
+	}
 
-		// Record commands.
+	//-----------------------------------------------------------------------------
+	//
+	// Describe the passes rendering a frame into a back buffer, either by
+	// rasterization or by raytracing. Each pass is recorded into its own command
+	// list, in parallel with the others.
+	//
+	void Dx12Api::AddFramePasses(CommandPassGraph<PooledCommandList>& graph, UINT backBufferIndex,
+		bool rasterMode, const D3D12_VERTEX_BUFFER_VIEW& vertexBufferView, uint32_t timerSet)
+	{
 		// #DXR
-		if (raster)
+		if (rasterMode)
 		{
-			const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-			m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-			m_commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-			m_commandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-			m_commandList->DrawInstanced(3, 1, 0, 0);
+			const uint32_t rasterQuery = m_gpuTimer.AddPass(timerSet, "Raster");
+			graph.AddPass("Raster", [this, backBufferIndex, vertexBufferView, rasterQuery](PooledCommandList& list)
+			{
+				PROFILE_ZONE("Record Raster");
+				ID3D12GraphicsCommandList4* commandList = list.commandList.Get();
+				m_gpuTimestamps.WriteTimestamp(commandList, rasterQuery);
+
+				// Set necessary state.
+				commandList->SetPipelineState(m_pipelineState.Get());
+				commandList->SetGraphicsRootSignature(m_rootSignature.Get());
+				commandList->RSSetViewports(1, &m_viewport);
+				commandList->RSSetScissorRects(1, &m_scissorRect);
+
+				// Indicate that the back buffer will be used as a render target.
+				commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[backBufferIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+
+				CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), backBufferIndex, m_rtvDescriptorSize);
+				commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+
+				// Record commands.
+				const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
+				commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+				commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+				commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
+				commandList->DrawInstanced(3, 1, 0, 0);
+
+				// Indicate that the back buffer will now be used to present.
+				commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[backBufferIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+
+				m_gpuTimestamps.WriteTimestamp(commandList, rasterQuery + 1);
+				ThrowIfFailed(commandList->Close());
+			});
+			return;
 		}
-		else
+
+		// The queries are assigned here, as the passes are recorded in parallel
+		const uint32_t dispatchQuery = m_gpuTimer.AddPass(timerSet, "DispatchRays");
+		const uint32_t compositeQuery = m_gpuTimer.AddPass(timerSet, "Composite");
+
+		const CommandPassGraph<PooledCommandList>::PassId dispatchPass =
+			graph.AddPass("DispatchRays", [this, backBufferIndex, dispatchQuery](PooledCommandList& list)
 		{
+			PROFILE_ZONE("Record DispatchRays");
+			ID3D12GraphicsCommandList4* commandList = list.commandList.Get();
+			m_gpuTimestamps.WriteTimestamp(commandList, dispatchQuery);
+
 			// #DXR
 			// Bind the descriptor heap giving access to the top-level acceleration
 			// structure, as well as the raytracing output
-			std::vector<ID3D12DescriptorHeap*> heaps = { m_srvUavHeap.Get() };
-			m_commandList->SetDescriptorHeaps(static_cast<UINT>(heaps.size()),
-				heaps.data());
-			// On the last frame, the raytracing output was used as a copy source, to
-			// copy its contents into the render target. Now we need to transition it to
-			// a UAV so that the shaders can write in it.
-			CD3DX12_RESOURCE_BARRIER transition = CD3DX12_RESOURCE_BARRIER::Transition(
-				m_outputResource.Get(), D3D12_RESOURCE_STATE_COPY_SOURCE,
-				D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-			m_commandList->ResourceBarrier(1, &transition);
+			ID3D12DescriptorHeap* heaps[] = { m_srvUavHeap.Get() };
+			commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+			// The raytracing output is in the UNORDERED_ACCESS state at the beginning
+			// of each frame, ready for the shaders to write in it
 			// Setup the raytracing task
 			D3D12_DISPATCH_RAYS_DESC desc = {};
 			// The layout of the SBT is as follows: ray generation shader, miss
 			// shaders, hit groups. As described in the CreateShaderBindingTable method,
 			// all SBT entries of a given type have the same size to allow a fixed stride.
 
+			// The frames of a back buffer trace rays through its version of the TLAS,
+			// from the table pointing to it
+			const TopLevelASVersion& version = m_topLevelAS[backBufferIndex];
+			const NvHelpers::ShaderBindingTableGenerator& sbtHelper = version.sbtHelper;
+			const D3D12_GPU_VIRTUAL_ADDRESS sbtAddress = version.sbtStorage->GetGPUVirtualAddress();
+
 			// The ray generation shaders are always at the beginning of the SBT. 
-			uint32_t rayGenerationSectionSizeInBytes = m_sbtHelper.GetRayGenSectionSize();
-			desc.RayGenerationShaderRecord.StartAddress = m_sbtStorage->GetGPUVirtualAddress();
+			uint32_t rayGenerationSectionSizeInBytes = sbtHelper.GetRayGenSectionSize();
+			desc.RayGenerationShaderRecord.StartAddress = sbtAddress;
 			desc.RayGenerationShaderRecord.SizeInBytes = rayGenerationSectionSizeInBytes;
-			// The miss shaders are in the second SBT section, right after the ray
-			// generation shader. We have one miss shader for the camera rays and one
-			// for the shadow rays, so this section has a size of 2*m_sbtEntrySize. We
-			// also indicate the stride between the two miss shaders, which is the size
-			// of a SBT entry
-			uint32_t missSectionSizeInBytes = m_sbtHelper.GetMissSectionSize();
-			desc.MissShaderTable.StartAddress =
-				m_sbtStorage->GetGPUVirtualAddress() + rayGenerationSectionSizeInBytes;
+			// The miss shaders are in the second SBT section, after the ray generation
+			// shader, at the next shader table boundary. We also indicate the stride
+			// between the miss shaders, which is the size of a SBT entry
+			uint32_t missSectionSizeInBytes = sbtHelper.GetMissSectionSize();
+			desc.MissShaderTable.StartAddress = sbtAddress + sbtHelper.GetMissSectionOffset();
 			desc.MissShaderTable.SizeInBytes = missSectionSizeInBytes;
-			desc.MissShaderTable.StrideInBytes = m_sbtHelper.GetMissEntrySize();
-			// The hit groups section start after the miss shaders. In this sample we
-			// have one 1 hit group for the triangle
-			uint32_t hitGroupsSectionSize = m_sbtHelper.GetHitGroupSectionSize();
-			desc.HitGroupTable.StartAddress = m_sbtStorage->GetGPUVirtualAddress() +
-				rayGenerationSectionSizeInBytes +
-				missSectionSizeInBytes;
+			desc.MissShaderTable.StrideInBytes = sbtHelper.GetMissEntrySize();
+			// The hit groups section start after the miss shaders, with one hit group
+			// per ray type for each geometry
+			uint32_t hitGroupsSectionSize = sbtHelper.GetHitGroupSectionSize();
+			desc.HitGroupTable.StartAddress = sbtAddress + sbtHelper.GetHitGroupSectionOffset();
 			desc.HitGroupTable.SizeInBytes = hitGroupsSectionSize;
-			desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
+			desc.HitGroupTable.StrideInBytes = sbtHelper.GetHitGroupEntrySize();
 			// Dimensions of the image to render, identical to a kernel launch dimension
 			desc.Width = m_viewportWidth;
 			desc.Height = m_viewportHeight;
 			desc.Depth = 1;
 
 			// Bind the raytracing pipeline
-			m_commandList->SetPipelineState1(m_rtStateObject.Get());
+			commandList->SetPipelineState1(m_rtStateObject.Get());
 			// Dispatch the rays and write to the raytracing output
-			m_commandList->DispatchRays(&desc);
-
-			// The raytracing output needs to be copied to the actual render target used
-			// for display. For this, we need to transition the raytracing output from a
-			// UAV to a copy source, and the render target buffer to a copy destination.
-			// We can then do the actual copy, before transitioning the render target
-			// buffer into a render target, that will be then used to display the image
-			transition = CD3DX12_RESOURCE_BARRIER::Transition(
-				m_outputResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-				D3D12_RESOURCE_STATE_COPY_SOURCE);
-			m_commandList->ResourceBarrier(1, &transition);
-			transition = CD3DX12_RESOURCE_BARRIER::Transition(
-				m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET,
-				D3D12_RESOURCE_STATE_COPY_DEST);
-			m_commandList->ResourceBarrier(1, &transition);
-
-			m_commandList->CopyResource(m_renderTargets[m_frameIndex].Get(),
-				m_outputResource.Get());
-
-			transition = CD3DX12_RESOURCE_BARRIER::Transition(
-				m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_COPY_DEST,
-				D3D12_RESOURCE_STATE_RENDER_TARGET);
-			m_commandList->ResourceBarrier(1, &transition);
-		}
-
-		// Indicate that the back buffer will now be used to present.
-		m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+			commandList->DispatchRays(&desc);
+
+			// The raytracing output is then read by the composite pass, either through
+			// the same UAV, which only requires the writes to be complete, or through
+			// a SRV
+			CD3DX12_RESOURCE_BARRIER barrier = m_compositeReadsUav ?
+				CD3DX12_RESOURCE_BARRIER::UAV(m_outputResource.Get()) :
+				CD3DX12_RESOURCE_BARRIER::Transition(m_outputResource.Get(),
+					D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			commandList->ResourceBarrier(1, &barrier);
+
+			m_gpuTimestamps.WriteTimestamp(commandList, dispatchQuery + 1);
+			ThrowIfFailed(commandList->Close());
+		});
+
+		const CommandPassGraph<PooledCommandList>::PassId compositePass =
+			graph.AddPass("Composite", [this, backBufferIndex, compositeQuery](PooledCommandList& list)
+		{
+			PROFILE_ZONE("Record Composite");
+			ID3D12GraphicsCommandList4* commandList = list.commandList.Get();
+			m_gpuTimestamps.WriteTimestamp(commandList, compositeQuery);
+
+			// The raytracing output is drawn into the back buffer by a fullscreen
+			// triangle, which also applies the tonemapping
+			CD3DX12_RESOURCE_BARRIER barriers[2] = {
+				CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[backBufferIndex].Get(),
+					D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET) };
+			commandList->ResourceBarrier(1, barriers);
+
+			ID3D12DescriptorHeap* heaps[] = { m_srvUavHeap.Get() };
+			commandList->SetDescriptorHeaps(_countof(heaps), heaps);
+			commandList->SetPipelineState(m_compositePipelineState.Get());
+			commandList->SetGraphicsRootSignature(m_compositeSignature.Get());
+			// The table starts at the output descriptor the pass reads
+			commandList->SetGraphicsRootDescriptorTable(0, GetGpuDescriptorHandle(
+				m_topLevelAS[backBufferIndex].descriptors + (m_compositeReadsUav ? 0 : kOutputSrvHeapSlot)));
+			commandList->SetGraphicsRoot32BitConstants(1, sizeof(CompositeSettings) / sizeof(UINT),
+				&m_compositeSettings, 0);
+			commandList->RSSetViewports(1, &m_viewport);
+			commandList->RSSetScissorRects(1, &m_scissorRect);
+
+			CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), backBufferIndex, m_rtvDescriptorSize);
+			commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+			commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+			commandList->DrawInstanced(3, 1, 0, 0);
+
+			// Present the back buffer, and give the output back to the next dispatch
+			barriers[0] = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[backBufferIndex].Get(),
+				D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+			UINT barrierCount = 1;
+			if (!m_compositeReadsUav)
+			{
+				barriers[barrierCount++] = CD3DX12_RESOURCE_BARRIER::Transition(m_outputResource.Get(),
+					D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			}
+			commandList->ResourceBarrier(barrierCount, barriers);
 
-		ThrowIfFailed(m_commandList->Close());
+			m_gpuTimestamps.WriteTimestamp(commandList, compositeQuery + 1);
+			ThrowIfFailed(commandList->Close());
+		});
+
+		graph.AddDependency(dispatchPass, compositePass);
 	}
 
 	void Dx12Api::Swap()
 	{
-		// Execute the command list.
-		ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
-		m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+		PROFILE_ZONE("Dx12Api::Swap");
+		// Ray dispatches read the version of the top-level AS of the back buffer,
+		// which is brought up to date if the transforms were updated for another
+		// one, and whose last build or refit may still be running on the compute
+		// queue
+		TopLevelASVersion& topLevelAS = m_topLevelAS[m_frameIndex];
+		if (m_frameCommandList->raytracing)
+		{
+			if (topLevelAS.generation != m_topLevelASGeneration)
+			{
+				RefitTopLevelAS(m_frameIndex);
+			}
+			InsertQueueWait(kDirectQueue, kComputeQueue, topLevelAS.buildFenceValue);
+		}
+
+		// Execute the command lists of all the passes, in dependency order.
+		m_commandQueue->ExecuteCommandLists(static_cast<UINT>(m_frameCommandList->submission.size()),
+			m_frameCommandList->submission.data());
+
+		// The recorded lists always write the same queries, which are copied to the
+		// readback slot of this frame by a small list recorded every frame
+		PooledCommandList* timerList = nullptr;
+		uint32_t timerSlot = GpuPassTimer::kInvalidIndex;
+		const uint32_t timerSet = m_frameCommandList->timerSet;
+		if (m_gpuTimestamps.IsValid() && m_gpuTimer.GetSetQueryCount(timerSet) != 0)
+		{
+			timerSlot = m_gpuTimer.AcquireSlot();
+		}
+		if (timerSlot != GpuPassTimer::kInvalidIndex)
+		{
+			timerList = &m_commandListPool.Acquire(m_fence->GetCompletedValue());
+			m_gpuTimestamps.Resolve(timerList->commandList.Get(), m_gpuTimer.GetSetFirstQuery(timerSet),
+				m_gpuTimer.GetSetQueryCount(timerSet), timerSlot);
+			ThrowIfFailed(timerList->commandList->Close());
+			ID3D12CommandList* timerLists[] = { timerList->commandList.Get() };
+			m_commandQueue->ExecuteCommandLists(_countof(timerLists), timerLists);
+		}
 
 		// Present the frame.
-		ThrowIfFailed(m_swapChain->Present(1, 0));
+		{
+			PROFILE_ZONE("Present");
+			ThrowIfFailed(m_swapChain->Present(1, 0));
+		}
 
-		WaitForPreviousFrame();
+		// Signal the end of the frame, and move on to the next frame context
+		const UINT64 fence = m_fenceValue;
+		ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fence));
+		m_fenceValue++;
+		m_queueSync.Signal(kDirectQueue, fence);
+		m_uploadRing.Close(fence);
+		m_descriptorAllocator.Close(fence);
+		m_bufferAllocator.Close(fence);
+		m_framePacer.EndFrame(fence);
+		m_frameCommandList->fenceValue = fence;
+		if (m_frameCommandList->raytracing)
+		{
+			topLevelAS.readFenceValue = fence;
+		}
+		if (timerList)
+		{
+			m_gpuTimer.Submit(timerSlot, timerSet, fence);
+			m_commandListPool.Release(*timerList, fence);
+		}
+
+		// Only wait for the frame which last used the next frame context, the other
+		// frames in flight keep executing while the CPU records
+		WaitForFenceValue(m_fence.Get(), m_framePacer.GetCurrentFrameFenceValue());
+		m_uploadRing.Retire(m_fence->GetCompletedValue());
+		m_descriptorAllocator.Retire(m_fence->GetCompletedValue());
+		m_bufferAllocator.Retire(m_fence->GetCompletedValue());
+		if (m_gpuTimestamps.IsValid())
+		{
+			m_gpuTimer.Collect(m_fence->GetCompletedValue(), m_gpuTimestamps);
+		}
+		RetireComputeWork();
+
+		m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
+	}
+
+	void Dx12Api::WaitForFenceValue(ID3D12Fence* fence, UINT64 fenceValue)
+	{
+		PROFILE_ZONE("Dx12Api::WaitForFenceValue");
+		if (fence->GetCompletedValue() < fenceValue)
+		{
+			ThrowIfFailed(fence->SetEventOnCompletion(fenceValue, m_fenceEvent));
+			WaitForSingleObject(m_fenceEvent, INFINITE);
+		}
+	}
+
+	void Dx12Api::InvalidateRecordedCommandLists()
+	{
+		for (auto& backBufferLists : m_recordedCommandLists)
+		{
+			for (RecordedCommandList& recorded : backBufferLists)
+			{
+				recorded.valid = false;
+			}
+		}
+	}
+
+	void Dx12Api::SetFramesInFlight(UINT frameCount)
+	{
+		if (m_device)
+		{
+			throw std::logic_error("The number of frames in flight must be set before Init");
+		}
+		m_framePacer = FramePacer(frameCount);
+	}
+
+	UINT64 Dx12Api::GetVideoMemoryUsage() const
+	{
+		Microsoft::WRL::ComPtr<IDXGIAdapter3> adapter;
+		if (!m_device || FAILED(factory->EnumAdapterByLuid(m_device->GetAdapterLuid(), IID_PPV_ARGS(&adapter))))
+		{
+			return 0;
+		}
+		DXGI_QUERY_VIDEO_MEMORY_INFO memoryInfo = {};
+		if (FAILED(adapter->QueryVideoMemoryInfo(0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &memoryInfo)))
+		{
+			return 0;
+		}
+		return memoryInfo.CurrentUsage;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// Describe the geometry of a bottom-level AS for the registry: the build
+	// flags, then the vertex count, stride and content of each vertex buffer.
+	// The key combines the same values, with the hash of each content computed
+	// once at upload. Buffers which were not created through CreateVertexBuffer
+	// have no known content, and their structures are not shared
+	//
+	uint64_t Dx12Api::DescribeBottomLevelASGeometry(
+		const std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, uint32_t>>& vVertexBuffers,
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags, std::vector<uint8_t>& geometry) const
+	{
+		const auto append = [&geometry](const void* data, size_t size)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			geometry.insert(geometry.end(), bytes, bytes + size);
+		};
+
+		geometry.clear();
+		append(&flags, sizeof(flags));
+		uint64_t key = HashCombine(0, static_cast<uint64_t>(flags));
+		for (const auto& buffer : vVertexBuffers)
+		{
+			auto content = m_vertexBufferContents.find(buffer.first.Get());
+			if (content == m_vertexBufferContents.end())
+			{
+				geometry.clear();
+				return 0;
+			}
+			const uint32_t vertexCount = buffer.second;
+			const uint32_t stride = sizeof(Vertex);
+			append(&vertexCount, sizeof(vertexCount));
+			append(&stride, sizeof(stride));
+			append(content->second.bytes.data(), content->second.bytes.size());
+
+			key = HashCombine(key, content->second.hash);
+			key = HashCombine(key, vertexCount);
+			key = HashCombine(key, stride);
+		}
+		// 0 is reserved for geometry which cannot be shared
+		return key == 0 ? 1 : key;
 	}
 
 	//-----------------------------------------------------------------------------
@@ -690,11 +1656,31 @@ namespace RaytracingImplementation
 	// Create a bottom-level acceleration structure based on a list of vertex
 	// buffers in GPU memory along with their vertex count. The build is then done
 	// in 3 steps: gathering the geometry, computing the sizes of the required
-	// buffers, and building the actual AS
+	// buffers, and building the actual AS. If the same geometry has already been
+	// built, the existing structure is returned instead
 	//
 	AccelerationStructureBuffers Dx12Api::CreateBottomLevelAS(
 		std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers)
 	{
+		PROFILE_ZONE("Dx12Api::CreateBottomLevelAS");
+		const bool allowUpdate = false;
+		std::vector<uint8_t> geometry;
+		const uint64_t key = DescribeBottomLevelASGeometry(vVertexBuffers,
+			allowUpdate ? D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE
+			: D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE, geometry);
+
+		AccelerationStructureBuffers buffers;
+
+		if (key != 0)
+		{
+			buffers.pResult = m_bottomLevelASRegistry.Acquire(key, geometry);
+			if (buffers.pResult)
+			{
+				m_bottomLevelASReferences.emplace_back(key, buffers.pResult);
+				return buffers;
+			}
+		}
+
 		NvHelpers::BottomLevelASGenerator bottomLevelAS;
 
 		// Adding all vertex buffers and not transforming their position.
@@ -710,48 +1696,70 @@ namespace RaytracingImplementation
 		// buffers. It size is also dependent on the scene complexity.
 		UINT64 resultSizeInBytes = 0;
 
-		bottomLevelAS.ComputeASBufferSizes(m_device.Get(), false, &scratchSizeInBytes, &resultSizeInBytes);
+		bottomLevelAS.ComputeASBufferSizes(m_device.Get(), allowUpdate, &scratchSizeInBytes, &resultSizeInBytes);
 
 		// Once the sizes are obtained, the application is responsible for allocating
-		// the necessary buffers. Since the entire generation will be done on the GPU,
-		// we can directly allocate those on the default heap
-		AccelerationStructureBuffers buffers;
-
-		buffers.pScratch = NvHelpers::CreateBuffer(
-			m_device.Get(), scratchSizeInBytes,
-			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_COMMON,
-			NvHelpers::kDefaultHeapProps);
-
-		buffers.pResult = NvHelpers::CreateBuffer(
+		// the result buffer. Since the entire generation will be done on the GPU,
+		// we can directly allocate it on the default heap. The scratch space is
+		// provided by the build scheduler, shared with the other pending builds
+		buffers.pResult.Attach(NvHelpers::CreateBuffer(
 			m_device.Get(), resultSizeInBytes,
 			D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
 			D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
-			NvHelpers::kDefaultHeapProps);
+			NvHelpers::kDefaultHeapProps));
 
-		// Build the acceleration structure. Note that this call integrates a barrier
-		// on the generated AS, so that it can be used to compute a top-level AS right
-		// after this method.
-		bottomLevelAS.Generate(m_commandList.Get(), buffers.pScratch.Get(), buffers.pResult.Get(), false, nullptr);
+		// Queue the build. The scheduler records it along with the other pending
+		// builds when flushed, before the top-level AS is built
+		m_bottomLevelASBuildScheduler.Enqueue(bottomLevelAS, scratchSizeInBytes, buffers.pResult);
+
+		if (key != 0)
+		{
+			m_bottomLevelASRegistry.Register(key, geometry, buffers.pResult);
+			m_bottomLevelASReferences.emplace_back(key, buffers.pResult);
+		}
 
 		return buffers;
 	}
 
+	//-----------------------------------------------------------------------------
+	//
+	// The hit group records of the instances follow each other in the SBT, each
+	// instance having one record per ray type for each of its geometries
+	//
+	UINT Dx12Api::GetInstanceHitGroupOffset(size_t instanceIndex) const
+	{
+		if (instanceIndex >= m_instanceGeometries.size())
+		{
+			throw std::logic_error("No geometry is known for the instance");
+		}
+
+		UINT offset = 0;
+		for (size_t i = 0; i < instanceIndex; i++)
+		{
+			offset += static_cast<UINT>(m_instanceGeometries[i].size()) * kRayTypeCount;
+		}
+		return offset;
+	}
+
 	//-----------------------------------------------------------------------------
 	// Create the main acceleration structure that holds all instances of the scene.
 	// Similarly to the bottom-level AS generation, it is done in 3 steps: gathering
 	// the instances, computing the memory requirements for the AS, and building the
 	// AS itself
 	//
-	void Dx12Api::CreateTopLevelAS(
+	void Dx12Api::CreateTopLevelAS(ID3D12GraphicsCommandList4* commandList,
 		const std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, DirectX::XMMATRIX>>& instances,
-		AccelerationStructureBuffers& m_topLevelASBuffers) // pair of bottom level AS and matrix of the instance
+		AccelerationStructureBuffers& m_topLevelASBuffers, // pair of bottom level AS and matrix of the instance
+		ID3D12Resource* previousResult)
 	{
+		PROFILE_ZONE("Dx12Api::CreateTopLevelAS");
 		// Gather all the instances into the builder helper
+		m_topLevelASGenerator.ClearInstances();
 		for (size_t i = 0; i < instances.size(); i++)
 		{
 			m_topLevelASGenerator.AddInstance(instances[i].first.Get(),
 				instances[i].second, static_cast<UINT>(i),
-				static_cast<UINT>(0));
+				GetInstanceHitGroupOffset(i));
 		}
 
 		// As for the bottom-level AS, the building the AS requires some scratch space
@@ -759,38 +1767,44 @@ namespace RaytracingImplementation
 		// top-level AS, the instance descriptors also need to be stored in GPU
 		// memory. This call outputs the memory requirements for each (scratch,
 		// results, instance descriptors) so that the application can allocate the
-		// corresponding memory
-		UINT64 scratchSize, resultSize, instanceDescsSize;
-
-		m_topLevelASGenerator.ComputeASBufferSizes(m_device.Get(), true, &scratchSize, &resultSize, &instanceDescsSize);
-
-		// Create the scratch and result buffers. Since the build is all done on GPU,
-		// those can be allocated on the default heap
-		m_topLevelASBuffers.pScratch = NvHelpers::CreateBuffer(
-			m_device.Get(), scratchSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-			NvHelpers::kDefaultHeapProps);
-
-		m_topLevelASBuffers.pResult = NvHelpers::CreateBuffer(
-			m_device.Get(), resultSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
-			D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
-			NvHelpers::kDefaultHeapProps);
-
-		// The buffer describing the instances: ID, shader binding information,
-		// matrices ... Those will be copied into the buffer by the helper through
-		// mapping, so the buffer has to be allocated on the upload heap.
-		m_topLevelASBuffers.pInstanceDesc = NvHelpers::CreateBuffer(
-			m_device.Get(), instanceDescsSize, D3D12_RESOURCE_FLAG_NONE,
-			D3D12_RESOURCE_STATE_GENERIC_READ, NvHelpers::kUploadHeapProps);
+		// corresponding memory. An update reuses the buffers of the original build
+		const bool updateOnly = previousResult != nullptr;
+		if (!updateOnly)
+		{
+			UINT64 scratchSize, resultSize, instanceDescsSize;
+
+			m_topLevelASGenerator.ComputeASBufferSizes(m_device.Get(), true, &scratchSize, &resultSize, &instanceDescsSize);
+
+			// Create the scratch and result buffers. Since the build is all done on GPU,
+			// those can be allocated on the default heap
+			m_topLevelASBuffers.pScratch.Attach(NvHelpers::CreateBuffer(
+				m_device.Get(), scratchSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+				D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+				NvHelpers::kDefaultHeapProps));
+
+			m_topLevelASBuffers.pResult.Attach(NvHelpers::CreateBuffer(
+				m_device.Get(), resultSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
+				D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
+				NvHelpers::kDefaultHeapProps));
+
+			// The buffer describing the instances: ID, shader binding information,
+			// matrices ... Those will be copied into the buffer by the helper through
+			// mapping, so the buffer has to be allocated on the upload heap.
+			m_topLevelASBuffers.pInstanceDesc.Attach(NvHelpers::CreateBuffer(
+				m_device.Get(), instanceDescsSize, D3D12_RESOURCE_FLAG_NONE,
+				D3D12_RESOURCE_STATE_GENERIC_READ, NvHelpers::kUploadHeapProps));
+		}
 
 		// After all the buffers are allocated, or if only an update is required, we
 		// can build the acceleration structure. Note that in the case of the update
-		// we also pass the existing AS as the 'previous' AS, so that it can be
-		// refitted in place.
-		m_topLevelASGenerator.Generate(m_commandList.Get(),
+		// we also pass the existing AS as the 'previous' AS, which is either the
+		// result itself, refitted in place, or another structure of the same
+		// instances.
+		m_topLevelASGenerator.Generate(commandList,
 			m_topLevelASBuffers.pScratch.Get(),
 			m_topLevelASBuffers.pResult.Get(),
-			m_topLevelASBuffers.pInstanceDesc.Get());
+			m_topLevelASBuffers.pInstanceDesc.Get(),
+			updateOnly, previousResult);
 	}
 
 	//-----------------------------------------------------------------------------
@@ -800,31 +1814,89 @@ namespace RaytracingImplementation
 	//
 	void Dx12Api::CreateAccelerationStructures(Microsoft::WRL::ComPtr<ID3D12Resource>& m_vertexBuffer)
 	{
+		PROFILE_ZONE("Dx12Api::CreateAccelerationStructures");
 		// Build the bottom AS from the Triangle vertex buffer
 		AccelerationStructureBuffers bottomLevelBuffers =
 			CreateBottomLevelAS({ {m_vertexBuffer.Get(), 3} });
 
+		// The builds read the vertex buffers, whose copies are submitted first on
+		// the direct queue; the compute queue waits for them on the GPU
+		SubmitUploads();
 
-		// Just one instance for now
-		m_instances = { {bottomLevelBuffers.pResult,DirectX::XMMatrixIdentity()} };
-		CreateTopLevelAS(m_instances, m_topLevelASBuffers);
+		// The builds are recorded on the compute queue
+		BeginComputeCommands("BuildAccelerationStructures");
 
-		// Flush the command list and wait for it to finish
-		m_commandList->Close();
-		ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
-		m_commandQueue->ExecuteCommandLists(1, ppCommandLists);
-		m_fenceValue++;
-		m_commandQueue->Signal(m_fence.Get(), m_fenceValue);
+		// Record all the queued bottom-level builds in batches sharing the same
+		// scratch memory
+		m_bottomLevelASBuildScheduler.Flush(m_device.Get(), m_computeCommandList.Get());
 
-		m_fence->SetEventOnCompletion(m_fenceValue, m_fenceEvent);
-		WaitForSingleObject(m_fenceEvent, INFINITE);
+		// Just one instance for now. Every version of the top-level AS is built,
+		// each in its own buffers
+		m_instances = { {bottomLevelBuffers.pResult,DirectX::XMMatrixIdentity()} };
+		m_instanceGeometries = { { m_vertexBuffer } };
+		for (TopLevelASVersion& version : m_topLevelAS)
+		{
+			CreateTopLevelAS(m_computeCommandList.Get(), m_instances, version.buffers);
+		}
 
-		// Once the command list is finished executing, reset it to be reused for
-		// rendering
-		ThrowIfFailed(m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
+		// Submit the builds without waiting for them: the direct queue waits for
+		// them on the GPU before the first ray dispatch, and the scratch memory is
+		// returned once they have completed
+		SubmitComputeCommands(m_queueSync.GetLastSignaled(kDirectQueue));
+		for (TopLevelASVersion& version : m_topLevelAS)
+		{
+			version.buildFenceValue = m_computeFenceValue;
+			version.generation = m_topLevelASGeneration;
+		}
+		m_bottomLevelASScratchFenceValue = m_computeFenceValue;
 
 		// Store the AS buffers. The rest of the buffers will be released once we exit
 		// the function
 		m_bottomLevelAS = bottomLevelBuffers.pResult;
 	}
-}
\ No newline at end of file
+
+	//-----------------------------------------------------------------------------
+	//
+	// Refit the top-level AS with new instance transforms. The refit is submitted
+	// to the compute queue and writes the version of the back buffer being
+	// recorded, which only has to wait for the last frame presented from this
+	// back buffer: it runs alongside the frame the GPU is rendering from the
+	// other version, and the next ray dispatch waits for it on the GPU.
+	//
+	void Dx12Api::UpdateTopLevelAS(const std::vector<DirectX::XMMATRIX>& transforms)
+	{
+		PROFILE_ZONE("Dx12Api::UpdateTopLevelAS");
+		if (transforms.size() != m_instances.size())
+		{
+			throw std::logic_error("The top-level AS update requires one transform per instance");
+		}
+
+		for (size_t i = 0; i < transforms.size(); i++)
+		{
+			m_instances[i].second = transforms[i];
+		}
+		m_topLevelASGeneration++;
+		RefitTopLevelAS(m_frameIndex);
+	}
+
+	void Dx12Api::RefitTopLevelAS(UINT versionIndex)
+	{
+		PROFILE_ZONE("Dx12Api::RefitTopLevelAS");
+		TopLevelASVersion& version = m_topLevelAS[versionIndex];
+		// The instance descriptors are rewritten through mapping, once the
+		// previous build of the version no longer reads them. The CPU only waits
+		// if the version was refitted for the previous frames in flight as well
+		WaitForFenceValue(m_computeFence.Get(), version.buildFenceValue);
+		BeginComputeCommands("RefitTopLevelAS");
+
+		// The source is the version holding the last transforms, which may be
+		// this one, refitted in place
+		CreateTopLevelAS(m_computeCommandList.Get(), m_instances, version.buffers,
+			m_topLevelAS[m_lastTopLevelASVersion].buffers.pResult.Get());
+
+		SubmitComputeCommands(version.readFenceValue);
+		version.buildFenceValue = m_computeFenceValue;
+		version.generation = m_topLevelASGeneration;
+		m_lastTopLevelASVersion = versionIndex;
+	}
+}
@@ -16,12 +16,29 @@
 #pragma once
 
 #include "AccelerationStructureBuffers.h"
+#include "BottomLevelASBuildScheduler.h"
+#include "BottomLevelASRegistry.h"
+#include "BufferAllocator.h"
+#include "CommandListPool.h"
+#include "CommandPassGraph.h"
+#include "DescriptorAllocator.h"
+#include "FramePacer.h"
+#include "GpuPassTimer.h"
+#include "QueueSyncTracker.h"
+#include "ShaderArchive.h"
+#include "ShaderCache.h"
+#include "ShaderCompileService.h"
+#include "ShaderFileWatcher.h"
+#include "UploadRing.h"
 #include <dxgi1_2.h>
+#include <chrono>
 #include <stdexcept>
+#include <unordered_map>
 #include <vector>
 #include "vertex.h"
 #include <combaseapi.h>
 #include "dx12/dxr/DXRHelper.h"
+#include "dx12/dxr/nv_helpers_dx12/RootSignatureCache.h"
 #include "dx12/dxr/nv_helpers_dx12/ShaderBindingTableGenerator.h"
 #include "dx12/dxr/nv_helpers_dx12/TopLevelASGenerator.h"
 #include "dx12/dxr/nv_helpers_dx12/BottomLevelASGenerator.h"
@@ -46,6 +63,11 @@ namespace RaytracingImplementation
 
 		void Init(D3D12_COMMAND_QUEUE_DESC&, DXGI_SWAP_CHAIN_DESC1&, D3D12_DESCRIPTOR_HEAP_DESC&);
 
+		/// Number of frames the CPU may record ahead of the GPU, from 1 to 3. Must be
+		/// called before Init
+		void SetFramesInFlight(UINT frameCount);
+		inline UINT GetFramesInFlight() const { return m_framePacer.GetFrameCount(); }
+
 		//void CreateVertexBuffer(const UINT, Microsoft::WRL::ComPtr<ID3D12Resource>&);
 		void CreateVertexBuffer(const UINT vertexBufferSize, Microsoft::WRL::ComPtr<ID3D12Resource>& m_vertexBuffer,
 			D3D12_VERTEX_BUFFER_VIEW& m_vertexBufferView, const void* const data, const size_t size);
@@ -56,11 +78,66 @@ namespace RaytracingImplementation
 
 		/// Create all acceleration structures, bottom and top
 		void CreateAccelerationStructures(Microsoft::WRL::ComPtr<ID3D12Resource>&);
+		/// Refit the top-level AS with new instance transforms, one per instance in
+		/// the order they were added. The refit runs on the compute queue, into the
+		/// version of the structure read by the back buffer being recorded
+		void UpdateTopLevelAS(const std::vector<DirectX::XMMATRIX>& transforms);
 		void CreateRaytracingPipeline();
+		/// Shaders compiled by the pipelines, relative to the working directory, to
+		/// be built into the shader archive loaded at startup
+		static std::vector<ShaderRequest> GetShaderManifest();
+		/// Flags of the FXC compilations, as recorded in the shader archive
+#if defined(_DEBUG)
+		// Enable better shader debugging with the graphics debugging tools.
+		static constexpr UINT kShaderCompileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+		static constexpr UINT kShaderCompileFlags = 0;
+#endif
+		/// Compile again the raytracing libraries and the composite shader affected by
+		/// the shader files modified since the last call, and rebuild the pipelines
+		/// using them. The files are polled at most a few times per second, and a
+		/// change is picked up by the poll after it has settled. A failed compilation
+		/// is logged and keeps the current pipelines. Returns true if any shader was
+		/// modified
+		bool ReloadModifiedShaders();
+		/// Create the shader-visible heap holding all the CBV/SRV/UAV descriptors, and
+		/// write the descriptors of the raytracing output and of the top-level AS
 		void CreateShaderResourceHeap();
-		void CreateShaderBindingTable(Microsoft::WRL::ComPtr<ID3D12Resource>&);
+		/// Allocate count contiguous descriptors of the shader-visible heap, valid
+		/// until the GPU is done with the frame being recorded. Returns the index of
+		/// the first one in the heap
+		UINT AllocateFrameDescriptors(UINT count);
+		D3D12_CPU_DESCRIPTOR_HANDLE GetCpuDescriptorHandle(UINT index) const;
+		D3D12_GPU_DESCRIPTOR_HANDLE GetGpuDescriptorHandle(UINT index) const;
+		inline const DescriptorAllocator& GetDescriptorAllocator() const { return m_descriptorAllocator; }
+		/// GPU timings of the frame passes and of the AS builds, read back without
+		/// waiting for the GPU, a few frames late
+		inline const GpuPassTimer& GetGpuTimer() const { return m_gpuTimer; }
+		inline const GpuPassTimer& GetComputeTimer() const { return m_computeTimer; }
+		/// Local video memory used by the process, in bytes, or 0 if the adapter
+		/// cannot report it
+		UINT64 GetVideoMemoryUsage() const;
+		/// Create the SBT: one miss record per ray type, and one hit group record per
+		/// ray type for every geometry of every instance
+		void CreateShaderBindingTable();
 		void CloseCommandList();
 		inline bool GetRaytracingSupport() const { return m_raytracing_support; }
+		inline const NvHelpers::RootSignatureCache& GetRootSignatureCache() const { return m_rootSignatureCache; }
+
+		/// Settings of the pass compositing the raytracing output into the back
+		/// buffer. Must match the CompositeConstants of Composite.hlsl
+		static constexpr UINT kTonemapNone = 0;
+		static constexpr UINT kTonemapReinhard = 1;
+		static constexpr UINT kTonemapAces = 2;
+		struct CompositeSettings
+		{
+			float exposure = 1.0f;
+			UINT tonemapOperator = kTonemapNone;
+			// Encode the color in sRGB, for non-sRGB back buffers
+			UINT encodeSrgb = 0;
+		};
+		void SetCompositeSettings(const CompositeSettings& settings);
+		inline const CompositeSettings& GetCompositeSettings() const { return m_compositeSettings; }
 
 		// Adapter info.
 		bool useWarpDevice;
@@ -72,6 +149,11 @@ namespace RaytracingImplementation
 		void GetHardwareAdapter(_In_ IDXGIFactory2* pFactory, _Outptr_result_maybenull_ IDXGIAdapter1** ppAdapter);
 		void EnableDebugLayer();
 		void WaitForPreviousFrame();
+		void WaitForFenceValue(ID3D12Fence* fence, UINT64 fenceValue);
+		inline ID3D12CommandAllocator* GetCommandAllocator() const
+		{
+			return m_commandAllocators[m_framePacer.GetCurrentFrame()].Get();
+		}
 
 		// #DXR
 		Microsoft::WRL::ComPtr<ID3D12RootSignature> CreateRayGenSignature();
@@ -80,27 +162,95 @@ namespace RaytracingImplementation
 
 		bool CheckRaytracingSupport();
 		void CreateCommandQueue(D3D12_COMMAND_QUEUE_DESC&);
+		void CreateComputeQueue();
+
+		// Acceleration structure work on the compute queue
+		/// Start recording AS work on the compute queue, timed as a single pass
+		void BeginComputeCommands(const char* passName);
+		/// Submit the AS work after the direct queue work up to a fence value, the
+		/// last one writing its inputs or reading the structures it overwrites
+		void SubmitComputeCommands(UINT64 directFenceValue);
+		// Release the resources of the compute work which has completed
+		void RetireComputeWork();
+		void InsertQueueWait(size_t consumer, size_t producer, UINT64 value);
 		void CreateSwapChain(DXGI_SWAP_CHAIN_DESC1&);
 		void CreateRtvResources(D3D12_DESCRIPTOR_HEAP_DESC&);
-		void WaitUploadVertexBuffer();
+		/// Execute the setup command list and close the upload space it used,
+		/// without waiting for the GPU
+		void ExecuteSetupCommands();
+		/// Same, reopening the list for more setup commands
+		void SubmitUploads();
+		/// Record the copy of data into a buffer in COPY_DEST state, staged through
+		/// the persistently mapped upload ring
+		void UploadToBuffer(ID3D12Resource* destination, UINT64 destinationOffset, const void* data, size_t size);
 		void CreateRaytracingOutputBuffer();
+		/// Create the fullscreen pass writing the raytracing output into the back
+		/// buffer, applying the tonemapping on the way
+		void CreateCompositePipeline();
+		/// Create the raytracing state object from the compiled libraries
+		void CreateRaytracingStateObject();
+
+		// Command list handed out to the workers recording the passes
+		struct PooledCommandList
+		{
+			Microsoft::WRL::ComPtr<ID3D12CommandAllocator> commandAllocator;
+			Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> commandList;
+		};
+
+		/// Add the passes rendering a frame into a back buffer to the graph
+		void AddFramePasses(CommandPassGraph<PooledCommandList>& graph, UINT backBufferIndex,
+			bool rasterMode, const D3D12_VERTEX_BUFFER_VIEW& vertexBufferView, uint32_t timerSet);
+		/// Force the recorded frames to be recorded again on their next use, after
+		/// a change of pipeline, SBT or resources
+		void InvalidateRecordedCommandLists();
+
+		// Heaps backing the buffers created through NvHelpers::CreateBuffer. Declared
+		// first so that it is destroyed after all the buffers it placed
+		BufferAllocator m_bufferAllocator;
 
 		NvHelpers::TopLevelASGenerator m_topLevelASGenerator;
 		std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, DirectX::XMMATRIX>> m_instances;
-
-		/// Create the acceleration structure of an instance
+		// Vertex buffer of each geometry of each instance, in the order of m_instances
+		// and of the geometries in their bottom-level AS. The SBT holds one hit group
+		// record per ray type for each of them
+		std::vector<std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>>> m_instanceGeometries;
+
+		// Ray types, matching the RAY_TYPE_* definitions of Common.hlsl
+		static constexpr UINT kRayTypeRadiance = 0;
+		static constexpr UINT kRayTypeShadow = 1;
+		static constexpr UINT kRayTypeCount = 2;
+		/// Index of the first hit group record of an instance in the SBT
+		UINT GetInstanceHitGroupOffset(size_t instanceIndex) const;
+
+		/// Create the acceleration structure of an instance. Geometry identical to
+		/// an already built structure resolves to that structure. The build itself
+		/// is queued in the BLAS build scheduler, so only the result buffer is
+		/// returned; the structure is usable once the scheduler has been flushed.
 		///
 		/// \param     vVertexBuffers : pair of buffer and vertex count
 		/// \return    AccelerationStructureBuffers for TLAS
 		AccelerationStructureBuffers CreateBottomLevelAS(
 			std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, uint32_t>> vVertexBuffers);
 
+		/// Describe the geometry of the bottom-level AS built from a set of vertex
+		/// buffers for the registry, and return its key, or 0 if the content of
+		/// one of the buffers is unknown
+		uint64_t DescribeBottomLevelASGeometry(
+			const std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, uint32_t>>& vVertexBuffers,
+			D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags, std::vector<uint8_t>& geometry) const;
+
 		/// Create the main acceleration structure that holds
-		/// all instances of the scene
+		/// all instances of the scene, or refit it
+		/// \param     commandList : list on which the build is recorded
 		/// \param     instances : pair of BLAS and transform
-		void CreateTopLevelAS(
+		/// \param     previousResult : structure to refit into the buffers, which
+		///                            must have been built before, or nullptr
+		void CreateTopLevelAS(ID3D12GraphicsCommandList4* commandList,
 			const std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, DirectX::XMMATRIX>>& instances,
-			AccelerationStructureBuffers& m_topLevelASBuffers);
+			AccelerationStructureBuffers& m_topLevelASBuffers, ID3D12Resource* previousResult = nullptr);
+		/// Refit a version of the top-level AS from the last built one, with the
+		/// transforms of m_instances
+		void RefitTopLevelAS(UINT version);
 
 		bool m_raytracing_support = false;
 
@@ -114,8 +264,9 @@ namespace RaytracingImplementation
 		CD3DX12_VIEWPORT m_viewport;
 		CD3DX12_RECT m_scissorRect;
 		Microsoft::WRL::ComPtr<IDXGISwapChain3> m_swapChain;
-		Microsoft::WRL::ComPtr<ID3D12Resource> m_renderTargets[2];
-		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_commandAllocator;
+		static constexpr UINT kBackBufferCount = 2;
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_renderTargets[kBackBufferCount];
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_commandAllocators[FramePacer::kMaxFrameCount];
 		Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_commandQueue;
 		Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature;
 		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
@@ -128,11 +279,117 @@ namespace RaytracingImplementation
 		HANDLE m_fenceEvent;
 		Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
 		UINT64 m_fenceValue;
-
-		Microsoft::WRL::ComPtr<IDxcBlob> m_rayGenLibrary;
-		Microsoft::WRL::ComPtr<IDxcBlob> m_hitLibrary;
-		Microsoft::WRL::ComPtr<IDxcBlob> m_missLibrary;
-
+		FramePacer m_framePacer;
+
+		// Compute queue running the acceleration structure builds and refits
+		static constexpr size_t kDirectQueue = 0;
+		static constexpr size_t kComputeQueue = 1;
+		Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_computeQueue;
+		// Allocators used in turn by the compute work, with the compute fence value
+		// of the work last recorded with each, so that a refit per frame in flight
+		// can be pending
+		Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_computeCommandAllocators[FramePacer::kMaxFrameCount];
+		UINT64 m_computeAllocatorFenceValues[FramePacer::kMaxFrameCount] = {};
+		UINT m_computeAllocatorIndex = 0;
+		Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList4> m_computeCommandList;
+		Microsoft::WRL::ComPtr<ID3D12Fence> m_computeFence;
+		UINT64 m_computeFenceValue = 0;
+		QueueSyncTracker m_queueSync{ 2 };
+		// Compute fence value of the bottom-level builds still using the scheduler
+		// scratch memory (0 if none)
+		UINT64 m_bottomLevelASScratchFenceValue = 0;
+
+		// Frame commands recorded once per back buffer and per mode (raster, raytracing),
+		// and replayed until invalidated: one list per pass, in submission order
+		struct RecordedCommandList
+		{
+			std::vector<PooledCommandList*> commandLists;
+			std::vector<ID3D12CommandList*> submission;
+			// Fence value signaled after the last frame which executed the lists
+			UINT64 fenceValue = 0;
+			// Whether the lists dispatch rays, and thus read the top-level AS
+			bool raytracing = false;
+			bool valid = false;
+			// Set of m_gpuTimer timing the passes of the lists
+			uint32_t timerSet = 0;
+		};
+		CommandListPool<PooledCommandList> m_commandListPool;
+		RecordedCommandList m_recordedCommandLists[kBackBufferCount][2];
+		D3D12_VERTEX_BUFFER_VIEW m_recordedVertexBufferView = {};
+		// List submitted by the next call to Swap
+		RecordedCommandList* m_frameCommandList = nullptr;
+
+		// Timestamp queries of a queue, resolved into a persistently mapped readback
+		// buffer holding one region per slot of the timer using them
+		class QueueTimestamps : public TimestampSource
+		{
+		public:
+			// Leaves the timestamps invalid if the queue cannot time its work
+			void Create(ID3D12Device* device, ID3D12CommandQueue* queue, const GpuPassTimer& timer);
+			inline bool IsValid() const { return m_heap != nullptr; }
+
+			// Both do nothing if the timestamps or the query are invalid
+			void WriteTimestamp(ID3D12GraphicsCommandList* commandList, uint32_t query) const;
+			void Resolve(ID3D12GraphicsCommandList* commandList, uint32_t firstQuery, uint32_t count, uint32_t slot) const;
+
+			uint64_t GetFrequency() const override { return m_frequency; }
+			void Read(uint32_t slot, uint32_t count, uint64_t* timestamps) override;
+			bool GetCalibration(uint64_t& timestamp, uint64_t& profilerTimestamp) override;
+
+		private:
+			ID3D12CommandQueue* m_queue = nullptr;
+			Microsoft::WRL::ComPtr<ID3D12QueryHeap> m_heap;
+			Microsoft::WRL::ComPtr<ID3D12Resource> m_readback;
+			uint64_t* m_readbackData = nullptr;
+			uint64_t m_frequency = 1;
+			uint32_t m_slotQueryCount = 0;
+		};
+		// One set per recorded frame, and one slot per frame in flight plus the one
+		// being recorded
+		static constexpr uint32_t kMaxTimedPassesPerFrame = 4;
+		GpuPassTimer m_gpuTimer{ kBackBufferCount * 2, kMaxTimedPassesPerFrame, FramePacer::kMaxFrameCount + 1 };
+		QueueTimestamps m_gpuTimestamps;
+		GpuPassTimer m_computeTimer{ 1, 1, 4 };
+		QueueTimestamps m_computeTimestamps;
+		uint32_t m_computeTimerQuery = GpuPassTimer::kInvalidIndex;
+
+		// Persistently mapped upload buffer, and the ring allocating the transient
+		// uploads in it
+		static constexpr UINT64 kUploadBufferSize = 4 * 1024 * 1024;
+		static constexpr UINT64 kUploadAlignment = 16;
+		Microsoft::WRL::ComPtr<ID3D12Resource> m_uploadBuffer;
+		UINT8* m_uploadBufferData = nullptr;
+		UploadRing m_uploadRing{ kUploadBufferSize };
+
+		// Compiled shader libraries, kept on disk between runs, and the workers
+		// compiling the shaders of the pipelines concurrently
+		ShaderCache m_shaderCache{ L"shadercache" };
+		ShaderCompileService m_shaderCompiler{ &m_shaderCache };
+		// Shaders compiled by the build, next to the executable, if any
+		std::shared_ptr<const ShaderArchive> m_shaderArchive;
+		static constexpr const wchar_t* kShaderArchivePath = L"shaders.pak";
+
+		// DXIL libraries of the raytracing pipeline, with the shaders they export
+		struct ShaderLibrary
+		{
+			std::wstring fileName;
+			std::vector<std::wstring> exports;
+			Microsoft::WRL::ComPtr<IDxcBlob> blob;
+		};
+		static std::vector<ShaderLibrary> GetRaytracingLibraries();
+		// Check the exports of the libraries against the ones recorded in the archive
+		void ValidateLibraryExports() const;
+		std::vector<ShaderLibrary> m_shaderLibraries;
+		static constexpr const wchar_t* kCompositeShaderPath = L"resources/shaders/Composite.hlsl";
+
+		// Shader files watched for hot reload, with their includes
+		ShaderFileWatcher m_shaderWatcher;
+		static constexpr std::chrono::milliseconds kShaderPollInterval{ 250 };
+		std::chrono::steady_clock::time_point m_lastShaderPoll;
+
+		// Root signatures shared by all the pipelines, so that identical layouts
+		// resolve to a single object
+		NvHelpers::RootSignatureCache m_rootSignatureCache;
 		Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rayGenSignature;
 		Microsoft::WRL::ComPtr<ID3D12RootSignature> m_hitSignature;
 		Microsoft::WRL::ComPtr<ID3D12RootSignature> m_missSignature;
@@ -146,11 +403,67 @@ namespace RaytracingImplementation
 
 		// #DXR
 		Microsoft::WRL::ComPtr<ID3D12Resource> m_outputResource;
+		// Single shader-visible heap of the CBV/SRV/UAV descriptors, bound once per
+		// command list. Its persistent region holds the descriptors of the resources,
+		// which keep the same index while they live, its transient region the ones
+		// written for a single frame
+		static constexpr UINT kPersistentDescriptorCount = 4096;
+		static constexpr UINT kTransientDescriptorCount = 1024;
 		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_srvUavHeap;
-
-		// #DXR
-		NvHelpers::ShaderBindingTableGenerator m_sbtHelper;
-		Microsoft::WRL::ComPtr<ID3D12Resource> m_sbtStorage;
+		UINT m_srvUavDescriptorSize = 0;
+		DescriptorAllocator m_descriptorAllocator{ kPersistentDescriptorCount, kTransientDescriptorCount };
+		// The raytracing output is kept in high precision, and converted to the back
+		// buffer format by the composite pass
+		static constexpr DXGI_FORMAT kRaytracingOutputFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		// Slot of the raytracing output SRV in the raytracing descriptors of a
+		// top-level AS version, after the output UAV and the TLAS SRV
+		static constexpr UINT kOutputSrvHeapSlot = 2;
+		DXGI_FORMAT m_backBufferFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+		// Composite pass. The raytracing output stays in the UNORDERED_ACCESS state
+		// when the pass can read it through its UAV, otherwise it goes through a SRV
+		Microsoft::WRL::ComPtr<ID3D12RootSignature> m_compositeSignature;
+		Microsoft::WRL::ComPtr<ID3D12PipelineState> m_compositePipelineState;
+		bool m_compositeReadsUav = false;
+		CompositeSettings m_compositeSettings;
+
+		// Names of the raytracing shaders and hit groups, shared by the pipeline and
+		// the SBT generators
+		NvHelpers::ShaderSymbolTable m_shaderSymbols;
+
+		// The top-level AS is kept in one version per back buffer, each with the
+		// descriptors and the SBT pointing to it. The refit for a frame writes the
+		// version read by the frames of its back buffer, while the GPU still runs
+		// the previous frame from the other one
+		struct TopLevelASVersion
+		{
+			explicit TopLevelASVersion(NvHelpers::ShaderSymbolTable& symbols) : sbtHelper{ symbols } {}
+
+			AccelerationStructureBuffers buffers;
+			// First of the contiguous descriptors of the raytracing output UAV, the
+			// TLAS SRV and the raytracing output SRV
+			UINT descriptors = DescriptorAllocator::kInvalidIndex;
+			// #DXR
+			NvHelpers::ShaderBindingTableGenerator sbtHelper;
+			Microsoft::WRL::ComPtr<ID3D12Resource> sbtStorage;
+			// Compute fence value of the last build or refit, and direct fence value
+			// of the last frame reading the structure
+			UINT64 buildFenceValue = 0;
+			UINT64 readFenceValue = 0;
+			// Value of m_topLevelASGeneration when the version was last built
+			UINT64 generation = 0;
+		};
+		static_assert(kBackBufferCount == 2, "One top-level AS version is declared per back buffer");
+		TopLevelASVersion m_topLevelAS[kBackBufferCount] = {
+			TopLevelASVersion(m_shaderSymbols), TopLevelASVersion(m_shaderSymbols) };
+		// Version holding the last instance transforms, and the number of updates
+		// of the transforms
+		UINT m_lastTopLevelASVersion = 0;
+		UINT64 m_topLevelASGeneration = 0;
+		/// Write the raytracing descriptors of a version in newly allocated slots
+		void CreateRaytracingDescriptors(TopLevelASVersion& version);
+		/// Create the SBT of a version, pointing to its structure and descriptors
+		void CreateShaderBindingTable(TopLevelASVersion& version);
 
 		// Root assets path.
 		std::wstring m_assetsPath;
@@ -158,7 +471,23 @@ namespace RaytracingImplementation
 		UINT dxgiFactoryFlags = 0;
 
 		Microsoft::WRL::ComPtr<ID3D12Resource> m_bottomLevelAS; // Storage for the bottom Level AS
-		AccelerationStructureBuffers m_topLevelASBuffers;
+
+		// Bottom-level AS shared between identical geometries, and the
+		// references held by this object
+		BottomLevelASRegistry m_bottomLevelASRegistry;
+		// Batches the BLAS builds over a shared, budgeted scratch buffer
+		BottomLevelASBuildScheduler m_bottomLevelASBuildScheduler;
+		std::vector<std::pair<uint64_t, Microsoft::WRL::ComPtr<ID3D12Resource>>> m_bottomLevelASReferences;
+		// Content uploaded into each vertex buffer. Each entry holds a reference
+		// to its buffer, so that the address of a released buffer is never
+		// reused by another one while its content is known
+		struct VertexBufferContent
+		{
+			Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+			std::vector<uint8_t> bytes;
+			uint64_t hash;
+		};
+		std::unordered_map<ID3D12Resource*, VertexBufferContent> m_vertexBufferContents;
 	};
 }
 
@@ -0,0 +1,40 @@
+#include "FramePacer.h"
+#include <stdexcept>
+
+namespace RaytracingImplementation
+{
+
+	FramePacer::FramePacer(uint32_t frameCount)
+	{
+		if (frameCount < kMinFrameCount || frameCount > kMaxFrameCount)
+		{
+			throw std::logic_error("The number of frames in flight must be between 1 and 3");
+		}
+		m_frameFenceValues.resize(frameCount, 0);
+	}
+
+	void FramePacer::EndFrame(uint64_t fenceValue)
+	{
+		if (fenceValue <= m_lastFenceValue)
+		{
+			throw std::logic_error("Frame fence values must be increasing");
+		}
+
+		m_frameFenceValues[m_currentFrame] = fenceValue;
+		m_lastFenceValue = fenceValue;
+		m_currentFrame = (m_currentFrame + 1) % GetFrameCount();
+	}
+
+	uint32_t FramePacer::GetFramesInFlight(uint64_t completedFenceValue) const
+	{
+		uint32_t count = 0;
+		for (uint64_t fenceValue : m_frameFenceValues)
+		{
+			if (fenceValue > completedFenceValue)
+			{
+				count++;
+			}
+		}
+		return count;
+	}
+}
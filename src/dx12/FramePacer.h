@@ -0,0 +1,56 @@
+#ifndef FRAME_PACER_GUARD
+#define FRAME_PACER_GUARD
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Schedules a ring of frame contexts, so that the CPU records a frame while the GPU is
+	// still executing up to frameCount - 1 previous ones. Each context remembers the fence
+	// value signaled after its last submission; it can only be recorded into again, and its
+	// command allocator and transient allocations reused, once that value has completed.
+	//
+	// The pacer only manipulates fence values, it does not depend on any platform header and
+	// can be driven by a simulated queue and fence.
+	class FramePacer
+	{
+	public:
+		static constexpr uint32_t kMinFrameCount = 1;
+		static constexpr uint32_t kMaxFrameCount = 3;
+		static constexpr uint32_t kDefaultFrameCount = 2;
+
+		explicit FramePacer(uint32_t frameCount = kDefaultFrameCount);
+
+		inline uint32_t GetFrameCount() const { return static_cast<uint32_t>(m_frameFenceValues.size()); }
+		// Index of the frame context being recorded
+		inline uint32_t GetCurrentFrame() const { return m_currentFrame; }
+
+		// Fence value which must have completed before the current frame context can be
+		// recorded into, 0 if it was never submitted
+		inline uint64_t GetCurrentFrameFenceValue() const { return m_frameFenceValues[m_currentFrame]; }
+		inline bool IsCurrentFrameAvailable(uint64_t completedFenceValue) const
+		{
+			return completedFenceValue >= GetCurrentFrameFenceValue();
+		}
+
+		// Record that the current frame has been submitted, followed by a signal of the fence
+		// value, and move on to the next frame context. Fence values must be increasing.
+		void EndFrame(uint64_t fenceValue);
+
+		// Number of submitted frames which have not completed yet
+		uint32_t GetFramesInFlight(uint64_t completedFenceValue) const;
+
+		// Fence value signaled after the last submitted frame, 0 if none
+		inline uint64_t GetLastFenceValue() const { return m_lastFenceValue; }
+
+	private:
+		std::vector<uint64_t> m_frameFenceValues;
+		uint32_t m_currentFrame = 0;
+		uint64_t m_lastFenceValue = 0;
+	};
+}
+
+#endif // !FRAME_PACER_GUARD
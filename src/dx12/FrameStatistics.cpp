@@ -0,0 +1,203 @@
+#include "FrameStatistics.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace RaytracingImplementation
+{
+	//-----------------------------------------------------------------------------
+	//
+	// frexp splits the value into a mantissa in [0.5, 1) and an exponent, the
+	// mantissa giving the sub-bucket linearly
+	//
+	uint32_t Histogram::GetBucket(double value)
+	{
+		if (!(value > 0.0))
+		{
+			return 0;
+		}
+		int exponent;
+		const double mantissa = std::frexp(value, &exponent);
+		if (exponent < kMinExponent)
+		{
+			return 0;
+		}
+		if (exponent >= kMaxExponent)
+		{
+			return kBucketCount - 1;
+		}
+		const uint32_t subBucket = std::min<uint32_t>(static_cast<uint32_t>((mantissa - 0.5) * 2.0 * kSubBucketCount),
+			kSubBucketCount - 1);
+		return uint32_t(exponent - kMinExponent) * kSubBucketCount + subBucket;
+	}
+
+	double Histogram::GetBucketValue(uint32_t bucket)
+	{
+		const int exponent = int(bucket / kSubBucketCount) + kMinExponent;
+		const double mantissa = 0.5 + (double(bucket % kSubBucketCount) + 0.5) / (2.0 * kSubBucketCount);
+		return std::ldexp(mantissa, exponent);
+	}
+
+	void Histogram::Record(double value)
+	{
+		m_counts[GetBucket(value)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void Histogram::Clear()
+	{
+		for (std::atomic<uint64_t>& count : m_counts)
+		{
+			count.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	void Histogram::Accumulate(std::array<uint64_t, kBucketCount>& counts) const
+	{
+		for (uint32_t bucket = 0; bucket < kBucketCount; bucket++)
+		{
+			counts[bucket] += m_counts[bucket].load(std::memory_order_relaxed);
+		}
+	}
+
+	FrameStatistics::FrameStatistics(double intervalSeconds) :
+		m_intervalSeconds(intervalSeconds)
+	{
+	}
+
+	void FrameStatistics::Record(Metric metric, double value)
+	{
+		MetricHistograms& histograms = m_metrics[metric];
+		histograms.windows[m_currentWindow.load(std::memory_order_relaxed)].Record(value);
+		histograms.total.Record(value);
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The oldest window is cleared before it becomes the current one. A value
+	// recorded concurrently into it may be lost, which does not matter for
+	// statistics over thousands of frames
+	//
+	bool FrameStatistics::Advance(double timeSeconds)
+	{
+		if (m_intervalEnd < 0.0)
+		{
+			m_intervalEnd = timeSeconds + m_intervalSeconds;
+			return false;
+		}
+		if (timeSeconds < m_intervalEnd)
+		{
+			return false;
+		}
+
+		// After a long pause, such as a breakpoint, all the windows are out of date
+		const uint32_t elapsedWindows = static_cast<uint32_t>(std::min<double>(
+			(timeSeconds - m_intervalEnd) / m_intervalSeconds + 1.0, kWindowCount));
+		uint32_t window = m_currentWindow.load(std::memory_order_relaxed);
+		for (uint32_t i = 0; i < elapsedWindows; i++)
+		{
+			window = (window + 1) % kWindowCount;
+			for (MetricHistograms& histograms : m_metrics)
+			{
+				histograms.windows[window].Clear();
+			}
+		}
+		m_currentWindow.store(window, std::memory_order_relaxed);
+		m_intervalEnd = timeSeconds + m_intervalSeconds;
+		return true;
+	}
+
+	FrameStatistics::Summary FrameStatistics::GetRecentSummary(Metric metric) const
+	{
+		std::array<uint64_t, Histogram::kBucketCount> counts = {};
+		for (const Histogram& window : m_metrics[metric].windows)
+		{
+			window.Accumulate(counts);
+		}
+		return Summarize(counts);
+	}
+
+	FrameStatistics::Summary FrameStatistics::GetTotalSummary(Metric metric) const
+	{
+		std::array<uint64_t, Histogram::kBucketCount> counts = {};
+		m_metrics[metric].total.Accumulate(counts);
+		return Summarize(counts);
+	}
+
+	FrameStatistics::Summary FrameStatistics::Summarize(const std::array<uint64_t, Histogram::kBucketCount>& counts)
+	{
+		Summary summary;
+		double sum = 0.0;
+		for (uint32_t bucket = 0; bucket < Histogram::kBucketCount; bucket++)
+		{
+			if (counts[bucket] != 0)
+			{
+				summary.count += counts[bucket];
+				sum += double(counts[bucket]) * Histogram::GetBucketValue(bucket);
+				summary.max = Histogram::GetBucketValue(bucket);
+			}
+		}
+		if (summary.count == 0)
+		{
+			return summary;
+		}
+		summary.mean = sum / double(summary.count);
+
+		// Nearest rank: the smallest value with at least the given share of the
+		// samples lower than or equal to it
+		const auto getRank = [&summary](double percentile)
+		{
+			return std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile * double(summary.count))));
+		};
+		const uint64_t ranks[] = { getRank(0.50), getRank(0.95), getRank(0.99) };
+		double* values[] = { &summary.p50, &summary.p95, &summary.p99 };
+		uint64_t cumulated = 0;
+		size_t next = 0;
+		for (uint32_t bucket = 0; bucket < Histogram::kBucketCount && next < 3; bucket++)
+		{
+			cumulated += counts[bucket];
+			while (next < 3 && cumulated >= ranks[next])
+			{
+				*values[next++] = Histogram::GetBucketValue(bucket);
+			}
+		}
+		return summary;
+	}
+
+	const char* FrameStatistics::GetMetricName(Metric metric)
+	{
+		switch (metric)
+		{
+		case kFrameTime:
+			return "frame_time_ms";
+		case kGpuTime:
+			return "gpu_time_ms";
+		case kMegaraysPerSecond:
+			return "mrays_per_s";
+		case kMemoryUsage:
+			return "memory_mb";
+		default:
+			return "unknown";
+		}
+	}
+
+	bool FrameStatistics::WriteCsv(const std::filesystem::path& path) const
+	{
+		std::ofstream file(path, std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		file << "metric,samples,mean,p50,p95,p99,max\n";
+		for (uint32_t metric = 0; metric < kMetricCount; metric++)
+		{
+			const Summary summary = GetTotalSummary(Metric(metric));
+			if (summary.count == 0)
+			{
+				continue;
+			}
+			file << GetMetricName(Metric(metric)) << ',' << summary.count << ',' << summary.mean << ',' <<
+				summary.p50 << ',' << summary.p95 << ',' << summary.p99 << ',' << summary.max << '\n';
+		}
+		return static_cast<bool>(file);
+	}
+}
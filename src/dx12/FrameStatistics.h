@@ -0,0 +1,111 @@
+#ifndef FRAME_STATISTICS_GUARD
+#define FRAME_STATISTICS_GUARD
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace RaytracingImplementation
+{
+	// Histogram of positive values, with buckets of constant relative width: each power of
+	// two is split into kSubBucketCount buckets, so a percentile is known within about 4% of
+	// its value whatever its magnitude. Values are recorded with a single relaxed atomic
+	// increment, so any thread can record while another one reads.
+	class Histogram
+	{
+	public:
+		static constexpr int kMinExponent = -24;
+		static constexpr int kMaxExponent = 40;
+		static constexpr uint32_t kSubBucketCount = 16;
+		static constexpr uint32_t kBucketCount = uint32_t(kMaxExponent - kMinExponent) * kSubBucketCount;
+
+		Histogram() = default;
+		Histogram(const Histogram&) = delete;
+		Histogram& operator = (const Histogram&) = delete;
+
+		// Values out of the range of the buckets are clamped to the first or the last one
+		void Record(double value);
+		void Clear();
+
+		// Add the counts of the histogram to counts, indexed by bucket
+		void Accumulate(std::array<uint64_t, kBucketCount>& counts) const;
+
+		static uint32_t GetBucket(double value);
+		// Value representing a bucket, in the middle of its range
+		static double GetBucketValue(uint32_t bucket);
+
+	private:
+		std::array<std::atomic<uint64_t>, kBucketCount> m_counts = {};
+	};
+
+	// Statistics of the frames, per metric: percentiles over the last few seconds, for a live
+	// display, and over the whole run, for a report. The recent values are kept in a ring of
+	// histograms each covering a fixed interval; Advance starts a new interval once the
+	// current one is over, dropping the oldest.
+	class FrameStatistics
+	{
+	public:
+		enum Metric : uint32_t
+		{
+			kFrameTime,
+			kGpuTime,
+			kMegaraysPerSecond,
+			kMemoryUsage,
+			kMetricCount
+		};
+
+		// All the values are known within the precision of the histogram buckets
+		struct Summary
+		{
+			uint64_t count = 0;
+			double mean = 0.0;
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+
+		static constexpr uint32_t kWindowCount = 4;
+
+		// The recent percentiles cover between (kWindowCount - 1) and kWindowCount intervals
+		explicit FrameStatistics(double intervalSeconds = 0.5);
+
+		FrameStatistics(const FrameStatistics&) = delete;
+		FrameStatistics& operator = (const FrameStatistics&) = delete;
+
+		void Record(Metric metric, double value);
+
+		// Move to the next interval if the current one is over. Returns true if it did. Must
+		// not be called by several threads at once
+		bool Advance(double timeSeconds);
+
+		Summary GetRecentSummary(Metric metric) const;
+		Summary GetTotalSummary(Metric metric) const;
+
+		static const char* GetMetricName(Metric metric);
+
+		// Write the total summary of every metric with samples, one line per metric. Returns
+		// false if the file cannot be written
+		bool WriteCsv(const std::filesystem::path& path) const;
+
+	private:
+		struct MetricHistograms
+		{
+			std::array<Histogram, kWindowCount> windows;
+			Histogram total;
+		};
+
+		static Summary Summarize(const std::array<uint64_t, Histogram::kBucketCount>& counts);
+
+		double m_intervalSeconds;
+		double m_intervalEnd = -1.0;
+		std::atomic<uint32_t> m_currentWindow{ 0 };
+		std::array<MetricHistograms, kMetricCount> m_metrics;
+	};
+}
+
+#endif // !FRAME_STATISTICS_GUARD
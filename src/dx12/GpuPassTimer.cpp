@@ -0,0 +1,191 @@
+#include "GpuPassTimer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		uint64_t GetNanoseconds(std::chrono::steady_clock::time_point origin)
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - origin).count());
+		}
+	}
+
+	CpuTimestampSource::CpuTimestampSource(uint32_t queryCount, uint32_t slotCount) :
+		m_queries(queryCount, 0),
+		m_slots(size_t(queryCount) * slotCount, 0)
+	{
+	}
+
+	void CpuTimestampSource::WriteTimestamp(uint32_t query)
+	{
+		m_queries.at(query) = GetNanoseconds(m_origin);
+	}
+
+	void CpuTimestampSource::Resolve(uint32_t firstQuery, uint32_t count, uint32_t slot)
+	{
+		if (size_t(firstQuery) + count > m_queries.size() || size_t(slot + 1) * m_queries.size() > m_slots.size())
+		{
+			throw std::logic_error("Timestamp resolve out of range");
+		}
+		std::copy(m_queries.begin() + firstQuery, m_queries.begin() + firstQuery + count,
+			m_slots.begin() + size_t(slot) * m_queries.size());
+	}
+
+	uint64_t CpuTimestampSource::GetFrequency() const
+	{
+		return std::nano::den;
+	}
+
+	void CpuTimestampSource::Read(uint32_t slot, uint32_t count, uint64_t* timestamps)
+	{
+		std::copy(m_slots.begin() + size_t(slot) * m_queries.size(),
+			m_slots.begin() + size_t(slot) * m_queries.size() + count, timestamps);
+	}
+
+	bool CpuTimestampSource::GetCalibration(uint64_t& timestamp, uint64_t& profilerTimestamp)
+	{
+		timestamp = GetNanoseconds(m_origin);
+		profilerTimestamp = Profiler::GetTimestamp();
+		return true;
+	}
+
+	GpuPassTimer::GpuPassTimer(uint32_t setCount, uint32_t maxPassesPerSet, uint32_t slotCount) :
+		m_setCount(setCount),
+		m_maxPassesPerSet(maxPassesPerSet),
+		m_sets(setCount),
+		m_slots(slotCount, false)
+	{
+		if (setCount == 0 || maxPassesPerSet == 0 || slotCount == 0)
+		{
+			throw std::logic_error("The GPU pass timer needs at least one set, pass and slot");
+		}
+	}
+
+	void GpuPassTimer::ResetSet(uint32_t set)
+	{
+		m_sets.at(set).clear();
+	}
+
+	uint32_t GpuPassTimer::AddPass(uint32_t set, const char* name)
+	{
+		std::vector<const char*>& passes = m_sets.at(set);
+		if (passes.size() == m_maxPassesPerSet)
+		{
+			return kInvalidIndex;
+		}
+		passes.push_back(name);
+		return GetSetFirstQuery(set) + static_cast<uint32_t>(passes.size() - 1) * 2;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The slots are used in order, so the next one is the oldest: if it is still
+	// in flight, all the others are as well
+	//
+	uint32_t GpuPassTimer::AcquireSlot()
+	{
+		if (m_slots[m_nextSlot])
+		{
+			return kInvalidIndex;
+		}
+		const uint32_t slot = m_nextSlot;
+		m_slots[slot] = true;
+		m_nextSlot = (m_nextSlot + 1) % GetSlotCount();
+		return slot;
+	}
+
+	void GpuPassTimer::Submit(uint32_t slot, uint32_t set, uint64_t fenceValue)
+	{
+		if (slot >= GetSlotCount() || !m_slots[slot])
+		{
+			throw std::logic_error("Submitting timestamps to a slot which was not acquired");
+		}
+		if (fenceValue <= m_lastFenceValue)
+		{
+			throw std::logic_error("GPU pass timer fence values must be increasing");
+		}
+		m_lastFenceValue = fenceValue;
+		m_submissions.push_back({ slot, fenceValue, m_sets.at(set) });
+	}
+
+	void GpuPassTimer::Collect(uint64_t completedFenceValue, TimestampSource& source)
+	{
+		// The source timestamps are mapped to the profiler timestamps through a single
+		// calibration, taken on the first submission collected
+		bool mapToProfiler = m_profilerTrack != kInvalidIndex && Profiler::IsEnabled();
+		bool calibrated = false;
+		uint64_t calibrationTimestamp = 0;
+		uint64_t calibrationProfilerTimestamp = 0;
+		double profilerTicksPerTick = 0.0;
+
+		const double millisecondsPerTick = 1000.0 / double(source.GetFrequency());
+		while (!m_submissions.empty() && m_submissions.front().fenceValue <= completedFenceValue)
+		{
+			const Submission& submission = m_submissions.front();
+			m_timestamps.resize(submission.passes.size() * 2);
+			if (!m_timestamps.empty())
+			{
+				source.Read(submission.slot, static_cast<uint32_t>(m_timestamps.size()), m_timestamps.data());
+			}
+
+			if (mapToProfiler && !calibrated)
+			{
+				const double profilerFrequency = Profiler::GetTimestampFrequency();
+				mapToProfiler = profilerFrequency > 0.0 &&
+					source.GetCalibration(calibrationTimestamp, calibrationProfilerTimestamp);
+				profilerTicksPerTick = profilerFrequency / double(source.GetFrequency());
+				calibrated = true;
+			}
+
+			m_lastSubmissionMilliseconds = 0.0;
+			for (size_t pass = 0; pass < submission.passes.size(); pass++)
+			{
+				const uint64_t begin = m_timestamps[pass * 2];
+				const uint64_t end = m_timestamps[pass * 2 + 1];
+				if (end < begin)
+				{
+					continue;
+				}
+
+				const double milliseconds = double(end - begin) * millisecondsPerTick;
+				PassTiming& timing = GetTiming(submission.passes[pass]);
+				timing.lastMilliseconds = milliseconds;
+				timing.averageMilliseconds = timing.sampleCount == 0 ? milliseconds :
+					timing.averageMilliseconds + (milliseconds - timing.averageMilliseconds) / kAverageLength;
+				timing.sampleCount++;
+				m_lastSubmissionMilliseconds += milliseconds;
+
+				if (mapToProfiler)
+				{
+					const auto toProfiler = [&](uint64_t timestamp)
+					{
+						return static_cast<uint64_t>(double(calibrationProfilerTimestamp) +
+							(double(timestamp) - double(calibrationTimestamp)) * profilerTicksPerTick);
+					};
+					Profiler::RecordOnTrack(m_profilerTrack, submission.passes[pass], toProfiler(begin), toProfiler(end));
+				}
+			}
+
+			m_slots[submission.slot] = false;
+			m_submissions.pop_front();
+		}
+	}
+
+	GpuPassTimer::PassTiming& GpuPassTimer::GetTiming(const char* name)
+	{
+		for (PassTiming& timing : m_timings)
+		{
+			if (timing.name == name || strcmp(timing.name, name) == 0)
+			{
+				return timing;
+			}
+		}
+		m_timings.push_back({ name });
+		return m_timings.back();
+	}
+}
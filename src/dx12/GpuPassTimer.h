@@ -0,0 +1,147 @@
+#ifndef GPU_PASS_TIMER_GUARD
+#define GPU_PASS_TIMER_GUARD
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Timestamps written by a queue, or by the CPU, and resolved into readback slots
+	class TimestampSource
+	{
+	public:
+		virtual ~TimestampSource() = default;
+
+		// Timestamps per second
+		virtual uint64_t GetFrequency() const = 0;
+
+		// Copy the count first timestamps resolved in a slot, whose submission has completed
+		virtual void Read(uint32_t slot, uint32_t count, uint64_t* timestamps) = 0;
+
+		// Timestamp of the source and timestamp of the profiler taken at the same moment.
+		// Returns false if the source cannot be related to the CPU clock
+		virtual bool GetCalibration(uint64_t& timestamp, uint64_t& profilerTimestamp) = 0;
+	};
+
+	// Source taking the timestamps on the CPU clock when they are written, so that the timer
+	// can be driven without any GPU
+	class CpuTimestampSource : public TimestampSource
+	{
+	public:
+		CpuTimestampSource(uint32_t queryCount, uint32_t slotCount);
+
+		// Take the timestamp of a query now
+		void WriteTimestamp(uint32_t query);
+		// Copy count timestamps, from the first query, to the beginning of a slot
+		void Resolve(uint32_t firstQuery, uint32_t count, uint32_t slot);
+
+		uint64_t GetFrequency() const override;
+		void Read(uint32_t slot, uint32_t count, uint64_t* timestamps) override;
+		bool GetCalibration(uint64_t& timestamp, uint64_t& profilerTimestamp) override;
+
+	private:
+		std::vector<uint64_t> m_queries;
+		std::vector<uint64_t> m_slots;
+		std::chrono::steady_clock::time_point m_origin = std::chrono::steady_clock::now();
+	};
+
+	// Times the passes of a queue with pairs of timestamp queries. The passes are grouped in
+	// sets recorded together, such as the command lists recorded once for a back buffer and
+	// replayed every frame: each set owns a fixed block of queries, its passes bracketed by
+	// consecutive begin and end queries. After each submission of a set, its queries are
+	// resolved into one of a ring of readback slots, which is read once the fence value
+	// signaled after the submission has completed. The CPU never waits for the GPU: when
+	// every slot is still in flight, the submission is not timed.
+	//
+	// The timer only manipulates query indices and fence values, the timestamps are read
+	// through a TimestampSource. It does not depend on any platform header.
+	class GpuPassTimer
+	{
+	public:
+		static constexpr uint32_t kInvalidIndex = ~0u;
+
+		struct PassTiming
+		{
+			const char* name;
+			double lastMilliseconds = 0.0;
+			// Exponential moving average over about kAverageLength submissions
+			double averageMilliseconds = 0.0;
+			uint64_t sampleCount = 0;
+		};
+		static constexpr uint32_t kAverageLength = 16;
+
+		GpuPassTimer(uint32_t setCount, uint32_t maxPassesPerSet, uint32_t slotCount);
+
+		GpuPassTimer(const GpuPassTimer&) = delete;
+		GpuPassTimer& operator = (const GpuPassTimer&) = delete;
+
+		// Size of the query heap and of a readback slot, in queries
+		inline uint32_t GetQueryCount() const { return m_setCount * m_maxPassesPerSet * 2; }
+		inline uint32_t GetSlotQueryCount() const { return m_maxPassesPerSet * 2; }
+		inline uint32_t GetSlotCount() const { return static_cast<uint32_t>(m_slots.size()); }
+
+		// Forget the passes of a set, before recording it again
+		void ResetSet(uint32_t set);
+
+		// Add a pass to a set. Returns its begin query, followed by its end query, or
+		// kInvalidIndex if the set is full, in which case the pass is not timed. The name must
+		// outlive the timer, such as a string literal
+		uint32_t AddPass(uint32_t set, const char* name);
+
+		// Queries of a set to resolve after its submission
+		inline uint32_t GetSetFirstQuery(uint32_t set) const { return set * m_maxPassesPerSet * 2; }
+		inline uint32_t GetSetQueryCount(uint32_t set) const { return static_cast<uint32_t>(m_sets.at(set).size()) * 2; }
+
+		// Slot to resolve the next submission into, or kInvalidIndex if all the slots are
+		// waiting for the GPU
+		uint32_t AcquireSlot();
+
+		// The queries of a set have been resolved into a slot acquired by AcquireSlot, and
+		// the fence value is signaled after the submission
+		void Submit(uint32_t slot, uint32_t set, uint64_t fenceValue);
+
+		// Read the timings of the submissions whose fence value has completed. When the
+		// profiler is enabled and a track is given, the passes are also recorded on the
+		// track, on the timeline of the CPU zones
+		void Collect(uint64_t completedFenceValue, TimestampSource& source);
+		inline void SetProfilerTrack(uint32_t track) { m_profilerTrack = track; }
+
+		// Timings of every pass name seen so far, in the order they were first collected
+		inline const std::vector<PassTiming>& GetPassTimings() const { return m_timings; }
+		// Sum of the last timings of the passes of a set, e.g. a frame
+		double GetLastSubmissionMilliseconds() const { return m_lastSubmissionMilliseconds; }
+
+	private:
+		struct Submission
+		{
+			uint32_t slot;
+			uint64_t fenceValue;
+			// Passes of the set when it was submitted, as it may be recorded again before
+			// the submission completes
+			std::vector<const char*> passes;
+		};
+
+		PassTiming& GetTiming(const char* name);
+
+		uint32_t m_setCount;
+		uint32_t m_maxPassesPerSet;
+		std::vector<std::vector<const char*>> m_sets;
+		// Whether each slot is waiting for its submission to complete
+		std::vector<bool> m_slots;
+		uint32_t m_nextSlot = 0;
+		std::deque<Submission> m_submissions;
+		uint64_t m_lastFenceValue = 0;
+
+		std::vector<PassTiming> m_timings;
+		double m_lastSubmissionMilliseconds = 0.0;
+		uint32_t m_profilerTrack = kInvalidIndex;
+		std::vector<uint64_t> m_timestamps;
+	};
+}
+
+#endif // !GPU_PASS_TIMER_GUARD
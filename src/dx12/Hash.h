@@ -0,0 +1,65 @@
+#ifndef HASH_GUARD
+#define HASH_GUARD
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace RaytracingImplementation
+{
+	// Fast non-cryptographic 64-bit hash of a block of memory, processing 8 bytes per step
+	// (MurmurHash64A). Used to key caches on the content of geometry, shaders or serialized
+	// descriptions. It does not depend on any platform header so it can be used by the device
+	// independent components.
+	inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0)
+	{
+		const uint64_t m = 0xc6a4a7935bd1e995ull;
+		const int r = 47;
+
+		uint64_t h = seed ^ (size * m);
+
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		const size_t blockCount = size / 8;
+		for (size_t i = 0; i < blockCount; i++)
+		{
+			uint64_t k;
+			memcpy(&k, bytes + i * 8, sizeof(k));
+
+			k *= m;
+			k ^= k >> r;
+			k *= m;
+
+			h ^= k;
+			h *= m;
+		}
+
+		const unsigned char* tail = bytes + blockCount * 8;
+		switch (size & 7)
+		{
+		case 7: h ^= uint64_t(tail[6]) << 48; // fall through
+		case 6: h ^= uint64_t(tail[5]) << 40; // fall through
+		case 5: h ^= uint64_t(tail[4]) << 32; // fall through
+		case 4: h ^= uint64_t(tail[3]) << 24; // fall through
+		case 3: h ^= uint64_t(tail[2]) << 16; // fall through
+		case 2: h ^= uint64_t(tail[1]) << 8; // fall through
+		case 1: h ^= uint64_t(tail[0]);
+			h *= m;
+		}
+
+		h ^= h >> r;
+		h *= m;
+		h ^= h >> r;
+
+		return h;
+	}
+
+	// Mix a value into an existing hash
+	inline uint64_t HashCombine(uint64_t hash, uint64_t value)
+	{
+		return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+	}
+}
+
+#endif // !HASH_GUARD
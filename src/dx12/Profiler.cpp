@@ -0,0 +1,257 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	std::atomic<bool> Profiler::s_enabled{ false };
+
+	namespace
+	{
+		struct Zone
+		{
+			const char* name;
+			uint64_t begin;
+			uint64_t end;
+		};
+
+		struct ThreadBuffer
+		{
+			uint32_t threadId;
+			// Guarded by the registry mutex
+			std::string name;
+			Zone zones[Profiler::kThreadCapacity];
+			// Number of zones ever recorded, only incremented by the owning thread once
+			// the zone has been written
+			std::atomic<uint64_t> count{ 0 };
+		};
+
+		// Buffers of all the threads which recorded a zone. They are kept when their thread
+		// exits, so that its zones are still exported
+		struct Registry
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+			// Reference points converting the timestamps to time
+			uint64_t baseTimestamp = 0;
+			std::chrono::steady_clock::time_point baseTime;
+			bool calibrated = false;
+		};
+
+		Registry& GetRegistry()
+		{
+			static Registry registry;
+			return registry;
+		}
+
+		// Must be called with the registry mutex held
+		ThreadBuffer& AddBuffer(Registry& registry)
+		{
+			registry.buffers.push_back(std::make_unique<ThreadBuffer>());
+			ThreadBuffer& buffer = *registry.buffers.back();
+			buffer.threadId = static_cast<uint32_t>(registry.buffers.size());
+			return buffer;
+		}
+
+		ThreadBuffer& GetThreadBuffer()
+		{
+			thread_local ThreadBuffer* buffer = nullptr;
+			if (!buffer)
+			{
+				Registry& registry = GetRegistry();
+				std::lock_guard<std::mutex> lock(registry.mutex);
+				buffer = &AddBuffer(registry);
+			}
+			return *buffer;
+		}
+
+		// Only the owning thread writes to its buffer. The count is published after
+		// the zone, so a reader never sees a zone before it has been written
+		void RecordZone(ThreadBuffer& buffer, const char* name, uint64_t begin, uint64_t end)
+		{
+			const uint64_t count = buffer.count.load(std::memory_order_relaxed);
+			Zone& zone = buffer.zones[count % Profiler::kThreadCapacity];
+			zone.name = name;
+			zone.begin = begin;
+			zone.end = end;
+			buffer.count.store(count + 1, std::memory_order_release);
+		}
+
+		// Must be called with the registry mutex held
+		void Calibrate(Registry& registry)
+		{
+			if (!registry.calibrated)
+			{
+				registry.baseTimestamp = Profiler::GetTimestamp();
+				registry.baseTime = std::chrono::steady_clock::now();
+				registry.calibrated = true;
+			}
+		}
+
+		void WriteEscaped(std::ofstream& file, const char* text)
+		{
+			for (; *text; text++)
+			{
+				const char c = *text;
+				if (c == '"' || c == '\\')
+				{
+					file << '\\' << c;
+				}
+				else if (static_cast<unsigned char>(c) < 0x20)
+				{
+					file << ' ';
+				}
+				else
+				{
+					file << c;
+				}
+			}
+		}
+	}
+
+	void Profiler::SetEnabled(bool enabled)
+	{
+		if (enabled)
+		{
+			Registry& registry = GetRegistry();
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			Calibrate(registry);
+		}
+		s_enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	void Profiler::Record(const char* name, uint64_t begin, uint64_t end)
+	{
+		RecordZone(GetThreadBuffer(), name, begin, end);
+	}
+
+	void Profiler::SetThreadName(const char* name)
+	{
+		ThreadBuffer& buffer = GetThreadBuffer();
+		std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+		buffer.name = name;
+	}
+
+	uint32_t Profiler::CreateTrack(const char* name)
+	{
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		ThreadBuffer& buffer = AddBuffer(registry);
+		buffer.name = name;
+		return static_cast<uint32_t>(registry.buffers.size() - 1);
+	}
+
+	void Profiler::RecordOnTrack(uint32_t track, const char* name, uint64_t begin, uint64_t end)
+	{
+		// The lock only protects the list of buffers, which may grow meanwhile
+		Registry& registry = GetRegistry();
+		ThreadBuffer* buffer;
+		{
+			std::lock_guard<std::mutex> lock(registry.mutex);
+			buffer = registry.buffers.at(track).get();
+		}
+		RecordZone(*buffer, name, begin, end);
+	}
+
+	double Profiler::GetTimestampFrequency()
+	{
+		Registry& registry = GetRegistry();
+		std::lock_guard<std::mutex> lock(registry.mutex);
+		if (!registry.calibrated)
+		{
+			return 0.0;
+		}
+		const uint64_t timestamp = GetTimestamp();
+		const double elapsedSeconds = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - registry.baseTime).count();
+		constexpr double kMinCalibrationSeconds = 0.01;
+		if (elapsedSeconds < kMinCalibrationSeconds)
+		{
+			return 0.0;
+		}
+		return double(timestamp - registry.baseTimestamp) / elapsedSeconds;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The TSC frequency is measured against the steady clock between the moment
+	// the profiler was first enabled and the export. The zones are written as
+	// complete events, in microseconds from the first enabling
+	//
+	bool Profiler::WriteChromeTrace(const std::filesystem::path& path)
+	{
+		Registry& registry = GetRegistry();
+		std::unique_lock<std::mutex> lock(registry.mutex);
+		Calibrate(registry);
+
+		// A short interval would give an imprecise frequency
+		constexpr std::chrono::milliseconds kMinCalibrationTime{ 10 };
+		const auto elapsedTime = std::chrono::steady_clock::now() - registry.baseTime;
+		if (elapsedTime < kMinCalibrationTime)
+		{
+			std::this_thread::sleep_for(kMinCalibrationTime - elapsedTime);
+		}
+		const uint64_t timestamp = GetTimestamp();
+		const double elapsedMicroseconds = std::chrono::duration<double, std::micro>(
+			std::chrono::steady_clock::now() - registry.baseTime).count();
+		const double ticksPerMicrosecond = double(timestamp - registry.baseTimestamp) / elapsedMicroseconds;
+		const auto toMicroseconds = [&](uint64_t ticks)
+		{
+			return (double(ticks) - double(registry.baseTimestamp)) / ticksPerMicrosecond;
+		};
+
+		std::ofstream file(path, std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		file.precision(3);
+		file << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+		bool first = true;
+		std::vector<Zone> zones;
+		for (const std::unique_ptr<ThreadBuffer>& buffer : registry.buffers)
+		{
+			if (!buffer->name.empty())
+			{
+				file << (first ? "" : ",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":"
+					<< buffer->threadId << ",\"args\":{\"name\":\"";
+				WriteEscaped(file, buffer->name.c_str());
+				file << "\"}}";
+				first = false;
+			}
+
+			// Copy the zones, then drop the ones the thread may have overwritten in the
+			// meantime, including the one it may be writing
+			const uint64_t end = buffer->count.load(std::memory_order_acquire);
+			const uint64_t begin = end > kThreadCapacity ? end - kThreadCapacity : 0;
+			zones.clear();
+			for (uint64_t i = begin; i < end; i++)
+			{
+				zones.push_back(buffer->zones[i % kThreadCapacity]);
+			}
+			const uint64_t last = buffer->count.load(std::memory_order_acquire) + 1;
+			const uint64_t valid = last > kThreadCapacity ? last - kThreadCapacity : 0;
+			const size_t skipped = static_cast<size_t>(std::min<uint64_t>(std::max<uint64_t>(valid, begin) - begin, zones.size()));
+
+			for (size_t i = skipped; i < zones.size(); i++)
+			{
+				const Zone& zone = zones[i];
+				file << (first ? "" : ",") << "\n{\"ph\":\"X\",\"name\":\"";
+				WriteEscaped(file, zone.name);
+				file << "\",\"pid\":1,\"tid\":" << buffer->threadId
+					<< ",\"ts\":" << toMicroseconds(zone.begin)
+					<< ",\"dur\":" << double(zone.end - zone.begin) / ticksPerMicrosecond << "}";
+				first = false;
+			}
+		}
+
+		file << "\n]}\n";
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,105 @@
+#ifndef PROFILER_GUARD
+#define PROFILER_GUARD
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace RaytracingImplementation
+{
+	// Scoped CPU profiler. Each thread records its zones in its own ring buffer, written
+	// without any lock or atomic read-modify-write: a zone costs two timestamp reads and
+	// three stores when the profiler is enabled, a single relaxed load when it is not. The
+	// timestamps are raw TSC values, converted to time only when the zones are exported.
+	// When a ring is full its oldest zones are overwritten.
+	//
+	// The zones are exported in the Chrome trace event format, to be opened in
+	// chrome://tracing or ui.perfetto.dev. The export can run while the other threads keep
+	// recording, the zones they overwrite meanwhile are skipped.
+	class Profiler
+	{
+	public:
+		// Zones kept per thread
+		static constexpr size_t kThreadCapacity = 16384;
+
+		static void SetEnabled(bool enabled);
+		static inline bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+		static inline uint64_t GetTimestamp()
+		{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+		}
+
+		// Record a zone of the calling thread. The name must outlive the profiler, such as a
+		// string literal
+		static void Record(const char* name, uint64_t begin, uint64_t end);
+
+		// Name of the calling thread in the trace
+		static void SetThreadName(const char* name);
+
+		// Timeline which is not a thread, such as a GPU queue, shown under its name in the
+		// trace. A track must only be recorded into by one thread at a time
+		static uint32_t CreateTrack(const char* name);
+		static void RecordOnTrack(uint32_t track, const char* name, uint64_t begin, uint64_t end);
+
+		// Timestamps per second, measured since the profiler was first enabled. Returns 0
+		// until enough time has passed for a precise measure
+		static double GetTimestampFrequency();
+
+		// Write the zones recorded so far as a Chrome trace. Returns false if the file
+		// cannot be written
+		static bool WriteChromeTrace(const std::filesystem::path& path);
+
+	private:
+		static std::atomic<bool> s_enabled;
+	};
+
+	// Zone covering the lifetime of the object
+	class ProfileZone
+	{
+	public:
+		explicit ProfileZone(const char* name) :
+			m_name(Profiler::IsEnabled() ? name : nullptr),
+			m_begin(m_name ? Profiler::GetTimestamp() : 0)
+		{
+		}
+
+		~ProfileZone()
+		{
+			if (m_name)
+			{
+				Profiler::Record(m_name, m_begin, Profiler::GetTimestamp());
+			}
+		}
+
+		ProfileZone(const ProfileZone&) = delete;
+		ProfileZone& operator = (const ProfileZone&) = delete;
+
+	private:
+		const char* m_name;
+		uint64_t m_begin;
+	};
+}
+
+#define PROFILE_ZONE_CONCAT_INNER(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_INNER(a, b)
+// Profile the rest of the enclosing scope
+#define PROFILE_ZONE(name) ::RaytracingImplementation::ProfileZone PROFILE_ZONE_CONCAT(profileZone, __LINE__)(name)
+
+#endif // !PROFILER_GUARD
@@ -0,0 +1,63 @@
+#include "QueueSyncTracker.h"
+#include <stdexcept>
+
+namespace RaytracingImplementation
+{
+
+	QueueSyncTracker::QueueSyncTracker(size_t queueCount) :
+		m_lastSignaled(queueCount, 0),
+		m_waited(queueCount * queueCount, 0)
+	{
+	}
+
+	void QueueSyncTracker::Signal(size_t queue, uint64_t value)
+	{
+		CheckQueue(queue);
+		if (value <= m_lastSignaled[queue])
+		{
+			throw std::logic_error("Queue fence values must be increasing");
+		}
+		m_lastSignaled[queue] = value;
+	}
+
+	bool QueueSyncTracker::NeedsWait(size_t consumer, size_t producer, uint64_t value) const
+	{
+		// Work on the same queue is executed in order
+		return consumer != producer && GetWaitedValue(consumer, producer) < value;
+	}
+
+	void QueueSyncTracker::Wait(size_t consumer, size_t producer, uint64_t value)
+	{
+		CheckQueue(consumer);
+		CheckQueue(producer);
+		if (consumer == producer)
+		{
+			throw std::logic_error("A queue cannot wait for itself");
+		}
+		if (value > m_lastSignaled[producer])
+		{
+			throw std::logic_error("Waiting for a fence value which was not signaled");
+		}
+
+		uint64_t& waited = m_waited[consumer * GetQueueCount() + producer];
+		if (value > waited)
+		{
+			waited = value;
+		}
+	}
+
+	uint64_t QueueSyncTracker::GetWaitedValue(size_t consumer, size_t producer) const
+	{
+		CheckQueue(consumer);
+		CheckQueue(producer);
+		return m_waited[consumer * GetQueueCount() + producer];
+	}
+
+	void QueueSyncTracker::CheckQueue(size_t queue) const
+	{
+		if (queue >= GetQueueCount())
+		{
+			throw std::logic_error("Invalid queue index");
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef QUEUE_SYNC_TRACKER_GUARD
+#define QUEUE_SYNC_TRACKER_GUARD
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Tracks the fence values signaled by a set of queues, and the values each queue has
+	// already waited for on the other ones. A consumer queue then only waits for a producer
+	// when the work it depends on is not already covered by a previous wait, and waits for
+	// values which were never signaled, which would hang the queue, are rejected.
+	//
+	// The tracker only manipulates queue indices and fence values, it does not depend on any
+	// platform header and can be driven by a simulated multi-queue timeline.
+	class QueueSyncTracker
+	{
+	public:
+		explicit QueueSyncTracker(size_t queueCount);
+
+		inline size_t GetQueueCount() const { return m_lastSignaled.size(); }
+
+		// Record that the queue signals its fence with the value after its last submission.
+		// Fence values of a queue must be increasing.
+		void Signal(size_t queue, uint64_t value);
+		inline uint64_t GetLastSignaled(size_t queue) const { return m_lastSignaled[queue]; }
+
+		// Whether work submitted to the consumer queue from now on requires a wait for the
+		// producer queue to reach the value
+		bool NeedsWait(size_t consumer, size_t producer, uint64_t value) const;
+
+		// Record that the consumer queue waits for the producer queue to reach the value
+		void Wait(size_t consumer, size_t producer, uint64_t value);
+
+		// Highest value of the producer the consumer has waited for
+		uint64_t GetWaitedValue(size_t consumer, size_t producer) const;
+
+	private:
+		void CheckQueue(size_t queue) const;
+
+		std::vector<uint64_t> m_lastSignaled;
+		// m_waited[consumer * queueCount + producer]
+		std::vector<uint64_t> m_waited;
+	};
+}
+
+#endif // !QUEUE_SYNC_TRACKER_GUARD
@@ -0,0 +1,259 @@
+#include "RootSignatureOptimizer.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		// Root descriptors are GPU virtual addresses
+		constexpr uint32_t kDescriptorSizeInDwords = 2;
+		constexpr uint32_t kTableSizeInDwords = 1;
+
+		// Most direct form allowed for a need
+		RootParameterKind GetDirectKind(const ShaderResourceNeed& need, const RootSignatureCostModel& model)
+		{
+			switch (need.type)
+			{
+			case ShaderResourceNeed::Type::Constants:
+				return need.count <= model.maxRootConstants ? RootParameterKind::Constants : RootParameterKind::Descriptor;
+			case ShaderResourceNeed::Type::Sampler:
+				return RootParameterKind::Table;
+			default:
+				return need.count == 1 && need.allowRootDescriptor ? RootParameterKind::Descriptor : RootParameterKind::Table;
+			}
+		}
+
+		// Next form of a need when demoted. Small constants go straight to a table, as a root
+		// descriptor would not be any smaller
+		RootParameterKind GetDemotedKind(const ShaderResourceNeed& need, RootParameterKind kind)
+		{
+			if (kind == RootParameterKind::Constants && need.count > kDescriptorSizeInDwords)
+			{
+				return RootParameterKind::Descriptor;
+			}
+			return RootParameterKind::Table;
+		}
+
+		uint32_t GetSizeInDwords(const ShaderResourceNeed& need, RootParameterKind kind)
+		{
+			switch (kind)
+			{
+			case RootParameterKind::Constants:
+				return need.count;
+			case RootParameterKind::Descriptor:
+				return kDescriptorSizeInDwords;
+			default:
+				return kTableSizeInDwords;
+			}
+		}
+
+		// The values of constants are written whenever they change, in the root signature or in
+		// a constant buffer, so that demoting them only adds the cost of the indirection
+		float GetCost(const RootParameterPlacement& parameter, const std::vector<ShaderResourceNeed>& needs,
+			const RootSignatureCostModel& model)
+		{
+			float cost = 0.0f;
+			for (uint32_t need : parameter.needs)
+			{
+				if (needs[need].type == ShaderResourceNeed::Type::Constants)
+				{
+					cost += needs[need].changeFrequency * model.constantChangeCost * needs[need].count;
+				}
+			}
+
+			switch (parameter.kind)
+			{
+			case RootParameterKind::Constants:
+				return cost;
+			case RootParameterKind::Descriptor:
+				return cost + parameter.changeFrequency * (model.descriptorChangeCost + model.descriptorAccessCost);
+			default:
+				return cost + parameter.changeFrequency * (model.tableChangeCost + model.tableAccessCost);
+			}
+		}
+
+		// Form of every need, and for the needs in tables, the table they share
+		struct Placement
+		{
+			std::vector<RootParameterKind> kinds;
+			std::vector<uint32_t> tables;
+		};
+
+		bool IsSampler(const ShaderResourceNeed& need)
+		{
+			return need.type == ShaderResourceNeed::Type::Sampler;
+		}
+
+		// Put a need in a table, shared with the needs of the same frequency and heap if any
+		void MoveToTable(const std::vector<ShaderResourceNeed>& needs, Placement& placement, uint32_t need)
+		{
+			placement.kinds[need] = RootParameterKind::Table;
+			placement.tables[need] = need;
+			for (uint32_t other = 0; other < needs.size(); other++)
+			{
+				if (other != need && placement.kinds[other] == RootParameterKind::Table &&
+					needs[other].changeFrequency == needs[need].changeFrequency &&
+					IsSampler(needs[other]) == IsSampler(needs[need]))
+				{
+					placement.tables[need] = placement.tables[other];
+					break;
+				}
+			}
+		}
+
+		// Layout of the needs in declaration order. A table changes as often as its most
+		// frequently changed need. The declared layout gives every need its own parameter
+		RootSignatureLayout BuildLayout(const std::vector<ShaderResourceNeed>& needs, const Placement& placement,
+			const RootSignatureCostModel& model, bool shareTables)
+		{
+			RootSignatureLayout layout;
+			layout.parameterOfNeed.resize(needs.size());
+			std::vector<uint32_t> tableOfParameter;
+			for (uint32_t i = 0; i < needs.size(); i++)
+			{
+				const ShaderResourceNeed& need = needs[i];
+				const RootParameterKind kind = placement.kinds[i];
+
+				auto table = tableOfParameter.end();
+				if (shareTables && kind == RootParameterKind::Table)
+				{
+					table = std::find(tableOfParameter.begin(), tableOfParameter.end(), placement.tables[i]);
+				}
+
+				if (table != tableOfParameter.end())
+				{
+					RootParameterPlacement& parameter = layout.parameters[table - tableOfParameter.begin()];
+					parameter.needs.push_back(i);
+					parameter.changeFrequency = std::max<float>(parameter.changeFrequency, need.changeFrequency);
+					layout.parameterOfNeed[i] = static_cast<uint32_t>(table - tableOfParameter.begin());
+				}
+				else
+				{
+					layout.parameterOfNeed[i] = static_cast<uint32_t>(layout.parameters.size());
+					layout.parameters.push_back({ kind, { i }, GetSizeInDwords(need, kind), need.changeFrequency });
+					tableOfParameter.push_back(kind == RootParameterKind::Table ? placement.tables[i] : ~0u);
+				}
+			}
+
+			for (const RootParameterPlacement& parameter : layout.parameters)
+			{
+				layout.sizeInDwords += parameter.sizeInDwords;
+				layout.cost += GetCost(parameter, needs, model);
+			}
+			return layout;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The layouts are small, so every candidate is evaluated by building the
+	// whole layout again
+	//
+	RootSignatureLayout OptimizeRootSignatureLayout(const std::vector<ShaderResourceNeed>& needs,
+		const RootSignatureCostModel& model)
+	{
+		Placement placement;
+		placement.kinds.resize(needs.size());
+		placement.tables.resize(needs.size(), ~0u);
+		for (uint32_t i = 0; i < needs.size(); i++)
+		{
+			placement.kinds[i] = GetDirectKind(needs[i], model);
+			if (placement.kinds[i] == RootParameterKind::Table)
+			{
+				MoveToTable(needs, placement, i);
+			}
+		}
+
+		const RootSignatureLayout declared = BuildLayout(needs, placement, model, false);
+		RootSignatureLayout layout = BuildLayout(needs, placement, model, true);
+		while (layout.sizeInDwords > model.budgetInDwords)
+		{
+			// Candidates are the demotion of a need to a more indirect form, and the merge of
+			// two tables of the same heap
+			std::vector<Placement> candidates;
+			for (uint32_t i = 0; i < needs.size(); i++)
+			{
+				if (placement.kinds[i] == RootParameterKind::Table)
+				{
+					continue;
+				}
+				Placement candidate = placement;
+				const RootParameterKind demoted = GetDemotedKind(needs[i], placement.kinds[i]);
+				if (demoted == RootParameterKind::Table)
+				{
+					MoveToTable(needs, candidate, i);
+				}
+				else
+				{
+					candidate.kinds[i] = demoted;
+				}
+				candidates.push_back(std::move(candidate));
+			}
+			for (uint32_t a = 0; a < needs.size(); a++)
+			{
+				for (uint32_t b = 0; b < needs.size(); b++)
+				{
+					// Each pair of tables is considered once, through the first need of each
+					if (placement.kinds[a] != RootParameterKind::Table || placement.kinds[b] != RootParameterKind::Table ||
+						placement.tables[a] != a || placement.tables[b] != b || a >= b ||
+						IsSampler(needs[a]) != IsSampler(needs[b]))
+					{
+						continue;
+					}
+					Placement candidate = placement;
+					std::replace(candidate.tables.begin(), candidate.tables.end(), b, a);
+					candidates.push_back(std::move(candidate));
+				}
+			}
+
+			// Pick the candidate adding the least cost per 32-bit value saved, which is
+			// negative when a need joins an existing table
+			const Placement* best = nullptr;
+			float bestScore = std::numeric_limits<float>::max();
+			RootSignatureLayout bestLayout;
+			for (const Placement& candidate : candidates)
+			{
+				RootSignatureLayout candidateLayout = BuildLayout(needs, candidate, model, true);
+				if (candidateLayout.sizeInDwords >= layout.sizeInDwords)
+				{
+					continue;
+				}
+				const float score = (candidateLayout.cost - layout.cost) /
+					(layout.sizeInDwords - candidateLayout.sizeInDwords);
+				if (score < bestScore)
+				{
+					best = &candidate;
+					bestScore = score;
+					bestLayout = std::move(candidateLayout);
+				}
+			}
+
+			if (!best)
+			{
+				throw std::length_error("Root signature exceeds the budget");
+			}
+			placement = *best;
+			layout = std::move(bestLayout);
+		}
+
+		// The most frequently changed parameters come first, the others keep their declaration order
+		std::stable_sort(layout.parameters.begin(), layout.parameters.end(),
+			[](const RootParameterPlacement& a, const RootParameterPlacement& b)
+			{
+				return a.changeFrequency > b.changeFrequency;
+			});
+		for (uint32_t p = 0; p < layout.parameters.size(); p++)
+		{
+			for (uint32_t need : layout.parameters[p].needs)
+			{
+				layout.parameterOfNeed[need] = p;
+			}
+		}
+
+		layout.declaredSizeInDwords = declared.sizeInDwords;
+		layout.declaredCost = declared.cost;
+		return layout;
+	}
+}
@@ -0,0 +1,99 @@
+#ifndef ROOT_SIGNATURE_OPTIMIZER_GUARD
+#define ROOT_SIGNATURE_OPTIMIZER_GUARD
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Resource a shader needs, as declared by the caller of the optimizer
+	struct ShaderResourceNeed
+	{
+		enum class Type : uint8_t
+		{
+			Constants,
+			ConstantBuffer,
+			ShaderResource,
+			UnorderedAccess,
+			Sampler
+		};
+
+		Type type;
+		uint32_t shaderRegister;
+		uint32_t registerSpace = 0;
+		// Number of 32-bit values for constants, number of descriptors otherwise
+		uint32_t count = 1;
+		// How often the binding changes, on any scale, e.g. 1 per frame and 1000 per draw
+		float changeFrequency = 1.0f;
+		// Whether the resource can be bound as a root descriptor, which requires a single buffer
+		// accessed without a typed view
+		bool allowRootDescriptor = true;
+	};
+
+	// Form of a root parameter, from the most direct to the most indirect
+	enum class RootParameterKind : uint8_t
+	{
+		Constants,
+		Descriptor,
+		Table
+	};
+
+	// Relative costs guiding the optimizer. The cost of a layout is the sum, over its parameters,
+	// of their change frequency times the cost of changing and accessing them
+	struct RootSignatureCostModel
+	{
+		// Writing constants, per 32-bit value, whether into the root signature or into the
+		// constant buffer of a demoted need
+		float constantChangeCost = 1.0f;
+		// Setting a root descriptor
+		float descriptorChangeCost = 1.0f;
+		// Writing the descriptors of a table into the heap and setting the table
+		float tableChangeCost = 4.0f;
+		// Extra indirections paid by the shaders, through a root descriptor or a table
+		float descriptorAccessCost = 0.5f;
+		float tableAccessCost = 1.0f;
+		// Root signature size limit, in 32-bit values
+		uint32_t budgetInDwords = 64;
+		// Larger constants are placed in a constant buffer
+		uint32_t maxRootConstants = 16;
+	};
+
+	// Root parameter chosen by the optimizer
+	struct RootParameterPlacement
+	{
+		RootParameterKind kind;
+		// Needs served by the parameter, as indices in the declaration. Only tables gather several
+		std::vector<uint32_t> needs;
+		uint32_t sizeInDwords;
+		float changeFrequency;
+	};
+
+	// Parameters chosen by the optimizer, the most frequently changed first
+	struct RootSignatureLayout
+	{
+		std::vector<RootParameterPlacement> parameters;
+		// Index of the parameter serving each need
+		std::vector<uint32_t> parameterOfNeed;
+		// Footprint and cost of the optimized layout, and of the layout binding every need in its
+		// own parameter, in declaration order and in the most direct form allowed
+		uint32_t sizeInDwords = 0;
+		uint32_t declaredSizeInDwords = 0;
+		float cost = 0.0f;
+		float declaredCost = 0.0f;
+	};
+
+	// Choose the form and the order of the root parameters serving a set of needs. Every need
+	// starts in its most direct form: root constants, then root descriptors for single buffers,
+	// then tables. Needs placed in tables are grouped by change frequency, samplers apart as they
+	// live in their own heap. While the layout exceeds the budget, the change adding the least
+	// cost per 32-bit value saved is applied: demoting a need to a more indirect form, or merging
+	// two tables, the merged table changing as often as its most frequently changed need.
+	// Throws std::length_error if the needs cannot fit in the budget even in a single table.
+	// The optimizer is pure CPU code, and does not depend on any D3D12 header.
+	RootSignatureLayout OptimizeRootSignatureLayout(const std::vector<ShaderResourceNeed>& needs,
+		const RootSignatureCostModel& model = {});
+}
+
+#endif // !ROOT_SIGNATURE_OPTIMIZER_GUARD
@@ -0,0 +1,48 @@
+#include "ScratchBatchPlanner.h"
+#include <algorithm>
+#include <numeric>
+
+namespace RaytracingImplementation
+{
+	//-----------------------------------------------------------------------------
+	//
+	// First-fit decreasing packing: the largest requests are placed first, each one
+	// in the first batch which still has enough room for it. The regions are
+	// aligned so that each build gets a valid scratch address.
+	//
+	std::vector<ScratchBatch> PlanScratchBatches(const std::vector<uint64_t>& scratchSizes, uint64_t budget,
+		uint64_t alignment)
+	{
+		std::vector<size_t> order(scratchSizes.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(),
+			[&scratchSizes](size_t a, size_t b) { return scratchSizes[a] > scratchSizes[b]; });
+
+		std::vector<ScratchBatch> batches;
+		for (size_t index : order)
+		{
+			const uint64_t size = (scratchSizes[index] + alignment - 1) & ~(alignment - 1);
+
+			ScratchBatch* target = nullptr;
+			for (ScratchBatch& batch : batches)
+			{
+				if (batch.scratchSizeInBytes + size <= budget)
+				{
+					target = &batch;
+					break;
+				}
+			}
+			// Requests larger than the budget end up alone in their batch
+			if (!target)
+			{
+				batches.emplace_back();
+				target = &batches.back();
+			}
+
+			target->requests.push_back(index);
+			target->scratchOffsets.push_back(target->scratchSizeInBytes);
+			target->scratchSizeInBytes += size;
+		}
+		return batches;
+	}
+}
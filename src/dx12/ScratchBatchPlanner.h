@@ -0,0 +1,30 @@
+#ifndef SCRATCH_BATCH_PLANNER_GUARD
+#define SCRATCH_BATCH_PLANNER_GUARD
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Builds sharing a scratch buffer: the requests they come from, in build order, and the
+	// offset of each request in the scratch buffer
+	struct ScratchBatch
+	{
+		std::vector<size_t> requests;
+		std::vector<uint64_t> scratchOffsets;
+		uint64_t scratchSizeInBytes = 0;
+	};
+
+	// Sort the requests by decreasing scratch size and pack them into batches of at most budget
+	// bytes of scratch memory, each region being aligned on alignment, a power of two. Requests
+	// of the same size keep their order, so that the plan only depends on the sizes. A request
+	// larger than the budget gets a batch of its own.
+	// Does not depend on any D3D12 header, so that it can be tested without a device.
+	std::vector<ScratchBatch> PlanScratchBatches(const std::vector<uint64_t>& scratchSizes, uint64_t budget,
+		uint64_t alignment);
+}
+
+#endif // !SCRATCH_BATCH_PLANNER_GUARD
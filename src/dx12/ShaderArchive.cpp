@@ -0,0 +1,292 @@
+#include "ShaderArchive.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		// Shader names are HLSL identifiers, so they are stored as 8-bit characters
+		std::string ToNarrow(const std::wstring& text)
+		{
+			std::string result(text.size(), '\0');
+			std::transform(text.begin(), text.end(), result.begin(),
+				[](wchar_t c) { return static_cast<char>(c); });
+			return result;
+		}
+
+		// Path of an asset from the resources directory, or the path itself if it is not under
+		// such a directory
+		std::string GetAssetName(const std::wstring& fileName)
+		{
+			const std::filesystem::path path = std::filesystem::path(fileName).lexically_normal();
+			std::filesystem::path assetName;
+			for (const std::filesystem::path& component : path)
+			{
+				if (component == "resources")
+				{
+					assetName.clear();
+				}
+				assetName /= component;
+			}
+			return ToNarrow(assetName.generic_wstring());
+		}
+
+		template <class T>
+		void Append(std::vector<uint8_t>& buffer, const T& value)
+		{
+			const size_t offset = buffer.size();
+			buffer.resize(offset + sizeof(T));
+			memcpy(buffer.data() + offset, &value, sizeof(T));
+		}
+
+		void AppendBytes(std::vector<uint8_t>& buffer, const void* data, size_t size)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			buffer.insert(buffer.end(), bytes, bytes + size);
+		}
+
+		// Pad the buffer to a power of two alignment
+		void Align(std::vector<uint8_t>& buffer, size_t alignment)
+		{
+			buffer.resize((buffer.size() + alignment - 1) & ~(alignment - 1));
+		}
+	}
+
+	std::string ShaderArchive::GetKey(const ShaderRequest& request)
+	{
+		char flags[16];
+		snprintf(flags, sizeof(flags), "%08x", request.flags);
+
+		std::string key = GetAssetName(request.fileName);
+		key += '|';
+		key += request.entryPoint;
+		key += '|';
+		key += request.target;
+		key += '|';
+		key += flags;
+		for (const auto& define : request.defines)
+		{
+			key += '|';
+			key += define.first;
+			key += '=';
+			key += define.second;
+		}
+		return key;
+	}
+
+	bool ShaderArchive::Open(const std::filesystem::path& path)
+	{
+		m_entryCount = 0;
+		m_compilerVersion = 0;
+		if (!m_file.Open(path) || m_file.GetSize() < sizeof(Header))
+		{
+			m_file.Close();
+			return false;
+		}
+
+		Header header;
+		memcpy(&header, m_file.GetData(), sizeof(Header));
+		if (header.magic != kMagic || header.version != kVersion ||
+			!IsInRange(sizeof(Header), uint64_t(header.entryCount) * sizeof(Entry)))
+		{
+			m_file.Close();
+			return false;
+		}
+		m_entryCount = header.entryCount;
+		m_compilerVersion = header.compilerVersion;
+
+		// Check all the ranges once, so that lookups can trust them
+		const Entry* entries = GetEntries();
+		for (uint32_t i = 0; i < m_entryCount; i++)
+		{
+			const Entry& entry = entries[i];
+			bool valid = IsInRange(entry.keyOffset, entry.keyLength) &&
+				IsInRange(entry.dataOffset, entry.dataSize) &&
+				IsInRange(entry.exportsOffset, uint64_t(entry.exportCount) * sizeof(StringRef)) &&
+				IsInRange(entry.bindingsOffset, uint64_t(entry.bindingCount) * sizeof(ShaderBinding));
+			for (uint32_t e = 0; valid && e < entry.exportCount; e++)
+			{
+				StringRef name;
+				memcpy(&name, m_file.GetData() + entry.exportsOffset + e * sizeof(StringRef), sizeof(StringRef));
+				valid = IsInRange(name.offset, name.length);
+			}
+			if (!valid)
+			{
+				m_file.Close();
+				m_entryCount = 0;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool ShaderArchive::Find(const ShaderRequest& request, Shader& shader) const
+	{
+		if (!IsOpen())
+		{
+			return false;
+		}
+
+		const std::string key = GetKey(request);
+		const uint64_t keyHash = HashBytes(key.data(), key.size());
+
+		const Entry* entries = GetEntries();
+		const Entry* it = std::lower_bound(entries, entries + m_entryCount, keyHash,
+			[](const Entry& entry, uint64_t hash) { return entry.keyHash < hash; });
+		for (; it != entries + m_entryCount && it->keyHash == keyHash; ++it)
+		{
+			const uint8_t* base = m_file.GetData();
+			if (it->keyLength != key.size() || memcmp(base + it->keyOffset, key.data(), key.size()) != 0)
+			{
+				continue;
+			}
+
+			shader.data = base + it->dataOffset;
+			shader.size = it->dataSize;
+			shader.sourceHash = it->sourceHash;
+
+			shader.exports.clear();
+			for (uint32_t e = 0; e < it->exportCount; e++)
+			{
+				StringRef name;
+				memcpy(&name, base + it->exportsOffset + e * sizeof(StringRef), sizeof(StringRef));
+				const char* text = reinterpret_cast<const char*>(base + name.offset);
+				shader.exports.emplace_back(text, text + name.length);
+			}
+
+			shader.bindings.resize(it->bindingCount);
+			if (it->bindingCount > 0)
+			{
+				memcpy(shader.bindings.data(), base + it->bindingsOffset, it->bindingCount * sizeof(ShaderBinding));
+			}
+			return true;
+		}
+		return false;
+	}
+
+	const ShaderArchive::Entry* ShaderArchive::GetEntries() const
+	{
+		return reinterpret_cast<const Entry*>(m_file.GetData() + sizeof(Header));
+	}
+
+	bool ShaderArchive::IsInRange(uint64_t offset, uint64_t size) const
+	{
+		return offset <= m_file.GetSize() && size <= m_file.GetSize() - offset;
+	}
+
+	void ShaderArchiveWriter::Add(const ShaderRequest& request, const void* data, size_t size, uint64_t sourceHash,
+		const std::vector<std::wstring>& exports, const std::vector<ShaderBinding>& bindings)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		m_shaders.push_back({ ShaderArchive::GetKey(request), std::vector<uint8_t>(bytes, bytes + size),
+			sourceHash, exports, bindings });
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The archive starts with the header and the entries, followed by the keys,
+	// export names and bindings, and finally the shader code, each shader being
+	// aligned so that it can be used in place
+	//
+	bool ShaderArchiveWriter::Write(const std::filesystem::path& path, uint64_t compilerVersion) const
+	{
+		using Entry = ShaderArchive::Entry;
+		using StringRef = ShaderArchive::StringRef;
+
+		std::vector<size_t> order(m_shaders.size());
+		std::vector<uint64_t> keyHashes(m_shaders.size());
+		for (size_t i = 0; i < m_shaders.size(); i++)
+		{
+			order[i] = i;
+			keyHashes[i] = HashBytes(m_shaders[i].key.data(), m_shaders[i].key.size());
+		}
+		std::sort(order.begin(), order.end(),
+			[&keyHashes](size_t a, size_t b) { return keyHashes[a] < keyHashes[b]; });
+
+		std::vector<uint8_t> buffer;
+		const ShaderArchive::Header header = { ShaderArchive::kMagic, ShaderArchive::kVersion,
+			static_cast<uint32_t>(m_shaders.size()), 0, compilerVersion };
+		Append(buffer, header);
+		buffer.resize(buffer.size() + m_shaders.size() * sizeof(Entry));
+
+		std::vector<Entry> entries(m_shaders.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const PendingShader& shader = m_shaders[order[i]];
+			Entry& entry = entries[i];
+			entry.keyHash = keyHashes[order[i]];
+			entry.sourceHash = shader.sourceHash;
+
+			entry.keyOffset = static_cast<uint32_t>(buffer.size());
+			entry.keyLength = static_cast<uint32_t>(shader.key.size());
+			AppendBytes(buffer, shader.key.data(), shader.key.size());
+
+			std::vector<std::string> names;
+			for (const std::wstring& name : shader.exports)
+			{
+				names.push_back(ToNarrow(name));
+			}
+			std::vector<StringRef> nameRefs;
+			for (const std::string& name : names)
+			{
+				nameRefs.push_back({ static_cast<uint32_t>(buffer.size()), static_cast<uint32_t>(name.size()) });
+				AppendBytes(buffer, name.data(), name.size());
+			}
+
+			Align(buffer, alignof(Entry));
+			entry.exportsOffset = static_cast<uint32_t>(buffer.size());
+			entry.exportCount = static_cast<uint32_t>(nameRefs.size());
+			for (const StringRef& nameRef : nameRefs)
+			{
+				Append(buffer, nameRef);
+			}
+
+			entry.bindingsOffset = static_cast<uint32_t>(buffer.size());
+			entry.bindingCount = static_cast<uint32_t>(shader.bindings.size());
+			for (const ShaderBinding& binding : shader.bindings)
+			{
+				Append(buffer, binding);
+			}
+		}
+
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			const PendingShader& shader = m_shaders[order[i]];
+			Align(buffer, ShaderArchive::kDataAlignment);
+			entries[i].dataOffset = static_cast<uint32_t>(buffer.size());
+			entries[i].dataSize = static_cast<uint32_t>(shader.data.size());
+			AppendBytes(buffer, shader.data.data(), shader.data.size());
+		}
+		if (!entries.empty())
+		{
+			memcpy(buffer.data() + sizeof(header), entries.data(), entries.size() * sizeof(Entry));
+		}
+
+		std::error_code error;
+		std::filesystem::path temporaryPath = path;
+		temporaryPath += ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+			if (!file.good())
+			{
+				file.close();
+				std::filesystem::remove(temporaryPath, error);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temporaryPath, path, error);
+		if (error)
+		{
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+		return true;
+	}
+}
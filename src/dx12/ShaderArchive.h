@@ -0,0 +1,148 @@
+#ifndef SHADER_ARCHIVE_GUARD
+#define SHADER_ARCHIVE_GUARD
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ShaderCache.h"
+
+namespace RaytracingImplementation
+{
+	// Shader compilation, as requested by the renderer and recorded in the archive. A DXIL library
+	// has no entry point
+	struct ShaderRequest
+	{
+		std::wstring fileName;
+		std::string entryPoint;
+		std::string target;
+		std::vector<std::pair<std::string, std::string>> defines;
+		uint32_t flags = 0;
+	};
+
+	// Resource a shader expects to be bound, as reported by the reflection of the compiled code
+	struct ShaderBinding
+	{
+		// D3D_SHADER_INPUT_TYPE
+		uint32_t type;
+		uint32_t bindPoint;
+		uint32_t space;
+		uint32_t count;
+	};
+
+	// Packed archive of compiled shaders, produced by the build and loaded instead of compiling the
+	// shaders at runtime. The archive is memory-mapped, and the code of each shader is used in place.
+	// Each shader comes with the names it exports and the resources it expects, and with a hash of
+	// the sources it was compiled from, so that a stale entry can be detected while the sources are
+	// around.
+	// Shaders are identified by their path from the resources directory, so that a shader is found
+	// whether it is referred to relative to the working directory or to the executable.
+	// The archive does not depend on the compiler or on any D3D12 header.
+	class ShaderArchive
+	{
+	public:
+		// View of a shader of the archive, valid as long as the archive is open
+		struct Shader
+		{
+			const void* data;
+			size_t size;
+			uint64_t sourceHash;
+			std::vector<std::wstring> exports;
+			std::vector<ShaderBinding> bindings;
+		};
+
+		ShaderArchive() = default;
+		ShaderArchive(const ShaderArchive&) = delete;
+		ShaderArchive& operator = (const ShaderArchive&) = delete;
+
+		// Map an archive, returning false if it cannot be opened or is not valid
+		bool Open(const std::filesystem::path& path);
+		inline bool IsOpen() const { return m_file.GetData() != nullptr; }
+
+		// Find the shader compiled for a request, returning false if the archive has none
+		bool Find(const ShaderRequest& request, Shader& shader) const;
+
+		inline uint32_t GetShaderCount() const { return m_entryCount; }
+		// Version of the compiler which produced the archive
+		inline uint64_t GetCompilerVersion() const { return m_compilerVersion; }
+
+		// Name identifying a request in the archive
+		static std::string GetKey(const ShaderRequest& request);
+
+	private:
+		friend class ShaderArchiveWriter;
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t reserved;
+			uint64_t compilerVersion;
+		};
+
+		// Entries are sorted by key hash. All the offsets are from the start of the archive,
+		// and the strings are stored as offset and length pairs
+		struct Entry
+		{
+			uint64_t keyHash;
+			uint64_t sourceHash;
+			uint32_t keyOffset;
+			uint32_t keyLength;
+			uint32_t dataOffset;
+			uint32_t dataSize;
+			uint32_t exportsOffset;
+			uint32_t exportCount;
+			uint32_t bindingsOffset;
+			uint32_t bindingCount;
+		};
+
+		struct StringRef
+		{
+			uint32_t offset;
+			uint32_t length;
+		};
+
+		static constexpr uint32_t kMagic = 0x52414853; // "SHAR"
+		static constexpr uint32_t kVersion = 1;
+		// Alignment of the shader code within the archive
+		static constexpr uint32_t kDataAlignment = 16;
+
+		const Entry* GetEntries() const;
+		bool IsInRange(uint64_t offset, uint64_t size) const;
+
+		MappedFile m_file;
+		uint32_t m_entryCount = 0;
+		uint64_t m_compilerVersion = 0;
+	};
+
+	// Collects compiled shaders and writes them into an archive
+	class ShaderArchiveWriter
+	{
+	public:
+		void Add(const ShaderRequest& request, const void* data, size_t size, uint64_t sourceHash,
+			const std::vector<std::wstring>& exports, const std::vector<ShaderBinding>& bindings);
+
+		// Write the archive, returning false if the file cannot be written. The archive is written
+		// to a temporary file first and then renamed, so that a failed build never leaves a
+		// partial archive
+		bool Write(const std::filesystem::path& path, uint64_t compilerVersion) const;
+
+	private:
+		struct PendingShader
+		{
+			std::string key;
+			std::vector<uint8_t> data;
+			uint64_t sourceHash;
+			std::vector<std::wstring> exports;
+			std::vector<ShaderBinding> bindings;
+		};
+		std::vector<PendingShader> m_shaders;
+	};
+}
+
+#endif // !SHADER_ARCHIVE_GUARD
@@ -0,0 +1,177 @@
+#include "stdafx.h"
+#include <d3d12shader.h>
+#include <algorithm>
+#include <exception>
+#include "ShaderArchiveBuilder.h"
+#include "ShaderCache.h"
+#include "ShaderCompileService.h"
+#include "dx12/dxr/DXRHelper.h"
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		// The reflection reports the mangled names of the library functions, such as
+		// "\x1?RayGen@@YAXXZ", while the state objects refer to them by their HLSL name
+		std::wstring DemangleExportName(const char* name)
+		{
+			std::string demangled(name);
+			const size_t begin = demangled.find('?');
+			if (begin != std::string::npos)
+			{
+				const size_t end = demangled.find("@@", begin);
+				demangled = demangled.substr(begin + 1, end == std::string::npos ? std::string::npos : end - begin - 1);
+			}
+			return std::wstring(demangled.begin(), demangled.end());
+		}
+
+		// Add a binding, unless a shader of the same library already expects it
+		void AddBinding(std::vector<ShaderBinding>& bindings, const D3D12_SHADER_INPUT_BIND_DESC& desc)
+		{
+			const ShaderBinding binding = { static_cast<uint32_t>(desc.Type), desc.BindPoint, desc.Space, desc.BindCount };
+			const bool known = std::any_of(bindings.begin(), bindings.end(),
+				[&binding](const ShaderBinding& other)
+				{
+					return other.type == binding.type && other.bindPoint == binding.bindPoint && other.space == binding.space;
+				});
+			if (!known)
+			{
+				bindings.push_back(binding);
+			}
+		}
+
+		void ReflectLibrary(IDxcBlob* library, std::vector<std::wstring>& exports, std::vector<ShaderBinding>& bindings)
+		{
+			Microsoft::WRL::ComPtr<IDxcContainerReflection> container;
+			ThrowIfFailed(DxcCreateInstance(CLSID_DxcContainerReflection, IID_PPV_ARGS(&container)));
+			ThrowIfFailed(container->Load(library));
+
+			UINT32 partIndex;
+			ThrowIfFailed(container->FindFirstPartKind(DXC_PART_DXIL, &partIndex));
+			Microsoft::WRL::ComPtr<ID3D12LibraryReflection> reflection;
+			ThrowIfFailed(container->GetPartReflection(partIndex, IID_PPV_ARGS(&reflection)));
+
+			D3D12_LIBRARY_DESC libraryDesc;
+			ThrowIfFailed(reflection->GetDesc(&libraryDesc));
+			for (UINT i = 0; i < libraryDesc.FunctionCount; i++)
+			{
+				// The function reflections are owned by the library reflection
+				ID3D12FunctionReflection* function = reflection->GetFunctionByIndex(i);
+				D3D12_FUNCTION_DESC functionDesc;
+				ThrowIfFailed(function->GetDesc(&functionDesc));
+
+				// Only the shaders can be exported to a state object, not the helper functions
+				const UINT type = D3D12_SHVER_GET_TYPE(functionDesc.Version);
+				if (type < D3D12_SHVER_RAY_GENERATION_SHADER || type > D3D12_SHVER_CALLABLE_SHADER)
+				{
+					continue;
+				}
+
+				exports.push_back(DemangleExportName(functionDesc.Name));
+				for (UINT r = 0; r < functionDesc.BoundResources; r++)
+				{
+					D3D12_SHADER_INPUT_BIND_DESC bindDesc;
+					ThrowIfFailed(function->GetResourceBindingDesc(r, &bindDesc));
+					AddBinding(bindings, bindDesc);
+				}
+			}
+		}
+
+		void ReflectShader(ID3DBlob* shader, std::vector<ShaderBinding>& bindings)
+		{
+			Microsoft::WRL::ComPtr<ID3D12ShaderReflection> reflection;
+			ThrowIfFailed(D3DReflect(shader->GetBufferPointer(), shader->GetBufferSize(), IID_PPV_ARGS(&reflection)));
+
+			D3D12_SHADER_DESC shaderDesc;
+			ThrowIfFailed(reflection->GetDesc(&shaderDesc));
+			for (UINT r = 0; r < shaderDesc.BoundResources; r++)
+			{
+				D3D12_SHADER_INPUT_BIND_DESC bindDesc;
+				ThrowIfFailed(reflection->GetResourceBindingDesc(r, &bindDesc));
+				AddBinding(bindings, bindDesc);
+			}
+		}
+
+		Microsoft::WRL::ComPtr<ID3DBlob> CompileShader(const ShaderRequest& request, std::string& messages)
+		{
+			std::vector<D3D_SHADER_MACRO> macros;
+			macros.reserve(request.defines.size() + 1);
+			for (const auto& define : request.defines)
+			{
+				macros.push_back({ define.first.c_str(), define.second.c_str() });
+			}
+			macros.push_back({ nullptr, nullptr });
+
+			Microsoft::WRL::ComPtr<ID3DBlob> shader;
+			Microsoft::WRL::ComPtr<ID3DBlob> error;
+			const HRESULT hr = D3DCompileFromFile(request.fileName.c_str(), macros.data(), nullptr,
+				request.entryPoint.c_str(), request.target.c_str(), request.flags, 0, &shader, &error);
+			if (error)
+			{
+				messages.assign(static_cast<const char*>(error->GetBufferPointer()), error->GetBufferSize());
+			}
+			ThrowIfFailed(hr);
+			return shader;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The shaders are compiled one after the other: the build compiles every
+	// shader once, and stops at the first failure with the compiler messages
+	//
+	bool BuildShaderArchive(const std::vector<ShaderRequest>& manifest, const std::filesystem::path& path,
+		std::string& errors)
+	{
+		ShaderArchiveWriter writer;
+		for (const ShaderRequest& request : manifest)
+		{
+			const std::string name = ShaderArchive::GetKey(request);
+			std::string source;
+			if (!ReadFileContent(request.fileName, source))
+			{
+				errors += "Cannot read the source of " + name + "\n";
+				return false;
+			}
+
+			std::string messages;
+			std::vector<std::wstring> exports;
+			std::vector<ShaderBinding> bindings;
+			try
+			{
+				if (request.entryPoint.empty())
+				{
+					if (request.target != ShaderCompileService::kLibraryTarget)
+					{
+						throw std::logic_error("Unsupported library target");
+					}
+					Microsoft::WRL::ComPtr<IDxcBlob> library;
+					library.Attach(NvHelpers::CompileShaderLibrary(request.fileName.c_str(), source, &messages));
+					ReflectLibrary(library.Get(), exports, bindings);
+					writer.Add(request, library->GetBufferPointer(), library->GetBufferSize(),
+						HashSourceContent(request.fileName, source), exports, bindings);
+				}
+				else
+				{
+					Microsoft::WRL::ComPtr<ID3DBlob> shader = CompileShader(request, messages);
+					ReflectShader(shader.Get(), bindings);
+					exports.emplace_back(request.entryPoint.begin(), request.entryPoint.end());
+					writer.Add(request, shader->GetBufferPointer(), shader->GetBufferSize(),
+						HashSourceContent(request.fileName, source), exports, bindings);
+				}
+			}
+			catch (const std::exception& exception)
+			{
+				errors += "Failed to compile " + name + ": " + exception.what() + "\n" + messages;
+				return false;
+			}
+		}
+
+		if (!writer.Write(path, NvHelpers::GetShaderCompilerVersion()))
+		{
+			errors += "Cannot write " + path.u8string() + "\n";
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,21 @@
+#ifndef SHADER_ARCHIVE_BUILDER_GUARD
+#define SHADER_ARCHIVE_BUILDER_GUARD
+
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "ShaderArchive.h"
+
+namespace RaytracingImplementation
+{
+	// Compile the shaders of a manifest, DXIL libraries with DXC and the other shaders with FXC,
+	// reflect the names they export and the resources they expect, and write everything into a
+	// shader archive. Returns false with the compiler messages if a shader fails to compile, or if
+	// the archive cannot be written
+	bool BuildShaderArchive(const std::vector<ShaderRequest>& manifest, const std::filesystem::path& path,
+		std::string& errors);
+}
+
+#endif // !SHADER_ARCHIVE_BUILDER_GUARD
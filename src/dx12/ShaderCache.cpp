@@ -0,0 +1,331 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		// Extract the file names of the #include directives of a source, in order
+		void ScanIncludes(std::string_view source, std::vector<std::string>& includes)
+		{
+			size_t lineStart = 0;
+			while (lineStart < source.size())
+			{
+				size_t lineEnd = source.find('\n', lineStart);
+				if (lineEnd == std::string_view::npos)
+				{
+					lineEnd = source.size();
+				}
+				std::string_view line = source.substr(lineStart, lineEnd - lineStart);
+				lineStart = lineEnd + 1;
+
+				size_t i = line.find_first_not_of(" \t");
+				if (i == std::string_view::npos || line[i] != '#')
+				{
+					continue;
+				}
+				i = line.find_first_not_of(" \t", i + 1);
+				if (i == std::string_view::npos || line.compare(i, 7, "include") != 0)
+				{
+					continue;
+				}
+				i = line.find_first_not_of(" \t", i + 7);
+				if (i == std::string_view::npos || (line[i] != '"' && line[i] != '<'))
+				{
+					continue;
+				}
+				const char close = line[i] == '"' ? '"' : '>';
+				const size_t end = line.find(close, i + 1);
+				if (end != std::string_view::npos)
+				{
+					includes.emplace_back(line.substr(i + 1, end - i - 1));
+				}
+			}
+		}
+
+		// Add the files included by a source to the list, depth first. Each file is listed once,
+		// even when included several times
+		void CollectIncludes(const std::filesystem::path& directory, const std::filesystem::path& rootDirectory,
+			std::string_view source, std::vector<std::filesystem::path>& files)
+		{
+			std::vector<std::string> includes;
+			ScanIncludes(source, includes);
+			for (const std::string& include : includes)
+			{
+				std::error_code error;
+				std::filesystem::path path = directory / include;
+				if (!std::filesystem::exists(path, error))
+				{
+					path = rootDirectory / include;
+				}
+				path = path.lexically_normal();
+
+				bool seen = false;
+				for (const std::filesystem::path& previous : files)
+				{
+					seen |= previous == path;
+				}
+				if (seen)
+				{
+					continue;
+				}
+				files.push_back(path);
+
+				std::string content;
+				if (ReadFileContent(path, content))
+				{
+					CollectIncludes(path.parent_path(), rootDirectory, content, files);
+				}
+			}
+		}
+	}
+
+	MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::Open(const std::filesystem::path& path)
+	{
+		Close();
+
+		HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		LARGE_INTEGER size = {};
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		{
+			mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		}
+		// The mapping keeps the file open
+		CloseHandle(file);
+		if (!mapping)
+		{
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view)
+		{
+			CloseHandle(mapping);
+			return false;
+		}
+
+		m_mapping = mapping;
+		m_data = static_cast<const uint8_t*>(view);
+		m_size = static_cast<size_t>(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_data)
+		{
+			UnmapViewOfFile(m_data);
+			CloseHandle(m_mapping);
+		}
+		m_mapping = nullptr;
+		m_data = nullptr;
+		m_size = 0;
+	}
+#else
+	bool MappedFile::Open(const std::filesystem::path& path)
+	{
+		Close();
+
+		const int file = open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+
+		struct stat status = {};
+		void* view = MAP_FAILED;
+		if (fstat(file, &status) == 0 && status.st_size > 0)
+		{
+			view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		}
+		// The mapping keeps the file open
+		close(file);
+		if (view == MAP_FAILED)
+		{
+			return false;
+		}
+
+		m_data = static_cast<const uint8_t*>(view);
+		m_size = static_cast<size_t>(status.st_size);
+		return true;
+	}
+
+	void MappedFile::Close()
+	{
+		if (m_data)
+		{
+			munmap(const_cast<uint8_t*>(m_data), m_size);
+		}
+		m_data = nullptr;
+		m_size = 0;
+	}
+#endif
+
+	ShaderCache::ShaderCache(std::filesystem::path directory) :
+		m_directory(std::move(directory))
+	{
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The source path takes part in the key: it appears in the compiler messages
+	// and debug information, and the includes are resolved relative to it
+	//
+	uint64_t ShaderCache::ComputeKey(const std::filesystem::path& sourcePath, std::string_view source,
+		std::wstring_view profile, std::wstring_view arguments, uint64_t compilerVersion) const
+	{
+		const std::filesystem::path normalized = sourcePath.lexically_normal();
+		const std::filesystem::path::string_type& name = normalized.native();
+
+		uint64_t key = HashSourceContent(normalized, source);
+		key = HashCombine(key, HashBytes(name.data(), name.size() * sizeof(name[0])));
+		key = HashCombine(key, HashBytes(profile.data(), profile.size() * sizeof(profile[0])));
+		key = HashCombine(key, HashBytes(arguments.data(), arguments.size() * sizeof(arguments[0])));
+		key = HashCombine(key, compilerVersion);
+
+		// The include names matter as well, as they appear in the compiler messages
+		for (const std::filesystem::path& include : FindIncludes(normalized, source))
+		{
+			const std::filesystem::path::string_type& includeName = include.native();
+			key = HashCombine(key, HashBytes(includeName.data(), includeName.size() * sizeof(includeName[0])));
+		}
+		return key;
+	}
+
+	std::shared_ptr<const ShaderCache::Entry> ShaderCache::Load(uint64_t key)
+	{
+		auto entry = std::make_shared<Entry>();
+		if (entry->m_file.Open(GetEntryPath(key)) && entry->m_file.GetSize() >= kHeaderSize)
+		{
+			Header header;
+			memcpy(&header, entry->m_file.GetData(), kHeaderSize);
+			if (header.magic == kMagic && header.version == kVersion && header.key == key &&
+				header.size == entry->m_file.GetSize() - kHeaderSize)
+			{
+				m_hits++;
+				return entry;
+			}
+		}
+
+		m_misses++;
+		return nullptr;
+	}
+
+	bool ShaderCache::Store(uint64_t key, const void* data, size_t size)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(m_directory, error);
+		if (error)
+		{
+			return false;
+		}
+
+		const std::filesystem::path path = GetEntryPath(key);
+		std::filesystem::path temporaryPath = path;
+		temporaryPath += "." + std::to_string(m_nextTemporary++) + ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			const Header header = { kMagic, kVersion, key, size };
+			file.write(reinterpret_cast<const char*>(&header), kHeaderSize);
+			file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+			if (!file.good())
+			{
+				file.close();
+				std::filesystem::remove(temporaryPath, error);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(temporaryPath, path, error);
+		if (error)
+		{
+			std::filesystem::remove(temporaryPath, error);
+			return false;
+		}
+		return true;
+	}
+
+	std::filesystem::path ShaderCache::GetEntryPath(uint64_t key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.dxil", static_cast<unsigned long long>(key));
+		return m_directory / name;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// A missing include contributes nothing, the compilation fails anyway
+	//
+	uint64_t HashSourceContent(const std::filesystem::path& sourcePath, std::string_view source)
+	{
+		uint64_t hash = HashBytes(source.data(), source.size());
+		for (const std::filesystem::path& include : FindIncludes(sourcePath.lexically_normal(), source))
+		{
+			std::string content;
+			if (ReadFileContent(include, content))
+			{
+				hash = HashCombine(hash, HashBytes(content.data(), content.size()));
+			}
+		}
+		return hash;
+	}
+
+	bool ReadFileContent(const std::filesystem::path& path, std::string& content)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.good())
+		{
+			return false;
+		}
+		const std::streamoff size = file.tellg();
+		if (size < 0)
+		{
+			return false;
+		}
+		content.resize(static_cast<size_t>(size));
+		file.seekg(0);
+		file.read(content.data(), size);
+		return file.good() || file.eof();
+	}
+
+	std::vector<std::filesystem::path> FindIncludes(const std::filesystem::path& sourcePath, std::string_view source)
+	{
+		const std::filesystem::path normalized = sourcePath.lexically_normal();
+		const std::filesystem::path directory = normalized.parent_path();
+
+		std::vector<std::filesystem::path> files = { normalized };
+		CollectIncludes(directory, directory, source, files);
+		files.erase(files.begin());
+		return files;
+	}
+}
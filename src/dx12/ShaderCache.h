@@ -0,0 +1,123 @@
+#ifndef SHADER_CACHE_GUARD
+#define SHADER_CACHE_GUARD
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Read-only view of a whole file mapped in memory. The view stays valid until the object is
+	// closed or destroyed.
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		// Map the file, returning false if it cannot be opened or is empty
+		bool Open(const std::filesystem::path& path);
+		void Close();
+
+		inline const uint8_t* GetData() const { return m_data; }
+		inline size_t GetSize() const { return m_size; }
+
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+#ifdef _WIN32
+		void* m_mapping = nullptr;
+#endif
+	};
+
+	// Content-addressed cache of compiled shaders on disk. A compilation is identified by a key
+	// hashing everything its output depends on: the source, the content of every file it includes,
+	// the target profile, the compiler arguments and the compiler version. Each entry is a file
+	// named after its key, which is memory-mapped when loaded, so that a warm start neither runs
+	// the compiler nor copies the bytecode.
+	// The cache can be used from several threads at once, and does not depend on the compiler or
+	// on any D3D12 header.
+	class ShaderCache
+	{
+	public:
+		// Cached shader, mapped from its file for as long as the object lives
+		class Entry
+		{
+		public:
+			inline const void* GetData() const { return m_file.GetData() + kHeaderSize; }
+			inline size_t GetSize() const { return m_file.GetSize() - kHeaderSize; }
+
+		private:
+			friend class ShaderCache;
+			MappedFile m_file;
+		};
+
+		explicit ShaderCache(std::filesystem::path directory);
+
+		// Key of the compilation of a source file. The includes are found by FindIncludes and
+		// hashed along with the source. Directives in inactive preprocessor branches are hashed
+		// as well, which can only cause unneeded recompilations.
+		uint64_t ComputeKey(const std::filesystem::path& sourcePath, std::string_view source,
+			std::wstring_view profile, std::wstring_view arguments, uint64_t compilerVersion) const;
+
+		// Map the entry stored under the key, or return nullptr if there is none or if it is not
+		// valid
+		std::shared_ptr<const Entry> Load(uint64_t key);
+
+		// Store compiled code under the key. The entry is written to a temporary file first and
+		// then renamed, so that a concurrent or interrupted write never leaves a partial entry.
+		// Returns false if the entry could not be written, which only costs a recompilation
+		bool Store(uint64_t key, const void* data, size_t size);
+
+		inline const std::filesystem::path& GetDirectory() const { return m_directory; }
+
+		// Statistics
+		inline uint64_t GetHitCount() const { return m_hits.load(); }
+		inline uint64_t GetMissCount() const { return m_misses.load(); }
+
+	private:
+		// Each entry starts with a header identifying the key and the size of the code, so that
+		// truncated or foreign files are rejected
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+			uint64_t size;
+		};
+		static constexpr uint32_t kMagic = 0x4c495844; // "DXIL"
+		static constexpr uint32_t kVersion = 1;
+		static constexpr size_t kHeaderSize = sizeof(Header);
+
+		std::filesystem::path GetEntryPath(uint64_t key) const;
+
+		std::filesystem::path m_directory;
+		std::atomic<uint64_t> m_hits{ 0 };
+		std::atomic<uint64_t> m_misses{ 0 };
+		// Suffix of the next temporary file, unique among the writers of this cache
+		std::atomic<uint64_t> m_nextTemporary{ 0 };
+	};
+
+	// Hash of the content of a source and of every file it includes, independent of where the
+	// files are located. Tells whether compiled code still matches its sources
+	uint64_t HashSourceContent(const std::filesystem::path& sourcePath, std::string_view source);
+
+	// Read a whole file into a string, returning false if it cannot be opened
+	bool ReadFileContent(const std::filesystem::path& path, std::string& content);
+
+	// Files included by a source, directly or not, in the order they are first included. The
+	// #include directives are resolved relative to the including file, then to the source, and
+	// files which cannot be found are listed as well
+	std::vector<std::filesystem::path> FindIncludes(const std::filesystem::path& sourcePath, std::string_view source);
+}
+
+#endif // !SHADER_CACHE_GUARD
@@ -0,0 +1,214 @@
+#include "stdafx.h"
+#include <algorithm>
+#include <stdexcept>
+#include "ShaderCompileService.h"
+#include "ShaderCache.h"
+#include "Profiler.h"
+#include "dx12/dxr/DXRHelper.h"
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		// Find the shader compiled for a request in the archive. An archived shader whose sources
+		// are readable is only used if they have not been modified since the archive was built;
+		// without the sources, as in a shipped build, the archive is used as is
+		bool FindUpToDateShader(const ShaderArchive* archive, const ShaderRequest& request, ShaderArchive::Shader& shader)
+		{
+			if (!archive || !archive->Find(request, shader))
+			{
+				return false;
+			}
+
+			std::string source;
+			if (!ReadFileContent(request.fileName, source))
+			{
+				return true;
+			}
+			return HashSourceContent(request.fileName, source) == shader.sourceHash;
+		}
+
+		// Compile a DXIL library, the compiler messages being carried by the exception thrown on
+		// failure. No dialog is ever shown from the workers: the requester reports the failure, with
+		// a message box at startup and in the debug output on a reload
+		IDxcBlob* CompileLibraryFromSource(const std::wstring& fileName, const std::string& source)
+		{
+			std::string messages;
+			try
+			{
+				return NvHelpers::CompileShaderLibrary(fileName.c_str(), source, &messages);
+			}
+			catch (const std::exception&)
+			{
+				if (messages.empty())
+				{
+					throw;
+				}
+				throw std::runtime_error(messages);
+			}
+		}
+
+		// Profile of the DXIL libraries, as hashed into their cache keys
+		std::wstring GetLibraryProfile()
+		{
+			const std::string_view target = ShaderCompileService::kLibraryTarget;
+			return std::wstring(target.begin(), target.end());
+		}
+	}
+
+	ShaderCompileService::ShaderCompileService(ShaderCache* cache, size_t threadCount) :
+		m_cache(cache)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+		}
+		m_workers.reserve(threadCount);
+		for (size_t i = 0; i < threadCount; i++)
+		{
+			m_workers.emplace_back(&ShaderCompileService::RunWorker, this);
+		}
+	}
+
+	ShaderCompileService::~ShaderCompileService()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_jobAvailable.notify_all();
+		for (std::thread& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ShaderCompileService::SetArchive(std::shared_ptr<const ShaderArchive> archive)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_archive = std::move(archive);
+	}
+
+	std::future<Microsoft::WRL::ComPtr<IDxcBlob>> ShaderCompileService::CompileLibrary(std::wstring fileName)
+	{
+		return Submit<Microsoft::WRL::ComPtr<IDxcBlob>>(
+			[this, fileName = std::move(fileName)]() { return LoadOrCompileLibrary(fileName); });
+	}
+
+	std::future<Microsoft::WRL::ComPtr<ID3DBlob>> ShaderCompileService::CompileShader(std::wstring fileName,
+		std::string entryPoint, std::string target, UINT flags, std::vector<Define> defines)
+	{
+		return Submit<Microsoft::WRL::ComPtr<ID3DBlob>>(
+			[archive = GetArchive(), fileName = std::move(fileName), entryPoint = std::move(entryPoint),
+			target = std::move(target), flags, defines = std::move(defines)]()
+			{
+				Microsoft::WRL::ComPtr<ID3DBlob> shader;
+				ShaderArchive::Shader archived;
+				if (FindUpToDateShader(archive.get(), GetShaderRequest(fileName, entryPoint, target, flags, defines), archived))
+				{
+					shader.Attach(new NvHelpers::SharedMemoryBlob<ID3DBlob>(archive, archived.data, archived.size));
+					return shader;
+				}
+
+				std::vector<D3D_SHADER_MACRO> macros;
+				macros.reserve(defines.size() + 1);
+				for (const Define& define : defines)
+				{
+					macros.push_back({ define.first.c_str(), define.second.c_str() });
+				}
+				macros.push_back({ nullptr, nullptr });
+
+				ThrowIfFailed(D3DCompileFromFile(fileName.c_str(), macros.data(), nullptr,
+					entryPoint.c_str(), target.c_str(), flags, 0, &shader, nullptr));
+				return shader;
+			});
+	}
+
+	ShaderRequest ShaderCompileService::GetLibraryRequest(std::wstring fileName)
+	{
+		ShaderRequest request;
+		request.fileName = std::move(fileName);
+		request.target = kLibraryTarget;
+		return request;
+	}
+
+	ShaderRequest ShaderCompileService::GetShaderRequest(std::wstring fileName, std::string entryPoint,
+		std::string target, UINT flags, std::vector<Define> defines)
+	{
+		return { std::move(fileName), std::move(entryPoint), std::move(target), std::move(defines), flags };
+	}
+
+	std::shared_ptr<const ShaderArchive> ShaderCompileService::GetArchive()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_archive;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The workers stop once the service is destroyed and the queue is empty, so
+	// every submitted request completes
+	//
+	void ShaderCompileService::RunWorker()
+	{
+		Profiler::SetThreadName("Shader compiler");
+		for (;;)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobAvailable.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+				if (m_jobs.empty())
+				{
+					return;
+				}
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+			// Exceptions are stored in the future of the request
+			PROFILE_ZONE("ShaderCompileService::Job");
+			job();
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The archive is looked up first, so that no compiler is loaded when it has
+	// the library. The cache key covers the source, its includes, the target
+	// profile and the compiler version, read from the file of the compiler without
+	// loading it, so a hit can be used as is. On a miss the library is
+	// compiled from the source already read for the key, and stored for the next
+	// run; failing to store it only costs a recompilation next time
+	//
+	Microsoft::WRL::ComPtr<IDxcBlob> ShaderCompileService::LoadOrCompileLibrary(const std::wstring& fileName)
+	{
+		Microsoft::WRL::ComPtr<IDxcBlob> library;
+		const std::shared_ptr<const ShaderArchive> archive = GetArchive();
+		ShaderArchive::Shader archived;
+		if (FindUpToDateShader(archive.get(), GetLibraryRequest(fileName), archived))
+		{
+			library.Attach(new NvHelpers::SharedMemoryBlob<>(archive, archived.data, archived.size));
+			return library;
+		}
+
+		const std::string source = NvHelpers::ReadShaderFile(fileName.c_str());
+		if (!m_cache)
+		{
+			library.Attach(CompileLibraryFromSource(fileName, source));
+			return library;
+		}
+
+		static const std::wstring profile = GetLibraryProfile();
+		const uint64_t key = m_cache->ComputeKey(fileName, source, profile, L"",
+			NvHelpers::GetShaderCompilerVersion());
+		if (std::shared_ptr<const ShaderCache::Entry> entry = m_cache->Load(key))
+		{
+			library.Attach(new NvHelpers::SharedMemoryBlob<>(entry, entry->GetData(), entry->GetSize()));
+			return library;
+		}
+
+		library.Attach(CompileLibraryFromSource(fileName, source));
+		m_cache->Store(key, library->GetBufferPointer(), library->GetBufferSize());
+		return library;
+	}
+}
@@ -0,0 +1,96 @@
+#ifndef SHADER_COMPILE_SERVICE_GUARD
+#define SHADER_COMPILE_SERVICE_GUARD
+
+#pragma once
+
+#include <d3dcommon.h>
+#include <dxcapi.h>
+#include <wrl/client.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "ShaderArchive.h"
+
+namespace RaytracingImplementation
+{
+	class ShaderCache;
+
+	// Compiles shaders on a pool of worker threads. Each request returns a future, so that all
+	// the shaders of a pipeline can be requested up front and compiled concurrently. Every
+	// worker uses its own compiler instances, which are not thread-safe, and keeps them for
+	// its whole lifetime.
+	// DXIL libraries go through the shader cache when one is given, so only the libraries
+	// whose sources changed are actually compiled.
+	// Shaders found in the shader archive are used in place and not compiled at all, unless their
+	// sources are around and were modified since the archive was built. Neither compiler is
+	// loaded as long as all the requests are served by the archive.
+	class ShaderCompileService
+	{
+	public:
+		// Preprocessor definition, as a name and a value
+		using Define = std::pair<std::string, std::string>;
+
+		// Start the workers. A thread count of 0 uses one worker per hardware thread
+		explicit ShaderCompileService(ShaderCache* cache, size_t threadCount = 0);
+		// Wait for the pending requests to complete, and stop the workers
+		~ShaderCompileService();
+
+		ShaderCompileService(const ShaderCompileService&) = delete;
+		ShaderCompileService& operator = (const ShaderCompileService&) = delete;
+
+		// Use the shaders of an archive for the following requests, or stop using any with nullptr
+		void SetArchive(std::shared_ptr<const ShaderArchive> archive);
+
+		// Compile a HLSL file into a DXIL library with DXC
+		std::future<Microsoft::WRL::ComPtr<IDxcBlob>> CompileLibrary(std::wstring fileName);
+
+		// Compile an entry point of a HLSL file with FXC
+		std::future<Microsoft::WRL::ComPtr<ID3DBlob>> CompileShader(std::wstring fileName,
+			std::string entryPoint, std::string target, UINT flags, std::vector<Define> defines = {});
+
+		// Requests as recorded in the shader archive, matching the compilations above
+		static ShaderRequest GetLibraryRequest(std::wstring fileName);
+		static ShaderRequest GetShaderRequest(std::wstring fileName, std::string entryPoint,
+			std::string target, UINT flags, std::vector<Define> defines = {});
+		// Target profile of the DXIL libraries
+		static constexpr const char* kLibraryTarget = "lib_6_3";
+
+		inline size_t GetThreadCount() const { return m_workers.size(); }
+
+	private:
+		template <class Result>
+		std::future<Result> Submit(std::function<Result()> job)
+		{
+			// std::function requires copyable targets, hence the shared task
+			auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+			std::future<Result> result = task->get_future();
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_jobs.push_back([task]() { (*task)(); });
+			}
+			m_jobAvailable.notify_one();
+			return result;
+		}
+
+		void RunWorker();
+		Microsoft::WRL::ComPtr<IDxcBlob> LoadOrCompileLibrary(const std::wstring& fileName);
+		std::shared_ptr<const ShaderArchive> GetArchive();
+
+		ShaderCache* m_cache;
+		std::shared_ptr<const ShaderArchive> m_archive;
+		std::vector<std::thread> m_workers;
+		std::deque<std::function<void()>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_jobAvailable;
+		bool m_stopping = false;
+	};
+}
+
+#endif // !SHADER_COMPILE_SERVICE_GUARD
@@ -0,0 +1,136 @@
+#include "ShaderFileWatcher.h"
+#include "ShaderCache.h"
+#include <algorithm>
+#include <string>
+#include <system_error>
+
+namespace RaytracingImplementation
+{
+	void ShaderFileWatcher::Watch(const std::filesystem::path& shader)
+	{
+		const std::filesystem::path normalized = shader.lexically_normal();
+		for (WatchedShader& watched : m_shaders)
+		{
+			if (watched.path == normalized)
+			{
+				UpdateFiles(watched);
+				RemoveUnusedFiles();
+				return;
+			}
+		}
+
+		m_shaders.push_back({ normalized, {} });
+		UpdateFiles(m_shaders.back());
+	}
+
+	void ShaderFileWatcher::Clear()
+	{
+		m_shaders.clear();
+		m_files.clear();
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// A file is considered changed as soon as its time differs from the last one
+	// seen, in either direction, so that restoring an older version of a file is
+	// picked up as well, or its size does, for the writes made within the
+	// resolution of the file times. It is reported as modified once no poll has
+	// seen it change for the settle time
+	//
+	std::vector<std::filesystem::path> ShaderFileWatcher::Poll(Clock::time_point now)
+	{
+		std::vector<std::filesystem::path> modifiedFiles;
+		for (auto& file : m_files)
+		{
+			const FileState state = GetFileState(file.first);
+			if (state.time != file.second.time || state.size != file.second.size)
+			{
+				file.second.time = state.time;
+				file.second.size = state.size;
+				file.second.pending = true;
+				file.second.changeTime = now;
+			}
+			if (file.second.pending && now - file.second.changeTime >= m_settleTime)
+			{
+				file.second.pending = false;
+				modifiedFiles.push_back(file.first);
+			}
+		}
+
+		std::vector<std::filesystem::path> affected;
+		if (modifiedFiles.empty())
+		{
+			return affected;
+		}
+
+		for (WatchedShader& shader : m_shaders)
+		{
+			const bool modified = std::any_of(shader.files.begin(), shader.files.end(),
+				[&modifiedFiles](const std::filesystem::path& file)
+				{
+					return std::find(modifiedFiles.begin(), modifiedFiles.end(), file) != modifiedFiles.end();
+				});
+			if (modified)
+			{
+				UpdateFiles(shader);
+				affected.push_back(shader.path);
+			}
+		}
+		RemoveUnusedFiles();
+		return affected;
+	}
+
+	void ShaderFileWatcher::UpdateFiles(WatchedShader& shader)
+	{
+		std::string source;
+		ReadFileContent(shader.path, source);
+
+		shader.files = FindIncludes(shader.path, source);
+		shader.files.insert(shader.files.begin(), shader.path);
+
+		// Files already watched keep their state, so that a modification made while the shader
+		// is being scanned is still reported by the next poll
+		for (const std::filesystem::path& file : shader.files)
+		{
+			if (m_files.find(file) == m_files.end())
+			{
+				m_files.emplace(file, GetFileState(file));
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// A file which cannot be read, e.g. while an editor replaces it, has the
+	// minimum time and the maximum size
+	//
+	ShaderFileWatcher::FileState ShaderFileWatcher::GetFileState(const std::filesystem::path& path)
+	{
+		std::error_code error;
+		FileState state;
+		state.time = std::filesystem::last_write_time(path, error);
+		if (error)
+		{
+			state.time = std::filesystem::file_time_type::min();
+		}
+		state.size = std::filesystem::file_size(path, error);
+		if (error)
+		{
+			state.size = static_cast<uintmax_t>(-1);
+		}
+		return state;
+	}
+
+	void ShaderFileWatcher::RemoveUnusedFiles()
+	{
+		for (auto it = m_files.begin(); it != m_files.end();)
+		{
+			const bool used = std::any_of(m_shaders.begin(), m_shaders.end(),
+				[&it](const WatchedShader& shader)
+				{
+					return std::find(shader.files.begin(), shader.files.end(), it->first) != shader.files.end();
+				});
+			it = used ? std::next(it) : m_files.erase(it);
+		}
+	}
+}
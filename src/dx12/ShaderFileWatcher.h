@@ -0,0 +1,79 @@
+#ifndef SHADER_FILE_WATCHER_GUARD
+#define SHADER_FILE_WATCHER_GUARD
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Watches shader files, along with every file they include, and reports which shaders are
+	// affected when any of those files is modified. A change to a shared include, such as
+	// Common.hlsl, affects all the shaders including it and only those.
+	// The watcher polls the modification times and sizes of the files, which is cheap for the few
+	// dozens of files of a pipeline, and does not depend on any platform header. A change is only
+	// reported once the file has stayed the same for a settle time, so that a file saved in several
+	// writes is reported once, complete.
+	class ShaderFileWatcher
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+		static constexpr std::chrono::milliseconds kDefaultSettleTime{ 100 };
+
+		explicit ShaderFileWatcher(std::chrono::milliseconds settleTime = kDefaultSettleTime) :
+			m_settleTime(settleTime)
+		{
+		}
+
+		// Start watching a shader and the files it includes. Watching a shader again only
+		// refreshes its includes
+		void Watch(const std::filesystem::path& shader);
+
+		// Stop watching all the shaders
+		void Clear();
+
+		// Return the shaders affected by the files whose changes have settled since the last call,
+		// in the order they were first watched. The includes of those shaders are scanned again, as
+		// the changes may have added or removed some
+		std::vector<std::filesystem::path> Poll(Clock::time_point now = Clock::now());
+
+		inline size_t GetShaderCount() const { return m_shaders.size(); }
+		inline size_t GetFileCount() const { return m_files.size(); }
+
+	private:
+		struct WatchedShader
+		{
+			std::filesystem::path path;
+			// The shader itself, then its includes
+			std::vector<std::filesystem::path> files;
+		};
+
+		// Scan the includes of a shader, and start tracking the files not watched yet
+		void UpdateFiles(WatchedShader& shader);
+		// Drop the files no shader depends on anymore
+		void RemoveUnusedFiles();
+
+		std::vector<WatchedShader> m_shaders;
+		struct FileState
+		{
+			std::filesystem::file_time_type time;
+			uintmax_t size;
+			// A change seen but not reported yet, and the poll which last saw the file change
+			bool pending = false;
+			Clock::time_point changeTime;
+		};
+		// Read the time and size of a file, or invalid values if it cannot be read
+		static FileState GetFileState(const std::filesystem::path& path);
+
+		std::chrono::milliseconds m_settleTime;
+		// Last known state of every watched file
+		std::map<std::filesystem::path, FileState> m_files;
+	};
+}
+
+#endif // !SHADER_FILE_WATCHER_GUARD
@@ -0,0 +1,354 @@
+#include "TlsfAllocator.h"
+#include <stdexcept>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		// Index of the most significant bit set, value must not be 0
+		inline uint32_t FindLastSet(uint64_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return static_cast<uint32_t>(index);
+#else
+			return 63u - static_cast<uint32_t>(__builtin_clzll(value));
+#endif
+		}
+
+		// Index of the least significant bit set, value must not be 0
+		inline uint32_t FindFirstSet(uint64_t value)
+		{
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanForward64(&index, value);
+			return static_cast<uint32_t>(index);
+#else
+			return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+		}
+
+		inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+	}
+
+	TlsfAllocator::TlsfAllocator(uint64_t size) :
+		m_size(size - size % kMinAlignment)
+	{
+		if (m_size == 0)
+		{
+			throw std::logic_error("The TLSF allocator range must hold at least one block");
+		}
+
+		for (auto& freeLists : m_freeLists)
+		{
+			for (uint32_t& head : freeLists)
+			{
+				head = kNullBlock;
+			}
+		}
+
+		// The whole range starts as a single free block
+		uint32_t block = NewBlock();
+		m_blocks[block].offset = 0;
+		m_blocks[block].size = m_size;
+		InsertFreeBlock(block);
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The first level is the position of the most significant bit of the size, the
+	// second level splits each power-of-two range in kSecondLevelCount linear bins.
+	//
+	void TlsfAllocator::MappingInsert(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+	{
+		if (size < (1ull << kFirstLevelShift))
+		{
+			firstLevel = 0;
+			secondLevel = static_cast<uint32_t>(size >> (kFirstLevelShift - kSecondLevelCountLog2));
+			return;
+		}
+
+		const uint32_t lastSet = FindLastSet(size);
+		firstLevel = lastSet - kFirstLevelShift + 1;
+		secondLevel = static_cast<uint32_t>(size >> (lastSet - kSecondLevelCountLog2)) ^ kSecondLevelCount;
+		// The first level 0 covers all the sizes below 2^kFirstLevelShift, shift the others
+		if (firstLevel >= kFirstLevelCount)
+		{
+			firstLevel = kFirstLevelCount - 1;
+			secondLevel = kSecondLevelCount - 1;
+		}
+	}
+
+	void TlsfAllocator::MappingSearch(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+	{
+		// Round the size up to the next bin boundary, so that every block of the bin
+		// returned by MappingInsert is large enough
+		if (size >= (1ull << kFirstLevelShift))
+		{
+			const uint64_t round = (1ull << (FindLastSet(size) - kSecondLevelCountLog2)) - 1;
+			size += round;
+		}
+		MappingInsert(size, firstLevel, secondLevel);
+	}
+
+	uint32_t TlsfAllocator::FindFreeBlock(uint64_t size) const
+	{
+		uint32_t firstLevel;
+		uint32_t secondLevel;
+		MappingSearch(size, firstLevel, secondLevel);
+
+		// Look for a non-empty bin in the same first level first, then in the larger ones
+		uint32_t secondLevelMap = m_secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+		if (secondLevelMap == 0)
+		{
+			const uint64_t firstLevelMap = m_firstLevelBitmap & (~0ull << (firstLevel + 1));
+			if (firstLevelMap == 0)
+			{
+				return kNullBlock;
+			}
+			firstLevel = FindFirstSet(firstLevelMap);
+			secondLevelMap = m_secondLevelBitmaps[firstLevel];
+		}
+		secondLevel = FindFirstSet(secondLevelMap);
+
+		uint32_t block = m_freeLists[firstLevel][secondLevel];
+		// The last bin also holds the blocks larger than the mapping can represent
+		// and the search rounding may not be enough there, check the actual sizes
+		while (block != kNullBlock && m_blocks[block].size < size)
+		{
+			block = m_blocks[block].nextFree;
+		}
+		return block;
+	}
+
+	void TlsfAllocator::InsertFreeBlock(uint32_t block)
+	{
+		uint32_t firstLevel;
+		uint32_t secondLevel;
+		MappingInsert(m_blocks[block].size, firstLevel, secondLevel);
+
+		uint32_t& head = m_freeLists[firstLevel][secondLevel];
+		m_blocks[block].free = true;
+		m_blocks[block].prevFree = kNullBlock;
+		m_blocks[block].nextFree = head;
+		if (head != kNullBlock)
+		{
+			m_blocks[head].prevFree = block;
+		}
+		head = block;
+
+		m_firstLevelBitmap |= 1ull << firstLevel;
+		m_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+		m_freeBlockCount++;
+	}
+
+	void TlsfAllocator::RemoveFreeBlock(uint32_t block)
+	{
+		uint32_t firstLevel;
+		uint32_t secondLevel;
+		MappingInsert(m_blocks[block].size, firstLevel, secondLevel);
+
+		Block& current = m_blocks[block];
+		if (current.prevFree != kNullBlock)
+		{
+			m_blocks[current.prevFree].nextFree = current.nextFree;
+		}
+		else
+		{
+			m_freeLists[firstLevel][secondLevel] = current.nextFree;
+		}
+		if (current.nextFree != kNullBlock)
+		{
+			m_blocks[current.nextFree].prevFree = current.prevFree;
+		}
+
+		if (m_freeLists[firstLevel][secondLevel] == kNullBlock)
+		{
+			m_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if (m_secondLevelBitmaps[firstLevel] == 0)
+			{
+				m_firstLevelBitmap &= ~(1ull << firstLevel);
+			}
+		}
+
+		current.free = false;
+		m_freeBlockCount--;
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// Allocation: find a block large enough for the size and the worst-case
+	// alignment padding, give the padding back as a free block, and split off the
+	// unused tail.
+	//
+	uint64_t TlsfAllocator::Allocate(uint64_t size, uint64_t alignment)
+	{
+		if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+		{
+			throw std::logic_error("The TLSF allocator alignment must be a power of two");
+		}
+		if (size == 0 || size > m_size)
+		{
+			return kInvalidOffset;
+		}
+
+		alignment = alignment < kMinAlignment ? kMinAlignment : alignment;
+		size = AlignUp(size, kMinAlignment);
+
+		// Offsets are always multiples of kMinAlignment, the padding is at most the
+		// difference between both alignments
+		const uint64_t searchSize = size + (alignment - kMinAlignment);
+		uint32_t block = FindFreeBlock(searchSize);
+		if (block == kNullBlock)
+		{
+			return kInvalidOffset;
+		}
+		RemoveFreeBlock(block);
+
+		const uint64_t padding = AlignUp(m_blocks[block].offset, alignment) - m_blocks[block].offset;
+		if (padding != 0)
+		{
+			// The previous block cannot be free, otherwise it would have been merged
+			// with this one, so the padding simply becomes a free block of its own
+			const uint32_t head = block;
+			SplitTail(head, padding);
+			block = m_blocks[head].nextPhysical;
+			RemoveFreeBlock(block);
+			InsertFreeBlock(head);
+		}
+
+		if (m_blocks[block].size - size >= kMinAlignment)
+		{
+			SplitTail(block, size);
+		}
+
+		m_usedSize += m_blocks[block].size;
+		m_allocations.emplace(m_blocks[block].offset, block);
+		return m_blocks[block].offset;
+	}
+
+	void TlsfAllocator::Free(uint64_t offset)
+	{
+		auto it = m_allocations.find(offset);
+		if (it == m_allocations.end())
+		{
+			throw std::logic_error("No TLSF allocation at this offset");
+		}
+
+		uint32_t block = it->second;
+		m_allocations.erase(it);
+		m_usedSize -= m_blocks[block].size;
+
+		// Coalesce with the free neighbours
+		const uint32_t next = m_blocks[block].nextPhysical;
+		if (next != kNullBlock && m_blocks[next].free)
+		{
+			RemoveFreeBlock(next);
+			MergeWithNext(block);
+		}
+		const uint32_t prev = m_blocks[block].prevPhysical;
+		if (prev != kNullBlock && m_blocks[prev].free)
+		{
+			RemoveFreeBlock(prev);
+			MergeWithNext(prev);
+			block = prev;
+		}
+
+		InsertFreeBlock(block);
+	}
+
+	uint64_t TlsfAllocator::GetAllocationSize(uint64_t offset) const
+	{
+		auto it = m_allocations.find(offset);
+		return it == m_allocations.end() ? 0 : m_blocks[it->second].size;
+	}
+
+	void TlsfAllocator::SplitTail(uint32_t block, uint64_t size)
+	{
+		const uint32_t tail = NewBlock();
+		Block& current = m_blocks[block];
+		Block& remainder = m_blocks[tail];
+
+		remainder.offset = current.offset + size;
+		remainder.size = current.size - size;
+		remainder.prevPhysical = block;
+		remainder.nextPhysical = current.nextPhysical;
+		if (current.nextPhysical != kNullBlock)
+		{
+			m_blocks[current.nextPhysical].prevPhysical = tail;
+		}
+		current.nextPhysical = tail;
+		current.size = size;
+
+		// The block following the original one is in use or the original block would
+		// have been merged with it, no further coalescing is needed
+		InsertFreeBlock(tail);
+	}
+
+	void TlsfAllocator::MergeWithNext(uint32_t block)
+	{
+		const uint32_t next = m_blocks[block].nextPhysical;
+		m_blocks[block].size += m_blocks[next].size;
+		m_blocks[block].nextPhysical = m_blocks[next].nextPhysical;
+		if (m_blocks[next].nextPhysical != kNullBlock)
+		{
+			m_blocks[m_blocks[next].nextPhysical].prevPhysical = block;
+		}
+		DeleteBlock(next);
+	}
+
+	uint32_t TlsfAllocator::NewBlock()
+	{
+		uint32_t block;
+		if (!m_unusedBlocks.empty())
+		{
+			block = m_unusedBlocks.back();
+			m_unusedBlocks.pop_back();
+		}
+		else
+		{
+			block = static_cast<uint32_t>(m_blocks.size());
+			m_blocks.emplace_back();
+		}
+		m_blocks[block] = { 0, 0, kNullBlock, kNullBlock, kNullBlock, kNullBlock, false };
+		return block;
+	}
+
+	void TlsfAllocator::DeleteBlock(uint32_t block)
+	{
+		m_unusedBlocks.push_back(block);
+	}
+
+	TlsfAllocator::Statistics TlsfAllocator::GetStatistics() const
+	{
+		Statistics stats;
+		stats.totalSize = m_size;
+		stats.usedSize = m_usedSize;
+		stats.freeSize = m_size - m_usedSize;
+		stats.allocationCount = m_allocations.size();
+		stats.freeBlockCount = m_freeBlockCount;
+
+		// The largest free block is in the highest non-empty bin
+		if (m_firstLevelBitmap != 0)
+		{
+			const uint32_t firstLevel = FindLastSet(m_firstLevelBitmap);
+			const uint32_t secondLevel = FindLastSet(m_secondLevelBitmaps[firstLevel]);
+			for (uint32_t block = m_freeLists[firstLevel][secondLevel]; block != kNullBlock; block = m_blocks[block].nextFree)
+			{
+				if (m_blocks[block].size > stats.largestFreeBlock)
+				{
+					stats.largestFreeBlock = m_blocks[block].size;
+				}
+			}
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,120 @@
+#ifndef TLSF_ALLOCATOR_GUARD
+#define TLSF_ALLOCATOR_GUARD
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Two-level segregated fit allocator managing offsets inside a contiguous range, such as a
+	// D3D12 heap. Free blocks are binned by the position of their most significant bit (first
+	// level) and then linearly into kSecondLevelCount sub-ranges (second level). Two bitmaps
+	// record the non-empty bins, so allocation and release run in constant time whatever the
+	// number of blocks. Neighbouring free blocks are merged on release.
+	//
+	// The allocator only manipulates offsets and does not depend on any platform header, so it
+	// can be exercised without a device. All the offsets and sizes are multiples of
+	// kMinAlignment, which is the D3D12 alignment of the acceleration structures and of the
+	// constant data; larger power-of-two alignments, such as the 64KB placement alignment of
+	// the resources in a heap, are supported as well.
+	class TlsfAllocator
+	{
+	public:
+		static constexpr uint64_t kMinAlignment = 256;
+		static constexpr uint64_t kInvalidOffset = ~0ull;
+
+		struct Statistics
+		{
+			uint64_t totalSize = 0;
+			uint64_t usedSize = 0;
+			uint64_t freeSize = 0;
+			uint64_t largestFreeBlock = 0;
+			size_t allocationCount = 0;
+			size_t freeBlockCount = 0;
+
+			// Share of the free memory which cannot be used by a single allocation: 0 when
+			// all the free memory is contiguous, close to 1 when it is scattered in small blocks
+			double GetFragmentation() const
+			{
+				return freeSize == 0 ? 0.0 : 1.0 - double(largestFreeBlock) / double(freeSize);
+			}
+		};
+
+		explicit TlsfAllocator(uint64_t size);
+
+		TlsfAllocator(const TlsfAllocator&) = delete;
+		TlsfAllocator& operator = (const TlsfAllocator&) = delete;
+
+		// Allocate a block of at least size bytes whose offset is a multiple of alignment, which
+		// must be a power of two. Returns kInvalidOffset if no free block is large enough.
+		uint64_t Allocate(uint64_t size, uint64_t alignment = kMinAlignment);
+
+		// Release a block returned by Allocate
+		void Free(uint64_t offset);
+
+		// Size of the block allocated at the given offset, rounded up to kMinAlignment
+		uint64_t GetAllocationSize(uint64_t offset) const;
+
+		inline uint64_t GetSize() const { return m_size; }
+		inline bool IsEmpty() const { return m_allocations.empty(); }
+		Statistics GetStatistics() const;
+
+	private:
+		static constexpr uint32_t kSecondLevelCountLog2 = 4;
+		static constexpr uint32_t kSecondLevelCount = 1u << kSecondLevelCountLog2;
+		// Blocks smaller than 2^kFirstLevelShift are all binned in the first level 0
+		static constexpr uint32_t kFirstLevelShift = 8;
+		static constexpr uint32_t kFirstLevelCount = 64 - kFirstLevelShift;
+		static constexpr uint32_t kNullBlock = ~0u;
+
+		struct Block
+		{
+			uint64_t offset;
+			uint64_t size;
+			// Neighbours in the address range
+			uint32_t prevPhysical;
+			uint32_t nextPhysical;
+			// Neighbours in the free list of the bin, when the block is free
+			uint32_t prevFree;
+			uint32_t nextFree;
+			bool free;
+		};
+
+		// Bin holding the blocks of the given size
+		static void MappingInsert(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+		// Bin from which any block is large enough for the given size
+		static void MappingSearch(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+
+		uint32_t FindFreeBlock(uint64_t size) const;
+		void InsertFreeBlock(uint32_t block);
+		void RemoveFreeBlock(uint32_t block);
+
+		// Split the tail of a block past size into a new free block
+		void SplitTail(uint32_t block, uint64_t size);
+		// Merge a block with the following one in the address range
+		void MergeWithNext(uint32_t block);
+
+		uint32_t NewBlock();
+		void DeleteBlock(uint32_t block);
+
+		uint64_t m_size;
+		uint64_t m_usedSize = 0;
+		size_t m_freeBlockCount = 0;
+
+		std::vector<Block> m_blocks;
+		std::vector<uint32_t> m_unusedBlocks;
+
+		uint64_t m_firstLevelBitmap = 0;
+		uint32_t m_secondLevelBitmaps[kFirstLevelCount] = {};
+		uint32_t m_freeLists[kFirstLevelCount][kSecondLevelCount];
+
+		// Allocated block at each offset
+		std::unordered_map<uint64_t, uint32_t> m_allocations;
+	};
+}
+
+#endif // !TLSF_ALLOCATOR_GUARD
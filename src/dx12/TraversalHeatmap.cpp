@@ -0,0 +1,184 @@
+#include "TraversalHeatmap.h"
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <stdexcept>
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		void WriteLittleEndian(std::ofstream& file, uint32_t value, uint32_t size)
+		{
+			for (uint32_t i = 0; i < size; i++)
+			{
+				file.put(static_cast<char>((value >> (i * 8)) & 0xFF));
+			}
+		}
+
+		// Color of a value in [0, 1], interpolated between the stops of the ramp
+		std::array<uint8_t, 3> GetFalseColor(float value)
+		{
+			static constexpr float kStops[][3] = {
+				{ 0.0f, 0.0f, 0.0f },
+				{ 0.0f, 0.0f, 1.0f },
+				{ 0.0f, 1.0f, 1.0f },
+				{ 0.0f, 1.0f, 0.0f },
+				{ 1.0f, 1.0f, 0.0f },
+				{ 1.0f, 0.0f, 0.0f } };
+			constexpr uint32_t kStopCount = sizeof(kStops) / sizeof(kStops[0]);
+
+			const float position = std::min<float>(std::max<float>(value, 0.0f), 1.0f) * float(kStopCount - 1);
+			const uint32_t stop = std::min<uint32_t>(static_cast<uint32_t>(position), kStopCount - 2);
+			const float weight = position - float(stop);
+			std::array<uint8_t, 3> color;
+			for (uint32_t channel = 0; channel < 3; channel++)
+			{
+				const float component = kStops[stop][channel] + (kStops[stop + 1][channel] - kStops[stop][channel]) * weight;
+				color[channel] = static_cast<uint8_t>(component * 255.0f + 0.5f);
+			}
+			return color;
+		}
+	}
+
+	TraversalHeatmap::TraversalHeatmap(uint32_t width, uint32_t height) :
+		m_width(width),
+		m_height(height),
+		m_pixels(size_t(width) * height)
+	{
+	}
+
+	void TraversalHeatmap::Record(uint32_t x, uint32_t y, const TraversalCounters& counters)
+	{
+		if (x >= m_width || y >= m_height)
+		{
+			throw std::logic_error("Traversal heatmap pixel out of range");
+		}
+		TraversalCounters& pixel = m_pixels[size_t(y) * m_width + x];
+		pixel.nodesVisited += counters.nodesVisited;
+		pixel.boxesTested += counters.boxesTested;
+		pixel.trianglesTested += counters.trianglesTested;
+		pixel.maxStackDepth = std::max<uint32_t>(pixel.maxStackDepth, counters.maxStackDepth);
+		m_rayCount++;
+	}
+
+	uint32_t TraversalHeatmap::GetValue(Counter counter, uint32_t x, uint32_t y) const
+	{
+		const TraversalCounters& pixel = m_pixels.at(size_t(y) * m_width + x);
+		switch (counter)
+		{
+		case kNodesVisited:
+			return pixel.nodesVisited;
+		case kBoxesTested:
+			return pixel.boxesTested;
+		case kTrianglesTested:
+			return pixel.trianglesTested;
+		case kStackDepth:
+			return pixel.maxStackDepth;
+		default:
+			throw std::logic_error("Unknown traversal counter");
+		}
+	}
+
+	TraversalHeatmap::Aggregate TraversalHeatmap::GetAggregate(Counter counter) const
+	{
+		Aggregate aggregate;
+		for (uint32_t y = 0; y < m_height; y++)
+		{
+			for (uint32_t x = 0; x < m_width; x++)
+			{
+				const uint32_t value = GetValue(counter, x, y);
+				aggregate.total += value;
+				aggregate.max = std::max<uint32_t>(aggregate.max, value);
+			}
+		}
+		if (!m_pixels.empty())
+		{
+			aggregate.mean = double(aggregate.total) / double(m_pixels.size());
+		}
+		return aggregate;
+	}
+
+	const char* TraversalHeatmap::GetCounterName(Counter counter)
+	{
+		switch (counter)
+		{
+		case kNodesVisited:
+			return "nodes_visited";
+		case kBoxesTested:
+			return "boxes_tested";
+		case kTrianglesTested:
+			return "triangles_tested";
+		case kStackDepth:
+			return "stack_depth";
+		default:
+			return "unknown";
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// BMP rows are stored bottom-up, in BGR order, each padded to 4 bytes
+	//
+	bool TraversalHeatmap::WriteImage(Counter counter, const std::filesystem::path& path) const
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+
+		constexpr uint32_t kHeaderSize = 54;
+		const uint32_t rowSize = (m_width * 3 + 3) & ~3u;
+		const uint32_t imageSize = rowSize * m_height;
+		file.put('B');
+		file.put('M');
+		WriteLittleEndian(file, kHeaderSize + imageSize, 4);
+		WriteLittleEndian(file, 0, 4);
+		WriteLittleEndian(file, kHeaderSize, 4);
+		WriteLittleEndian(file, 40, 4);
+		WriteLittleEndian(file, m_width, 4);
+		WriteLittleEndian(file, m_height, 4);
+		WriteLittleEndian(file, 1, 2);
+		WriteLittleEndian(file, 24, 2);
+		WriteLittleEndian(file, 0, 4);
+		WriteLittleEndian(file, imageSize, 4);
+		// 72 DPI
+		WriteLittleEndian(file, 2835, 4);
+		WriteLittleEndian(file, 2835, 4);
+		WriteLittleEndian(file, 0, 4);
+		WriteLittleEndian(file, 0, 4);
+
+		const uint32_t max = std::max<uint32_t>(GetAggregate(counter).max, 1);
+		std::vector<char> row(rowSize, 0);
+		for (uint32_t y = m_height; y-- > 0;)
+		{
+			for (uint32_t x = 0; x < m_width; x++)
+			{
+				const std::array<uint8_t, 3> color = GetFalseColor(float(GetValue(counter, x, y)) / float(max));
+				row[x * 3] = static_cast<char>(color[2]);
+				row[x * 3 + 1] = static_cast<char>(color[1]);
+				row[x * 3 + 2] = static_cast<char>(color[0]);
+			}
+			file.write(row.data(), row.size());
+		}
+		return static_cast<bool>(file);
+	}
+
+	bool TraversalHeatmap::WriteCsv(const std::filesystem::path& path) const
+	{
+		std::ofstream file(path, std::ios::trunc);
+		if (!file)
+		{
+			return false;
+		}
+		file << "counter,rays,total,mean_per_pixel,max_per_pixel\n";
+		for (uint32_t counter = 0; counter < kCounterCount; counter++)
+		{
+			const Aggregate aggregate = GetAggregate(Counter(counter));
+			file << GetCounterName(Counter(counter)) << ',' << m_rayCount << ',' << aggregate.total << ',' <<
+				aggregate.mean << ',' << aggregate.max << '\n';
+		}
+		return static_cast<bool>(file);
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef TRAVERSAL_HEATMAP_GUARD
+#define TRAVERSAL_HEATMAP_GUARD
+
+#pragma once
+
+#include "TriangleBvh.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Traversal counters of every pixel of a frame, written as false-color images and
+	// aggregated over the frame. It does not depend on any platform header.
+	class TraversalHeatmap
+	{
+	public:
+		enum Counter : uint32_t
+		{
+			kNodesVisited,
+			kBoxesTested,
+			kTrianglesTested,
+			kStackDepth,
+			kCounterCount
+		};
+
+		struct Aggregate
+		{
+			uint64_t total = 0;
+			double mean = 0.0;
+			uint32_t max = 0;
+		};
+
+		TraversalHeatmap(uint32_t width, uint32_t height);
+
+		// Add the counters of a ray traced for a pixel. The stack depth keeps its maximum
+		void Record(uint32_t x, uint32_t y, const TraversalCounters& counters);
+
+		inline uint32_t GetWidth() const { return m_width; }
+		inline uint32_t GetHeight() const { return m_height; }
+		inline uint64_t GetRayCount() const { return m_rayCount; }
+
+		// Counter of a pixel, summed over its rays
+		uint32_t GetValue(Counter counter, uint32_t x, uint32_t y) const;
+		// Over the pixels
+		Aggregate GetAggregate(Counter counter) const;
+
+		static const char* GetCounterName(Counter counter);
+
+		// Write a counter as a 24-bit BMP, from black for 0 through blue, green and yellow to
+		// red for its maximum. Returns false if the file cannot be written
+		bool WriteImage(Counter counter, const std::filesystem::path& path) const;
+		// Write the aggregate of every counter, one line per counter
+		bool WriteCsv(const std::filesystem::path& path) const;
+
+	private:
+		uint32_t m_width;
+		uint32_t m_height;
+		uint64_t m_rayCount = 0;
+		// Counters of each pixel, row by row
+		std::vector<TraversalCounters> m_pixels;
+	};
+}
+
+#endif // !TRAVERSAL_HEATMAP_GUARD
@@ -0,0 +1,486 @@
+#include "TriangleBvh.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		using Vector3 = TriangleBvh::Vector3;
+
+		struct Bounds
+		{
+			Vector3 min = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+			Vector3 max = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+			void Grow(const Vector3& point)
+			{
+				min = { std::min<float>(min.x, point.x), std::min<float>(min.y, point.y), std::min<float>(min.z, point.z) };
+				max = { std::max<float>(max.x, point.x), std::max<float>(max.y, point.y), std::max<float>(max.z, point.z) };
+			}
+
+			void Grow(const Bounds& bounds)
+			{
+				if (!bounds.IsEmpty())
+				{
+					Grow(bounds.min);
+					Grow(bounds.max);
+				}
+			}
+
+			bool IsEmpty() const
+			{
+				return min.x > max.x;
+			}
+
+			float GetSurfaceArea() const
+			{
+				if (IsEmpty())
+				{
+					return 0.0f;
+				}
+				const float dx = max.x - min.x;
+				const float dy = max.y - min.y;
+				const float dz = max.z - min.z;
+				return 2.0f * (dx * dy + dy * dz + dz * dx);
+			}
+		};
+
+		inline float GetAxis(const Vector3& vector, uint32_t axis)
+		{
+			return axis == 0 ? vector.x : axis == 1 ? vector.y : vector.z;
+		}
+
+		inline Vector3 Subtract(const Vector3& a, const Vector3& b)
+		{
+			return { a.x - b.x, a.y - b.y, a.z - b.z };
+		}
+
+		inline Vector3 Cross(const Vector3& a, const Vector3& b)
+		{
+			return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+		}
+
+		inline float Dot(const Vector3& a, const Vector3& b)
+		{
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		struct Primitive
+		{
+			Bounds bounds;
+			Vector3 centroid;
+		};
+
+		// Range of primitives to split, and the node to write them into
+		struct BuildTask
+		{
+			uint32_t node;
+			uint32_t first;
+			uint32_t count;
+			uint32_t depth;
+		};
+
+		struct Bin
+		{
+			Bounds bounds;
+			uint32_t count = 0;
+		};
+
+		// Memory of the binned SAH split, reused by all the nodes
+		struct BinningScratch
+		{
+			explicit BinningScratch(uint32_t binCount) :
+				bins(binCount),
+				rightAreas(binCount),
+				rightCounts(binCount)
+			{
+			}
+
+			std::vector<Bin> bins;
+			std::vector<float> rightAreas;
+			std::vector<uint32_t> rightCounts;
+		};
+
+		uint32_t GetLargestAxis(const Bounds& bounds)
+		{
+			const Vector3 extent = Subtract(bounds.max, bounds.min);
+			return extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+		}
+
+		// The split functions order the indices of the range so that the left child takes
+		// the first ones, and return their count, or 0 to make the range a leaf.
+		//
+		// Evaluate the planes between bins of equal width on each axis, and split at the
+		// lowest SAH cost unless a leaf is cheaper. When all the centroids coincide no plane
+		// separates them, and a range still too large is cut in its middle
+		uint32_t SplitBinnedSah(const std::vector<Primitive>& primitives, uint32_t* indices, uint32_t count,
+			const Bounds& bounds, const Bounds& centroidBounds, const TriangleBvh::BuildOptions& options,
+			BinningScratch& scratch)
+		{
+			const float leafCost = TriangleBvh::kIntersectionCost * float(count);
+			const float inverseArea = 1.0f / std::max<float>(bounds.GetSurfaceArea(), std::numeric_limits<float>::min());
+			float bestCost = std::numeric_limits<float>::infinity();
+			uint32_t bestAxis = 0;
+			uint32_t bestPlane = 0;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const float axisMin = GetAxis(centroidBounds.min, axis);
+				const float extent = GetAxis(centroidBounds.max, axis) - axisMin;
+				if (!(extent > 0.0f))
+				{
+					continue;
+				}
+				const float scale = float(options.binCount) / extent;
+				std::fill(scratch.bins.begin(), scratch.bins.end(), Bin{});
+				for (uint32_t i = 0; i < count; i++)
+				{
+					const Primitive& primitive = primitives[indices[i]];
+					const uint32_t bin = std::min<uint32_t>(static_cast<uint32_t>((GetAxis(primitive.centroid, axis) - axisMin) * scale),
+						options.binCount - 1);
+					scratch.bins[bin].bounds.Grow(primitive.bounds);
+					scratch.bins[bin].count++;
+				}
+
+				Bounds right;
+				uint32_t rightCount = 0;
+				for (uint32_t bin = options.binCount - 1; bin > 0; bin--)
+				{
+					right.Grow(scratch.bins[bin].bounds);
+					rightCount += scratch.bins[bin].count;
+					scratch.rightAreas[bin] = right.GetSurfaceArea();
+					scratch.rightCounts[bin] = rightCount;
+				}
+				Bounds left;
+				uint32_t leftCount = 0;
+				for (uint32_t plane = 1; plane < options.binCount; plane++)
+				{
+					left.Grow(scratch.bins[plane - 1].bounds);
+					leftCount += scratch.bins[plane - 1].count;
+					if (leftCount == 0 || scratch.rightCounts[plane] == 0)
+					{
+						continue;
+					}
+					const float cost = TriangleBvh::kTraversalCost + TriangleBvh::kIntersectionCost * inverseArea *
+						(left.GetSurfaceArea() * float(leftCount) + scratch.rightAreas[plane] * float(scratch.rightCounts[plane]));
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestPlane = plane;
+					}
+				}
+			}
+
+			if (bestPlane == 0)
+			{
+				return count > options.maxLeafSize ? count / 2 : 0;
+			}
+			if (bestCost >= leafCost && count <= options.maxLeafSize)
+			{
+				return 0;
+			}
+			const float axisMin = GetAxis(centroidBounds.min, bestAxis);
+			const float scale = float(options.binCount) / (GetAxis(centroidBounds.max, bestAxis) - axisMin);
+			const uint32_t* middle = std::partition(indices, indices + count, [&](uint32_t triangle)
+			{
+				const uint32_t bin = std::min<uint32_t>(static_cast<uint32_t>(
+					(GetAxis(primitives[triangle].centroid, bestAxis) - axisMin) * scale), options.binCount - 1);
+				return bin < bestPlane;
+			});
+			return static_cast<uint32_t>(middle - indices);
+		}
+
+		// Split the centroids in two halves of equal count along the largest axis
+		uint32_t SplitObjectMedian(const std::vector<Primitive>& primitives, uint32_t* indices, uint32_t count,
+			const Bounds& centroidBounds, const TriangleBvh::BuildOptions& options)
+		{
+			if (count <= options.maxLeafSize)
+			{
+				return 0;
+			}
+			const uint32_t axis = GetLargestAxis(centroidBounds);
+			std::nth_element(indices, indices + count / 2, indices + count, [&](uint32_t a, uint32_t b)
+			{
+				return GetAxis(primitives[a].centroid, axis) < GetAxis(primitives[b].centroid, axis);
+			});
+			return count / 2;
+		}
+
+		// Split the centroids at the middle of their bounds along the largest axis
+		uint32_t SplitSpatialMedian(const std::vector<Primitive>& primitives, uint32_t* indices, uint32_t count,
+			const Bounds& centroidBounds, const TriangleBvh::BuildOptions& options)
+		{
+			if (count <= options.maxLeafSize)
+			{
+				return 0;
+			}
+			const uint32_t axis = GetLargestAxis(centroidBounds);
+			const float middle = (GetAxis(centroidBounds.min, axis) + GetAxis(centroidBounds.max, axis)) * 0.5f;
+			const uint32_t* right = std::partition(indices, indices + count, [&](uint32_t triangle)
+			{
+				return GetAxis(primitives[triangle].centroid, axis) < middle;
+			});
+			const uint32_t leftCount = static_cast<uint32_t>(right - indices);
+			return leftCount == 0 || leftCount == count ? count / 2 : leftCount;
+		}
+
+		// Entry distance of a box along the ray, or infinity if the ray misses it
+		inline float IntersectBox(const TriangleBvh::Node& node, const Vector3& origin,
+			const Vector3& inverseDirection, float tMin, float tMax)
+		{
+			const float x0 = (node.boundsMin.x - origin.x) * inverseDirection.x;
+			const float x1 = (node.boundsMax.x - origin.x) * inverseDirection.x;
+			const float y0 = (node.boundsMin.y - origin.y) * inverseDirection.y;
+			const float y1 = (node.boundsMax.y - origin.y) * inverseDirection.y;
+			const float z0 = (node.boundsMin.z - origin.z) * inverseDirection.z;
+			const float z1 = (node.boundsMax.z - origin.z) * inverseDirection.z;
+			const float entry = std::max<float>(std::max<float>(std::min<float>(x0, x1), std::min<float>(y0, y1)),
+				std::max<float>(std::min<float>(z0, z1), tMin));
+			const float exit = std::min<float>(std::min<float>(std::max<float>(x0, x1), std::max<float>(y0, y1)),
+				std::min<float>(std::max<float>(z0, z1), tMax));
+			return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The ranges are split top-down by the chosen builder until it makes them
+	// leaves, or the maximum depth is reached
+	//
+	TriangleBvh::TriangleBvh(const std::vector<Vector3>& vertices, const BuildOptions& options)
+	{
+		if (vertices.size() % 3 != 0)
+		{
+			throw std::logic_error("The BVH vertices must be given by triangles");
+		}
+		if (options.maxLeafSize == 0 || options.binCount < 2)
+		{
+			throw std::logic_error("The BVH needs at least one triangle per leaf and two bins");
+		}
+		if (options.builder >= Builder::kCount)
+		{
+			throw std::logic_error("Unknown BVH builder");
+		}
+		const uint32_t triangleCount = static_cast<uint32_t>(vertices.size() / 3);
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		std::vector<Primitive> primitives(triangleCount);
+		m_triangleIndices.resize(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			Primitive& primitive = primitives[i];
+			for (uint32_t vertex = 0; vertex < 3; vertex++)
+			{
+				primitive.bounds.Grow(vertices[i * 3 + vertex]);
+			}
+			primitive.centroid = { (primitive.bounds.min.x + primitive.bounds.max.x) * 0.5f,
+				(primitive.bounds.min.y + primitive.bounds.max.y) * 0.5f,
+				(primitive.bounds.min.z + primitive.bounds.max.z) * 0.5f };
+			m_triangleIndices[i] = i;
+		}
+
+		BinningScratch scratch(options.binCount);
+		m_nodes.reserve(size_t(triangleCount) * 2);
+		m_nodes.push_back({});
+		std::vector<BuildTask> tasks = { { 0, 0, triangleCount, 0 } };
+		while (!tasks.empty())
+		{
+			const BuildTask task = tasks.back();
+			tasks.pop_back();
+
+			Bounds bounds;
+			Bounds centroidBounds;
+			for (uint32_t i = task.first; i < task.first + task.count; i++)
+			{
+				bounds.Grow(primitives[m_triangleIndices[i]].bounds);
+				centroidBounds.Grow(primitives[m_triangleIndices[i]].centroid);
+			}
+			Node& node = m_nodes[task.node];
+			node.boundsMin = bounds.min;
+			node.boundsMax = bounds.max;
+			node.firstIndex = task.first;
+			node.count = task.count;
+			if (task.count == 1 || task.depth + 1 >= kMaxDepth)
+			{
+				continue;
+			}
+
+			uint32_t* indices = m_triangleIndices.data() + task.first;
+			uint32_t leftCount = 0;
+			switch (options.builder)
+			{
+			case Builder::kBinnedSah:
+				leftCount = SplitBinnedSah(primitives, indices, task.count, bounds, centroidBounds, options, scratch);
+				break;
+			case Builder::kObjectMedian:
+				leftCount = SplitObjectMedian(primitives, indices, task.count, centroidBounds, options);
+				break;
+			case Builder::kSpatialMedian:
+				leftCount = SplitSpatialMedian(primitives, indices, task.count, centroidBounds, options);
+				break;
+			default:
+				break;
+			}
+			if (leftCount == 0)
+			{
+				continue;
+			}
+
+			const uint32_t leftChild = static_cast<uint32_t>(m_nodes.size());
+			m_nodes.push_back({});
+			m_nodes.push_back({});
+			m_nodes[task.node].firstIndex = leftChild;
+			m_nodes[task.node].count = 0;
+			tasks.push_back({ leftChild + 1, task.first + leftCount, task.count - leftCount, task.depth + 1 });
+			tasks.push_back({ leftChild, task.first, leftCount, task.depth + 1 });
+		}
+
+		m_triangles.resize(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			const uint32_t triangle = m_triangleIndices[i];
+			m_triangles[i] = { vertices[triangle * 3], vertices[triangle * 3 + 1], vertices[triangle * 3 + 2] };
+		}
+	}
+
+	const char* TriangleBvh::GetBuilderName(Builder builder)
+	{
+		switch (builder)
+		{
+		case Builder::kBinnedSah:
+			return "binned_sah";
+		case Builder::kObjectMedian:
+			return "object_median";
+		case Builder::kSpatialMedian:
+			return "spatial_median";
+		default:
+			return "unknown";
+		}
+	}
+
+	bool TriangleBvh::Intersect(const Ray& ray, Hit& hit) const
+	{
+		NoTraversalStatistics statistics;
+		return Intersect(ray, hit, statistics);
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The nearer child is visited first, and the farther one is pushed with its
+	// entry distance, so that it is skipped once a closer hit is found. The
+	// triangles are tested with the Moller-Trumbore algorithm, both faces
+	// hitting as with the default DXR ray flags
+	//
+	template <class Statistics>
+	bool TriangleBvh::Intersect(const Ray& ray, Hit& hit, Statistics& statistics) const
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		const Vector3 inverseDirection = { 1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z };
+		float tMax = ray.tMax;
+		bool found = false;
+
+		struct StackEntry
+		{
+			uint32_t node;
+			float entry;
+		};
+		StackEntry stack[kMaxDepth];
+		uint32_t stackSize = 0;
+
+		statistics.TestBoxes(1);
+		if (IntersectBox(m_nodes[0], ray.origin, inverseDirection, ray.tMin, tMax) == std::numeric_limits<float>::infinity())
+		{
+			return false;
+		}
+		uint32_t nodeIndex = 0;
+		for (;;)
+		{
+			statistics.VisitNode();
+			const Node& node = m_nodes[nodeIndex];
+			if (node.count == 0)
+			{
+				statistics.TestBoxes(2);
+				uint32_t nearChild = node.firstIndex;
+				uint32_t farChild = node.firstIndex + 1;
+				float nearEntry = IntersectBox(m_nodes[nearChild], ray.origin, inverseDirection, ray.tMin, tMax);
+				float farEntry = IntersectBox(m_nodes[farChild], ray.origin, inverseDirection, ray.tMin, tMax);
+				if (farEntry < nearEntry)
+				{
+					std::swap(nearChild, farChild);
+					std::swap(nearEntry, farEntry);
+				}
+				if (nearEntry != std::numeric_limits<float>::infinity())
+				{
+					if (farEntry != std::numeric_limits<float>::infinity())
+					{
+						stack[stackSize++] = { farChild, farEntry };
+						statistics.SetStackDepth(stackSize);
+					}
+					nodeIndex = nearChild;
+					continue;
+				}
+			}
+			else
+			{
+				statistics.TestTriangles(node.count);
+				for (uint32_t i = node.firstIndex; i < node.firstIndex + node.count; i++)
+				{
+					const Triangle& triangle = m_triangles[i];
+					const Vector3 edge1 = Subtract(triangle.v1, triangle.v0);
+					const Vector3 edge2 = Subtract(triangle.v2, triangle.v0);
+					const Vector3 p = Cross(ray.direction, edge2);
+					const float determinant = Dot(edge1, p);
+					if (std::fabs(determinant) < std::numeric_limits<float>::epsilon())
+					{
+						continue;
+					}
+					const float inverseDeterminant = 1.0f / determinant;
+					const Vector3 s = Subtract(ray.origin, triangle.v0);
+					const float u = Dot(s, p) * inverseDeterminant;
+					if (u < 0.0f || u > 1.0f)
+					{
+						continue;
+					}
+					const Vector3 q = Cross(s, edge1);
+					const float v = Dot(ray.direction, q) * inverseDeterminant;
+					if (v < 0.0f || u + v > 1.0f)
+					{
+						continue;
+					}
+					const float t = Dot(edge2, q) * inverseDeterminant;
+					if (t >= ray.tMin && t < tMax)
+					{
+						tMax = t;
+						hit = { t, m_triangleIndices[i], u, v };
+						found = true;
+					}
+				}
+			}
+
+			// Resume with the nearest node left which may still hold a closer hit
+			while (stackSize != 0 && stack[stackSize - 1].entry > tMax)
+			{
+				stackSize--;
+			}
+			if (stackSize == 0)
+			{
+				break;
+			}
+			nodeIndex = stack[--stackSize].node;
+		}
+		return found;
+	}
+
+	template bool TriangleBvh::Intersect<NoTraversalStatistics>(const Ray&, Hit&, NoTraversalStatistics&) const;
+	template bool TriangleBvh::Intersect<TraversalStatistics>(const Ray&, Hit&, TraversalStatistics&) const;
+}
@@ -0,0 +1,146 @@
+#ifndef TRIANGLE_BVH_GUARD
+#define TRIANGLE_BVH_GUARD
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Work done by the traversal of a single ray
+	struct TraversalCounters
+	{
+		uint32_t nodesVisited = 0;
+		uint32_t boxesTested = 0;
+		uint32_t trianglesTested = 0;
+		// Largest number of nodes waiting on the traversal stack
+		uint32_t maxStackDepth = 0;
+	};
+
+	// Statistics policies of the traversal. The kernel is instantiated for each of them, and
+	// the empty functions of NoTraversalStatistics are inlined away, so the traversal without
+	// statistics compiles to the same code as if it had no instrumentation at all
+	struct NoTraversalStatistics
+	{
+		inline void VisitNode() {}
+		inline void TestBoxes(uint32_t) {}
+		inline void TestTriangles(uint32_t) {}
+		inline void SetStackDepth(uint32_t) {}
+	};
+
+	struct TraversalStatistics
+	{
+		TraversalCounters counters;
+
+		inline void VisitNode() { counters.nodesVisited++; }
+		inline void TestBoxes(uint32_t count) { counters.boxesTested += count; }
+		inline void TestTriangles(uint32_t count) { counters.trianglesTested += count; }
+		inline void SetStackDepth(uint32_t depth) { counters.maxStackDepth = depth > counters.maxStackDepth ? depth : counters.maxStackDepth; }
+	};
+
+	// Bounding volume hierarchy of a triangle list, traced on the CPU. It mirrors the
+	// geometry of the bottom-level AS to instrument the traversal, which the driver hides
+	// in the DXR path: nodes visited, boxes and triangles tested, and stack depth per ray.
+	//
+	// The tree is binary, built top-down. The default builder bins the triangle centroids and
+	// splits where the surface area heuristic is the lowest, the others split at a median
+	// and build faster, trading trace speed as the DXR fast-trace and fast-build flags do.
+	// The nodes are stored depth-first, the two children of an interior node next to each
+	// other. It does not depend on any platform header.
+	class TriangleBvh
+	{
+	public:
+		struct Vector3
+		{
+			float x;
+			float y;
+			float z;
+		};
+
+		struct Ray
+		{
+			Vector3 origin;
+			Vector3 direction;
+			float tMin;
+			float tMax;
+		};
+
+		struct Hit
+		{
+			float t;
+			// Index of the triangle in the list given to the constructor
+			uint32_t triangle;
+			// Barycentrics of the second and third vertices, as in DXR
+			float u;
+			float v;
+		};
+
+		// 32 bytes: an interior node has a count of 0, and its children at firstIndex and
+		// firstIndex + 1. A leaf holds count triangles from firstIndex
+		struct Node
+		{
+			Vector3 boundsMin;
+			uint32_t firstIndex;
+			Vector3 boundsMax;
+			uint32_t count;
+		};
+
+		struct Triangle
+		{
+			Vector3 v0;
+			Vector3 v1;
+			Vector3 v2;
+		};
+
+		enum class Builder : uint32_t
+		{
+			// Lowest SAH cost over the planes between bins of centroids
+			kBinnedSah,
+			// Half of the centroids on each side, along the largest axis
+			kObjectMedian,
+			// Middle of the centroid bounds, along the largest axis
+			kSpatialMedian,
+			kCount
+		};
+
+		struct BuildOptions
+		{
+			Builder builder = Builder::kBinnedSah;
+			uint32_t maxLeafSize = 4;
+			// Only used by the binned SAH builder
+			uint32_t binCount = 16;
+		};
+
+		// Relative costs of a node traversal and of a triangle test in the SAH
+		static constexpr float kTraversalCost = 1.0f;
+		static constexpr float kIntersectionCost = 1.0f;
+		// Deeper nodes are made leaves, which bounds the traversal stack
+		static constexpr uint32_t kMaxDepth = 64;
+
+		// Build the hierarchy of the triangles given by 3 consecutive vertices each
+		TriangleBvh(const std::vector<Vector3>& vertices, const BuildOptions& options);
+
+		// Find the closest hit along the ray. Returns false if there is none
+		bool Intersect(const Ray& ray, Hit& hit) const;
+		// Same, counting the work of the traversal
+		template <class Statistics>
+		bool Intersect(const Ray& ray, Hit& hit, Statistics& statistics) const;
+
+		inline const std::vector<Node>& GetNodes() const { return m_nodes; }
+		inline size_t GetTriangleCount() const { return m_triangleIndices.size(); }
+		// Triangles in the order of the leaves, indexed by the firstIndex of the leaf nodes
+		inline const std::vector<Triangle>& GetTriangles() const { return m_triangles; }
+
+		static const char* GetBuilderName(Builder builder);
+
+	private:
+		// Triangles and their original indices, in the order of the leaves
+		std::vector<Triangle> m_triangles;
+		std::vector<uint32_t> m_triangleIndices;
+		std::vector<Node> m_nodes;
+	};
+}
+
+#endif // !TRIANGLE_BVH_GUARD
@@ -0,0 +1,110 @@
+#include "UploadRing.h"
+#include <stdexcept>
+
+namespace RaytracingImplementation
+{
+	namespace
+	{
+		inline uint64_t AlignUp(uint64_t value, uint64_t alignment)
+		{
+			return (value + alignment - 1) & ~(alignment - 1);
+		}
+	}
+
+	UploadRing::UploadRing(uint64_t capacity) :
+		m_capacity(capacity)
+	{
+		if (m_capacity == 0)
+		{
+			throw std::logic_error("The upload ring capacity must not be 0");
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The used bytes go from the tail to the head, possibly wrapping around the end
+	// of the ring. Since tail == head both when the ring is empty and when it is
+	// full, the used size tells both cases apart.
+	//
+	uint64_t UploadRing::Allocate(uint64_t size, uint64_t alignment)
+	{
+		if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+		{
+			throw std::logic_error("The upload ring alignment must be a power of two");
+		}
+		if (size == 0 || size > m_capacity)
+		{
+			return kInvalidOffset;
+		}
+
+		// Nothing in flight, restart from the beginning to get the largest free range
+		if (m_usedSize == 0)
+		{
+			m_head = 0;
+			m_tail = 0;
+		}
+
+		uint64_t offset = AlignUp(m_head, alignment);
+		// Bytes consumed before the allocation, to honor the alignment or to wrap around
+		uint64_t skipped;
+		const bool wrapped = m_head < m_tail || (m_head == m_tail && m_usedSize != 0);
+		if (!wrapped)
+		{
+			// Free space is [head, capacity) followed by [0, tail)
+			if (offset + size <= m_capacity)
+			{
+				skipped = offset - m_head;
+			}
+			else if (size <= m_tail)
+			{
+				// The end of the ring is skipped, offset 0 is always aligned
+				skipped = m_capacity - m_head;
+				offset = 0;
+			}
+			else
+			{
+				return kInvalidOffset;
+			}
+		}
+		else
+		{
+			// Free space is [head, tail)
+			if (offset + size > m_tail)
+			{
+				return kInvalidOffset;
+			}
+			skipped = offset - m_head;
+		}
+
+		m_usedSize += skipped + size;
+		m_openSize += skipped + size;
+		m_head = offset + size == m_capacity ? 0 : offset + size;
+		return offset;
+	}
+
+	void UploadRing::Close(uint64_t fenceValue)
+	{
+		if (!m_submissions.empty() && fenceValue <= m_submissions.back().fenceValue)
+		{
+			throw std::logic_error("Upload ring fence values must be increasing");
+		}
+		if (m_openSize == 0)
+		{
+			return;
+		}
+
+		m_submissions.push_back({ fenceValue, m_head, m_openSize });
+		m_openSize = 0;
+	}
+
+	void UploadRing::Retire(uint64_t completedFenceValue)
+	{
+		while (!m_submissions.empty() && m_submissions.front().fenceValue <= completedFenceValue)
+		{
+			const Submission& submission = m_submissions.front();
+			m_tail = submission.head;
+			m_usedSize -= submission.size;
+			m_submissions.pop_front();
+		}
+	}
+}
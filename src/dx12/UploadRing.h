@@ -0,0 +1,69 @@
+#ifndef UPLOAD_RING_GUARD
+#define UPLOAD_RING_GUARD
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace RaytracingImplementation
+{
+	// Allocator of transient regions in a ring buffer, such as a persistently mapped upload
+	// buffer. Allocations are made at the head of the ring and grouped by submission: Close
+	// tags all the allocations made since the previous call with the fence value signaled
+	// after the submission, and Retire frees the regions of all the submissions whose fence
+	// value has been reached. An allocation which does not fit before the end of the ring
+	// wraps around to its beginning, the skipped bytes being retired along with it.
+	//
+	// The ring only manipulates offsets and fence values, it does not depend on any platform
+	// header and can be driven by a simulated fence.
+	class UploadRing
+	{
+	public:
+		static constexpr uint64_t kInvalidOffset = ~0ull;
+
+		explicit UploadRing(uint64_t capacity);
+
+		UploadRing(const UploadRing&) = delete;
+		UploadRing& operator = (const UploadRing&) = delete;
+
+		// Allocate size bytes at an offset multiple of alignment, which must be a power of
+		// two. Returns kInvalidOffset if the ring has not enough free space left, in which
+		// case older submissions have to be retired first.
+		uint64_t Allocate(uint64_t size, uint64_t alignment);
+
+		// Tag the allocations made since the previous call with the fence value signaled
+		// after their submission. Fence values must be increasing.
+		void Close(uint64_t fenceValue);
+
+		// Free the allocations of all the submissions whose fence value is lower than or
+		// equal to the completed value
+		void Retire(uint64_t completedFenceValue);
+
+		inline uint64_t GetCapacity() const { return m_capacity; }
+		// Bytes in use, including the ones skipped when wrapping around
+		inline uint64_t GetUsedSize() const { return m_usedSize; }
+		// Bytes allocated since the last Close
+		inline uint64_t GetOpenSize() const { return m_openSize; }
+		inline size_t GetPendingSubmissionCount() const { return m_submissions.size(); }
+
+	private:
+		struct Submission
+		{
+			uint64_t fenceValue;
+			// Head of the ring when the submission was closed, i.e. the new tail once retired
+			uint64_t head;
+			uint64_t size;
+		};
+
+		uint64_t m_capacity;
+		uint64_t m_head = 0;
+		uint64_t m_tail = 0;
+		uint64_t m_usedSize = 0;
+		uint64_t m_openSize = 0;
+		std::deque<Submission> m_submissions;
+	};
+}
+
+#endif // !UPLOAD_RING_GUARD
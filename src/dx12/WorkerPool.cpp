@@ -0,0 +1,166 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+namespace RaytracingImplementation
+{
+	thread_local const WorkerPool::RunningLoop* WorkerPool::s_runningLoop = nullptr;
+
+	WorkerPool::RunningLoop::RunningLoop(const WorkerPool* runningPool, const RunningLoop* outerLoop) :
+		pool(runningPool),
+		outer(outerLoop)
+	{
+		s_runningLoop = this;
+	}
+
+	WorkerPool::RunningLoop::~RunningLoop()
+	{
+		s_runningLoop = outer;
+	}
+
+	WorkerPool::WorkerPool(uint32_t threadCount)
+	{
+		m_threads.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+		{
+			m_threads.emplace_back(&WorkerPool::RunWorker, this);
+		}
+	}
+
+	WorkerPool::~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_loopStarted.notify_all();
+		for (std::thread& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	void WorkerPool::Run(size_t taskCount, const std::function<void(size_t)>& task)
+	{
+		if (taskCount == 0)
+		{
+			return;
+		}
+
+		// Called from a task of this pool: m_runMutex is held by the outer loop, whose
+		// completion waits for the calling task
+		if (IsRunningOnThisThread())
+		{
+			std::exception_ptr exception;
+			for (size_t index = 0; index < taskCount; index++)
+			{
+				try
+				{
+					task(index);
+				}
+				catch (...)
+				{
+					exception = exception ? exception : std::current_exception();
+				}
+			}
+			if (exception)
+			{
+				std::rethrow_exception(exception);
+			}
+			return;
+		}
+
+		std::lock_guard<std::mutex> runLock(m_runMutex);
+		RunningLoop runningLoop(this, s_runningLoop);
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_callerLoop = &runningLoop;
+		m_task = &task;
+		m_taskCount = taskCount;
+		m_nextTask = 0;
+		m_completedTaskCount = 0;
+		m_exception = nullptr;
+		m_loop++;
+		m_loopStarted.notify_all();
+
+		RunTasks(lock);
+		m_loopCompleted.wait(lock, [this]() { return m_completedTaskCount == m_taskCount; });
+		m_task = nullptr;
+		m_callerLoop = nullptr;
+
+		if (m_exception)
+		{
+			std::exception_ptr exception = m_exception;
+			m_exception = nullptr;
+			std::rethrow_exception(exception);
+		}
+	}
+
+	WorkerPool& WorkerPool::GetShared()
+	{
+		static WorkerPool pool(std::max<uint32_t>(1, std::thread::hardware_concurrency()) - 1);
+		return pool;
+	}
+
+	bool WorkerPool::IsRunningOnThisThread() const
+	{
+		for (const RunningLoop* loop = s_runningLoop; loop; loop = loop->outer)
+		{
+			if (loop->pool == this)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void WorkerPool::RunWorker()
+	{
+		uint64_t lastLoop = 0;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (;;)
+		{
+			m_loopStarted.wait(lock, [&]() { return m_stopping || (m_loop != lastLoop && m_task != nullptr); });
+			if (m_stopping)
+			{
+				return;
+			}
+			lastLoop = m_loop;
+			RunningLoop runningLoop(this, m_callerLoop);
+			RunTasks(lock);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//
+	// The tasks are claimed one at a time under the lock, the callers giving
+	// few, large tasks. The first exception thrown by a task is rethrown by Run
+	// once the loop has completed
+	//
+	void WorkerPool::RunTasks(std::unique_lock<std::mutex>& lock)
+	{
+		while (m_nextTask < m_taskCount)
+		{
+			const size_t index = m_nextTask++;
+			const std::function<void(size_t)>& task = *m_task;
+			lock.unlock();
+			std::exception_ptr exception;
+			try
+			{
+				task(index);
+			}
+			catch (...)
+			{
+				exception = std::current_exception();
+			}
+			lock.lock();
+
+			if (exception && !m_exception)
+			{
+				m_exception = exception;
+			}
+			if (++m_completedTaskCount == m_taskCount)
+			{
+				m_loopCompleted.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#ifndef WORKER_POOL_GUARD
+#define WORKER_POOL_GUARD
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RaytracingImplementation
+{
+	// Persistent threads running the tasks of a parallel loop. The threads are started once
+	// and sleep between the loops, so that a loop only costs a wake-up instead of the
+	// creation and the join of its threads. The calling thread takes part in the loop, and
+	// Run returns once every task has completed. It does not depend on any platform header.
+	class WorkerPool
+	{
+	public:
+		// Start threadCount threads besides the calling one
+		explicit WorkerPool(uint32_t threadCount);
+		// Stop the threads, which must not be running a loop
+		~WorkerPool();
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator = (const WorkerPool&) = delete;
+
+		// Call task for every index in [0, taskCount), spread over the threads. Loops are run
+		// one at a time: a loop started while another one runs waits for it. A loop started
+		// by a task of the pool, such as a helper using the shared pool called from a task,
+		// runs inline on the thread of that task instead, as waiting would never end. The
+		// first exception thrown by a task is rethrown once all the tasks have completed
+		void Run(size_t taskCount, const std::function<void(size_t)>& task);
+
+		// Threads running the tasks, including the calling one
+		inline uint32_t GetConcurrency() const { return static_cast<uint32_t>(m_threads.size()) + 1; }
+
+		// Pool shared by the whole process, with one thread per hardware thread. Started on
+		// first use
+		static WorkerPool& GetShared();
+
+	private:
+		// Loop a thread takes part in, innermost first, while the object lives. A worker
+		// running the tasks of a loop takes part in the loops of its caller as well, since
+		// they wait for it
+		struct RunningLoop
+		{
+			RunningLoop(const WorkerPool* runningPool, const RunningLoop* outerLoop);
+			~RunningLoop();
+			RunningLoop(const RunningLoop&) = delete;
+			RunningLoop& operator = (const RunningLoop&) = delete;
+
+			const WorkerPool* pool;
+			const RunningLoop* outer;
+		};
+
+		// Whether the calling thread takes part in a loop of this pool
+		bool IsRunningOnThisThread() const;
+		void RunWorker();
+		// Run the tasks of the current loop until none is left
+		void RunTasks(std::unique_lock<std::mutex>& lock);
+
+		std::vector<std::thread> m_threads;
+		// Serializes the loops
+		std::mutex m_runMutex;
+
+		std::mutex m_mutex;
+		std::condition_variable m_loopStarted;
+		std::condition_variable m_loopCompleted;
+		const std::function<void(size_t)>* m_task = nullptr;
+		size_t m_taskCount = 0;
+		size_t m_nextTask = 0;
+		size_t m_completedTaskCount = 0;
+		std::exception_ptr m_exception;
+		// Loops the caller of the current loop takes part in, inherited by the workers
+		const RunningLoop* m_callerLoop = nullptr;
+		// Incremented for every loop, so that a worker never runs the same loop twice
+		uint64_t m_loop = 0;
+		bool m_stopping = false;
+
+		// Innermost loop of each thread
+		static thread_local const RunningLoop* s_runningLoop;
+	};
+}
+
+#endif // !WORKER_POOL_GUARD
@@ -7,8 +7,9 @@
 
 #pragma once
 
+#include <atomic>
 #include <fstream>
-#include <sstream>
+#include <memory>
 #include <string>
 #include <d3d12.h>
 #include "dx12/DXSampleHelper.h"
@@ -19,6 +20,33 @@
 namespace NvHelpers
 {
 
+//--------------------------------------------------------------------------------------------------
+// Optional allocator serving the CreateBuffer calls, e.g. by placing the buffers in larger heaps.
+// CreateBuffer falls back to a committed resource when no allocator is installed, or when it
+// returns nullptr.
+//
+class IBufferAllocator
+{
+public:
+  virtual ~IBufferAllocator() = default;
+  virtual ID3D12Resource* CreateBuffer(ID3D12Device* device, uint64_t size,
+                                       D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initState,
+                                       const D3D12_HEAP_PROPERTIES& heapProps) = 0;
+};
+
+inline IBufferAllocator*& CurrentBufferAllocator()
+{
+  static IBufferAllocator* allocator = nullptr;
+  return allocator;
+}
+
+/// Install the allocator used by CreateBuffer, or nullptr to go back to committed resources. The
+/// allocator must outlive all the buffers it creates.
+inline void SetBufferAllocator(IBufferAllocator* allocator)
+{
+  CurrentBufferAllocator() = allocator;
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 //
@@ -26,6 +54,14 @@ inline ID3D12Resource* CreateBuffer(ID3D12Device* m_device, uint64_t size,
                                     D3D12_RESOURCE_FLAGS flags, D3D12_RESOURCE_STATES initState,
                                     const D3D12_HEAP_PROPERTIES& heapProps)
 {
+  if (IBufferAllocator* allocator = CurrentBufferAllocator())
+  {
+    if (ID3D12Resource* pBuffer = allocator->CreateBuffer(m_device, size, flags, initState, heapProps))
+    {
+      return pBuffer;
+    }
+  }
+
   D3D12_RESOURCE_DESC bufDesc = {};
   bufDesc.Alignment = 0;
   bufDesc.DepthOrArraySize = 1;
@@ -60,42 +96,131 @@ static const D3D12_HEAP_PROPERTIES kDefaultHeapProps = {
     D3D12_HEAP_TYPE_DEFAULT, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 0, 0};
 
 //--------------------------------------------------------------------------------------------------
-// Compile a HLSL file into a DXIL library
+// DXC compiler instances, created on first use. The DXC objects are not thread-safe, so each
+// thread compiling shaders gets its own instances, released when the thread exits
 //
-inline IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
+struct ShaderCompiler
 {
-  static IDxcCompiler* pCompiler = nullptr;
-  static IDxcLibrary* pLibrary = nullptr;
-  static IDxcIncludeHandler* dxcIncludeHandler;
+  ShaderCompiler() = default;
+  ShaderCompiler(const ShaderCompiler&) = delete;
+  ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+  ~ShaderCompiler()
+  {
+    if (includeHandler)
+      includeHandler->Release();
+    if (library)
+      library->Release();
+    if (compiler)
+      compiler->Release();
+  }
 
-  HRESULT hr;
+  IDxcCompiler* compiler = nullptr;
+  IDxcLibrary* library = nullptr;
+  IDxcIncludeHandler* includeHandler = nullptr;
+};
+
+inline ShaderCompiler& GetShaderCompiler()
+{
+  thread_local ShaderCompiler instance;
 
   // Initialize the DXC compiler and compiler helper
-  if (!pCompiler)
+  if (!instance.compiler)
   {
-    ThrowIfFailed(DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler), (void **)&pCompiler));
-    ThrowIfFailed(DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), (void **)&pLibrary));
-    ThrowIfFailed(pLibrary->CreateIncludeHandler(&dxcIncludeHandler));
+    ThrowIfFailed(DxcCreateInstance(CLSID_DxcCompiler, __uuidof(IDxcCompiler),
+                                    (void**)&instance.compiler));
+    ThrowIfFailed(
+        DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), (void**)&instance.library));
+    ThrowIfFailed(instance.library->CreateIncludeHandler(&instance.includeHandler));
   }
-  // Open and read the file
-  std::ifstream shaderFile(fileName);
+  return instance;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Version of the DXC compiler, as the file version of dxcompiler.dll with the major and minor
+// numbers in the upper 32 bits, or the version reported by the compiler if the file cannot be
+// found. Used to invalidate compiled code when the compiler changes. Reading the file version
+// neither loads the delay-loaded DLL nor creates a compiler, so that the shaders served by the
+// cache never do
+//
+inline uint64_t GetShaderCompilerVersion()
+{
+  // Queried once per process, by the first thread asking for it
+  static const uint64_t version = []() {
+    // The DLL loaded, or the one the delay-load would find
+    wchar_t path[MAX_PATH] = {};
+    HMODULE module = GetModuleHandleW(L"dxcompiler.dll");
+    const bool found = module ? GetModuleFileNameW(module, path, MAX_PATH) != 0
+                              : SearchPathW(nullptr, L"dxcompiler.dll", nullptr, MAX_PATH, path,
+                                            nullptr) != 0;
+    const DWORD infoSize = found ? GetFileVersionInfoSizeW(path, nullptr) : 0;
+    if (infoSize != 0)
+    {
+      std::vector<uint8_t> info(infoSize);
+      VS_FIXEDFILEINFO* fileInfo = nullptr;
+      UINT fileInfoSize = 0;
+      if (GetFileVersionInfoW(path, 0, infoSize, info.data()) &&
+          VerQueryValueW(info.data(), L"\\", reinterpret_cast<void**>(&fileInfo), &fileInfoSize) &&
+          fileInfoSize >= sizeof(VS_FIXEDFILEINFO))
+      {
+        return (static_cast<uint64_t>(fileInfo->dwFileVersionMS) << 32) | fileInfo->dwFileVersionLS;
+      }
+    }
+
+    uint64_t result = 0;
+    IDxcVersionInfo* pVersionInfo = nullptr;
+    if (SUCCEEDED(GetShaderCompiler().compiler->QueryInterface(__uuidof(IDxcVersionInfo),
+                                                                (void**)&pVersionInfo)))
+    {
+      UINT32 major = 0;
+      UINT32 minor = 0;
+      if (SUCCEEDED(pVersionInfo->GetVersion(&major, &minor)))
+      {
+        result = (static_cast<uint64_t>(major) << 32) | minor;
+      }
+      pVersionInfo->Release();
+    }
+    return result;
+  }();
+  return version;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Read a whole shader file
+//
+inline std::string ReadShaderFile(LPCWSTR fileName)
+{
+  std::ifstream shaderFile(fileName, std::ios::binary | std::ios::ate);
   if (shaderFile.good() == false)
   {
     throw std::logic_error("Cannot find shader file");
   }
-  std::stringstream strStream;
-  strStream << shaderFile.rdbuf();
-  std::string sShader = strStream.str();
+  std::string sShader(static_cast<size_t>(shaderFile.tellg()), '\0');
+  shaderFile.seekg(0);
+  shaderFile.read(&sShader[0], sShader.size());
+  return sShader;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compile the HLSL source of a file into a DXIL library. The file name is used to resolve the
+// includes and in the error messages. The compiler messages are returned in pErrors when given,
+// as any caller off the main thread must do, e.g. the compile service workers or the archive
+// builder, and are shown in a message box otherwise
+//
+inline IDxcBlob* CompileShaderLibrary(LPCWSTR fileName, const std::string& sShader,
+                                      std::string* pErrors = nullptr)
+{
+  ShaderCompiler& dxc = GetShaderCompiler();
+  HRESULT hr;
 
   // Create blob from the string
   IDxcBlobEncoding* pTextBlob;
-  ThrowIfFailed(pLibrary->CreateBlobWithEncodingFromPinned(
+  ThrowIfFailed(dxc.library->CreateBlobWithEncodingFromPinned(
       (LPBYTE)sShader.c_str(), (uint32_t)sShader.size(), 0, &pTextBlob));
 
   // Compile
   IDxcOperationResult* pResult;
-  ThrowIfFailed(pCompiler->Compile(pTextBlob, fileName, L"", L"lib_6_3", nullptr, 0, nullptr, 0,
-                                   dxcIncludeHandler, &pResult));
+  ThrowIfFailed(dxc.compiler->Compile(pTextBlob, fileName, L"", L"lib_6_3", nullptr, 0, nullptr,
+                                      0, dxc.includeHandler, &pResult));
 
   // Verify the result
   HRESULT resultCode;
@@ -117,7 +242,14 @@ inline IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
     std::string errorMsg = "Shader Compiler Error:\n";
     errorMsg.append(infoLog.data());
 
-    MessageBoxA(nullptr, errorMsg.c_str(), "Error!", MB_OK);
+    if (pErrors)
+    {
+      *pErrors = errorMsg;
+    }
+    else
+    {
+      MessageBoxA(nullptr, errorMsg.c_str(), "Error!", MB_OK);
+    }
     throw std::logic_error("Failed compile shader");
   }
 
@@ -126,6 +258,65 @@ inline IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
   return pBlob;
 }
 
+//--------------------------------------------------------------------------------------------------
+// Compile a HLSL file into a DXIL library
+//
+inline IDxcBlob* CompileShaderLibrary(LPCWSTR fileName)
+{
+  return CompileShaderLibrary(fileName, ReadShaderFile(fileName));
+}
+
+//--------------------------------------------------------------------------------------------------
+// Blob exposing memory it does not own, such as a memory-mapped file. The owner of the memory is
+// kept alive as long as the blob is referenced. The blob implements either IDxcBlob or ID3DBlob,
+// which share the same layout
+//
+template <class Interface = IDxcBlob>
+class SharedMemoryBlob : public Interface
+{
+public:
+  SharedMemoryBlob(std::shared_ptr<const void> owner, const void* data, size_t size)
+      : m_owner(std::move(owner)), m_data(data), m_size(size)
+  {
+  }
+  virtual ~SharedMemoryBlob() = default;
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+  {
+    if (!ppvObject)
+    {
+      return E_POINTER;
+    }
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(Interface))
+    {
+      *ppvObject = static_cast<Interface*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = nullptr;
+    return E_NOINTERFACE;
+  }
+  ULONG STDMETHODCALLTYPE AddRef() override { return ++m_refCount; }
+  ULONG STDMETHODCALLTYPE Release() override
+  {
+    const ULONG refCount = --m_refCount;
+    if (refCount == 0)
+    {
+      delete this;
+    }
+    return refCount;
+  }
+
+  LPVOID STDMETHODCALLTYPE GetBufferPointer() override { return const_cast<void*>(m_data); }
+  SIZE_T STDMETHODCALLTYPE GetBufferSize() override { return m_size; }
+
+private:
+  std::atomic<ULONG> m_refCount{1};
+  std::shared_ptr<const void> m_owner;
+  const void* m_data;
+  size_t m_size;
+};
+
 //--------------------------------------------------------------------------------------------------
 //
 //
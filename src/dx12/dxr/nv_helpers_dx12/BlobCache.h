@@ -0,0 +1,117 @@
+/*
+The BlobCache shares the objects created from a serialized description, such as root signatures:
+two identical blobs resolve to a single object, created once by the factory given on the first
+lookup. The blobs are keyed by their hash and compared on lookup, so that colliding hashes never
+share an object. The cache does not depend on any D3D12 header, the Handle being whatever keeps the
+object alive, e.g. a ComPtr. The cache can be used from several threads at once.
+
+Example:
+
+BlobCache<ComPtr<ID3D12RootSignature>> cache;
+ComPtr<ID3D12RootSignature> signature = cache.GetOrCreate(blob, size, [&](const void* data, size_t size) {
+  ComPtr<ID3D12RootSignature> created;
+  device->CreateRootSignature(0, data, size, IID_PPV_ARGS(&created));
+  return created;
+});
+*/
+
+#ifndef BLOB_CACHE_GUARD
+#define BLOB_CACHE_GUARD
+
+#pragma once
+
+#include "dx12/Hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace NvHelpers
+{
+
+/// Cache of objects, keyed by a hash of the blob they are created from
+template <class Handle>
+class BlobCache
+{
+public:
+  using Factory = std::function<Handle(const void* blob, size_t size)>;
+
+  BlobCache() = default;
+  BlobCache(const BlobCache&) = delete;
+  BlobCache& operator=(const BlobCache&) = delete;
+
+  /// Return the object created from the blob, calling create on first use. The lock is held while
+  /// the object is created, so that two threads asking for the same blob never create it twice
+  Handle GetOrCreate(const void* blob, size_t size, const Factory& create)
+  {
+    const uint64_t key = RaytracingImplementation::HashBytes(blob, size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto range = m_entries.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      const Entry& entry = it->second;
+      if (entry.blob.size() == size && (size == 0 || memcmp(entry.blob.data(), blob, size) == 0))
+      {
+        m_hits++;
+        return entry.handle;
+      }
+    }
+
+    m_misses++;
+    Entry entry;
+    const uint8_t* bytes = static_cast<const uint8_t*>(blob);
+    entry.blob.assign(bytes, bytes + size);
+    entry.handle = create(blob, size);
+    Handle handle = entry.handle;
+    m_entries.emplace(key, std::move(entry));
+    return handle;
+  }
+
+  /// Drop the references of the cache. The objects still referenced elsewhere stay valid
+  void Clear()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.clear();
+  }
+
+  /// Statistics
+  size_t GetUniqueCount() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+
+  uint64_t GetHitCount() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_hits;
+  }
+
+  uint64_t GetMissCount() const
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_misses;
+  }
+
+private:
+  struct Entry
+  {
+    /// Serialized blob, compared on lookup so that colliding hashes never share an object
+    std::vector<uint8_t> blob;
+    Handle handle;
+  };
+
+  std::unordered_multimap<uint64_t, Entry> m_entries;
+  uint64_t m_hits = 0;
+  uint64_t m_misses = 0;
+  mutable std::mutex m_mutex;
+};
+
+} // namespace NvHelpers
+#endif
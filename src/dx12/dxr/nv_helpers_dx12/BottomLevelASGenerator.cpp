@@ -30,6 +30,7 @@ Contacts for feedback:
 */
 
 #include "BottomLevelASGenerator.h"
+#include "dx12/Profiler.h"
 
 // Helper to compute aligned buffer sizes
 #ifndef ROUND_UP
@@ -187,6 +188,40 @@ void BottomLevelASGenerator::Generate(
                                    // structure, used if an iterative update
                                    // is requested
 ) {
+  GenerateUnsynchronized(commandList, scratchBuffer->GetGPUVirtualAddress(),
+                         resultBuffer, updateOnly, previousResult);
+
+  // Wait for the builder to complete by setting a barrier on the resulting
+  // buffer. This is particularly important as the construction of the top-level
+  // hierarchy may be called right afterwards, before executing the command
+  // list.
+  D3D12_RESOURCE_BARRIER uavBarrier;
+  uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+  uavBarrier.UAV.pResource = resultBuffer;
+  uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+  commandList->ResourceBarrier(1, &uavBarrier);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same as Generate, but the scratch space is given as a GPU address, typically
+// a region of a larger scratch buffer shared by several builds, and no barrier
+// is inserted after the build. The caller is then responsible for the UAV
+// barriers on the result and scratch memory, which allows several independent
+// builds to overlap on the GPU.
+void BottomLevelASGenerator::GenerateUnsynchronized(
+    ID3D12GraphicsCommandList4
+        *commandList, // Command list on which the build will be enqueued
+    D3D12_GPU_VIRTUAL_ADDRESS scratchAddress, // Start of the scratch region,
+                                              // 256-byte aligned
+    ID3D12Resource
+        *resultBuffer, // Result buffer storing the acceleration structure
+    bool updateOnly,   // If true, simply refit the existing
+                       // acceleration structure
+    ID3D12Resource *previousResult // Optional previous acceleration
+                                   // structure, used if an iterative update
+                                   // is requested
+) {
+  PROFILE_ZONE("BottomLevelASGenerator::Generate");
 
   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags = m_flags;
   // The stored flags represent whether the AS has been built for updates or
@@ -224,23 +259,12 @@ void BottomLevelASGenerator::Generate(
   buildDesc.Inputs.pGeometryDescs = m_vertexBuffers.data();
   buildDesc.DestAccelerationStructureData = {
       resultBuffer->GetGPUVirtualAddress()};
-  buildDesc.ScratchAccelerationStructureData = {
-      scratchBuffer->GetGPUVirtualAddress()};
+  buildDesc.ScratchAccelerationStructureData = {scratchAddress};
   buildDesc.SourceAccelerationStructureData =
       previousResult ? previousResult->GetGPUVirtualAddress() : 0;
   buildDesc.Inputs.Flags = flags;
 
   // Build the AS
   commandList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
-
-  // Wait for the builder to complete by setting a barrier on the resulting
-  // buffer. This is particularly important as the construction of the top-level
-  // hierarchy may be called right afterwards, before executing the command
-  // list.
-  D3D12_RESOURCE_BARRIER uavBarrier;
-  uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-  uavBarrier.UAV.pResource = resultBuffer;
-  uavBarrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
-  commandList->ResourceBarrier(1, &uavBarrier);
 }
 } // namespace NvHelpers
@@ -157,6 +157,21 @@ public:
                                                /// if an iterative update is requested
   );
 
+  /// Same as Generate, but the scratch space is given as a GPU address, typically a region of a
+  /// larger scratch buffer shared by several builds, and no barrier is inserted after the build.
+  /// The caller is then responsible for the UAV barriers on the result and scratch memory, which
+  /// allows several independent builds to overlap on the GPU.
+  void GenerateUnsynchronized(
+      ID3D12GraphicsCommandList4* commandList, /// Command list on which the build will be enqueued
+      D3D12_GPU_VIRTUAL_ADDRESS scratchAddress, /// Start of the scratch region, 256-byte aligned,
+                                                /// of at least the size returned by
+                                                /// ComputeASBufferSizes
+      ID3D12Resource* resultBuffer,  /// Result buffer storing the acceleration structure
+      bool updateOnly = false,       /// If true, simply refit the existing acceleration structure
+      ID3D12Resource* previousResult = nullptr /// Optional previous acceleration structure, used
+                                               /// if an iterative update is requested
+  );
+
 private:
   /// Vertex buffer descriptors used to generate the AS
   std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> m_vertexBuffers = {};
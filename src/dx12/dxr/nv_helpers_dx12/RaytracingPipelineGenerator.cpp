@@ -40,9 +40,9 @@ compiling in debug mode.
 */
 
 #include "RaytracingPipelineGenerator.h"
+#include "dx12/Profiler.h"
 
 #include "dxcapi.h"
-#include <unordered_set>
 #include <stdexcept>
 
 namespace NvHelpers
@@ -52,7 +52,18 @@ namespace NvHelpers
 // The pipeline helper requires access to the device, as well as the
 // raytracing device prior to Windows 10 RS5.
 RayTracingPipelineGenerator::RayTracingPipelineGenerator(ID3D12Device5* device)
-    : m_device(device)
+    : m_ownedSymbols(std::make_unique<ShaderSymbolTable>()), m_symbols(m_ownedSymbols.get()),
+      m_device(device)
+{
+  CreateDummyRootSignatures();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Same as above, interning the shader names in a table shared with other generators
+RayTracingPipelineGenerator::RayTracingPipelineGenerator(ID3D12Device5* device,
+                                                         ShaderSymbolTable& symbols,
+                                                         RootSignatureCache* rootSignatures)
+    : m_symbols(&symbols), m_device(device), m_rootSignatures(rootSignatures)
 {
   // The pipeline creation requires having at least one empty global and local root signatures, so
   // we systematically create both, as this does not incur any overhead
@@ -67,7 +78,13 @@ RayTracingPipelineGenerator::RayTracingPipelineGenerator(ID3D12Device5* device)
 void RayTracingPipelineGenerator::AddLibrary(IDxcBlob* dxilLibrary,
                                              const std::vector<std::wstring>& symbolExports)
 {
-  m_libraries.emplace_back(Library(dxilLibrary, symbolExports));
+  AddLibrary(dxilLibrary, InternSymbols(symbolExports));
+}
+
+void RayTracingPipelineGenerator::AddLibrary(IDxcBlob* dxilLibrary,
+                                             const std::vector<ShaderSymbol>& symbolExports)
+{
+  m_libraries.push_back({dxilLibrary, symbolExports});
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -85,8 +102,16 @@ void RayTracingPipelineGenerator::AddHitGroup(const std::wstring& hitGroupName,
                                               const std::wstring& anyHitSymbol /*= L""*/,
                                               const std::wstring& intersectionSymbol /*= L""*/)
 {
-  m_hitGroups.emplace_back(
-      HitGroup(hitGroupName, closestHitSymbol, anyHitSymbol, intersectionSymbol));
+  AddHitGroup(m_symbols->Intern(hitGroupName), m_symbols->Intern(closestHitSymbol),
+              m_symbols->Intern(anyHitSymbol), m_symbols->Intern(intersectionSymbol));
+}
+
+void RayTracingPipelineGenerator::AddHitGroup(ShaderSymbol hitGroupName,
+                                              ShaderSymbol closestHitSymbol,
+                                              ShaderSymbol anyHitSymbol /*= kNullShaderSymbol*/,
+                                              ShaderSymbol intersectionSymbol /*= kNullShaderSymbol*/)
+{
+  m_hitGroups.push_back({hitGroupName, closestHitSymbol, anyHitSymbol, intersectionSymbol});
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -97,7 +122,28 @@ void RayTracingPipelineGenerator::AddHitGroup(const std::wstring& hitGroupName,
 void RayTracingPipelineGenerator::AddRootSignatureAssociation(
     ID3D12RootSignature* rootSignature, const std::vector<std::wstring>& symbols)
 {
-  m_rootSignatureAssociations.emplace_back(RootSignatureAssociation(rootSignature, symbols));
+  AddRootSignatureAssociation(rootSignature, InternSymbols(symbols));
+}
+
+void RayTracingPipelineGenerator::AddRootSignatureAssociation(
+    ID3D12RootSignature* rootSignature, const std::vector<ShaderSymbol>& symbols)
+{
+  m_rootSignatureAssociations.push_back({rootSignature, symbols});
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Intern a list of names
+std::vector<ShaderSymbol> RayTracingPipelineGenerator::InternSymbols(
+    const std::vector<std::wstring>& names)
+{
+  std::vector<ShaderSymbol> symbols;
+  symbols.reserve(names.size());
+  for (const auto& name : names)
+  {
+    symbols.push_back(m_symbols->Intern(name));
+  }
+  return symbols;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -137,6 +183,7 @@ void RayTracingPipelineGenerator::SetMaxRecursionDepth(UINT maxDepth)
 // Compiles the raytracing state object
 ID3D12StateObject* RayTracingPipelineGenerator::Generate()
 {
+  PROFILE_ZONE("RayTracingPipelineGenerator::Generate");
   // The pipeline is made of a set of sub-objects, representing the DXIL libraries, hit group
   // declarations, root signature associations, plus some configuration objects
   UINT64 subobjectCount =
@@ -155,22 +202,53 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
 
   UINT currentIndex = 0;
 
-  // Add all the DXIL libraries
-  for (const Library& lib : m_libraries)
+  // The descriptors reference the names stored in the symbol table, which stay valid until the
+  // state object is created. As for the subobjects, all the storage is allocated upfront since
+  // the descriptors point to each other
+  std::vector<std::vector<D3D12_EXPORT_DESC>> libExports(m_libraries.size());
+  std::vector<D3D12_DXIL_LIBRARY_DESC> libDescs(m_libraries.size());
+  std::vector<D3D12_HIT_GROUP_DESC> hitGroupDescs(m_hitGroups.size());
+
+  // Add all the DXIL libraries, with one export descriptor per symbol
+  for (size_t i = 0; i < m_libraries.size(); i++)
   {
+    const Library& lib = m_libraries[i];
+    libExports[i].resize(lib.m_exportedSymbols.size());
+    for (size_t j = 0; j < lib.m_exportedSymbols.size(); j++)
+    {
+      libExports[i][j] = {};
+      libExports[i][j].Name = m_symbols->GetName(lib.m_exportedSymbols[j]);
+      libExports[i][j].ExportToRename = nullptr;
+      libExports[i][j].Flags = D3D12_EXPORT_FLAG_NONE;
+    }
+
+    // Create a library descriptor combining the DXIL code and the export names
+    libDescs[i].DXILLibrary.BytecodeLength = lib.m_dxil->GetBufferSize();
+    libDescs[i].DXILLibrary.pShaderBytecode = lib.m_dxil->GetBufferPointer();
+    libDescs[i].NumExports = static_cast<UINT>(libExports[i].size());
+    libDescs[i].pExports = libExports[i].data();
+
     D3D12_STATE_SUBOBJECT libSubobject = {};
     libSubobject.Type = D3D12_STATE_SUBOBJECT_TYPE_DXIL_LIBRARY;
-    libSubobject.pDesc = &lib.m_libDesc;
+    libSubobject.pDesc = &libDescs[i];
 
     subobjects[currentIndex++] = libSubobject;
   }
 
-  // Add all the hit group declarations
-  for (const HitGroup& group : m_hitGroups)
+  // Add all the hit group declarations. Unused shaders have a null symbol, whose name is nullptr
+  // as expected by D3D12 for the default behavior
+  for (size_t i = 0; i < m_hitGroups.size(); i++)
   {
+    const HitGroup& group = m_hitGroups[i];
+    hitGroupDescs[i] = {};
+    hitGroupDescs[i].HitGroupExport = m_symbols->GetName(group.m_hitGroupName);
+    hitGroupDescs[i].ClosestHitShaderImport = m_symbols->GetName(group.m_closestHitSymbol);
+    hitGroupDescs[i].AnyHitShaderImport = m_symbols->GetName(group.m_anyHitSymbol);
+    hitGroupDescs[i].IntersectionShaderImport = m_symbols->GetName(group.m_intersectionSymbol);
+
     D3D12_STATE_SUBOBJECT hitGroup = {};
     hitGroup.Type = D3D12_STATE_SUBOBJECT_TYPE_HIT_GROUP;
-    hitGroup.pDesc = &group.m_desc;
+    hitGroup.pDesc = &hitGroupDescs[i];
 
     subobjects[currentIndex++] = hitGroup;
   }
@@ -188,15 +266,15 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
 
   // Build a list of all the symbols for ray generation, miss and hit groups
   // Those shaders have to be associated with the payload definition
-  std::vector<std::wstring> exportedSymbols = {};
+  std::vector<ShaderSymbol> exportedSymbols = {};
   std::vector<LPCWSTR> exportedSymbolPointers = {};
   BuildShaderExportList(exportedSymbols);
 
   // Build an array of the string pointers
   exportedSymbolPointers.reserve(exportedSymbols.size());
-  for (const auto& name : exportedSymbols)
+  for (ShaderSymbol symbol : exportedSymbols)
   {
-    exportedSymbolPointers.push_back(name.c_str());
+    exportedSymbolPointers.push_back(m_symbols->GetName(symbol));
   }
   const WCHAR** shaderExports = exportedSymbolPointers.data();
 
@@ -216,8 +294,12 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
 
   // The root signature association requires two objects for each: one to declare the root
   // signature, and another to associate that root signature to a set of symbols
-  for (RootSignatureAssociation& assoc : m_rootSignatureAssociations)
+  std::vector<std::vector<LPCWSTR>> associationSymbols(m_rootSignatureAssociations.size());
+  std::vector<D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION> associations(
+      m_rootSignatureAssociations.size());
+  for (size_t i = 0; i < m_rootSignatureAssociations.size(); i++)
   {
+    const RootSignatureAssociation& assoc = m_rootSignatureAssociations[i];
 
     // Add a subobject to declare the root signature
     D3D12_STATE_SUBOBJECT rootSigObject = {};
@@ -228,13 +310,19 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
 
     // Add a subobject for the association between the exported shader symbols and the root
     // signature
-    assoc.m_association.NumExports = static_cast<UINT>(assoc.m_symbolPointers.size());
-    assoc.m_association.pExports = assoc.m_symbolPointers.data();
-    assoc.m_association.pSubobjectToAssociate = &subobjects[(currentIndex - 1)];
+    associationSymbols[i].reserve(assoc.m_symbols.size());
+    for (ShaderSymbol symbol : assoc.m_symbols)
+    {
+      associationSymbols[i].push_back(m_symbols->GetName(symbol));
+    }
+    associations[i] = {};
+    associations[i].NumExports = static_cast<UINT>(associationSymbols[i].size());
+    associations[i].pExports = associationSymbols[i].data();
+    associations[i].pSubobjectToAssociate = &subobjects[(currentIndex - 1)];
 
     D3D12_STATE_SUBOBJECT rootSigAssociationObject = {};
     rootSigAssociationObject.Type = D3D12_STATE_SUBOBJECT_TYPE_SUBOBJECT_TO_EXPORTS_ASSOCIATION;
-    rootSigAssociationObject.pDesc = &assoc.m_association;
+    rootSigAssociationObject.pDesc = &associations[i];
 
     subobjects[currentIndex++] = rootSigAssociationObject;
   }
@@ -242,7 +330,7 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
   // The pipeline construction always requires an empty global root signature
   D3D12_STATE_SUBOBJECT globalRootSig;
   globalRootSig.Type = D3D12_STATE_SUBOBJECT_TYPE_GLOBAL_ROOT_SIGNATURE;
-  ID3D12RootSignature* dgSig = m_dummyGlobalRootSignature;
+  ID3D12RootSignature* dgSig = m_dummyGlobalRootSignature.Get();
   globalRootSig.pDesc = &dgSig;
 
   subobjects[currentIndex++] = globalRootSig;
@@ -250,7 +338,7 @@ ID3D12StateObject* RayTracingPipelineGenerator::Generate()
   // The pipeline construction always requires an empty local root signature
   D3D12_STATE_SUBOBJECT dummyLocalRootSig;
   dummyLocalRootSig.Type = D3D12_STATE_SUBOBJECT_TYPE_LOCAL_ROOT_SIGNATURE;
-  ID3D12RootSignature* dlSig = m_dummyLocalRootSignature;
+  ID3D12RootSignature* dlSig = m_dummyLocalRootSignature.Get();
   dummyLocalRootSig.pDesc = &dlSig;
   subobjects[currentIndex++] = dummyLocalRootSig;
 
@@ -294,108 +382,77 @@ void RayTracingPipelineGenerator::CreateDummyRootSignatures()
   // A global root signature is the default, hence this flag
   rootDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
 
-  HRESULT hr = 0;
-
-  ID3DBlob* serializedRootSignature;
-  ID3DBlob* error;
-
-  // Create the empty global root signature
-  hr = D3D12SerializeRootSignature(&rootDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-                                   &serializedRootSignature, &error);
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Could not serialize the global root signature");
-  }
-  hr = m_device->CreateRootSignature(0, serializedRootSignature->GetBufferPointer(),
-                                     serializedRootSignature->GetBufferSize(),
-                                     IID_PPV_ARGS(&m_dummyGlobalRootSignature));
-
-  serializedRootSignature->Release();
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Could not create the global root signature");
-  }
+  // Create the empty global root signature. With a cache, all the generators share the same one
+  m_dummyGlobalRootSignature.Attach(CreateRootSignature(m_device, rootDesc, m_rootSignatures));
 
   // Create the local root signature, reusing the same descriptor but altering the creation flag
   rootDesc.Flags = D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE;
-  hr = D3D12SerializeRootSignature(&rootDesc, D3D_ROOT_SIGNATURE_VERSION_1,
-                                   &serializedRootSignature, &error);
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Could not serialize the local root signature");
-  }
-  hr = m_device->CreateRootSignature(0, serializedRootSignature->GetBufferPointer(),
-                                     serializedRootSignature->GetBufferSize(),
-                                     IID_PPV_ARGS(&m_dummyLocalRootSignature));
-
-  serializedRootSignature->Release();
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Could not create the local root signature");
-  }
+  m_dummyLocalRootSignature.Attach(CreateRootSignature(m_device, rootDesc, m_rootSignatures));
 }
 
 //--------------------------------------------------------------------------------------------------
 //
 // Build a list containing the export symbols for the ray generation shaders, miss shaders, and
-// hit group names
-void RayTracingPipelineGenerator::BuildShaderExportList(std::vector<std::wstring>& exportedSymbols)
+// hit group names. Symbols are dense indices, so the sets are plain flag arrays
+void RayTracingPipelineGenerator::BuildShaderExportList(std::vector<ShaderSymbol>& exportedSymbols)
 {
   // Get all names from libraries
   // Get names associated to hit groups
   // Return list of libraries+hit group names - shaders in hit groups
 
-  std::unordered_set<std::wstring> exports;
+  std::vector<bool> exports(m_symbols->GetSize(), false);
+  // Candidate symbols, in order of first appearance
+  std::vector<ShaderSymbol> candidates;
 
   // Add all the symbols exported by the libraries
   for (const Library& lib : m_libraries)
   {
-    for (const auto& exportName : lib.m_exportedSymbols)
+    for (ShaderSymbol exportName : lib.m_exportedSymbols)
     {
 #ifdef _DEBUG
       // Sanity check in debug mode: check that no name is exported more than once
-      if (exports.find(exportName) != exports.end())
+      if (exports[exportName])
       {
         throw std::logic_error("Multiple definition of a symbol in the imported DXIL libraries");
       }
 #endif
-      exports.insert(exportName);
+      exports[exportName] = true;
+      candidates.push_back(exportName);
     }
   }
 
 #ifdef _DEBUG
   // Sanity check in debug mode: verify that the hit groups do not reference an unknown shader name
-  std::unordered_set<std::wstring> all_exports = exports;
+  std::vector<bool> all_exports = exports;
 
   for (const auto& hitGroup : m_hitGroups)
   {
-    if (!hitGroup.m_anyHitSymbol.empty() && exports.find(hitGroup.m_anyHitSymbol) == exports.end())
+    if (hitGroup.m_anyHitSymbol != kNullShaderSymbol && !exports[hitGroup.m_anyHitSymbol])
     {
       throw std::logic_error("Any hit symbol not found in the imported DXIL libraries");
     }
 
-    if (!hitGroup.m_closestHitSymbol.empty() &&
-        exports.find(hitGroup.m_closestHitSymbol) == exports.end())
+    if (hitGroup.m_closestHitSymbol != kNullShaderSymbol && !exports[hitGroup.m_closestHitSymbol])
     {
       throw std::logic_error("Closest hit symbol not found in the imported DXIL libraries");
     }
 
-    if (!hitGroup.m_intersectionSymbol.empty() &&
-        exports.find(hitGroup.m_intersectionSymbol) == exports.end())
+    if (hitGroup.m_intersectionSymbol != kNullShaderSymbol &&
+        !exports[hitGroup.m_intersectionSymbol])
     {
       throw std::logic_error("Intersection symbol not found in the imported DXIL libraries");
     }
 
-    all_exports.insert(hitGroup.m_hitGroupName);
+    all_exports[hitGroup.m_hitGroupName] = true;
   }
 
   // Sanity check in debug mode: verify that the root signature associations do not reference an
   // unknown shader or hit group name
   for (const auto& assoc : m_rootSignatureAssociations)
   {
-    for (const auto& symb : assoc.m_symbols)
+    for (ShaderSymbol symb : assoc.m_symbols)
     {
-      if (!symb.empty() && all_exports.find(symb) == all_exports.end())
+      if (symb != kNullShaderSymbol && !all_exports[symb])
       {
         throw std::logic_error("Root association symbol not found in the "
                                "imported DXIL libraries and hit group names");
@@ -408,116 +465,25 @@ void RayTracingPipelineGenerator::BuildShaderExportList(std::vector<std::wstring
   // closest hit shaders from the symbol set
   for (const auto& hitGroup : m_hitGroups)
   {
-    if (!hitGroup.m_anyHitSymbol.empty())
-    {
-      exports.erase(hitGroup.m_anyHitSymbol);
-    }
-    if (!hitGroup.m_closestHitSymbol.empty())
-    {
-      exports.erase(hitGroup.m_closestHitSymbol);
-    }
-    if (!hitGroup.m_intersectionSymbol.empty())
-    {
-      exports.erase(hitGroup.m_intersectionSymbol);
-    }
-    exports.insert(hitGroup.m_hitGroupName);
+    exports[hitGroup.m_anyHitSymbol] = false;
+    exports[hitGroup.m_closestHitSymbol] = false;
+    exports[hitGroup.m_intersectionSymbol] = false;
   }
-
-  // Finally build a vector containing ray generation and miss shaders, plus the hit group names
-  for (const auto& name : exports)
+  for (const auto& hitGroup : m_hitGroups)
   {
-    exportedSymbols.push_back(name);
+    exports[hitGroup.m_hitGroupName] = true;
+    candidates.push_back(hitGroup.m_hitGroupName);
   }
-}
 
-//--------------------------------------------------------------------------------------------------
-//
-// Store data related to a DXIL library: the library itself, the exported symbols, and the
-// associated descriptors
-RayTracingPipelineGenerator::Library::Library(IDxcBlob* dxil,
-                                              const std::vector<std::wstring>& exportedSymbols)
-    : m_dxil(dxil), m_exportedSymbols(exportedSymbols), m_exports(exportedSymbols.size())
-{
-  // Create one export descriptor per symbol
-  for (size_t i = 0; i < m_exportedSymbols.size(); i++)
+  // Finally build a vector containing ray generation and miss shaders, plus the hit group names,
+  // each of them once
+  for (ShaderSymbol symbol : candidates)
   {
-    m_exports[i] = {};
-    m_exports[i].Name = m_exportedSymbols[i].c_str();
-    m_exports[i].ExportToRename = nullptr;
-    m_exports[i].Flags = D3D12_EXPORT_FLAG_NONE;
-  }
-
-  // Create a library descriptor combining the DXIL code and the export names
-  m_libDesc.DXILLibrary.BytecodeLength = dxil->GetBufferSize();
-  m_libDesc.DXILLibrary.pShaderBytecode = dxil->GetBufferPointer();
-  m_libDesc.NumExports = static_cast<UINT>(m_exportedSymbols.size());
-  m_libDesc.pExports = m_exports.data();
-}
-
-//--------------------------------------------------------------------------------------------------
-//
-// This copy constructor has to be defined so that the export descriptors are set correctly. Using
-// the default constructor would copy the string pointers of the symbols into the descriptors, which
-// would cause issues when the original Library object gets out of scope
-RayTracingPipelineGenerator::Library::Library(const Library& source)
-    : Library(source.m_dxil, source.m_exportedSymbols)
-{
-}
-
-//--------------------------------------------------------------------------------------------------
-//
-// Create a hit group descriptor from the input hit group name and shader symbols
-RayTracingPipelineGenerator::HitGroup::HitGroup(std::wstring hitGroupName,
-                                                std::wstring closestHitSymbol,
-                                                std::wstring anyHitSymbol /*= L""*/,
-                                                std::wstring intersectionSymbol /*= L""*/)
-    : m_hitGroupName(std::move(hitGroupName)), m_closestHitSymbol(std::move(closestHitSymbol)),
-      m_anyHitSymbol(std::move(anyHitSymbol)), m_intersectionSymbol(std::move(intersectionSymbol))
-{
-  // Indicate which shader program is used for closest hit, leave the other
-  // ones undefined (default behavior), export the name of the group
-  m_desc.HitGroupExport = m_hitGroupName.c_str();
-  m_desc.ClosestHitShaderImport = m_closestHitSymbol.empty() ? nullptr : m_closestHitSymbol.c_str();
-  m_desc.AnyHitShaderImport = m_anyHitSymbol.empty() ? nullptr : m_anyHitSymbol.c_str();
-  m_desc.IntersectionShaderImport =
-      m_intersectionSymbol.empty() ? nullptr : m_intersectionSymbol.c_str();
-}
-
-//--------------------------------------------------------------------------------------------------
-//
-// This copy constructor has to be defined so that the export descriptors are set correctly. Using
-// the default constructor would copy the string pointers of the symbols into the descriptors, which
-// would cause issues when the original HitGroup object gets out of scope
-RayTracingPipelineGenerator::HitGroup::HitGroup(const HitGroup& source)
-    : HitGroup(source.m_hitGroupName, source.m_closestHitSymbol, source.m_anyHitSymbol,
-               source.m_intersectionSymbol)
-{
-}
-
-//--------------------------------------------------------------------------------------------------
-//
-// Store the association between a set of symbols and a root signature. The associated descriptors
-// will be built when compiling the pipeline. We store the symbol pointers directly so that they can
-// be used without processing during compilation.
-RayTracingPipelineGenerator::RootSignatureAssociation::RootSignatureAssociation(
-    ID3D12RootSignature* rootSignature, const std::vector<std::wstring>& symbols)
-    : m_rootSignature(rootSignature), m_symbols(symbols), m_symbolPointers(symbols.size())
-{
-  for (size_t i = 0; i < m_symbols.size(); i++)
-  {
-    m_symbolPointers[i] = m_symbols[i].c_str();
+    if (exports[symbol])
+    {
+      exportedSymbols.push_back(symbol);
+      exports[symbol] = false;
+    }
   }
-  m_rootSignaturePointer = m_rootSignature;
-}
-
-//--------------------------------------------------------------------------------------------------
-//
-// This copy constructor has to be defined so that the export descriptors are set correctly. Using
-// the default constructor would copy the string pointers of the symbols into the descriptors, which
-// would cause issues when the original RootSignatureAssociation object gets out of scope
-RayTracingPipelineGenerator::RootSignatureAssociation::RootSignatureAssociation(
-    const RootSignatureAssociation& source)
-    : RootSignatureAssociation(source.m_rootSignature, source.m_symbols)
-{
 }
 } // namespace NvHelpers
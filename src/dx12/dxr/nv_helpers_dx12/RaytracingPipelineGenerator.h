@@ -65,9 +65,12 @@ rtStateObject = pipeline.Generate();
 #pragma once
 
 #include "d3d12.h"
+#include "RootSignatureCache.h"
+#include "ShaderSymbolTable.h"
 
 #include <dxcapi.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -82,10 +85,17 @@ public:
   /// raytracing device prior to Windows 10 RS5.
   RayTracingPipelineGenerator(ID3D12Device5* device);
 
+  /// Same as above, interning the shader names in a table shared with other generators, such as
+  /// the ShaderBindingTableGenerator. The table must outlive the generator. The empty root
+  /// signatures the pipeline requires are taken from the cache when one is given
+  RayTracingPipelineGenerator(ID3D12Device5* device, ShaderSymbolTable& symbols,
+                              RootSignatureCache* rootSignatures = nullptr);
+
   /// Add a DXIL library to the pipeline. Note that this library has to be
   /// compiled with dxc, using a lib_6_3 target. The exported symbols must correspond exactly to the
   /// names of the shaders declared in the library, although unused ones can be omitted.
   void AddLibrary(IDxcBlob* dxilLibrary, const std::vector<std::wstring>& symbolExports);
+  void AddLibrary(IDxcBlob* dxilLibrary, const std::vector<ShaderSymbol>& symbolExports);
 
   /// In DXR the hit-related shaders are grouped into hit groups. Such shaders are:
   /// - The intersection shader, which can be used to intersect custom geometry, and is called upon
@@ -98,12 +108,17 @@ public:
   void AddHitGroup(const std::wstring& hitGroupName, const std::wstring& closestHitSymbol,
                    const std::wstring& anyHitSymbol = L"",
                    const std::wstring& intersectionSymbol = L"");
+  void AddHitGroup(ShaderSymbol hitGroupName, ShaderSymbol closestHitSymbol,
+                   ShaderSymbol anyHitSymbol = kNullShaderSymbol,
+                   ShaderSymbol intersectionSymbol = kNullShaderSymbol);
 
   /// The shaders and hit groups may have various root signatures. This call associates a root
   /// signature to one or more symbols. All imported symbols must be associated to one root
   /// signature.
   void AddRootSignatureAssociation(ID3D12RootSignature* rootSignature,
                                    const std::vector<std::wstring>& symbols);
+  void AddRootSignatureAssociation(ID3D12RootSignature* rootSignature,
+                                   const std::vector<ShaderSymbol>& symbols);
 
   /// The payload is the way hit or miss shaders can exchange data with the shader that called
   /// TraceRay. When several ray types are used (e.g. primary and shadow rays), this value must be
@@ -126,58 +141,45 @@ public:
   ID3D12StateObject* Generate();
 
 private:
-  /// Storage for DXIL libraries and their exported symbols
+  /// Storage for DXIL libraries and their exported symbols. The D3D12 descriptors referencing
+  /// the names are only built by Generate, so that the storage can be copied freely
   struct Library
   {
-    Library(IDxcBlob* dxil, const std::vector<std::wstring>& exportedSymbols);
-
-    Library(const Library& source);
-
     IDxcBlob* m_dxil;
-    const std::vector<std::wstring> m_exportedSymbols;
-
-    std::vector<D3D12_EXPORT_DESC> m_exports;
-    D3D12_DXIL_LIBRARY_DESC m_libDesc;
+    std::vector<ShaderSymbol> m_exportedSymbols;
   };
 
   /// Storage for the hit groups, binding the hit group name with the underlying intersection, any
   /// hit and closest hit symbols
   struct HitGroup
   {
-    HitGroup(std::wstring hitGroupName, std::wstring closestHitSymbol,
-             std::wstring anyHitSymbol = L"", std::wstring intersectionSymbol = L"");
-
-    HitGroup(const HitGroup& source);
-
-    std::wstring m_hitGroupName;
-    std::wstring m_closestHitSymbol;
-    std::wstring m_anyHitSymbol;
-    std::wstring m_intersectionSymbol;
-    D3D12_HIT_GROUP_DESC m_desc = {};
+    ShaderSymbol m_hitGroupName;
+    ShaderSymbol m_closestHitSymbol;
+    ShaderSymbol m_anyHitSymbol;
+    ShaderSymbol m_intersectionSymbol;
   };
 
   /// Storage for the association between shaders and root signatures
   struct RootSignatureAssociation
   {
-    RootSignatureAssociation(ID3D12RootSignature* rootSignature,
-                             const std::vector<std::wstring>& symbols);
-
-    RootSignatureAssociation(const RootSignatureAssociation& source);
-
     ID3D12RootSignature* m_rootSignature;
-    ID3D12RootSignature* m_rootSignaturePointer;
-    std::vector<std::wstring> m_symbols;
-    std::vector<LPCWSTR> m_symbolPointers;
-    D3D12_SUBOBJECT_TO_EXPORTS_ASSOCIATION m_association = {};
+    std::vector<ShaderSymbol> m_symbols;
   };
 
+  /// Intern a list of names
+  std::vector<ShaderSymbol> InternSymbols(const std::vector<std::wstring>& names);
+
   /// The pipeline creation requires having at least one empty global and local root signatures, so
   /// we systematically create both
   void CreateDummyRootSignatures();
 
   /// Build a list containing the export symbols for the ray generation shaders, miss shaders, and
   /// hit group names
-  void BuildShaderExportList(std::vector<std::wstring>& exportedSymbols);
+  void BuildShaderExportList(std::vector<ShaderSymbol>& exportedSymbols);
+
+  /// Table owned by the generator when none is shared with it
+  std::unique_ptr<ShaderSymbolTable> m_ownedSymbols;
+  ShaderSymbolTable* m_symbols;
 
   std::vector<Library> m_libraries = {};
   std::vector<HitGroup> m_hitGroups = {};
@@ -191,8 +193,9 @@ private:
   UINT m_maxRecursionDepth = 1;
 
   ID3D12Device5* m_device;
-  ID3D12RootSignature* m_dummyLocalRootSignature;
-  ID3D12RootSignature* m_dummyGlobalRootSignature;
+  RootSignatureCache* m_rootSignatures = nullptr;
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> m_dummyLocalRootSignature;
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> m_dummyGlobalRootSignature;
 
   
 };
@@ -0,0 +1,97 @@
+#include "RootSignatureCache.h"
+
+#include <stdexcept>
+
+namespace NvHelpers
+{
+
+namespace
+{
+/// Serialize a root signature description, as version 1.0 like all the signatures of the helpers
+Microsoft::WRL::ComPtr<ID3DBlob> SerializeRootSignature(const D3D12_ROOT_SIGNATURE_DESC& desc)
+{
+  Microsoft::WRL::ComPtr<ID3DBlob> blob;
+  Microsoft::WRL::ComPtr<ID3DBlob> error;
+  HRESULT hr = D3D12SerializeRootSignature(&desc, D3D_ROOT_SIGNATURE_VERSION_1_0, &blob, &error);
+  if (FAILED(hr))
+  {
+    throw std::logic_error("Cannot serialize root signature");
+  }
+  return blob;
+}
+
+ID3D12RootSignature* CreateRootSignatureFromBlob(ID3D12Device* device, const void* blob, size_t size)
+{
+  ID3D12RootSignature* pRootSig;
+  HRESULT hr = device->CreateRootSignature(0, blob, size, IID_PPV_ARGS(&pRootSig));
+  if (FAILED(hr))
+  {
+    throw std::logic_error("Cannot create root signature");
+  }
+  return pRootSig;
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// The signatures are shared by the BlobCache, which creates each of them once
+ID3D12RootSignature* RootSignatureCache::GetOrCreate(ID3D12Device* device, const void* blob,
+                                                     size_t size)
+{
+  Microsoft::WRL::ComPtr<ID3D12RootSignature> rootSignature =
+      m_cache.GetOrCreate(blob, size, [device](const void* data, size_t dataSize) {
+        Microsoft::WRL::ComPtr<ID3D12RootSignature> created;
+        created.Attach(CreateRootSignatureFromBlob(device, data, dataSize));
+        return created;
+      });
+  return rootSignature.Detach();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Same as above, serializing the description first
+ID3D12RootSignature* RootSignatureCache::GetOrCreate(ID3D12Device* device,
+                                                     const D3D12_ROOT_SIGNATURE_DESC& desc)
+{
+  Microsoft::WRL::ComPtr<ID3DBlob> blob = SerializeRootSignature(desc);
+  return GetOrCreate(device, blob->GetBufferPointer(), blob->GetBufferSize());
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Drop the references of the cache
+void RootSignatureCache::Clear()
+{
+  m_cache.Clear();
+}
+
+size_t RootSignatureCache::GetUniqueCount() const
+{
+  return m_cache.GetUniqueCount();
+}
+
+uint64_t RootSignatureCache::GetHitCount() const
+{
+  return m_cache.GetHitCount();
+}
+
+uint64_t RootSignatureCache::GetMissCount() const
+{
+  return m_cache.GetMissCount();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Serialize a root signature description and create it, through the cache when one is given
+ID3D12RootSignature* CreateRootSignature(ID3D12Device* device, const D3D12_ROOT_SIGNATURE_DESC& desc,
+                                         RootSignatureCache* cache)
+{
+  if (cache)
+  {
+    return cache->GetOrCreate(device, desc);
+  }
+  Microsoft::WRL::ComPtr<ID3DBlob> blob = SerializeRootSignature(desc);
+  return CreateRootSignatureFromBlob(device, blob->GetBufferPointer(), blob->GetBufferSize());
+}
+
+} // namespace NvHelpers
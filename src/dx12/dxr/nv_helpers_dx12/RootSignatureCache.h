@@ -0,0 +1,68 @@
+/*
+The RootSignatureCache shares root signatures between all the places creating them. Root signatures
+are identified by their serialized blob, so two identical descriptions resolve to a single object
+regardless of who created them: the per-shader signatures of the raytracing pipeline, the empty
+signatures the pipeline generator needs, or the signatures of the raster passes. Materials sharing
+a layout then share one root signature instead of creating thousands of duplicates.
+All the root signatures of a cache must be created on the same device. The cache can be used from
+several threads at once. The sharing itself is implemented by the device independent BlobCache.
+
+Example:
+
+RootSignatureCache cache;
+RootSignatureGenerator rsc;
+rsc.AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_SRV);
+ComPtr<ID3D12RootSignature> signature;
+signature.Attach(rsc.Generate(device, true, &cache));
+*/
+
+#ifndef ROOT_SIGNATURE_CACHE_GUARD
+#define ROOT_SIGNATURE_CACHE_GUARD
+
+#pragma once
+
+#include "d3d12.h"
+#include <wrl/client.h>
+
+#include "BlobCache.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace NvHelpers
+{
+
+/// Cache of root signatures, keyed by a hash of their serialized blob
+class RootSignatureCache
+{
+public:
+  RootSignatureCache() = default;
+  RootSignatureCache(const RootSignatureCache&) = delete;
+  RootSignatureCache& operator=(const RootSignatureCache&) = delete;
+
+  /// Return the root signature serialized in the blob, creating it on first use. The returned
+  /// pointer holds a new reference, to be released by the caller
+  ID3D12RootSignature* GetOrCreate(ID3D12Device* device, const void* blob, size_t size);
+
+  /// Same as above, serializing the description first
+  ID3D12RootSignature* GetOrCreate(ID3D12Device* device, const D3D12_ROOT_SIGNATURE_DESC& desc);
+
+  /// Drop the references of the cache. The root signatures still referenced elsewhere stay valid
+  void Clear();
+
+  /// Statistics
+  size_t GetUniqueCount() const;
+  uint64_t GetHitCount() const;
+  uint64_t GetMissCount() const;
+
+private:
+  BlobCache<Microsoft::WRL::ComPtr<ID3D12RootSignature>> m_cache;
+};
+
+/// Serialize a root signature description and create it, through the cache when one is given. The
+/// returned pointer holds a new reference, to be released by the caller
+ID3D12RootSignature* CreateRootSignature(ID3D12Device* device, const D3D12_ROOT_SIGNATURE_DESC& desc,
+                                         RootSignatureCache* cache = nullptr);
+
+} // namespace NvHelpers
+#endif
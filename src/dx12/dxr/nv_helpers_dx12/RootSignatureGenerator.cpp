@@ -36,6 +36,7 @@ pointers will be bound.
 */
 
 #include "RootSignatureGenerator.h"
+#include "dx12/Profiler.h"
 
 namespace NvHelpers
 {
@@ -150,11 +151,78 @@ void RootSignatureGenerator::AddRootParameter(D3D12_ROOT_PARAMETER_TYPE type,
   m_rangeLocations.push_back(~0u);
 }
 
+//--------------------------------------------------------------------------------------------------
+//
+// Add the parameters chosen by OptimizeRootSignatureLayout for a set of needs, in the order of the
+// layout
+void RootSignatureGenerator::AddOptimizedParameters(
+    const RaytracingImplementation::RootSignatureLayout& layout,
+    const std::vector<RaytracingImplementation::ShaderResourceNeed>& needs)
+{
+  using Type = RaytracingImplementation::ShaderResourceNeed::Type;
+  using Kind = RaytracingImplementation::RootParameterKind;
+
+  for (const RaytracingImplementation::RootParameterPlacement& parameter : layout.parameters)
+  {
+    if (parameter.kind == Kind::Table)
+    {
+      std::vector<D3D12_DESCRIPTOR_RANGE> ranges;
+      for (uint32_t index : parameter.needs)
+      {
+        const RaytracingImplementation::ShaderResourceNeed& need = needs[index];
+        D3D12_DESCRIPTOR_RANGE r = {};
+        r.BaseShaderRegister = need.shaderRegister;
+        r.RegisterSpace = need.registerSpace;
+        r.OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+        switch (need.type)
+        {
+        case Type::Sampler:
+          r.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER;
+          r.NumDescriptors = need.count;
+          break;
+        case Type::ShaderResource:
+          r.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+          r.NumDescriptors = need.count;
+          break;
+        case Type::UnorderedAccess:
+          r.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_UAV;
+          r.NumDescriptors = need.count;
+          break;
+        default:
+          // Constants are held by a single constant buffer
+          r.RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_CBV;
+          r.NumDescriptors = need.type == Type::Constants ? 1 : need.count;
+          break;
+        }
+        ranges.push_back(r);
+      }
+      AddHeapRangesParameter(ranges);
+      continue;
+    }
+
+    const RaytracingImplementation::ShaderResourceNeed& need = needs[parameter.needs.front()];
+    if (parameter.kind == Kind::Constants)
+    {
+      AddRootParameter(D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS, need.shaderRegister,
+                       need.registerSpace, need.count);
+    }
+    else
+    {
+      AddRootParameter(need.type == Type::ShaderResource    ? D3D12_ROOT_PARAMETER_TYPE_SRV
+                       : need.type == Type::UnorderedAccess ? D3D12_ROOT_PARAMETER_TYPE_UAV
+                                                            : D3D12_ROOT_PARAMETER_TYPE_CBV,
+                       need.shaderRegister, need.registerSpace);
+    }
+  }
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 // Create the root signature from the set of parameters, in the order of the addition calls
-ID3D12RootSignature* RootSignatureGenerator::Generate(ID3D12Device* device, bool isLocal)
+ID3D12RootSignature* RootSignatureGenerator::Generate(ID3D12Device* device, bool isLocal,
+                                                      RootSignatureCache* cache)
 {
+  PROFILE_ZONE("RootSignatureGenerator::Generate");
   // Go through all the parameters, and set the actual addresses of the heap range descriptors based
   // on their indices in the range set array
   for (size_t i = 0; i < m_parameters.size(); i++)
@@ -174,22 +242,7 @@ ID3D12RootSignature* RootSignatureGenerator::Generate(ID3D12Device* device, bool
       isLocal ? D3D12_ROOT_SIGNATURE_FLAG_LOCAL_ROOT_SIGNATURE : D3D12_ROOT_SIGNATURE_FLAG_NONE;
 
   // Create the root signature from its descriptor
-  ID3DBlob* pSigBlob;
-  ID3DBlob* pErrorBlob;
-  HRESULT hr = D3D12SerializeRootSignature(&rootDesc, D3D_ROOT_SIGNATURE_VERSION_1_0, &pSigBlob,
-                                           &pErrorBlob);
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Cannot serialize root signature");
-  }
-  ID3D12RootSignature* pRootSig;
-  hr = device->CreateRootSignature(0, pSigBlob->GetBufferPointer(), pSigBlob->GetBufferSize(),
-                                   IID_PPV_ARGS(&pRootSig));
-  if (FAILED(hr))
-  {
-    throw std::logic_error("Cannot create root signature");
-  }
-  return pRootSig;
+  return CreateRootSignature(device, rootDesc, cache);
 }
 
 } // namespace NvHelpers
@@ -56,6 +56,8 @@ return rsc.Generate(m_device.Get(), true);
 #pragma once
 
 #include "d3d12.h"
+#include "RootSignatureCache.h"
+#include "dx12/RootSignatureOptimizer.h"
 
 #include <tuple>
 #include <vector>
@@ -106,8 +108,17 @@ public:
   void AddRootParameter(D3D12_ROOT_PARAMETER_TYPE type, UINT shaderRegister = 0,
                         UINT registerSpace = 0, UINT numRootConstants = 1);
 
-  /// Create the root signature from the set of parameters, in the order of the addition calls
-  ID3D12RootSignature* Generate(ID3D12Device* device, bool isLocal);
+  /// Add the parameters chosen by OptimizeRootSignatureLayout for a set of needs, in the order of
+  /// the layout. Each table holds one range per need, appended in the order of the declaration, and
+  /// constants placed in a root descriptor become a constant buffer. The layout tells which root
+  /// parameter serves each need
+  void AddOptimizedParameters(const RaytracingImplementation::RootSignatureLayout& layout,
+                              const std::vector<RaytracingImplementation::ShaderResourceNeed>& needs);
+
+  /// Create the root signature from the set of parameters, in the order of the addition calls. When
+  /// a cache is given, an identical root signature created earlier is returned instead
+  ID3D12RootSignature* Generate(ID3D12Device* device, bool isLocal,
+                                RootSignatureCache* cache = nullptr);
 
 private:
   /// Heap range descriptors
@@ -35,65 +35,101 @@ dispatch rays description.
 */
 
 #include "ShaderBindingTableGenerator.h"
-
-// Helper to compute aligned buffer sizes
-#ifndef ROUND_UP
-#define ROUND_UP(v, powerOf2Alignment) (((v) + (powerOf2Alignment)-1) & ~((powerOf2Alignment)-1))
-#endif
+#include "dx12/Profiler.h"
 
 namespace NvHelpers
 {
 
+static_assert(ShaderBindingTableLayout::kShaderIdentifierSize ==
+                  D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES,
+              "Shader identifier size mismatch");
+static_assert(ShaderBindingTableLayout::kRecordAlignment ==
+                  D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT,
+              "Shader record alignment mismatch");
+static_assert(ShaderBindingTableLayout::kTableAlignment ==
+                  D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT,
+              "Shader table alignment mismatch");
+static_assert(ShaderBindingTableLayout::kArgumentSize == sizeof(void*),
+              "Root arguments are stored as 8-byte values");
+
+ShaderBindingTableGenerator::ShaderBindingTableGenerator()
+    : m_ownedSymbols(std::make_unique<ShaderSymbolTable>()), m_symbols(m_ownedSymbols.get())
+{
+}
+
+ShaderBindingTableGenerator::ShaderBindingTableGenerator(ShaderSymbolTable& symbols)
+    : m_symbols(&symbols)
+{
+}
+
+ShaderBindingTableGenerator::~ShaderBindingTableGenerator()
+{
+  ReleaseBuffer();
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 // Add a ray generation program by name, with its list of data pointers or values according to
 // the layout of its root signature
-void ShaderBindingTableGenerator::AddRayGenerationProgram(const std::wstring& entryPoint,
-                                                          const std::vector<void*>& inputData)
+uint32_t ShaderBindingTableGenerator::AddRayGenerationProgram(const std::wstring& entryPoint,
+                                                              const std::vector<void*>& inputData)
+{
+  return AddEntry(Section::RayGen, m_symbols->Intern(entryPoint), inputData);
+}
+
+uint32_t ShaderBindingTableGenerator::AddRayGenerationProgram(ShaderSymbol entryPoint,
+                                                              const std::vector<void*>& inputData)
 {
-  m_rayGen.emplace_back(SBTEntry(entryPoint, inputData));
+  return AddEntry(Section::RayGen, entryPoint, inputData);
 }
 
 //--------------------------------------------------------------------------------------------------
 //
 // Add a miss program by name, with its list of data pointers or values according to
 // the layout of its root signature
-void ShaderBindingTableGenerator::AddMissProgram(const std::wstring& entryPoint,
-                                                 const std::vector<void*>& inputData)
+uint32_t ShaderBindingTableGenerator::AddMissProgram(const std::wstring& entryPoint,
+                                                     const std::vector<void*>& inputData)
+{
+  return AddEntry(Section::Miss, m_symbols->Intern(entryPoint), inputData);
+}
+
+uint32_t ShaderBindingTableGenerator::AddMissProgram(ShaderSymbol entryPoint,
+                                                     const std::vector<void*>& inputData)
 {
-  m_miss.emplace_back(SBTEntry(entryPoint, inputData));
+  return AddEntry(Section::Miss, entryPoint, inputData);
 }
 
 //--------------------------------------------------------------------------------------------------
 //
 // Add a hit group by name, with its list of data pointers or values according to
 // the layout of its root signature
-void ShaderBindingTableGenerator::AddHitGroup(const std::wstring& entryPoint,
-                                              const std::vector<void*>& inputData)
+uint32_t ShaderBindingTableGenerator::AddHitGroup(const std::wstring& entryPoint,
+                                                  const std::vector<void*>& inputData)
+{
+  return AddEntry(Section::HitGroup, m_symbols->Intern(entryPoint), inputData);
+}
+
+uint32_t ShaderBindingTableGenerator::AddHitGroup(ShaderSymbol entryPoint,
+                                                  const std::vector<void*>& inputData)
 {
-  m_hitGroup.emplace_back(SBTEntry(entryPoint, inputData));
+  return AddEntry(Section::HitGroup, entryPoint, inputData);
+}
+
+uint32_t ShaderBindingTableGenerator::AddEntry(Section section, ShaderSymbol entryPoint,
+                                               const std::vector<void*>& inputData)
+{
+  m_entries[static_cast<uint32_t>(section)].push_back({entryPoint, inputData});
+  return m_layout.AddRecord(section, static_cast<uint32_t>(inputData.size()));
 }
 
 //--------------------------------------------------------------------------------------------------
 //
-// Compute the size of the SBT based on the set of programs and hit groups it contains
+// Compute the size of the SBT based on the set of programs and hit groups it contains. The entry
+// size of each program type depends on the maximum number of parameters in each category, and
+// each category starts on a shader table boundary
 uint32_t ShaderBindingTableGenerator::ComputeSBTSize()
 {
-  // Size of a program identifier
-  m_progIdSize = D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT;
-  // Compute the entry size of each program type depending on the maximum number of parameters in
-  // each category
-  m_rayGenEntrySize = GetEntrySize(m_rayGen);
-  m_missEntrySize = GetEntrySize(m_miss);
-  m_hitGroupEntrySize = GetEntrySize(m_hitGroup);
-
-  // The total SBT size is the sum of the entries for ray generation, miss and hit groups, aligned
-  // on 256 bytes
-  uint32_t sbtSize = ROUND_UP(m_rayGenEntrySize * static_cast<UINT>(m_rayGen.size()) +
-                                  m_missEntrySize * static_cast<UINT>(m_miss.size()) +
-                                  m_hitGroupEntrySize * static_cast<UINT>(m_hitGroup.size()),
-                              256);
-  return sbtSize;
+  return m_layout.Compute();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -104,27 +140,172 @@ uint32_t ShaderBindingTableGenerator::ComputeSBTSize()
 void ShaderBindingTableGenerator::Generate(ID3D12Resource* sbtBuffer,
                                            ID3D12StateObjectProperties* raytracingPipeline)
 {
-  // Map the SBT
-  uint8_t* pData;
-  HRESULT hr = sbtBuffer->Map(0, nullptr, reinterpret_cast<void**>(&pData));
-  if (FAILED(hr))
+  PROFILE_ZONE("ShaderBindingTableGenerator::Generate");
+  if (!m_layout.IsComputed())
+  {
+    throw std::logic_error("ComputeSBTSize must be called before generating the SBT");
+  }
+  if (sbtBuffer->GetDesc().Width < m_layout.GetTotalSize())
+  {
+    throw std::logic_error("The shader binding table buffer is too small");
+  }
+
+  // Map the SBT, unless it is already mapped by a previous call
+  if (sbtBuffer != m_sbtBuffer)
   {
-    throw std::logic_error("Could not map the shader binding table");
+    ReleaseBuffer();
+
+    uint8_t* pData;
+    HRESULT hr = sbtBuffer->Map(0, nullptr, reinterpret_cast<void**>(&pData));
+    if (FAILED(hr))
+    {
+      throw std::logic_error("Could not map the shader binding table");
+    }
+    sbtBuffer->AddRef();
+    m_sbtBuffer = sbtBuffer;
+    m_mappedData = pData;
   }
+
+  // Resolve the shader identifiers, once per program symbol. The pipeline may have changed since
+  // the last call, so the identifiers are not kept across calls
+  m_identifiers.assign(m_symbols->GetSize(), nullptr);
+  for (auto& entries : m_entries)
+  {
+    for (auto& shader : entries)
+    {
+      memcpy(shader.m_identifier, ResolveIdentifier(raytracingPipeline, shader.m_entryPoint),
+             ShaderBindingTableLayout::kShaderIdentifierSize);
+    }
+  }
+
   // Copy the shader identifiers followed by their resource pointers or root constants: first the
   // ray generation, then the miss shaders, and finally the set of hit groups
-  uint32_t offset = 0;
+  for (uint32_t section = 0; section < ShaderBindingTableLayout::kSectionCount; section++)
+  {
+    for (uint32_t index = 0; index < m_entries[section].size(); index++)
+    {
+      WriteEntry(static_cast<Section>(section), index);
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Get the identifier of a program from the pipeline, looking it up once per symbol
+const void* ShaderBindingTableGenerator::ResolveIdentifier(
+    ID3D12StateObjectProperties* raytracingPipeline, ShaderSymbol entryPoint)
+{
+  const void*& id = m_identifiers[entryPoint];
+  if (!id)
+  {
+    // Get the shader identifier, and check whether that identifier is known
+    const wchar_t* name = m_symbols->GetName(entryPoint);
+    id = name ? raytracingPipeline->GetShaderIdentifier(name) : nullptr;
+    if (!id)
+    {
+      std::wstring errMsg(std::wstring(L"Unknown shader identifier used in the SBT: ") +
+                          (name ? name : L""));
+      throw std::logic_error(std::string(errMsg.begin(), errMsg.end()));
+    }
+  }
+  return id;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Fetch the shader identifiers from a new pipeline, and rewrite the identifiers of the records
+// they changed. Identifiers are only guaranteed to be stable within a state object, so they are
+// all fetched again, but the records whose identifier did not change are not written
+uint32_t ShaderBindingTableGenerator::UpdateShaderIdentifiers(
+    ID3D12StateObjectProperties* raytracingPipeline)
+{
+  if (!m_mappedData)
+  {
+    throw std::logic_error("The SBT must be generated before its identifiers can be updated");
+  }
+
+  m_identifiers.assign(m_symbols->GetSize(), nullptr);
+  uint32_t updatedCount = 0;
+  for (uint32_t section = 0; section < ShaderBindingTableLayout::kSectionCount; section++)
+  {
+    for (uint32_t index = 0; index < m_entries[section].size(); index++)
+    {
+      // The mapped SBT is write-combined memory, so the comparison uses the copy of the entry
+      SBTEntry& shader = m_entries[section][index];
+      const void* identifier = ResolveIdentifier(raytracingPipeline, shader.m_entryPoint);
+      if (memcmp(shader.m_identifier, identifier, ShaderBindingTableLayout::kShaderIdentifierSize) != 0)
+      {
+        memcpy(shader.m_identifier, identifier, ShaderBindingTableLayout::kShaderIdentifierSize);
+        memcpy(m_mappedData + m_layout.GetRecordOffset(static_cast<Section>(section), index),
+               identifier, ShaderBindingTableLayout::kShaderIdentifierSize);
+        updatedCount++;
+      }
+    }
+  }
+  return updatedCount;
+}
 
-  offset = CopyShaderData(raytracingPipeline, pData, m_rayGen, m_rayGenEntrySize);
-  pData += offset;
+//--------------------------------------------------------------------------------------------------
+//
+// Replace the root arguments of a single record of the SBT written by the last Generate
+void ShaderBindingTableGenerator::UpdateRayGenerationProgram(uint32_t index,
+                                                             const std::vector<void*>& inputData)
+{
+  UpdateEntry(Section::RayGen, index, inputData);
+}
 
-  offset = CopyShaderData(raytracingPipeline, pData, m_miss, m_missEntrySize);
-  pData += offset;
+void ShaderBindingTableGenerator::UpdateMissProgram(uint32_t index,
+                                                    const std::vector<void*>& inputData)
+{
+  UpdateEntry(Section::Miss, index, inputData);
+}
 
-  offset = CopyShaderData(raytracingPipeline, pData, m_hitGroup, m_hitGroupEntrySize);
+void ShaderBindingTableGenerator::UpdateHitGroup(uint32_t index,
+                                                 const std::vector<void*>& inputData)
+{
+  UpdateEntry(Section::HitGroup, index, inputData);
+}
 
-  // Unmap the SBT
-  sbtBuffer->Unmap(0, nullptr);
+void ShaderBindingTableGenerator::UpdateEntry(Section section, uint32_t index,
+                                              const std::vector<void*>& inputData)
+{
+  if (!m_mappedData)
+  {
+    throw std::logic_error("The SBT must be generated before its records can be updated");
+  }
+  std::vector<SBTEntry>& entries = m_entries[static_cast<uint32_t>(section)];
+  if (index >= entries.size())
+  {
+    throw std::out_of_range("Shader binding table record index out of range");
+  }
+  if (inputData.size() > m_layout.GetArgumentCapacity(section))
+  {
+    throw std::logic_error("The new root arguments do not fit in the SBT record");
+  }
+
+  entries[index].m_inputData = inputData;
+  WriteEntry(section, index);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Copy the shader identifier followed by its resource pointers and/or root constants. The rest of
+// the record is cleared, so that a record patched with fewer arguments holds no stale values
+void ShaderBindingTableGenerator::WriteEntry(Section section, uint32_t index)
+{
+  const SBTEntry& shader = m_entries[static_cast<uint32_t>(section)][index];
+  uint8_t* pData = m_mappedData + m_layout.GetRecordOffset(section, index);
+  const uint32_t stride = m_layout.GetRecordStride(section);
+
+  // Copy the shader identifier
+  memcpy(pData, shader.m_identifier, ShaderBindingTableLayout::kShaderIdentifierSize);
+  pData += ShaderBindingTableLayout::kShaderIdentifierSize;
+
+  // Copy all its resources pointers or values in bulk
+  const size_t argumentsSize = shader.m_inputData.size() * ShaderBindingTableLayout::kArgumentSize;
+  memcpy(pData, shader.m_inputData.data(), argumentsSize);
+  memset(pData + argumentsSize, 0,
+         stride - ShaderBindingTableLayout::kShaderIdentifierSize - argumentsSize);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -132,14 +313,23 @@ void ShaderBindingTableGenerator::Generate(ID3D12Resource* sbtBuffer,
 // Reset the sets of programs and hit groups
 void ShaderBindingTableGenerator::Reset()
 {
-  m_rayGen.clear();
-  m_miss.clear();
-  m_hitGroup.clear();
-
-  m_rayGenEntrySize = 0;
-  m_missEntrySize = 0;
-  m_hitGroupEntrySize = 0;
-  m_progIdSize = 0;
+  for (auto& entries : m_entries)
+  {
+    entries.clear();
+  }
+  m_layout.Reset();
+  ReleaseBuffer();
+}
+
+void ShaderBindingTableGenerator::ReleaseBuffer()
+{
+  if (m_sbtBuffer)
+  {
+    m_sbtBuffer->Unmap(0, nullptr);
+    m_sbtBuffer->Release();
+    m_sbtBuffer = nullptr;
+    m_mappedData = nullptr;
+  }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -151,7 +341,7 @@ void ShaderBindingTableGenerator::Reset()
 // Get the size in bytes of the SBT section dedicated to ray generation programs
 UINT ShaderBindingTableGenerator::GetRayGenSectionSize() const
 {
-  return m_rayGenEntrySize * static_cast<UINT>(m_rayGen.size());
+  return m_layout.GetSectionSize(Section::RayGen);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -159,100 +349,55 @@ UINT ShaderBindingTableGenerator::GetRayGenSectionSize() const
 // Get the size in bytes of one ray generation program entry in the SBT
 UINT ShaderBindingTableGenerator::GetRayGenEntrySize() const
 {
-  return m_rayGenEntrySize;
+  return m_layout.GetRecordStride(Section::RayGen);
 }
 
 //--------------------------------------------------------------------------------------------------
 //
-// Get the size in bytes of the SBT section dedicated to miss programs
-UINT ShaderBindingTableGenerator::GetMissSectionSize() const
+// Get the offset in bytes of the miss programs from the start of the SBT
+UINT ShaderBindingTableGenerator::GetMissSectionOffset() const
 {
-  return m_missEntrySize * static_cast<UINT>(m_miss.size());
+  return m_layout.GetSectionOffset(Section::Miss);
 }
 
 //--------------------------------------------------------------------------------------------------
 //
-// Get the size in bytes of one miss program entry in the SBT
-UINT ShaderBindingTableGenerator::GetMissEntrySize()
+// Get the size in bytes of the SBT section dedicated to miss programs
+UINT ShaderBindingTableGenerator::GetMissSectionSize() const
 {
-  return m_missEntrySize;
+  return m_layout.GetSectionSize(Section::Miss);
 }
 
 //--------------------------------------------------------------------------------------------------
 //
-// Get the size in bytes of the SBT section dedicated to hit groups
-UINT ShaderBindingTableGenerator::GetHitGroupSectionSize() const
+// Get the size in bytes of one miss program entry in the SBT
+UINT ShaderBindingTableGenerator::GetMissEntrySize() const
 {
-  return m_hitGroupEntrySize * static_cast<UINT>(m_hitGroup.size());
+  return m_layout.GetRecordStride(Section::Miss);
 }
 
 //--------------------------------------------------------------------------------------------------
 //
-// Get the size in bytes of one hit group entry in the SBT
-UINT ShaderBindingTableGenerator::GetHitGroupEntrySize() const
+// Get the offset in bytes of the hit groups from the start of the SBT
+UINT ShaderBindingTableGenerator::GetHitGroupSectionOffset() const
 {
-  return m_hitGroupEntrySize;
+  return m_layout.GetSectionOffset(Section::HitGroup);
 }
 
 //--------------------------------------------------------------------------------------------------
 //
-// For each entry, copy the shader identifier followed by its resource pointers and/or root
-// constants in outputData, with a stride in bytes of entrySize, and returns the size in bytes
-// actually written to outputData.
-uint32_t ShaderBindingTableGenerator::CopyShaderData(
-    ID3D12StateObjectProperties* raytracingPipeline, uint8_t* outputData,
-    const std::vector<SBTEntry>& shaders, uint32_t entrySize)
+// Get the size in bytes of the SBT section dedicated to hit groups
+UINT ShaderBindingTableGenerator::GetHitGroupSectionSize() const
 {
-  uint8_t* pData = outputData;
-  for (const auto& shader : shaders)
-  {
-    // Get the shader identifier, and check whether that identifier is known
-    void* id = raytracingPipeline->GetShaderIdentifier(shader.m_entryPoint.c_str());
-    if (!id)
-    {
-      std::wstring errMsg(std::wstring(L"Unknown shader identifier used in the SBT: ") +
-                          shader.m_entryPoint);
-      throw std::logic_error(std::string(errMsg.begin(), errMsg.end()));
-    }
-    // Copy the shader identifier
-    memcpy(pData, id, m_progIdSize);
-    // Copy all its resources pointers or values in bulk
-    memcpy(pData + m_progIdSize, shader.m_inputData.data(), shader.m_inputData.size() * 8);
-
-    pData += entrySize;
-  }
-  // Return the number of bytes actually written to the output buffer
-  return static_cast<uint32_t>(shaders.size()) * entrySize;
+  return m_layout.GetSectionSize(Section::HitGroup);
 }
 
 //--------------------------------------------------------------------------------------------------
 //
-// Compute the size of the SBT entries for a set of entries, which is determined by the maximum
-// number of parameters of their root signature
-uint32_t ShaderBindingTableGenerator::GetEntrySize(const std::vector<SBTEntry>& entries)
+// Get the size in bytes of one hit group entry in the SBT
+UINT ShaderBindingTableGenerator::GetHitGroupEntrySize() const
 {
-  // Find the maximum number of parameters used by a single entry
-  size_t maxArgs = 0;
-  for (const auto& shader : entries)
-  {
-    maxArgs = max(maxArgs, shader.m_inputData.size());
-  }
-  // A SBT entry is made of a program ID and a set of parameters, taking 8 bytes each. Those
-  // parameters can either be 8-bytes pointers, or 4-bytes constants
-  uint32_t entrySize = m_progIdSize + 8 * static_cast<uint32_t>(maxArgs);
-
-  // The entries of the shader binding table must be 16-bytes-aligned
-  entrySize = ROUND_UP(entrySize, D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT);
-
-  return entrySize;
+  return m_layout.GetRecordStride(Section::HitGroup);
 }
 
-//--------------------------------------------------------------------------------------------------
-//
-//
-ShaderBindingTableGenerator::SBTEntry::SBTEntry(std::wstring entryPoint,
-                                                std::vector<void*> inputData)
-    : m_entryPoint(std::move(entryPoint)), m_inputData(std::move(inputData))
-{
-}
 } // namespace NvHelpers
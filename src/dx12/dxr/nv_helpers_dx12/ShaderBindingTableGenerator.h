@@ -61,48 +61,30 @@ Then setting the descriptor for the dispatch rays become way easier
 //--------------------------------------------------------------------
 
 D3D12_DISPATCH_RAYS_DESC desc = {};
-// The layout of the SBT is as follows: ray generation shaders, miss shaders,
-hit groups. As
-// described in the CreateShaderBindingTable method, all SBT entries have the
-same size to allow
-// a fixed stride.
-
-// The ray generation shaders are always at the beginning of the SBT. In this
-// example we have only one RG, so the size of this SBT sections is
-m_sbtEntrySize. uint32_t rayGenerationSectionSizeInBytes =
-m_sbtHelper.GetRayGenSectionSize(); desc.RayGenerationShaderRecord.StartAddress
-= m_sbtStorage->GetGPUVirtualAddress();
-desc.RayGenerationShaderRecord.SizeInBytes = rayGenerationSectionSizeInBytes;
-
-// The miss shaders are in the second SBT section, right after the ray
-generation shader. We
-// have one miss shader for the camera rays and one for the shadow rays, so this
-section has a
-// size of 2*m_sbtEntrySize. We also indicate the stride between the two miss
-shaders, which is
-// the size of a SBT entry
-uint32_t missSectionSizeInBytes = m_sbtHelper.GetMissSectionSize();
-desc.MissShaderTable.StartAddress =
-m_sbtStorage->GetGPUVirtualAddress() + rayGenerationSectionSizeInBytes;
-desc.MissShaderTable.SizeInBytes = missSectionSizeInBytes;
+// The layout of the SBT is as follows: ray generation shaders, miss shaders, hit groups. Each
+// section starts on a D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT boundary, so the start of a
+// section is not the sum of the sizes of the previous ones: the offsets are given by the helper.
+// All the records of a section share the same stride.
+D3D12_GPU_VIRTUAL_ADDRESS sbtAddress = m_sbtStorage->GetGPUVirtualAddress();
+
+// The ray generation shaders are always at the beginning of the SBT. In this example we have
+// only one RG, so the size of this section is the size of its single record
+desc.RayGenerationShaderRecord.StartAddress = sbtAddress;
+desc.RayGenerationShaderRecord.SizeInBytes = m_sbtHelper.GetRayGenSectionSize();
+
+// The miss shaders are in the second SBT section. We have one miss shader for the camera rays
+// and one for the shadow rays, and indicate the stride between the two
+desc.MissShaderTable.StartAddress = sbtAddress + m_sbtHelper.GetMissSectionOffset();
+desc.MissShaderTable.SizeInBytes = m_sbtHelper.GetMissSectionSize();
 desc.MissShaderTable.StrideInBytes = m_sbtHelper.GetMissEntrySize();
 
-// The hit groups section start after the miss shaders. In this sample we have 4
-hit groups: 2
-// for the triangles (1 used when hitting the geometry from a camera ray, 1 when
-hitting the
-// same geometry from a shadow ray) and 2 for the plane. We also indicate the
-stride between the
-// two miss shaders, which is the size of a SBT entry
-// #Pascal: experiment with different sizes for the SBT entries
-uint32_t hitGroupsSectionSize = m_sbtHelper.GetHitGroupSectionSize();
-desc.HitGroupTable.StartAddress =
-m_sbtStorage->GetGPUVirtualAddress() + rayGenerationSectionSizeInBytes +
-missSectionSizeInBytes; desc.HitGroupTable.SizeInBytes = hitGroupsSectionSize;
+// The hit groups section comes last. In this sample we have 4 hit groups: 2 for the triangles
+// (1 used when hitting the geometry from a camera ray, 1 when hitting the same geometry from a
+// shadow ray) and 2 for the plane
+desc.HitGroupTable.StartAddress = sbtAddress + m_sbtHelper.GetHitGroupSectionOffset();
+desc.HitGroupTable.SizeInBytes = m_sbtHelper.GetHitGroupSectionSize();
 desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
 
-
-
 */
 
 #ifndef SHADER_BINDING_GENERATOR_GUARD
@@ -111,6 +93,9 @@ desc.HitGroupTable.StrideInBytes = m_sbtHelper.GetHitGroupEntrySize();
 #pragma once
 
 #include "d3d12.h"
+#include "ShaderBindingTableLayout.h"
+#include "ShaderSymbolTable.h"
+#include <memory>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -121,28 +106,55 @@ namespace NvHelpers
 class ShaderBindingTableGenerator
 {
 public:
+  ShaderBindingTableGenerator();
+  /// Use a symbol table shared with other generators, typically the RayTracingPipelineGenerator
+  /// creating the pipeline. The table must outlive the generator
+  explicit ShaderBindingTableGenerator(ShaderSymbolTable& symbols);
+  ShaderBindingTableGenerator(const ShaderBindingTableGenerator&) = delete;
+  ShaderBindingTableGenerator& operator=(const ShaderBindingTableGenerator&) = delete;
+  ~ShaderBindingTableGenerator();
+
   /// Add a ray generation program by name, with its list of data pointers or values according to
-  /// the layout of its root signature
-  void AddRayGenerationProgram(const std::wstring& entryPoint, const std::vector<void*>& inputData);
+  /// the layout of its root signature. Returns the index of the program in its section
+  uint32_t AddRayGenerationProgram(const std::wstring& entryPoint,
+                                   const std::vector<void*>& inputData);
+  uint32_t AddRayGenerationProgram(ShaderSymbol entryPoint, const std::vector<void*>& inputData);
 
   /// Add a miss program by name, with its list of data pointers or values according to
-  /// the layout of its root signature
-  void AddMissProgram(const std::wstring& entryPoint, const std::vector<void*>& inputData);
+  /// the layout of its root signature. Returns the index of the program in its section
+  uint32_t AddMissProgram(const std::wstring& entryPoint, const std::vector<void*>& inputData);
+  uint32_t AddMissProgram(ShaderSymbol entryPoint, const std::vector<void*>& inputData);
 
   /// Add a hit group by name, with its list of data pointers or values according to
-  /// the layout of its root signature
-  void AddHitGroup(const std::wstring& entryPoint, const std::vector<void*>& inputData);
+  /// the layout of its root signature. Returns the index of the hit group in its section
+  uint32_t AddHitGroup(const std::wstring& entryPoint, const std::vector<void*>& inputData);
+  uint32_t AddHitGroup(ShaderSymbol entryPoint, const std::vector<void*>& inputData);
 
   /// Compute the size of the SBT based on the set of programs and hit groups it contains
   uint32_t ComputeSBTSize();
 
   /// Build the SBT and store it into sbtBuffer, which has to be pre-allocated on the upload heap.
   /// Access to the raytracing pipeline object is required to fetch program identifiers using their
-  /// names
+  /// names. The buffer stays mapped, and referenced, until the next Reset so that records can be
+  /// patched in place
   void Generate(ID3D12Resource* sbtBuffer,
                 ID3D12StateObjectProperties* raytracingPipeline);
 
-  /// Reset the sets of programs and hit groups
+  /// Replace the root arguments of a single record of the SBT written by the last Generate, e.g.
+  /// when the resources of a hit group change. The other records, and the layout, are left
+  /// untouched, so the new arguments must fit in the stride of the section. The record must not
+  /// be read by a DispatchRays still executing on the GPU
+  void UpdateRayGenerationProgram(uint32_t index, const std::vector<void*>& inputData);
+  void UpdateMissProgram(uint32_t index, const std::vector<void*>& inputData);
+  void UpdateHitGroup(uint32_t index, const std::vector<void*>& inputData);
+
+  /// Fetch the shader identifiers again from a new pipeline exporting the same programs, e.g. after
+  /// shaders have been recompiled, and rewrite the identifiers of the records they changed. The
+  /// root arguments and the layout are left untouched. Returns the number of records rewritten.
+  /// The SBT must not be read by a DispatchRays still executing on the GPU
+  uint32_t UpdateShaderIdentifiers(ID3D12StateObjectProperties* raytracingPipeline);
+
+  /// Reset the sets of programs and hit groups, and release the SBT buffer
   void Reset();
 
   /// The following getters are used to simplify the call to DispatchRays where the offsets of the
@@ -153,52 +165,70 @@ public:
   /// Get the size in bytes of one ray generation program entry in the SBT
   UINT GetRayGenEntrySize() const;
 
+  /// Get the offset in bytes of the miss programs from the start of the SBT
+  UINT GetMissSectionOffset() const;
   /// Get the size in bytes of the SBT section dedicated to miss programs
   UINT GetMissSectionSize() const;
   /// Get the size in bytes of one miss program entry in the SBT
-  UINT GetMissEntrySize();
+  UINT GetMissEntrySize() const;
 
+  /// Get the offset in bytes of the hit groups from the start of the SBT
+  UINT GetHitGroupSectionOffset() const;
   /// Get the size in bytes of the SBT section dedicated to hit groups
   UINT GetHitGroupSectionSize() const;
   /// Get the size in bytes of hit group entry in the SBT
   UINT GetHitGroupEntrySize() const;
 
+  /// Layout of the SBT as computed by ComputeSBTSize
+  const ShaderBindingTableLayout& GetLayout() const { return m_layout; }
+
 private:
-  /// Wrapper for SBT entries, each consisting of the name of the program and a list of values,
+  using Section = ShaderBindingTableLayout::Section;
+
+  /// Wrapper for SBT entries, each consisting of the symbol of the program and a list of values,
   /// which can be either pointers or raw 32-bit constants
   struct SBTEntry
   {
-    SBTEntry(std::wstring entryPoint, std::vector<void*> inputData);
-
-    const std::wstring m_entryPoint;
-    const std::vector<void*> m_inputData;
+    ShaderSymbol m_entryPoint;
+    std::vector<void*> m_inputData;
+    /// Copy of the shader identifier, resolved from the entry point by Generate. Kept by value so
+    /// that it can be compared with the identifier given by a new pipeline
+    uint8_t m_identifier[ShaderBindingTableLayout::kShaderIdentifierSize] = {};
   };
 
-  /// For each entry, copy the shader identifier followed by its resource pointers and/or root
-  /// constants in outputData, with a stride in bytes of entrySize, and returns the size in bytes
-  /// actually written to outputData.
-  uint32_t CopyShaderData(ID3D12StateObjectProperties* raytracingPipeline,
-                          uint8_t* outputData, const std::vector<SBTEntry>& shaders,
-                          uint32_t entrySize);
-
-  /// Compute the size of the SBT entries for a set of entries, which is determined by the maximum
-  /// number of parameters of their root signature
-  uint32_t GetEntrySize(const std::vector<SBTEntry>& entries);
-
-  std::vector<SBTEntry> m_rayGen;
-  std::vector<SBTEntry> m_miss;
-  std::vector<SBTEntry> m_hitGroup;
-
-  /// For each category, the size of an entry in the SBT depends on the maximum number of resources
-  /// used by the shaders in that category.The helper computes those values automatically in
-  /// GetEntrySize()
-  uint32_t m_rayGenEntrySize;
-  uint32_t m_missEntrySize;
-  uint32_t m_hitGroupEntrySize;
-
-  /// The program names are translated into program identifiers.The size in bytes of an identifier
-  /// is provided by the device and is the same for all categories.
-  UINT m_progIdSize;
+  uint32_t AddEntry(Section section, ShaderSymbol entryPoint,
+                    const std::vector<void*>& inputData);
+
+  /// Get the identifier of a program from the pipeline, looking it up once per symbol
+  const void* ResolveIdentifier(ID3D12StateObjectProperties* raytracingPipeline,
+                                ShaderSymbol entryPoint);
+
+  /// Patch the root arguments of an entry in the mapped SBT
+  void UpdateEntry(Section section, uint32_t index, const std::vector<void*>& inputData);
+
+  /// Copy the shader identifier of an entry followed by its resource pointers and/or root
+  /// constants at its offset in the mapped SBT
+  void WriteEntry(Section section, uint32_t index);
+
+  /// Unmap and release the SBT buffer
+  void ReleaseBuffer();
+
+  /// Table owned by the generator when none is shared with it
+  std::unique_ptr<ShaderSymbolTable> m_ownedSymbols;
+  ShaderSymbolTable* m_symbols;
+
+  std::vector<SBTEntry> m_entries[ShaderBindingTableLayout::kSectionCount];
+
+  /// Identifiers resolved by the current Generate, indexed by symbol
+  std::vector<const void*> m_identifiers;
+
+  /// Offsets and strides of the entries. For each category, the size of an entry in the SBT
+  /// depends on the maximum number of resources used by the shaders in that category
+  ShaderBindingTableLayout m_layout;
+
+  /// SBT written by the last Generate, kept mapped for patching
+  ID3D12Resource* m_sbtBuffer = nullptr;
+  uint8_t* m_mappedData = nullptr;
 };
 } // namespace NvHelpers
 #endif
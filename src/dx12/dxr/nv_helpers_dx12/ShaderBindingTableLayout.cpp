@@ -0,0 +1,144 @@
+#include "ShaderBindingTableLayout.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace NvHelpers
+{
+namespace
+{
+uint32_t AlignUp(uint32_t value, uint32_t alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+} // namespace
+
+//--------------------------------------------------------------------------------------------------
+//
+// Add a record with the given number of root arguments at the end of a section, and return its
+// index within the section
+uint32_t ShaderBindingTableLayout::AddRecord(Section section, uint32_t argumentCount)
+{
+  std::vector<uint32_t>& counts =
+      m_sections[static_cast<uint32_t>(section)].argumentCounts;
+  counts.push_back(argumentCount);
+  m_computed = false;
+  return static_cast<uint32_t>(counts.size() - 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Remove all the records
+void ShaderBindingTableLayout::Reset()
+{
+  for (SectionLayout& section : m_sections)
+  {
+    section = SectionLayout();
+  }
+  m_totalSize = 0;
+  m_computed = false;
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Compute the offsets and strides of all the sections. The stride of a section is given by its
+// largest record, and each section starts on a table boundary so that its address can be used
+// directly in D3D12_DISPATCH_RAYS_DESC
+uint32_t ShaderBindingTableLayout::Compute()
+{
+  uint32_t offset = 0;
+  for (SectionLayout& section : m_sections)
+  {
+    uint32_t maxArguments = 0;
+    for (uint32_t count : section.argumentCounts)
+    {
+      maxArguments = std::max<uint32_t>(maxArguments, count);
+    }
+    section.stride =
+        AlignUp(kShaderIdentifierSize + kArgumentSize * maxArguments, kRecordAlignment);
+
+    offset = AlignUp(offset, kTableAlignment);
+    section.offset = offset;
+    offset += section.stride * static_cast<uint32_t>(section.argumentCounts.size());
+  }
+
+  m_totalSize = AlignUp(offset, kSizeAlignment);
+  m_computed = true;
+  return m_totalSize;
+}
+
+uint32_t ShaderBindingTableLayout::GetTotalSize() const
+{
+  CheckComputed();
+  return m_totalSize;
+}
+
+uint32_t ShaderBindingTableLayout::GetSectionOffset(Section section) const
+{
+  CheckComputed();
+  return GetSection(section).offset;
+}
+
+uint32_t ShaderBindingTableLayout::GetSectionSize(Section section) const
+{
+  CheckComputed();
+  const SectionLayout& layout = GetSection(section);
+  return layout.stride * static_cast<uint32_t>(layout.argumentCounts.size());
+}
+
+uint32_t ShaderBindingTableLayout::GetRecordStride(Section section) const
+{
+  CheckComputed();
+  return GetSection(section).stride;
+}
+
+uint32_t ShaderBindingTableLayout::GetRecordCount(Section section) const
+{
+  return static_cast<uint32_t>(GetSection(section).argumentCounts.size());
+}
+
+uint32_t ShaderBindingTableLayout::GetRecordOffset(Section section, uint32_t index) const
+{
+  CheckComputed();
+  const SectionLayout& layout = GetSection(section);
+  if (index >= layout.argumentCounts.size())
+  {
+    throw std::out_of_range("Shader binding table record index out of range");
+  }
+  return layout.offset + layout.stride * index;
+}
+
+uint32_t ShaderBindingTableLayout::GetRecordArgumentCount(Section section, uint32_t index) const
+{
+  const SectionLayout& layout = GetSection(section);
+  if (index >= layout.argumentCounts.size())
+  {
+    throw std::out_of_range("Shader binding table record index out of range");
+  }
+  return layout.argumentCounts[index];
+}
+
+uint32_t ShaderBindingTableLayout::GetArgumentCapacity(Section section) const
+{
+  CheckComputed();
+  return (GetSection(section).stride - kShaderIdentifierSize) / kArgumentSize;
+}
+
+const ShaderBindingTableLayout::SectionLayout& ShaderBindingTableLayout::GetSection(
+    Section section) const
+{
+  const uint32_t index = static_cast<uint32_t>(section);
+  if (index >= kSectionCount)
+  {
+    throw std::out_of_range("Invalid shader binding table section");
+  }
+  return m_sections[index];
+}
+
+void ShaderBindingTableLayout::CheckComputed() const
+{
+  if (!m_computed)
+  {
+    throw std::logic_error("The shader binding table layout must be computed first");
+  }
+}
+} // namespace NvHelpers
@@ -0,0 +1,107 @@
+/*
+The ShaderBindingTableLayout computes where each record of a shader binding table lives: the
+offset, size and stride of the ray generation, miss and hit group sections, and the offset of
+every record within them. It only deals with sizes and alignments, and does not depend on any
+D3D12 header, so that the layout rules can be checked independently of a device.
+
+Sections start on a table boundary (64 bytes), records are aligned on 32 bytes, and all the
+records of a section share the stride of its largest record. A record is made of a shader
+identifier followed by its root arguments, each taking 8 bytes.
+
+Example:
+
+ShaderBindingTableLayout layout;
+layout.AddRecord(ShaderBindingTableLayout::Section::RayGen, 1);
+layout.AddRecord(ShaderBindingTableLayout::Section::Miss, 0);
+uint32_t hitGroup = layout.AddRecord(ShaderBindingTableLayout::Section::HitGroup, 1);
+uint32_t sbtSize = layout.Compute();
+
+uint32_t offset = layout.GetRecordOffset(ShaderBindingTableLayout::Section::HitGroup, hitGroup);
+*/
+
+#ifndef SHADER_BINDING_TABLE_LAYOUT_GUARD
+#define SHADER_BINDING_TABLE_LAYOUT_GUARD
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace NvHelpers
+{
+/// Device independent layout of a shader binding table
+class ShaderBindingTableLayout
+{
+public:
+  /// Sections of the table, in the order they are laid out
+  enum class Section : uint32_t
+  {
+    RayGen = 0,
+    Miss = 1,
+    HitGroup = 2
+  };
+  static constexpr uint32_t kSectionCount = 3;
+
+  /// Size of a shader identifier (D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES)
+  static constexpr uint32_t kShaderIdentifierSize = 32;
+  /// Alignment of a record (D3D12_RAYTRACING_SHADER_RECORD_BYTE_ALIGNMENT)
+  static constexpr uint32_t kRecordAlignment = 32;
+  /// Alignment of the start of a section (D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT)
+  static constexpr uint32_t kTableAlignment = 64;
+  /// Size of a root argument, either a pointer, a descriptor handle or a pair of 32-bit constants
+  static constexpr uint32_t kArgumentSize = 8;
+  /// Alignment of the total size of the table
+  static constexpr uint32_t kSizeAlignment = 256;
+
+  /// Add a record with the given number of root arguments at the end of a section, and return its
+  /// index within the section. Invalidates the layout until the next call to Compute
+  uint32_t AddRecord(Section section, uint32_t argumentCount);
+
+  /// Remove all the records
+  void Reset();
+
+  /// Compute the offsets and strides of all the sections, and return the total size of the table
+  uint32_t Compute();
+
+  /// Whether Compute has been called since the last change of records
+  bool IsComputed() const { return m_computed; }
+
+  /// Total size of the table, a multiple of kSizeAlignment
+  uint32_t GetTotalSize() const;
+
+  /// Offset of the section from the start of the table, a multiple of kTableAlignment
+  uint32_t GetSectionOffset(Section section) const;
+  /// Size of the section, excluding the padding up to the next section
+  uint32_t GetSectionSize(Section section) const;
+  /// Distance between two consecutive records of the section
+  uint32_t GetRecordStride(Section section) const;
+  /// Number of records in the section
+  uint32_t GetRecordCount(Section section) const;
+
+  /// Offset of a record from the start of the table
+  uint32_t GetRecordOffset(Section section, uint32_t index) const;
+  /// Number of root arguments declared for a record
+  uint32_t GetRecordArgumentCount(Section section, uint32_t index) const;
+  /// Maximum number of root arguments any record of the section can hold without changing the
+  /// layout
+  uint32_t GetArgumentCapacity(Section section) const;
+
+private:
+  struct SectionLayout
+  {
+    std::vector<uint32_t> argumentCounts;
+    uint32_t offset = 0;
+    uint32_t stride = 0;
+  };
+
+  const SectionLayout& GetSection(Section section) const;
+  /// Throw if the layout is not up to date
+  void CheckComputed() const;
+
+  SectionLayout m_sections[kSectionCount];
+  uint32_t m_totalSize = 0;
+  bool m_computed = false;
+};
+} // namespace NvHelpers
+
+#endif // !SHADER_BINDING_TABLE_LAYOUT_GUARD
@@ -0,0 +1,61 @@
+#include "ShaderSymbolTable.h"
+#include <stdexcept>
+
+namespace NvHelpers
+{
+
+//--------------------------------------------------------------------------------------------------
+//
+// The first symbol is reserved for the empty name
+ShaderSymbolTable::ShaderSymbolTable()
+{
+  m_names.emplace_back();
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Return the symbol of a name, adding the name to the table on first use
+ShaderSymbol ShaderSymbolTable::Intern(std::wstring_view name)
+{
+  if (name.empty())
+  {
+    return kNullShaderSymbol;
+  }
+
+  auto it = m_symbols.find(name);
+  if (it != m_symbols.end())
+  {
+    return it->second;
+  }
+
+  const ShaderSymbol symbol = static_cast<ShaderSymbol>(m_names.size());
+  if (symbol == kInvalidShaderSymbol)
+  {
+    throw std::length_error("Too many shader symbols");
+  }
+  // The key references the stored copy of the name, not the caller's string
+  const std::wstring& stored = m_names.emplace_back(name);
+  m_symbols.emplace(std::wstring_view(stored), symbol);
+  return symbol;
+}
+
+ShaderSymbol ShaderSymbolTable::Find(std::wstring_view name) const
+{
+  if (name.empty())
+  {
+    return kNullShaderSymbol;
+  }
+
+  auto it = m_symbols.find(name);
+  return it == m_symbols.end() ? kInvalidShaderSymbol : it->second;
+}
+
+const wchar_t* ShaderSymbolTable::GetName(ShaderSymbol symbol) const
+{
+  if (symbol >= m_names.size())
+  {
+    throw std::out_of_range("Unknown shader symbol");
+  }
+  return symbol == kNullShaderSymbol ? nullptr : m_names[symbol].c_str();
+}
+} // namespace NvHelpers
@@ -0,0 +1,71 @@
+/*
+The ShaderSymbolTable interns the names of the shaders and hit groups used by the raytracing
+pipeline and the shader binding table. Each name is stored once and referred to by a compact
+ShaderSymbol, so that the generators copy, compare and hash integers instead of strings. The
+symbols are dense indices, which lets per-symbol data such as resolved shader identifiers be
+kept in plain arrays. The table does not depend on any D3D12 header.
+
+Example:
+
+ShaderSymbolTable symbols;
+ShaderSymbol hitGroup = symbols.Intern(L"HitGroup");
+
+RayTracingPipelineGenerator pipeline(device, symbols);
+pipeline.AddHitGroup(hitGroup, symbols.Intern(L"ClosestHit"));
+
+ShaderBindingTableGenerator sbt(symbols);
+sbt.AddHitGroup(hitGroup, {});
+*/
+
+#ifndef SHADER_SYMBOL_TABLE_GUARD
+#define SHADER_SYMBOL_TABLE_GUARD
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace NvHelpers
+{
+/// Index of an interned shader name
+using ShaderSymbol = uint32_t;
+
+/// Symbol of the empty name, used for the optional shaders of a hit group
+static constexpr ShaderSymbol kNullShaderSymbol = 0;
+/// Returned by Find for unknown names
+static constexpr ShaderSymbol kInvalidShaderSymbol = ~0u;
+
+/// Table of interned shader names
+class ShaderSymbolTable
+{
+public:
+  ShaderSymbolTable();
+  ShaderSymbolTable(const ShaderSymbolTable&) = delete;
+  ShaderSymbolTable& operator=(const ShaderSymbolTable&) = delete;
+
+  /// Return the symbol of a name, adding the name to the table on first use. The empty name
+  /// always maps to kNullShaderSymbol
+  ShaderSymbol Intern(std::wstring_view name);
+
+  /// Return the symbol of a name, or kInvalidShaderSymbol if it has never been interned
+  ShaderSymbol Find(std::wstring_view name) const;
+
+  /// Name of a symbol, as a null-terminated string which stays valid as long as the table. Returns
+  /// nullptr for kNullShaderSymbol, which is what D3D12 expects for an unused hit group shader
+  const wchar_t* GetName(ShaderSymbol symbol) const;
+
+  /// Number of symbols, including kNullShaderSymbol. Symbols are lower than this value
+  uint32_t GetSize() const { return static_cast<uint32_t>(m_names.size()); }
+
+private:
+  /// Interned names, indexed by symbol. A deque never moves its elements, so the names and the
+  /// views referencing them stay valid when the table grows
+  std::deque<std::wstring> m_names;
+  std::unordered_map<std::wstring_view, ShaderSymbol> m_symbols;
+};
+} // namespace NvHelpers
+
+#endif // !SHADER_SYMBOL_TABLE_GUARD
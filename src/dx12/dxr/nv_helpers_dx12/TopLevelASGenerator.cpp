@@ -46,6 +46,11 @@ buffer needs to be kept until the command list execution is finished.
 */
 
 #include "TopLevelASGenerator.h"
+#include "dx12/Profiler.h"
+#include "dx12/WorkerPool.h"
+
+#include <algorithm>
+#include <emmintrin.h>
 
 // Helper to compute aligned buffer sizes
 #ifndef ROUND_UP
@@ -73,10 +78,29 @@ void TopLevelASGenerator::AddInstance(
                                         // hit group in the Shader Binding Table that will be
                                         // invocated upon hitting the geometry
 )
+{
+  AddInstance(bottomLevelAS->GetGPUVirtualAddress(), transform, instanceID, hitGroupIndex);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Same, with the GPU address of the bottom-level AS
+void TopLevelASGenerator::AddInstance(D3D12_GPU_VIRTUAL_ADDRESS bottomLevelAS,
+                                      const DirectX::XMMATRIX& transform, UINT instanceID,
+                                      UINT hitGroupIndex)
 {
   m_instances.emplace_back(Instance(bottomLevelAS, transform, instanceID, hitGroupIndex));
 }
 
+//--------------------------------------------------------------------------------------------------
+//
+// Remove all the instances, so that they can be added again with new transforms
+// before an update. The build flags and buffer sizes are kept
+void TopLevelASGenerator::ClearInstances()
+{
+  m_instances.clear();
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 // Compute the size of the scratch space required to build the acceleration
@@ -159,43 +183,20 @@ void TopLevelASGenerator::Generate(
                                                  // is requested
 )
 {
-  // Copy the descriptors in the target descriptor buffer
+  PROFILE_ZONE("TopLevelASGenerator::Generate");
+  // Copy the descriptors in the target descriptor buffer. The CPU never reads from the upload
+  // heap, so an empty read range is given to the driver
   D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs;
-  descriptorsBuffer->Map(0, nullptr, reinterpret_cast<void**>(&instanceDescs));
+  D3D12_RANGE readRange = {0, 0};
+  descriptorsBuffer->Map(0, &readRange, reinterpret_cast<void**>(&instanceDescs));
   if (!instanceDescs)
   {
     throw std::logic_error("Cannot map the instance descriptor buffer - is it "
                            "in the upload heap?");
   }
 
-  auto instanceCount = static_cast<UINT>(m_instances.size());
-
-  // Initialize the memory to zero on the first time only
-  if (!updateOnly)
-  {
-    ZeroMemory(instanceDescs, m_instanceDescsSizeInBytes);
-  }
-
-  // Create the description for each instance
-  for (uint32_t i = 0; i < instanceCount; i++)
-  {
-    // Instance ID visible in the shader in InstanceID()
-    instanceDescs[i].InstanceID = m_instances[i].instanceID;
-    // Index of the hit group invoked upon intersection
-    instanceDescs[i].InstanceContributionToHitGroupIndex = m_instances[i].hitGroupIndex;
-    // Instance flags, including backface culling, winding, etc - TODO: should
-    // be accessible from outside
-    instanceDescs[i].Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-    // Instance transform matrix
-    DirectX::XMMATRIX m = XMMatrixTranspose(
-        m_instances[i].transform); // GLM is column major, the INSTANCE_DESC is row major
-    memcpy(instanceDescs[i].Transform, &m, sizeof(instanceDescs[i].Transform));
-    // Get access to the bottom level
-    instanceDescs[i].AccelerationStructure = m_instances[i].bottomLevelAS->GetGPUVirtualAddress();
-    // Visibility mask, always visible here - TODO: should be accessible from
-    // outside
-    instanceDescs[i].InstanceMask = 0xFF;
-  }
+  WriteInstanceDescs(instanceDescs);
+  const size_t instanceCount = m_instances.size();
 
   descriptorsBuffer->Unmap(0, nullptr);
 
@@ -205,10 +206,11 @@ void TopLevelASGenerator::Generate(
   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags = m_flags;
   // The stored flags represent whether the AS has been built for updates or
   // not. If yes and an update is requested, the builder is told to only update
-  // the AS instead of fully rebuilding it
+  // the AS instead of fully rebuilding it. The update must keep the flags of the
+  // original build
   if (flags == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE && updateOnly)
   {
-    flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+    flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
   }
 
   // Sanity checks
@@ -227,7 +229,7 @@ void TopLevelASGenerator::Generate(
   buildDesc.Inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
   buildDesc.Inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
   buildDesc.Inputs.InstanceDescs = descriptorsBuffer->GetGPUVirtualAddress();
-  buildDesc.Inputs.NumDescs = instanceCount;
+  buildDesc.Inputs.NumDescs = static_cast<UINT>(instanceCount);
   buildDesc.DestAccelerationStructureData = {resultBuffer->GetGPUVirtualAddress()
                                              };
   buildDesc.ScratchAccelerationStructureData = {scratchBuffer->GetGPUVirtualAddress()
@@ -248,12 +250,95 @@ void TopLevelASGenerator::Generate(
   commandList->ResourceBarrier(1, &uavBarrier);
 }
 
+//--------------------------------------------------------------------------------------------------
+//
+// Every field of each descriptor is written, so the destination does not need to be cleared
+// beforehand. Large instance counts are split across the threads of the shared worker pool, which
+// are started once for the whole process, each task filling a contiguous range of descriptors. The
+// ranges are multiples of 4 descriptors (256 bytes) so that two threads never share a cache line of
+// the destination buffer
+void TopLevelASGenerator::WriteInstanceDescs(D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs) const
+{
+  const size_t instanceCount = m_instances.size();
+  if (instanceCount < 2 * kMinInstancesPerWorker)
+  {
+    WriteInstanceDescRange(instanceDescs, 0, instanceCount);
+    return;
+  }
+
+  RaytracingImplementation::WorkerPool& pool = RaytracingImplementation::WorkerPool::GetShared();
+  const size_t taskCount =
+      std::min<size_t>(pool.GetConcurrency(), instanceCount / kMinInstancesPerWorker);
+  const size_t chunkSize = ROUND_UP((instanceCount + taskCount - 1) / taskCount, 4);
+  pool.Run(taskCount, [&](size_t task) {
+    const size_t begin = std::min<size_t>(task * chunkSize, instanceCount);
+    const size_t end = std::min<size_t>(begin + chunkSize, instanceCount);
+    WriteInstanceDescRange(instanceDescs, begin, end);
+  });
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+// Write the descriptors of the instances [begin, end) into the mapped descriptor buffer. The
+// transforms are converted from the 4x4 DirectXMath layout to the 3x4 row-major layout of the
+// instance descriptor with SSE shuffles, and each descriptor is streamed to the destination as four
+// aligned 16-byte non-temporal stores, so that the write-combining buffers are always flushed as
+// complete cache lines
+void TopLevelASGenerator::WriteInstanceDescRange(D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs,
+                                                 size_t begin, size_t end) const
+{
+  PROFILE_ZONE("TopLevelASGenerator::WriteInstanceDescRange");
+  static_assert(sizeof(D3D12_RAYTRACING_INSTANCE_DESC) == 4 * sizeof(__m128i),
+                "Instance descriptors are expected to span exactly 4 SSE registers");
+
+  for (size_t i = begin; i < end; i++)
+  {
+    const Instance& instance = m_instances[i];
+
+    // The descriptor is assembled in an aligned local copy, which stays in L1, and only then
+    // streamed to the upload heap. This avoids partial writes to write-combined memory
+    alignas(16) D3D12_RAYTRACING_INSTANCE_DESC desc;
+
+    // DirectXMath matrices are stored with the translation in the last row, while the instance
+    // descriptor expects it in the last column: the first three rows of the transposed matrix are
+    // exactly the 3x4 transform
+    DirectX::XMMATRIX m = DirectX::XMMatrixTranspose(instance.transform);
+    _mm_store_ps(desc.Transform[0], m.r[0]);
+    _mm_store_ps(desc.Transform[1], m.r[1]);
+    _mm_store_ps(desc.Transform[2], m.r[2]);
+
+    // Instance ID visible in the shader in InstanceID()
+    desc.InstanceID = instance.instanceID;
+    // Visibility mask, always visible here - TODO: should be accessible from
+    // outside
+    desc.InstanceMask = 0xFF;
+    // Index of the hit group invoked upon intersection
+    desc.InstanceContributionToHitGroupIndex = instance.hitGroupIndex;
+    // Instance flags, including backface culling, winding, etc - TODO: should
+    // be accessible from outside
+    desc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
+    // Get access to the bottom level
+    desc.AccelerationStructure = instance.bottomLevelAS;
+
+    const __m128i* src = reinterpret_cast<const __m128i*>(&desc);
+    __m128i* dst = reinterpret_cast<__m128i*>(instanceDescs + i);
+    _mm_stream_si128(dst + 0, _mm_load_si128(src + 0));
+    _mm_stream_si128(dst + 1, _mm_load_si128(src + 1));
+    _mm_stream_si128(dst + 2, _mm_load_si128(src + 2));
+    _mm_stream_si128(dst + 3, _mm_load_si128(src + 3));
+  }
+
+  // Non-temporal stores are weakly ordered: make them globally visible before the buffer is unmapped
+  // and consumed by the GPU
+  _mm_sfence();
+}
+
 //--------------------------------------------------------------------------------------------------
 //
 //
-TopLevelASGenerator::Instance::Instance(ID3D12Resource* blAS, const DirectX::XMMATRIX& tr, UINT iID,
-                                        UINT hgId)
-    : bottomLevelAS(blAS), transform(tr), instanceID(iID), hitGroupIndex(hgId)
+TopLevelASGenerator::Instance::Instance(D3D12_GPU_VIRTUAL_ADDRESS blAS,
+                                        const DirectX::XMMATRIX& tr, UINT iID, UINT hgId)
+    : transform(tr), bottomLevelAS(blAS), instanceID(iID), hitGroupIndex(hgId)
 {
 }
 } // namespace NvHelpers
@@ -102,6 +102,14 @@ public:
                                  /// invocated upon hitting the geometry
   );
 
+  /// Same, with the GPU address of the bottom-level AS
+  void AddInstance(D3D12_GPU_VIRTUAL_ADDRESS bottomLevelAS, const DirectX::XMMATRIX& transform,
+                   UINT instanceID, UINT hitGroupIndex);
+
+  /// Remove all the instances, so that they can be added again with new transforms
+  /// before an update. The build flags and buffer sizes are kept
+  void ClearInstances();
+
   /// Compute the size of the scratch space required to build the acceleration
   /// structure, as well as the size of the resulting structure. The allocation
   /// of the buffers is then left to the application
@@ -135,21 +143,41 @@ public:
                                                /// if an iterative update is requested
   );
 
+  /// Write the descriptors of all the instances, as done by Generate into the mapped descriptor
+  /// buffer. Large instance counts are split over the threads of the shared worker pool, or
+  /// written on the calling thread when it already runs a task of that pool. The destination must
+  /// be 16-byte aligned, and hold GetInstanceCount() descriptors
+  void WriteInstanceDescs(D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs) const;
+
+  size_t GetInstanceCount() const { return m_instances.size(); }
+
 private:
   /// Helper struct storing the instance data
   struct Instance
   {
-    Instance(ID3D12Resource* blAS, const DirectX::XMMATRIX& tr, UINT iID, UINT hgId);
-    /// Bottom-level AS
-    ID3D12Resource* bottomLevelAS;
-    /// Transform matrix
-    const DirectX::XMMATRIX& transform;
+    Instance(D3D12_GPU_VIRTUAL_ADDRESS blAS, const DirectX::XMMATRIX& tr, UINT iID, UINT hgId);
+    /// Transform matrix, stored by value so that the instances can be converted in contiguous
+    /// batches without chasing pointers into application memory
+    DirectX::XMMATRIX transform;
+    /// GPU address of the bottom-level AS, fetched once when the instance is added
+    D3D12_GPU_VIRTUAL_ADDRESS bottomLevelAS;
     /// Instance ID visible in the shader
     UINT instanceID;
     /// Hit group index used to fetch the shaders from the SBT
     UINT hitGroupIndex;
   };
 
+  /// Write the descriptors of the instances [begin, end). Each descriptor is assembled in an aligned
+  /// local copy, which stays in L1, and streamed out as four 16-byte non-temporal stores covering
+  /// its whole 64-byte cache line, which is the access pattern write-combined upload memory is
+  /// designed for
+  void WriteInstanceDescRange(D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs, size_t begin,
+                              size_t end) const;
+
+  /// Minimum number of instances handled by a single thread when filling the descriptors. Below
+  /// this count waking a worker of the pool costs more than the conversion it takes over
+  static constexpr size_t kMinInstancesPerWorker = 16384;
+
   /// Construction flags, indicating whether the AS supports iterative updates
   D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS m_flags;
   /// Instances contained in the top-level AS
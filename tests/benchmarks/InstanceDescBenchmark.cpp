@@ -0,0 +1,88 @@
+#include "TopLevelASGenerator.h"
+#include "dx12/WorkerPool.h"
+#include <chrono>
+#include <cstdio>
+#include <new>
+#include <thread>
+#include <vector>
+
+// Measures how long TopLevelASGenerator takes to fill the instance descriptors of 1K to 1M
+// instances, the CPU part of every top-level AS build or refit. The descriptors are written
+// to ordinary cached memory, so the figures are a lower bound of the writes to a mapped
+// upload heap, which is write-combined. The cost of a parallel loop on the worker pool is
+// compared to spawning and joining one thread per hardware thread, which is what filling
+// the descriptors in parallel would cost without a persistent pool.
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	constexpr uint32_t kRepetitionCount = 20;
+
+	double GetMicroseconds(Clock::duration duration)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+
+	// Best of the repetitions, the least disturbed by the rest of the system
+	template<class Function>
+	double MeasureMicroseconds(uint32_t repetitionCount, Function function)
+	{
+		double best = 0.0;
+		for (uint32_t i = 0; i < repetitionCount; i++)
+		{
+			const Clock::time_point start = Clock::now();
+			function();
+			const double microseconds = GetMicroseconds(Clock::now() - start);
+			best = i == 0 || microseconds < best ? microseconds : best;
+		}
+		return best;
+	}
+}
+
+int main()
+{
+	std::printf("instances,microseconds,ns_per_instance,gb_per_s\n");
+	for (size_t instanceCount = 1024; instanceCount <= 1024 * 1024; instanceCount *= 4)
+	{
+		nv_helpers_dx12::TopLevelASGenerator generator;
+		for (size_t i = 0; i < instanceCount; i++)
+		{
+			const float offset = static_cast<float>(i);
+			generator.AddInstance(D3D12_GPU_VIRTUAL_ADDRESS(0x10000) * (i % 16 + 1),
+				DirectX::XMMatrixRotationY(offset) * DirectX::XMMatrixTranslation(offset, 0.0f, -offset),
+				static_cast<UINT>(i), static_cast<UINT>(i % 2));
+		}
+
+		// Aligned on a cache line, as the placed resources of an upload heap are
+		const size_t size = instanceCount * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
+		D3D12_RAYTRACING_INSTANCE_DESC* instanceDescs =
+			static_cast<D3D12_RAYTRACING_INSTANCE_DESC*>(::operator new(size, std::align_val_t(64)));
+
+		const double microseconds = MeasureMicroseconds(kRepetitionCount,
+			[&]() { generator.WriteInstanceDescs(instanceDescs); });
+		std::printf("%zu,%.1f,%.2f,%.2f\n", instanceCount, microseconds,
+			microseconds * 1000.0 / double(instanceCount), double(size) / (microseconds * 1000.0));
+
+		::operator delete(instanceDescs, std::align_val_t(64));
+	}
+
+	RaytracingImplementation::WorkerPool& pool = RaytracingImplementation::WorkerPool::GetShared();
+	const uint32_t threadCount = pool.GetConcurrency();
+	const double poolMicroseconds = MeasureMicroseconds(kRepetitionCount,
+		[&]() { pool.Run(threadCount, [](size_t) {}); });
+	const double spawnMicroseconds = MeasureMicroseconds(kRepetitionCount, [&]()
+		{
+			std::vector<std::thread> threads;
+			for (uint32_t i = 1; i < threadCount; i++)
+			{
+				threads.emplace_back([]() {});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		});
+	std::printf("\nempty parallel loop on %u threads: pool %.1f us, spawn and join %.1f us\n",
+		threadCount, poolMicroseconds, spawnMicroseconds);
+	return 0;
+}
@@ -0,0 +1,187 @@
+#include "ShaderSymbolTable.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Measures the CPU bookkeeping of the pipeline and shader binding table generators for 10K
+// hit groups, with the names kept as strings, as the generators did before, and as symbols
+// of a ShaderSymbolTable. Each hit group is declared to the pipeline with its closest hit
+// shader, given one SBT record, then the exports of the pipeline are gathered without
+// duplicates and the shader identifier of every record is resolved. The identifiers come
+// from a map standing for the state object, queried once per name in both cases, so that
+// only the work the symbols remove is compared.
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using NvHelpers::ShaderSymbol;
+	using NvHelpers::ShaderSymbolTable;
+
+	constexpr uint32_t kHitGroupCount = 10000;
+	constexpr uint32_t kRepetitionCount = 20;
+	constexpr size_t kShaderIdentifierSize = 32;
+
+	// Best of the repetitions, the least disturbed by the rest of the system
+	template<class Function>
+	double MeasureMicroseconds(uint32_t repetitionCount, Function function)
+	{
+		double best = 0.0;
+		for (uint32_t i = 0; i < repetitionCount; i++)
+		{
+			const Clock::time_point start = Clock::now();
+			function();
+			const double microseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+			best = i == 0 || microseconds < best ? microseconds : best;
+		}
+		return best;
+	}
+
+	struct Names
+	{
+		std::vector<std::wstring> hitGroups;
+		std::vector<std::wstring> closestHits;
+	};
+
+	// Stands for ID3D12StateObjectProperties::GetShaderIdentifier
+	class StateObject
+	{
+	public:
+		explicit StateObject(const Names& names)
+		{
+			for (uint32_t i = 0; i < kHitGroupCount; i++)
+			{
+				m_identifiers.emplace(names.hitGroups[i], m_storage.data() + i % m_storage.size());
+			}
+		}
+
+		const void* GetShaderIdentifier(const wchar_t* name) const
+		{
+			auto it = m_identifiers.find(name);
+			return it == m_identifiers.end() ? nullptr : it->second;
+		}
+
+	private:
+		std::vector<uint8_t> m_storage = std::vector<uint8_t>(kShaderIdentifierSize * 64);
+		std::unordered_map<std::wstring, const void*> m_identifiers;
+	};
+
+	struct StringEntry
+	{
+		std::wstring entryPoint;
+		uint8_t identifier[kShaderIdentifierSize];
+	};
+
+	// The hit groups and records hold copies of the names, the exports are deduplicated in a
+	// set of strings and the identifiers cached in a map of strings
+	size_t RunWithStrings(const Names& names, const StateObject& stateObject)
+	{
+		std::vector<std::pair<std::wstring, std::wstring>> hitGroups;
+		std::vector<StringEntry> entries;
+		for (uint32_t i = 0; i < kHitGroupCount; i++)
+		{
+			hitGroups.emplace_back(names.hitGroups[i], names.closestHits[i]);
+			entries.push_back({ names.hitGroups[i], {} });
+		}
+
+		std::unordered_set<std::wstring> exports;
+		for (const auto& hitGroup : hitGroups)
+		{
+			exports.insert(hitGroup.first);
+			exports.insert(hitGroup.second);
+		}
+
+		std::unordered_map<std::wstring, const void*> identifiers;
+		for (StringEntry& entry : entries)
+		{
+			auto it = identifiers.find(entry.entryPoint);
+			if (it == identifiers.end())
+			{
+				it = identifiers.emplace(entry.entryPoint, stateObject.GetShaderIdentifier(entry.entryPoint.c_str())).first;
+			}
+			std::memcpy(entry.identifier, it->second, kShaderIdentifierSize);
+		}
+		return exports.size() + entries.size();
+	}
+
+	struct SymbolEntry
+	{
+		ShaderSymbol entryPoint;
+		uint8_t identifier[kShaderIdentifierSize];
+	};
+
+	// The names are interned once, the hit groups and records hold symbols, and the exports
+	// and identifiers are kept in arrays indexed by symbol
+	size_t RunWithSymbols(const Names& names, const StateObject& stateObject)
+	{
+		ShaderSymbolTable symbols;
+		std::vector<std::pair<ShaderSymbol, ShaderSymbol>> hitGroups;
+		std::vector<SymbolEntry> entries;
+		for (uint32_t i = 0; i < kHitGroupCount; i++)
+		{
+			const ShaderSymbol hitGroup = symbols.Intern(names.hitGroups[i]);
+			hitGroups.emplace_back(hitGroup, symbols.Intern(names.closestHits[i]));
+			entries.push_back({ hitGroup, {} });
+		}
+
+		std::vector<bool> isExported(symbols.GetSize(), false);
+		size_t exportCount = 0;
+		for (const auto& hitGroup : hitGroups)
+		{
+			for (ShaderSymbol symbol : { hitGroup.first, hitGroup.second })
+			{
+				if (!isExported[symbol])
+				{
+					isExported[symbol] = true;
+					exportCount++;
+				}
+			}
+		}
+
+		std::vector<const void*> identifiers(symbols.GetSize(), nullptr);
+		for (SymbolEntry& entry : entries)
+		{
+			const void*& identifier = identifiers[entry.entryPoint];
+			if (!identifier)
+			{
+				identifier = stateObject.GetShaderIdentifier(symbols.GetName(entry.entryPoint));
+			}
+			std::memcpy(entry.identifier, identifier, kShaderIdentifierSize);
+		}
+		return exportCount + entries.size();
+	}
+}
+
+int main()
+{
+	// Names as long as the ones generated for per-material hit groups, beyond the small
+	// string buffer of std::wstring
+	Names names;
+	for (uint32_t i = 0; i < kHitGroupCount; i++)
+	{
+		names.hitGroups.push_back(L"MaterialHitGroup_" + std::to_wstring(i));
+		names.closestHits.push_back(L"MaterialClosestHit_" + std::to_wstring(i));
+	}
+	const StateObject stateObject(names);
+
+	size_t checksum = 0;
+	const double stringMicroseconds = MeasureMicroseconds(kRepetitionCount,
+		[&]() { checksum += RunWithStrings(names, stateObject); });
+	const double symbolMicroseconds = MeasureMicroseconds(kRepetitionCount,
+		[&]() { checksum -= RunWithSymbols(names, stateObject); });
+	if (checksum != 0)
+	{
+		std::printf("the string and symbol versions disagree\n");
+		return 1;
+	}
+
+	std::printf("names,microseconds\n");
+	std::printf("strings,%.1f\n", stringMicroseconds);
+	std::printf("symbols,%.1f\n", symbolMicroseconds);
+	std::printf("\n%u hit groups: symbols are %.2fx as fast as strings\n", kHitGroupCount,
+		stringMicroseconds / symbolMicroseconds);
+	return 0;
+}
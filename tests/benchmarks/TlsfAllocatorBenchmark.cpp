@@ -0,0 +1,168 @@
+#include "TlsfAllocator.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+// Measures the cost of an allocation and of a release in a heap managed by TlsfAllocator,
+// under a churn of buffers of the sizes placed by BufferAllocator: acceleration structures
+// and scratch buffers from 256 bytes to 2MB, some of them placed on the 64KB resource
+// alignment. The same sequence is replayed on a first-fit free list kept sorted by offset,
+// whose search grows with the number of free blocks, and the fragmentation of the heap is
+// reported once the churn is over.
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+	using RaytracingImplementation::TlsfAllocator;
+
+	constexpr uint64_t kHeapSize = 256ull * 1024 * 1024;
+	constexpr uint64_t kPlacementAlignment = 64 * 1024;
+	constexpr uint32_t kOperationCount = 100000;
+
+	struct Operation
+	{
+		uint64_t size;
+		uint64_t alignment;
+		// Index of the allocation to release before allocating, or ~0u
+		uint32_t release;
+	};
+
+	// Keeps liveCount allocations alive, releasing a random one before each new one
+	std::vector<Operation> MakeOperations(uint32_t liveCount)
+	{
+		std::mt19937_64 random(29);
+		std::vector<Operation> operations;
+		std::vector<uint32_t> live;
+		for (uint32_t i = 0; i < kOperationCount; i++)
+		{
+			// Sizes spread over 256 bytes to 2MB, the small ones the most frequent
+			const uint32_t log2 = 8 + uint32_t(random() % 13) * uint32_t(random() % 2 + 1) / 2;
+			const uint64_t size = (1ull << log2) + random() % (1ull << log2);
+			const uint64_t alignment = random() % 4 == 0 ? kPlacementAlignment : TlsfAllocator::kMinAlignment;
+			uint32_t release = ~0u;
+			if (live.size() == liveCount)
+			{
+				const size_t victim = random() % live.size();
+				release = live[victim];
+				live[victim] = live.back();
+				live.pop_back();
+			}
+			live.push_back(i);
+			operations.push_back({ size, alignment, release });
+		}
+		return operations;
+	}
+
+	// First fit over the free blocks sorted by offset, merging the neighbours on release
+	class FirstFitAllocator
+	{
+	public:
+		explicit FirstFitAllocator(uint64_t size) { m_free.emplace(0, size); }
+
+		uint64_t Allocate(uint64_t size, uint64_t alignment)
+		{
+			size = (size + TlsfAllocator::kMinAlignment - 1) & ~(TlsfAllocator::kMinAlignment - 1);
+			for (auto it = m_free.begin(); it != m_free.end(); ++it)
+			{
+				const uint64_t offset = (it->first + alignment - 1) & ~(alignment - 1);
+				if (offset + size > it->first + it->second)
+				{
+					continue;
+				}
+				const uint64_t blockOffset = it->first;
+				const uint64_t blockEnd = it->first + it->second;
+				m_free.erase(it);
+				if (offset != blockOffset)
+				{
+					m_free.emplace(blockOffset, offset - blockOffset);
+				}
+				if (offset + size != blockEnd)
+				{
+					m_free.emplace(offset + size, blockEnd - offset - size);
+				}
+				m_allocations.emplace(offset, size);
+				return offset;
+			}
+			return TlsfAllocator::kInvalidOffset;
+		}
+
+		void Free(uint64_t offset)
+		{
+			auto allocation = m_allocations.find(offset);
+			uint64_t size = allocation->second;
+			m_allocations.erase(allocation);
+
+			auto next = m_free.lower_bound(offset);
+			if (next != m_free.end() && offset + size == next->first)
+			{
+				size += next->second;
+				next = m_free.erase(next);
+			}
+			if (next != m_free.begin() && std::prev(next)->first + std::prev(next)->second == offset)
+			{
+				std::prev(next)->second += size;
+				return;
+			}
+			m_free.emplace_hint(next, offset, size);
+		}
+
+		size_t GetFreeBlockCount() const { return m_free.size(); }
+
+	private:
+		std::map<uint64_t, uint64_t> m_free;
+		std::map<uint64_t, uint64_t> m_allocations;
+	};
+
+	struct Result
+	{
+		double nanosecondsPerOperation = 0.0;
+		uint32_t failedCount = 0;
+	};
+
+	template<class Allocator>
+	Result Replay(Allocator& allocator, const std::vector<Operation>& operations)
+	{
+		std::vector<uint64_t> offsets(operations.size(), TlsfAllocator::kInvalidOffset);
+		Result result;
+		const Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < operations.size(); i++)
+		{
+			const Operation& operation = operations[i];
+			if (operation.release != ~0u && offsets[operation.release] != TlsfAllocator::kInvalidOffset)
+			{
+				allocator.Free(offsets[operation.release]);
+				offsets[operation.release] = TlsfAllocator::kInvalidOffset;
+			}
+			offsets[i] = allocator.Allocate(operation.size, operation.alignment);
+			result.failedCount += offsets[i] == TlsfAllocator::kInvalidOffset ? 1 : 0;
+		}
+		result.nanosecondsPerOperation =
+			std::chrono::duration<double, std::nano>(Clock::now() - start).count() / double(operations.size());
+		return result;
+	}
+}
+
+int main()
+{
+	std::printf("live_buffers,tlsf_ns,first_fit_ns,tlsf_failures,first_fit_failures,"
+		"tlsf_free_blocks,first_fit_free_blocks,tlsf_fragmentation\n");
+	for (uint32_t liveCount = 64; liveCount <= 1024; liveCount *= 2)
+	{
+		const std::vector<Operation> operations = MakeOperations(liveCount);
+
+		TlsfAllocator tlsf(kHeapSize);
+		const Result tlsfResult = Replay(tlsf, operations);
+		const TlsfAllocator::Statistics statistics = tlsf.GetStatistics();
+
+		FirstFitAllocator firstFit(kHeapSize);
+		const Result firstFitResult = Replay(firstFit, operations);
+
+		std::printf("%u,%.1f,%.1f,%u,%u,%zu,%zu,%.3f\n", liveCount, tlsfResult.nanosecondsPerOperation,
+			firstFitResult.nanosecondsPerOperation, tlsfResult.failedCount, firstFitResult.failedCount,
+			statistics.freeBlockCount, firstFit.GetFreeBlockCount(), statistics.GetFragmentation());
+	}
+	return 0;
+}
@@ -0,0 +1,157 @@
+#include "BlobCache.h"
+#include "UnitTest.h"
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using NvHelpers::BlobCache;
+
+namespace
+{
+	// Stand-ins for a root signature description and for the signature created from it
+	struct Range
+	{
+		uint32_t type;
+		uint32_t count;
+		uint32_t baseRegister;
+		uint32_t registerSpace;
+	};
+
+	struct Description
+	{
+		std::vector<Range> ranges;
+		uint32_t flags = 0;
+	};
+
+	struct Signature
+	{
+		uint32_t id;
+	};
+
+	// Flat serialization of the description, standing in for D3D12SerializeRootSignature
+	std::vector<uint8_t> Serialize(const Description& description)
+	{
+		std::vector<uint8_t> blob(sizeof(uint32_t) + description.ranges.size() * sizeof(Range));
+		memcpy(blob.data(), &description.flags, sizeof(uint32_t));
+		if (!description.ranges.empty())
+		{
+			memcpy(blob.data() + sizeof(uint32_t), description.ranges.data(), description.ranges.size() * sizeof(Range));
+		}
+		return blob;
+	}
+
+	class SignatureFactory
+	{
+	public:
+		std::shared_ptr<Signature> GetOrCreate(BlobCache<std::shared_ptr<Signature>>& cache, const Description& description)
+		{
+			const std::vector<uint8_t> blob = Serialize(description);
+			return cache.GetOrCreate(blob.data(), blob.size(),
+				[this](const void*, size_t) { return std::make_shared<Signature>(Signature{ createdCount++ }); });
+		}
+
+		uint32_t createdCount = 0;
+	};
+
+	Description MakeDescription()
+	{
+		Description description;
+		description.ranges = { { 0, 1, 0, 0 }, { 1, 4, 0, 0 }, { 2, 1, 0, 1 } };
+		description.flags = 1;
+		return description;
+	}
+}
+
+UNIT_TEST(BlobCache, SharesTheObjectOfIdenticalDescriptions)
+{
+	BlobCache<std::shared_ptr<Signature>> cache;
+	SignatureFactory factory;
+
+	const std::shared_ptr<Signature> first = factory.GetOrCreate(cache, MakeDescription());
+	const std::shared_ptr<Signature> second = factory.GetOrCreate(cache, MakeDescription());
+	CHECK(first == second);
+	CHECK_EQ(factory.createdCount, 1u);
+	CHECK_EQ(cache.GetUniqueCount(), 1u);
+	CHECK_EQ(cache.GetHitCount(), 1u);
+	CHECK_EQ(cache.GetMissCount(), 1u);
+
+	// Empty descriptions are shared as well
+	CHECK(factory.GetOrCreate(cache, Description()) == factory.GetOrCreate(cache, Description()));
+	CHECK_EQ(factory.createdCount, 2u);
+}
+
+UNIT_TEST(BlobCache, KeepsDescriptionsWithDifferentRangesOrFlagsApart)
+{
+	BlobCache<std::shared_ptr<Signature>> cache;
+	SignatureFactory factory;
+	const std::shared_ptr<Signature> reference = factory.GetOrCreate(cache, MakeDescription());
+
+	Description otherRegister = MakeDescription();
+	otherRegister.ranges[1].baseRegister = 1;
+	Description otherCount = MakeDescription();
+	otherCount.ranges[1].count = 5;
+	Description otherSpace = MakeDescription();
+	otherSpace.ranges[2].registerSpace = 0;
+	Description fewerRanges = MakeDescription();
+	fewerRanges.ranges.pop_back();
+	Description otherFlags = MakeDescription();
+	otherFlags.flags = 0;
+
+	std::vector<std::shared_ptr<Signature>> signatures = { reference };
+	for (const Description& description : { otherRegister, otherCount, otherSpace, fewerRanges, otherFlags })
+	{
+		const std::shared_ptr<Signature> signature = factory.GetOrCreate(cache, description);
+		for (const std::shared_ptr<Signature>& other : signatures)
+		{
+			CHECK(signature != other);
+		}
+		signatures.push_back(signature);
+	}
+	CHECK_EQ(cache.GetUniqueCount(), 6u);
+	CHECK_EQ(cache.GetHitCount(), 0u);
+	CHECK(factory.GetOrCreate(cache, otherFlags) == signatures.back());
+}
+
+UNIT_TEST(BlobCache, ClearKeepsTheObjectsReferencedElsewhere)
+{
+	BlobCache<std::shared_ptr<Signature>> cache;
+	SignatureFactory factory;
+	const std::shared_ptr<Signature> before = factory.GetOrCreate(cache, MakeDescription());
+	cache.Clear();
+	CHECK_EQ(cache.GetUniqueCount(), 0u);
+	CHECK_EQ(before.use_count(), 1);
+
+	// The description is created again after a clear
+	const std::shared_ptr<Signature> after = factory.GetOrCreate(cache, MakeDescription());
+	CHECK(after != before);
+	CHECK_EQ(factory.createdCount, 2u);
+}
+
+UNIT_TEST(BlobCache, CreatesEachObjectOnceAcrossThreads)
+{
+	BlobCache<std::shared_ptr<Signature>> cache;
+	SignatureFactory factory;
+	std::vector<std::shared_ptr<Signature>> results(8);
+	std::vector<std::thread> threads;
+	for (size_t t = 0; t < results.size(); t++)
+	{
+		threads.emplace_back([&, t]() {
+			for (uint32_t i = 0; i < 100; i++)
+			{
+				results[t] = factory.GetOrCreate(cache, MakeDescription());
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	CHECK_EQ(factory.createdCount, 1u);
+	for (const std::shared_ptr<Signature>& result : results)
+	{
+		CHECK(result == results[0]);
+	}
+	CHECK_EQ(cache.GetHitCount() + cache.GetMissCount(), 800u);
+}
@@ -0,0 +1,59 @@
+#include "CommandListPool.h"
+#include "UnitTest.h"
+#include <stdexcept>
+
+using RaytracingImplementation::CommandListPool;
+
+namespace
+{
+	struct StandInList
+	{
+		uint32_t id;
+		uint32_t resetCount;
+	};
+}
+
+UNIT_TEST(CommandListPool, ReusesEntriesOnceTheirFenceCompleted)
+{
+	uint32_t createdCount = 0;
+	CommandListPool<StandInList> pool([&]() { return StandInList{ createdCount++, 0 }; },
+		[](StandInList& list) { list.resetCount++; });
+
+	StandInList& first = pool.Acquire(0);
+	pool.Release(first, 5);
+	// Still executing on the simulated GPU, a second entry is created
+	StandInList& second = pool.Acquire(4);
+	CHECK(&second != &first);
+	CHECK_EQ(pool.GetSize(), 2u);
+
+	StandInList& reused = pool.Acquire(5);
+	CHECK(&reused == &first);
+	CHECK_EQ(reused.resetCount, 1u);
+	pool.Release(second, 6);
+	CHECK_THROWS(pool.Release(second, 7), std::logic_error);
+}
+
+UNIT_TEST(CommandListPool, FailedResetReturnsTheEntryToThePool)
+{
+	bool failReset = true;
+	CommandListPool<StandInList> pool([]() { return StandInList{ 0, 0 }; },
+		[&](StandInList& list)
+		{
+			if (failReset)
+			{
+				throw std::runtime_error("reset failed");
+			}
+			list.resetCount++;
+		});
+
+	StandInList& entry = pool.Acquire(0);
+	pool.Release(entry, 1);
+	CHECK_THROWS(pool.Acquire(1), std::runtime_error);
+
+	// The entry is not leaked as in use, the next Acquire resets it again
+	failReset = false;
+	StandInList& retried = pool.Acquire(1);
+	CHECK(&retried == &entry);
+	CHECK_EQ(retried.resetCount, 1u);
+	CHECK_EQ(pool.GetSize(), 1u);
+}
@@ -0,0 +1,138 @@
+#include "DescriptorAllocator.h"
+#include "UnitTest.h"
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using RaytracingImplementation::DescriptorAllocator;
+
+UNIT_TEST(DescriptorAllocator, AllocatesTheFirstPersistentRangeLargeEnough)
+{
+	DescriptorAllocator allocator(16, 8);
+	CHECK_EQ(allocator.GetCount(), 24u);
+	CHECK_EQ(allocator.AllocatePersistent(3), 0u);
+	const uint32_t middle = allocator.AllocatePersistent(5);
+	CHECK_EQ(middle, 3u);
+	CHECK_EQ(allocator.AllocatePersistent(4), 8u);
+	CHECK_EQ(allocator.AllocatePersistent(0), DescriptorAllocator::kInvalidIndex);
+
+	allocator.FreePersistent(middle);
+	allocator.Close(1);
+	allocator.Retire(1);
+	// The freed range comes before the end of the region and is taken first
+	CHECK_EQ(allocator.AllocatePersistent(2), 3u);
+	CHECK_EQ(allocator.AllocatePersistent(4), 12u);
+	CHECK_EQ(allocator.AllocatePersistent(4), DescriptorAllocator::kInvalidIndex);
+	CHECK_EQ(allocator.GetPersistentUsedCount(), 13u);
+}
+
+UNIT_TEST(DescriptorAllocator, ReleasesPersistentRangesOnceTheFenceIsReached)
+{
+	DescriptorAllocator allocator(16, 8);
+	const uint32_t first = allocator.AllocatePersistent(3);
+	const uint32_t second = allocator.AllocatePersistent(5);
+	CHECK_EQ(allocator.AllocatePersistent(8), 8u);
+
+	// The releases are open until the next Close, whatever the completed value
+	allocator.FreePersistent(second);
+	allocator.FreePersistent(first);
+	allocator.Retire(100);
+	CHECK_EQ(allocator.AllocatePersistent(1), DescriptorAllocator::kInvalidIndex);
+
+	allocator.Close(101);
+	allocator.Retire(100);
+	CHECK_EQ(allocator.GetPersistentUsedCount(), 16u);
+	allocator.Retire(101);
+	CHECK_EQ(allocator.GetPersistentUsedCount(), 8u);
+
+	// The two neighbouring ranges were merged
+	CHECK_EQ(allocator.AllocatePersistent(8), 0u);
+	CHECK_THROWS(allocator.FreePersistent(first + 1), std::logic_error);
+	CHECK_THROWS(allocator.Close(101), std::logic_error);
+}
+
+UNIT_TEST(DescriptorAllocator, RecyclesTheTransientRegionByFrame)
+{
+	DescriptorAllocator allocator(16, 8);
+	// Transient indices follow the persistent region
+	CHECK_EQ(allocator.AllocateTransient(5), 16u);
+	CHECK_EQ(allocator.AllocateTransient(4), DescriptorAllocator::kInvalidIndex);
+	allocator.Close(1);
+	CHECK_EQ(allocator.AllocateTransient(3), 21u);
+	allocator.Close(2);
+	CHECK_EQ(allocator.GetTransientUsedCount(), 8u);
+
+	allocator.Retire(1);
+	CHECK_EQ(allocator.GetTransientUsedCount(), 3u);
+	CHECK_EQ(allocator.AllocateTransient(5), 16u);
+	allocator.Close(3);
+	allocator.Retire(3);
+	CHECK_EQ(allocator.GetTransientUsedCount(), 0u);
+	CHECK_EQ(allocator.AllocateTransient(8), 16u);
+	CHECK_EQ(allocator.GetPersistentUsedCount(), 0u);
+}
+
+UNIT_TEST(DescriptorAllocator, NeverHandsOutADescriptorTwice)
+{
+	constexpr uint32_t kPersistentCount = 256;
+	// State of every descriptor: free, allocated, or released during a frame the GPU may
+	// still be running
+	constexpr uint64_t kFree = 0;
+	constexpr uint64_t kAllocated = ~0ull;
+	DescriptorAllocator allocator(kPersistentCount, 64);
+	std::vector<uint64_t> states(kPersistentCount, kFree);
+	std::vector<std::pair<uint32_t, uint32_t>> allocations;
+	std::mt19937 random(7);
+
+	for (uint64_t frame = 1; frame <= 500; frame++)
+	{
+		for (uint32_t i = 0; i < 4; i++)
+		{
+			if (!allocations.empty() && random() % 2 == 0)
+			{
+				const size_t victim = random() % allocations.size();
+				const auto [index, count] = allocations[victim];
+				allocator.FreePersistent(index);
+				allocations[victim] = allocations.back();
+				allocations.pop_back();
+				for (uint32_t d = index; d < index + count; d++)
+				{
+					states[d] = frame;
+				}
+				continue;
+			}
+
+			const uint32_t count = 1 + random() % 16;
+			const uint32_t index = allocator.AllocatePersistent(count);
+			if (index == DescriptorAllocator::kInvalidIndex)
+			{
+				continue;
+			}
+			REQUIRE(index + count <= kPersistentCount);
+			for (uint32_t d = index; d < index + count; d++)
+			{
+				CHECK_EQ(states[d], kFree);
+				states[d] = kAllocated;
+			}
+			allocations.push_back({ index, count });
+		}
+
+		allocator.Close(frame);
+		// The GPU runs two frames behind
+		if (frame > 2)
+		{
+			allocator.Retire(frame - 2);
+			for (uint64_t& state : states)
+			{
+				state = state != kAllocated && state <= frame - 2 ? kFree : state;
+			}
+		}
+	}
+
+	uint32_t usedCount = 0;
+	for (uint64_t state : states)
+	{
+		usedCount += state != kFree ? 1 : 0;
+	}
+	CHECK_EQ(allocator.GetPersistentUsedCount(), usedCount);
+}
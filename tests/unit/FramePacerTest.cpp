@@ -0,0 +1,78 @@
+#include "FramePacer.h"
+#include "UnitTest.h"
+#include <algorithm>
+#include <deque>
+#include <stdexcept>
+
+using RaytracingImplementation::FramePacer;
+
+UNIT_TEST(FramePacer, CyclesThroughTheFrameContexts)
+{
+	FramePacer pacer(3);
+	CHECK_EQ(pacer.GetCurrentFrame(), 0u);
+	CHECK(pacer.IsCurrentFrameAvailable(0));
+
+	pacer.EndFrame(1);
+	pacer.EndFrame(2);
+	pacer.EndFrame(3);
+	// Back to the first context, which waits for the first frame
+	CHECK_EQ(pacer.GetCurrentFrame(), 0u);
+	CHECK_EQ(pacer.GetCurrentFrameFenceValue(), 1u);
+	CHECK(!pacer.IsCurrentFrameAvailable(0));
+	CHECK(pacer.IsCurrentFrameAvailable(1));
+	CHECK_EQ(pacer.GetFramesInFlight(1), 2u);
+	CHECK_EQ(pacer.GetLastFenceValue(), 3u);
+}
+
+UNIT_TEST(FramePacer, RejectsInvalidUse)
+{
+	CHECK_THROWS(FramePacer(0), std::logic_error);
+	CHECK_THROWS(FramePacer(FramePacer::kMaxFrameCount + 1), std::logic_error);
+
+	FramePacer pacer;
+	pacer.EndFrame(4);
+	CHECK_THROWS(pacer.EndFrame(4), std::logic_error);
+}
+
+// A simulated queue completes the frames in order, now and then; the CPU only waits when
+// the context it is about to record into is still in flight. The CPU then runs exactly
+// frameCount frames ahead of the GPU
+UNIT_TEST(FramePacer, SimulatedQueueKeepsFrameCountFramesInFlight)
+{
+	for (uint32_t frameCount = FramePacer::kMinFrameCount; frameCount <= FramePacer::kMaxFrameCount; frameCount++)
+	{
+		FramePacer pacer(frameCount);
+		std::deque<uint64_t> queue;
+		uint64_t completedFenceValue = 0;
+		uint64_t nextFenceValue = 1;
+		uint32_t maxFramesInFlight = 0;
+		uint32_t waitCount = 0;
+		for (uint32_t frame = 0; frame < 1000; frame++)
+		{
+			while (!pacer.IsCurrentFrameAvailable(completedFenceValue))
+			{
+				REQUIRE(!queue.empty());
+				completedFenceValue = queue.front();
+				queue.pop_front();
+				waitCount++;
+			}
+
+			// Other submissions signal the fence between the frames
+			if (frame % 5 == 0)
+			{
+				nextFenceValue++;
+			}
+			queue.push_back(nextFenceValue);
+			pacer.EndFrame(nextFenceValue++);
+			maxFramesInFlight = std::max<uint32_t>(maxFramesInFlight, pacer.GetFramesInFlight(completedFenceValue));
+
+			if (frame % 7 == 0)
+			{
+				completedFenceValue = queue.front();
+				queue.pop_front();
+			}
+		}
+		CHECK_EQ(maxFramesInFlight, frameCount);
+		CHECK(waitCount > 0);
+	}
+}
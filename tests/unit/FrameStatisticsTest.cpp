@@ -0,0 +1,127 @@
+#include "FrameStatistics.h"
+#include "UnitTest.h"
+#include <cmath>
+#include <limits>
+
+using RaytracingImplementation::FrameStatistics;
+using RaytracingImplementation::Histogram;
+
+namespace
+{
+	// Value of the i-th of consecutive buckets, so that every recorded value is exact
+	double GetValue(uint32_t i)
+	{
+		return Histogram::GetBucketValue(Histogram::GetBucket(1.0) + i);
+	}
+
+	void RecordValues(FrameStatistics& statistics, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			statistics.Record(FrameStatistics::kFrameTime, GetValue(i));
+		}
+	}
+}
+
+UNIT_TEST(Histogram, KeepsEveryValueWithinItsBucket)
+{
+	for (double value = 1e-6; value < 1e11; value *= 1.01)
+	{
+		const double bucketValue = Histogram::GetBucketValue(Histogram::GetBucket(value));
+		CHECK(std::fabs(bucketValue - value) <= value / Histogram::kSubBucketCount);
+	}
+	CHECK_EQ(Histogram::GetBucket(Histogram::GetBucketValue(100)), 100u);
+
+	// Values out of range are clamped
+	CHECK_EQ(Histogram::GetBucket(0.0), 0u);
+	CHECK_EQ(Histogram::GetBucket(-1.0), 0u);
+	CHECK_EQ(Histogram::GetBucket(std::numeric_limits<double>::quiet_NaN()), 0u);
+	CHECK_EQ(Histogram::GetBucket(1e-30), 0u);
+	CHECK_EQ(Histogram::GetBucket(1e30), Histogram::kBucketCount - 1);
+}
+
+UNIT_TEST(FrameStatistics, TakesTheNearestRankAsPercentile)
+{
+	FrameStatistics statistics;
+	RecordValues(statistics, 100);
+	FrameStatistics::Summary summary = statistics.GetTotalSummary(FrameStatistics::kFrameTime);
+	CHECK_EQ(summary.count, 100u);
+	CHECK_EQ(summary.p50, GetValue(49));
+	CHECK_EQ(summary.p95, GetValue(94));
+	CHECK_EQ(summary.p99, GetValue(98));
+	CHECK_EQ(summary.max, GetValue(99));
+
+	// One more sample moves each rank past the boundary
+	statistics.Record(FrameStatistics::kFrameTime, GetValue(100));
+	summary = statistics.GetTotalSummary(FrameStatistics::kFrameTime);
+	CHECK_EQ(summary.p50, GetValue(50));
+	CHECK_EQ(summary.p95, GetValue(95));
+	CHECK_EQ(summary.p99, GetValue(99));
+	CHECK_EQ(summary.max, GetValue(100));
+
+	// With a single sample every percentile is that sample
+	FrameStatistics single;
+	single.Record(FrameStatistics::kGpuTime, 4.0);
+	summary = single.GetTotalSummary(FrameStatistics::kGpuTime);
+	CHECK_EQ(summary.count, 1u);
+	CHECK_EQ(summary.p50, summary.max);
+	CHECK_EQ(summary.p99, summary.max);
+	CHECK_EQ(summary.mean, summary.max);
+	CHECK(std::fabs(summary.max - 4.0) <= 4.0 / Histogram::kSubBucketCount);
+}
+
+UNIT_TEST(FrameStatistics, SummarizesAnEmptyWindowAsZero)
+{
+	FrameStatistics statistics(1.0);
+	FrameStatistics::Summary summary = statistics.GetRecentSummary(FrameStatistics::kFrameTime);
+	CHECK_EQ(summary.count, 0u);
+	CHECK_EQ(summary.mean, 0.0);
+	CHECK_EQ(summary.p50, 0.0);
+	CHECK_EQ(summary.p99, 0.0);
+	CHECK_EQ(summary.max, 0.0);
+
+	// The other metrics are not affected by a recorded one
+	statistics.Record(FrameStatistics::kFrameTime, 16.0);
+	CHECK_EQ(statistics.GetRecentSummary(FrameStatistics::kGpuTime).count, 0u);
+	CHECK_EQ(statistics.GetTotalSummary(FrameStatistics::kMemoryUsage).count, 0u);
+
+	// A long pause empties every window but keeps the total
+	CHECK(!statistics.Advance(0.0));
+	CHECK(statistics.Advance(100.0));
+	CHECK_EQ(statistics.GetRecentSummary(FrameStatistics::kFrameTime).count, 0u);
+	CHECK_EQ(statistics.GetRecentSummary(FrameStatistics::kFrameTime).max, 0.0);
+	CHECK_EQ(statistics.GetTotalSummary(FrameStatistics::kFrameTime).count, 1u);
+}
+
+UNIT_TEST(FrameStatistics, DropsTheOldestIntervalWhenTheWindowsWrapAround)
+{
+	FrameStatistics statistics(1.0);
+	CHECK(!statistics.Advance(0.0));
+
+	// One sample per interval, the value of its interval
+	for (uint32_t interval = 0; interval < FrameStatistics::kWindowCount; interval++)
+	{
+		statistics.Record(FrameStatistics::kFrameTime, GetValue(interval));
+		CHECK(!statistics.Advance(interval + 0.5));
+		CHECK(statistics.Advance(interval + 1.0));
+	}
+
+	// The current window is the first one again, cleared: only the last intervals are left
+	FrameStatistics::Summary recent = statistics.GetRecentSummary(FrameStatistics::kFrameTime);
+	CHECK_EQ(recent.count, uint64_t(FrameStatistics::kWindowCount - 1));
+	CHECK_EQ(recent.p50, GetValue(2));
+	CHECK_EQ(recent.max, GetValue(FrameStatistics::kWindowCount - 1));
+
+	statistics.Record(FrameStatistics::kFrameTime, GetValue(10));
+	recent = statistics.GetRecentSummary(FrameStatistics::kFrameTime);
+	CHECK_EQ(recent.count, uint64_t(FrameStatistics::kWindowCount));
+	CHECK_EQ(recent.max, GetValue(10));
+
+	// Two intervals elapsed at once drop two windows
+	CHECK(statistics.Advance(FrameStatistics::kWindowCount + 2.0));
+	recent = statistics.GetRecentSummary(FrameStatistics::kFrameTime);
+	CHECK_EQ(recent.count, uint64_t(FrameStatistics::kWindowCount - 2));
+	CHECK_EQ(recent.max, GetValue(10));
+	CHECK_EQ(statistics.GetTotalSummary(FrameStatistics::kFrameTime).count,
+		uint64_t(FrameStatistics::kWindowCount + 1));
+}
@@ -0,0 +1,209 @@
+#include "GpuPassTimer.h"
+#include "UnitTest.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using RaytracingImplementation::CpuTimestampSource;
+using RaytracingImplementation::GpuPassTimer;
+using RaytracingImplementation::TimestampSource;
+
+namespace
+{
+	// Source whose timestamps are set by the test, one tick per microsecond
+	class ScriptedTimestampSource : public TimestampSource
+	{
+	public:
+		ScriptedTimestampSource(uint32_t queryCount, uint32_t slotCount) :
+			m_queryCount(queryCount),
+			m_slots(size_t(queryCount) * slotCount, 0)
+		{
+		}
+
+		// Write the timestamps of a submission into the slot it was resolved into
+		void Resolve(uint32_t slot, const std::vector<uint64_t>& timestamps)
+		{
+			std::copy(timestamps.begin(), timestamps.end(), m_slots.begin() + size_t(slot) * m_queryCount);
+		}
+
+		uint64_t GetFrequency() const override { return 1000000; }
+
+		void Read(uint32_t slot, uint32_t count, uint64_t* timestamps) override
+		{
+			REQUIRE(count <= m_queryCount);
+			readCount++;
+			std::copy(m_slots.begin() + size_t(slot) * m_queryCount,
+				m_slots.begin() + size_t(slot) * m_queryCount + count, timestamps);
+		}
+
+		bool GetCalibration(uint64_t&, uint64_t&) override { return false; }
+
+		uint32_t readCount = 0;
+
+	private:
+		uint32_t m_queryCount;
+		std::vector<uint64_t> m_slots;
+	};
+
+	const GpuPassTimer::PassTiming* FindTiming(const GpuPassTimer& timer, const char* name)
+	{
+		for (const GpuPassTimer::PassTiming& timing : timer.GetPassTimings())
+		{
+			if (std::string(timing.name) == name)
+			{
+				return &timing;
+			}
+		}
+		return nullptr;
+	}
+}
+
+UNIT_TEST(GpuPassTimer, GivesEachPassOfASetConsecutiveQueries)
+{
+	GpuPassTimer timer(2, 3, 2);
+	CHECK_EQ(timer.GetQueryCount(), 12u);
+	CHECK_EQ(timer.GetSlotQueryCount(), 6u);
+
+	CHECK_EQ(timer.AddPass(1, "DispatchRays"), 6u);
+	CHECK_EQ(timer.AddPass(1, "Composite"), 8u);
+	CHECK_EQ(timer.AddPass(1, "Present"), 10u);
+	CHECK_EQ(timer.AddPass(1, "Overflow"), GpuPassTimer::kInvalidIndex);
+	CHECK_EQ(timer.AddPass(0, "DispatchRays"), 0u);
+	CHECK_EQ(timer.GetSetFirstQuery(1), 6u);
+	CHECK_EQ(timer.GetSetQueryCount(1), 6u);
+
+	timer.ResetSet(1);
+	CHECK_EQ(timer.GetSetQueryCount(1), 0u);
+	CHECK_EQ(timer.AddPass(1, "DispatchRays"), 6u);
+	CHECK_THROWS(timer.AddPass(2, "Invalid"), std::out_of_range);
+	CHECK_THROWS(GpuPassTimer(1, 0, 1), std::logic_error);
+}
+
+UNIT_TEST(GpuPassTimer, ReadsASubmissionOnlyOnceItsFenceHasCompleted)
+{
+	GpuPassTimer timer(1, 2, 2);
+	ScriptedTimestampSource source(timer.GetSlotQueryCount(), timer.GetSlotCount());
+	timer.AddPass(0, "DispatchRays");
+	timer.AddPass(0, "Composite");
+
+	uint32_t slot = timer.AcquireSlot();
+	CHECK_EQ(slot, 0u);
+	source.Resolve(slot, { 100, 4100, 4100, 6100 });
+	timer.Submit(slot, 0, 1);
+
+	timer.Collect(0, source);
+	CHECK_EQ(source.readCount, 0u);
+	CHECK(timer.GetPassTimings().empty());
+
+	timer.Collect(1, source);
+	REQUIRE(timer.GetPassTimings().size() == 2);
+	const GpuPassTimer::PassTiming* dispatchRays = FindTiming(timer, "DispatchRays");
+	REQUIRE(dispatchRays != nullptr);
+	CHECK_EQ(dispatchRays->lastMilliseconds, 4.0);
+	CHECK_EQ(dispatchRays->averageMilliseconds, 4.0);
+	CHECK_EQ(dispatchRays->sampleCount, 1u);
+	CHECK_EQ(timer.GetLastSubmissionMilliseconds(), 6.0);
+
+	// A second sample moves the average by a kAverageLength-th of the difference
+	slot = timer.AcquireSlot();
+	CHECK_EQ(slot, 1u);
+	source.Resolve(slot, { 0, 20000, 20000, 22000 });
+	timer.Submit(slot, 0, 2);
+	timer.Collect(2, source);
+	CHECK_EQ(dispatchRays->lastMilliseconds, 20.0);
+	CHECK_EQ(dispatchRays->averageMilliseconds, 4.0 + 16.0 / GpuPassTimer::kAverageLength);
+	CHECK_EQ(dispatchRays->sampleCount, 2u);
+	CHECK_THROWS(timer.Submit(0, 0, 3), std::logic_error);
+}
+
+UNIT_TEST(GpuPassTimer, SkipsSubmissionsWhenEverySlotIsInFlight)
+{
+	GpuPassTimer timer(1, 1, 2);
+	ScriptedTimestampSource source(timer.GetSlotQueryCount(), timer.GetSlotCount());
+	timer.AddPass(0, "DispatchRays");
+
+	uint64_t fenceValue = 0;
+	uint32_t timedCount = 0;
+	for (uint32_t frame = 0; frame < 10; frame++)
+	{
+		// The GPU runs three frames behind, one more than the slots cover
+		fenceValue++;
+		const uint32_t slot = timer.AcquireSlot();
+		if (slot != GpuPassTimer::kInvalidIndex)
+		{
+			source.Resolve(slot, { 0, 1000 * uint64_t(frame + 1) });
+			timer.Submit(slot, 0, fenceValue);
+			timedCount++;
+		}
+		if (fenceValue > 3)
+		{
+			timer.Collect(fenceValue - 3, source);
+		}
+	}
+	timer.Collect(fenceValue, source);
+
+	CHECK(timedCount < 10u);
+	REQUIRE(timer.GetPassTimings().size() == 1);
+	CHECK_EQ(timer.GetPassTimings()[0].sampleCount, uint64_t(timedCount));
+	CHECK_EQ(source.readCount, timedCount);
+	// Both slots are free again
+	CHECK(timer.AcquireSlot() != GpuPassTimer::kInvalidIndex);
+	CHECK(timer.AcquireSlot() != GpuPassTimer::kInvalidIndex);
+	CHECK_EQ(timer.AcquireSlot(), GpuPassTimer::kInvalidIndex);
+}
+
+UNIT_TEST(GpuPassTimer, KeepsThePassesOfASetRecordedAgainBeforeCompletion)
+{
+	GpuPassTimer timer(1, 2, 2);
+	ScriptedTimestampSource source(timer.GetSlotQueryCount(), timer.GetSlotCount());
+	timer.AddPass(0, "Raster");
+	uint32_t slot = timer.AcquireSlot();
+	source.Resolve(slot, { 0, 3000 });
+	timer.Submit(slot, 0, 1);
+
+	timer.ResetSet(0);
+	timer.AddPass(0, "DispatchRays");
+	slot = timer.AcquireSlot();
+	source.Resolve(slot, { 0, 5000 });
+	timer.Submit(slot, 0, 2);
+
+	timer.Collect(2, source);
+	REQUIRE(timer.GetPassTimings().size() == 2);
+	CHECK_EQ(FindTiming(timer, "Raster")->lastMilliseconds, 3.0);
+	CHECK_EQ(FindTiming(timer, "DispatchRays")->lastMilliseconds, 5.0);
+}
+
+UNIT_TEST(CpuTimestampSource, ResolvesTheQueriesIntoSlots)
+{
+	GpuPassTimer timer(1, 2, 2);
+	CpuTimestampSource source(timer.GetQueryCount(), timer.GetSlotCount());
+	CHECK_EQ(source.GetFrequency(), 1000000000u);
+	const uint32_t dispatchRays = timer.AddPass(0, "DispatchRays");
+	const uint32_t composite = timer.AddPass(0, "Composite");
+
+	for (uint32_t query = 0; query < timer.GetQueryCount(); query++)
+	{
+		source.WriteTimestamp(query);
+	}
+	const uint32_t slot = timer.AcquireSlot();
+	source.Resolve(timer.GetSetFirstQuery(0), timer.GetSetQueryCount(0), slot);
+
+	uint64_t timestamps[4] = {};
+	source.Read(slot, 4, timestamps);
+	// The queries were written in order on a monotonic clock
+	CHECK(timestamps[0] <= timestamps[1]);
+	CHECK(timestamps[1] <= timestamps[2]);
+	CHECK(timestamps[2] <= timestamps[3]);
+
+	timer.Submit(slot, 0, 1);
+	timer.Collect(1, source);
+	REQUIRE(timer.GetPassTimings().size() == 2);
+	CHECK(timer.GetPassTimings()[0].lastMilliseconds >= 0.0);
+	CHECK_EQ(timer.GetPassTimings()[1].sampleCount, 1u);
+	CHECK_EQ(composite, dispatchRays + 2);
+
+	CHECK_THROWS(source.WriteTimestamp(timer.GetQueryCount()), std::out_of_range);
+	CHECK_THROWS(source.Resolve(2, 4, 0), std::logic_error);
+	CHECK_THROWS(source.Resolve(0, 4, 2), std::logic_error);
+}
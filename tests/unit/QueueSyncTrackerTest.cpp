@@ -0,0 +1,219 @@
+#include "QueueSyncTracker.h"
+#include "UnitTest.h"
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using RaytracingImplementation::QueueSyncTracker;
+
+namespace
+{
+	constexpr size_t kDirectQueue = 0;
+	constexpr size_t kComputeQueue = 1;
+
+	// Queues of a simulated GPU. Each queue executes its submissions in order, a submission
+	// starting once the fence values it waits for have been reached on the other queues
+	class SimulatedQueues
+	{
+	public:
+		struct Wait
+		{
+			size_t producer;
+			uint64_t value;
+		};
+
+		explicit SimulatedQueues(QueueSyncTracker& tracker) :
+			m_tracker(tracker),
+			m_pending(tracker.GetQueueCount()),
+			m_completed(tracker.GetQueueCount(), 0),
+			m_waits(tracker.GetQueueCount())
+		{
+		}
+
+		// Same as Dx12Api::InsertQueueWait: the wait is only recorded when needed
+		void InsertWait(size_t consumer, size_t producer, uint64_t value)
+		{
+			if (!m_tracker.NeedsWait(consumer, producer, value))
+			{
+				return;
+			}
+			m_waits[consumer].push_back({ producer, value });
+			m_tracker.Wait(consumer, producer, value);
+			m_waitCount++;
+		}
+
+		// Submit work followed by a signal of the queue fence, returning the signaled value
+		uint64_t Submit(size_t queue)
+		{
+			const uint64_t value = m_tracker.GetLastSignaled(queue) + 1;
+			m_pending[queue].push_back({ std::move(m_waits[queue]), value });
+			m_waits[queue].clear();
+			m_tracker.Signal(queue, value);
+			return value;
+		}
+
+		// Execute the submission at the head of a queue if its waits are satisfied. Returns
+		// false when no queue can progress
+		bool Step(std::mt19937& random)
+		{
+			const size_t first = random() % m_pending.size();
+			for (size_t i = 0; i < m_pending.size(); i++)
+			{
+				const size_t queue = (first + i) % m_pending.size();
+				if (m_pending[queue].empty())
+				{
+					continue;
+				}
+				const Submission& submission = m_pending[queue].front();
+				bool ready = true;
+				for (const Wait& wait : submission.waits)
+				{
+					ready = ready && m_completed[wait.producer] >= wait.value;
+				}
+				if (ready)
+				{
+					m_completed[queue] = submission.value;
+					m_executionOrder.push_back({ queue, submission.value });
+					m_pending[queue].pop_front();
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool IsIdle() const
+		{
+			for (const std::deque<Submission>& queue : m_pending)
+			{
+				if (!queue.empty())
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		inline uint64_t GetCompleted(size_t queue) const { return m_completed[queue]; }
+		inline uint32_t GetWaitCount() const { return m_waitCount; }
+
+		// Position of a submission in the execution order of the GPU
+		size_t GetExecutionIndex(size_t queue, uint64_t value) const
+		{
+			for (size_t i = 0; i < m_executionOrder.size(); i++)
+			{
+				if (m_executionOrder[i].producer == queue && m_executionOrder[i].value == value)
+				{
+					return i;
+				}
+			}
+			return ~size_t(0);
+		}
+
+	private:
+		struct Submission
+		{
+			std::vector<Wait> waits;
+			uint64_t value;
+		};
+
+		QueueSyncTracker& m_tracker;
+		std::vector<std::deque<Submission>> m_pending;
+		std::vector<uint64_t> m_completed;
+		// Waits recorded for the next submission of each queue
+		std::vector<std::vector<Wait>> m_waits;
+		std::vector<Wait> m_executionOrder;
+		uint32_t m_waitCount = 0;
+	};
+}
+
+UNIT_TEST(QueueSyncTracker, SkipsWaitsAlreadyCovered)
+{
+	QueueSyncTracker tracker(2);
+	tracker.Signal(kComputeQueue, 1);
+	CHECK(tracker.NeedsWait(kDirectQueue, kComputeQueue, 1));
+	tracker.Wait(kDirectQueue, kComputeQueue, 1);
+	CHECK(!tracker.NeedsWait(kDirectQueue, kComputeQueue, 1));
+	CHECK_EQ(tracker.GetWaitedValue(kDirectQueue, kComputeQueue), 1u);
+
+	// A queue never waits for itself, nor for a value of 0
+	tracker.Signal(kDirectQueue, 5);
+	CHECK(!tracker.NeedsWait(kDirectQueue, kDirectQueue, 5));
+	CHECK(!tracker.NeedsWait(kComputeQueue, kDirectQueue, 0));
+}
+
+UNIT_TEST(QueueSyncTracker, RejectsInvalidWaitsAndSignals)
+{
+	QueueSyncTracker tracker(2);
+	tracker.Signal(kComputeQueue, 1);
+	CHECK_THROWS(tracker.Wait(kDirectQueue, kComputeQueue, 2), std::logic_error);
+	CHECK_THROWS(tracker.Wait(kDirectQueue, kDirectQueue, 0), std::logic_error);
+	CHECK_THROWS(tracker.Signal(kComputeQueue, 1), std::logic_error);
+	CHECK_THROWS(tracker.Signal(2, 1), std::logic_error);
+}
+
+// Replays the submissions of Dx12Api on a simulated direct and compute queue: every frame
+// refits the top-level AS on the compute queue, after the frames which read it, and the
+// frame then dispatches rays from it on the direct queue. Uploads signal the direct queue
+// in between. Whatever the order in which the GPU executes what is ready, every
+// dependency is honored, no queue deadlocks, and no redundant wait is inserted
+UNIT_TEST(QueueSyncTracker, SimulatedTimelineHonorsEveryDependency)
+{
+	QueueSyncTracker tracker(2);
+	SimulatedQueues queues(tracker);
+	std::mt19937 random(7);
+
+	struct Frame
+	{
+		uint64_t refitValue;
+		uint64_t frameValue;
+	};
+	std::vector<Frame> frames;
+	for (uint32_t frame = 0; frame < 500; frame++)
+	{
+		if (frame != 0 && random() % 4 == 0)
+		{
+			queues.Submit(kDirectQueue);
+		}
+
+		// Refit: waits for the frames already submitted, which read the structure
+		queues.InsertWait(kComputeQueue, kDirectQueue, tracker.GetLastSignaled(kDirectQueue));
+		const uint64_t refitValue = queues.Submit(kComputeQueue);
+
+		// Frame: the ray dispatch waits for the refit. The second wait is redundant
+		queues.InsertWait(kDirectQueue, kComputeQueue, refitValue);
+		queues.InsertWait(kDirectQueue, kComputeQueue, refitValue);
+		const uint64_t frameValue = queues.Submit(kDirectQueue);
+		frames.push_back({ refitValue, frameValue });
+
+		// The GPU executes part of the submitted work, at random, while the CPU records
+		for (uint32_t step = random() % 4; step > 0; step--)
+		{
+			if (!queues.Step(random))
+			{
+				break;
+			}
+		}
+	}
+	while (!queues.IsIdle())
+	{
+		REQUIRE(queues.Step(random));
+	}
+	CHECK_EQ(queues.GetCompleted(kDirectQueue), tracker.GetLastSignaled(kDirectQueue));
+	CHECK_EQ(queues.GetCompleted(kComputeQueue), tracker.GetLastSignaled(kComputeQueue));
+
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		const size_t refit = queues.GetExecutionIndex(kComputeQueue, frames[i].refitValue);
+		const size_t frame = queues.GetExecutionIndex(kDirectQueue, frames[i].frameValue);
+		CHECK(refit < frame);
+		if (i > 0)
+		{
+			// The refit only overwrites the structure once the previous frame is done with it
+			CHECK(queues.GetExecutionIndex(kDirectQueue, frames[i - 1].frameValue) < refit);
+		}
+	}
+	// One wait each way per frame, the duplicate ones being skipped. The first refit has no
+	// frame to wait for
+	CHECK_EQ(queues.GetWaitCount(), 2u * uint32_t(frames.size()) - 1u);
+}
@@ -0,0 +1,171 @@
+#include "RootSignatureOptimizer.h"
+#include "UnitTest.h"
+#include <stdexcept>
+#include <vector>
+
+using RaytracingImplementation::OptimizeRootSignatureLayout;
+using RaytracingImplementation::RootParameterKind;
+using RaytracingImplementation::RootSignatureCostModel;
+using RaytracingImplementation::RootSignatureLayout;
+using RaytracingImplementation::ShaderResourceNeed;
+using Type = ShaderResourceNeed::Type;
+
+namespace
+{
+	RootParameterKind GetKindOfNeed(const RootSignatureLayout& layout, uint32_t need)
+	{
+		return layout.parameters[layout.parameterOfNeed[need]].kind;
+	}
+
+	// The most frequently changed parameters come first, and every need points to the
+	// parameter serving it
+	void CheckOrderAndIndices(const RootSignatureLayout& layout)
+	{
+		for (size_t p = 1; p < layout.parameters.size(); p++)
+		{
+			CHECK(layout.parameters[p - 1].changeFrequency >= layout.parameters[p].changeFrequency);
+		}
+		for (uint32_t p = 0; p < layout.parameters.size(); p++)
+		{
+			for (uint32_t need : layout.parameters[p].needs)
+			{
+				CHECK_EQ(layout.parameterOfNeed[need], p);
+			}
+		}
+	}
+
+	// Constant buffers changing 1 to count times as often as the first one
+	std::vector<ShaderResourceNeed> MakeConstantBuffers(uint32_t count)
+	{
+		std::vector<ShaderResourceNeed> needs;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			needs.push_back({ Type::ConstantBuffer, i, 0, 1, float(i + 1) });
+		}
+		return needs;
+	}
+}
+
+UNIT_TEST(RootSignatureOptimizer, KeepsTheDirectFormsWithinTheBudget)
+{
+	const std::vector<ShaderResourceNeed> needs = {
+		{ Type::ShaderResource, 0, 0, 1, 1.0f },
+		{ Type::Constants, 0, 0, 4, 1000.0f },
+		{ Type::ShaderResource, 1, 0, 8, 10.0f },
+		{ Type::Sampler, 0, 0, 1, 10.0f },
+		// A typed view cannot be a root descriptor
+		{ Type::UnorderedAccess, 0, 0, 1, 10.0f, false },
+	};
+	const RootSignatureLayout layout = OptimizeRootSignatureLayout(needs);
+	CheckOrderAndIndices(layout);
+
+	CHECK_EQ(GetKindOfNeed(layout, 0), RootParameterKind::Descriptor);
+	CHECK_EQ(layout.parameterOfNeed[1], 0u);
+	CHECK_EQ(GetKindOfNeed(layout, 1), RootParameterKind::Constants);
+	// The views changing as often share a table, the sampler has its own as it lives in
+	// another heap
+	CHECK_EQ(layout.parameterOfNeed[2], layout.parameterOfNeed[4]);
+	CHECK(layout.parameterOfNeed[3] != layout.parameterOfNeed[2]);
+	CHECK_EQ(GetKindOfNeed(layout, 3), RootParameterKind::Table);
+
+	// 4 constants, 2 tables and a root descriptor, against a table per need
+	CHECK_EQ(layout.parameters.size(), 4u);
+	CHECK_EQ(layout.sizeInDwords, 4u + 1u + 1u + 2u);
+	CHECK_EQ(layout.declaredSizeInDwords, 4u + 1u + 1u + 1u + 2u);
+	CHECK(layout.cost <= layout.declaredCost);
+}
+
+UNIT_TEST(RootSignatureOptimizer, DemotesTheRarelyChangedConstantsFirst)
+{
+	// 5 x 16 constants need 80 32-bit values against a budget of 64
+	const std::vector<ShaderResourceNeed> needs = {
+		{ Type::Constants, 0, 0, 16, 100.0f },
+		{ Type::Constants, 1, 0, 16, 1.0f },
+		{ Type::Constants, 2, 0, 16, 10000.0f },
+		{ Type::Constants, 3, 0, 16, 10.0f },
+		{ Type::Constants, 4, 0, 16, 1000.0f },
+	};
+	const RootSignatureLayout layout = OptimizeRootSignatureLayout(needs);
+	CheckOrderAndIndices(layout);
+
+	// Demoting one to a root descriptor saves 14 values, so two are demoted: the two
+	// changed the least often
+	CHECK_EQ(layout.declaredSizeInDwords, 80u);
+	CHECK_EQ(layout.sizeInDwords, 3u * 16u + 2u * 2u);
+	CHECK_EQ(GetKindOfNeed(layout, 1), RootParameterKind::Descriptor);
+	CHECK_EQ(GetKindOfNeed(layout, 3), RootParameterKind::Descriptor);
+	CHECK_EQ(GetKindOfNeed(layout, 0), RootParameterKind::Constants);
+	CHECK_EQ(GetKindOfNeed(layout, 2), RootParameterKind::Constants);
+	CHECK_EQ(GetKindOfNeed(layout, 4), RootParameterKind::Constants);
+	CHECK_EQ(layout.parameterOfNeed[2], 0u);
+	CHECK(layout.cost > layout.declaredCost);
+}
+
+UNIT_TEST(RootSignatureOptimizer, DemotesTheRarelyChangedBuffersToTables)
+{
+	std::vector<ShaderResourceNeed> needs = MakeConstantBuffers(20);
+	needs.push_back({ Type::Constants, 20, 0, 16, 500.0f });
+
+	// 20 root descriptors and 16 constants fit in the default budget
+	RootSignatureLayout layout = OptimizeRootSignatureLayout(needs);
+	CHECK_EQ(layout.sizeInDwords, 56u);
+	CHECK_EQ(layout.declaredSizeInDwords, 56u);
+
+	RootSignatureCostModel model;
+	model.budgetInDwords = 20;
+	layout = OptimizeRootSignatureLayout(needs, model);
+	CheckOrderAndIndices(layout);
+	CHECK(layout.sizeInDwords <= 20u);
+	CHECK_EQ(layout.parameterOfNeed[20], 0u);
+	CHECK_EQ(GetKindOfNeed(layout, 19), RootParameterKind::Descriptor);
+	CHECK_EQ(GetKindOfNeed(layout, 0), RootParameterKind::Table);
+	// A demoted buffer never changes more often than one kept as a root descriptor
+	for (uint32_t a = 0; a < 20; a++)
+	{
+		for (uint32_t b = 0; b < 20; b++)
+		{
+			if (GetKindOfNeed(layout, a) == RootParameterKind::Table && GetKindOfNeed(layout, b) == RootParameterKind::Descriptor)
+			{
+				CHECK(needs[a].changeFrequency < needs[b].changeFrequency);
+			}
+		}
+	}
+}
+
+UNIT_TEST(RootSignatureOptimizer, MergesTablesOfTheSameHeap)
+{
+	std::vector<ShaderResourceNeed> needs = MakeConstantBuffers(20);
+	needs.push_back({ Type::Constants, 20, 0, 16, 500.0f });
+	RootSignatureCostModel model;
+	model.budgetInDwords = 1;
+
+	// Everything ends up in a single table, changing as often as its most frequent need
+	RootSignatureLayout layout = OptimizeRootSignatureLayout(needs, model);
+	CHECK_EQ(layout.sizeInDwords, 1u);
+	REQUIRE(layout.parameters.size() == 1);
+	CHECK_EQ(layout.parameters[0].needs.size(), needs.size());
+	CHECK_EQ(layout.parameters[0].changeFrequency, 500.0f);
+
+	// A sampler is never merged with the views
+	needs.push_back({ Type::Sampler, 0, 0, 1, 1.0f });
+	model.budgetInDwords = 2;
+	layout = OptimizeRootSignatureLayout(needs, model);
+	CheckOrderAndIndices(layout);
+	CHECK_EQ(layout.sizeInDwords, 2u);
+	REQUIRE(layout.parameters.size() == 2);
+	CHECK_EQ(layout.parameters[layout.parameterOfNeed[21]].needs.size(), 1u);
+	CHECK_EQ(layout.parameters[1].changeFrequency, 1.0f);
+}
+
+UNIT_TEST(RootSignatureOptimizer, ThrowsWhenNothingFits)
+{
+	std::vector<ShaderResourceNeed> needs = MakeConstantBuffers(4);
+	needs.push_back({ Type::Sampler, 0, 0, 1, 1.0f });
+	RootSignatureCostModel model;
+	model.budgetInDwords = 1;
+	CHECK_THROWS(OptimizeRootSignatureLayout(needs, model), std::length_error);
+
+	model.budgetInDwords = 0;
+	CHECK_THROWS(OptimizeRootSignatureLayout(MakeConstantBuffers(1), model), std::length_error);
+	CHECK_EQ(OptimizeRootSignatureLayout({}, model).sizeInDwords, 0u);
+}
@@ -0,0 +1,96 @@
+#include "ScratchBatchPlanner.h"
+#include "UnitTest.h"
+#include <random>
+#include <vector>
+
+using RaytracingImplementation::PlanScratchBatches;
+using RaytracingImplementation::ScratchBatch;
+
+namespace
+{
+	constexpr uint64_t kAlignment = 256;
+
+	uint64_t AlignUp(uint64_t size)
+	{
+		return (size + kAlignment - 1) & ~(kAlignment - 1);
+	}
+}
+
+UNIT_TEST(ScratchBatchPlanner, GivesAnOversizedBuildItsOwnBatch)
+{
+	const std::vector<ScratchBatch> batches = PlanScratchBatches({ 1000, 5000, 300 }, 4096, kAlignment);
+	REQUIRE(batches.size() == 2);
+
+	// The largest request is placed first and fills a batch over the budget on its own
+	REQUIRE(batches[0].requests.size() == 1);
+	CHECK_EQ(batches[0].requests[0], 1u);
+	CHECK_EQ(batches[0].scratchOffsets[0], 0u);
+	CHECK_EQ(batches[0].scratchSizeInBytes, AlignUp(5000));
+
+	REQUIRE(batches[1].requests.size() == 2);
+	CHECK_EQ(batches[1].requests[0], 0u);
+	CHECK_EQ(batches[1].requests[1], 2u);
+	CHECK_EQ(batches[1].scratchOffsets[1], AlignUp(1000));
+	CHECK_EQ(batches[1].scratchSizeInBytes, AlignUp(1000) + AlignUp(300));
+
+	CHECK(PlanScratchBatches({}, 4096, kAlignment).empty());
+}
+
+UNIT_TEST(ScratchBatchPlanner, KeepsEveryBatchWithinTheBudget)
+{
+	constexpr uint64_t kBudget = 64 * 1024;
+	std::mt19937_64 random(11);
+	for (uint32_t iteration = 0; iteration < 100; iteration++)
+	{
+		std::vector<uint64_t> sizes(1 + random() % 64);
+		for (uint64_t& size : sizes)
+		{
+			size = 1 + random() % kBudget;
+		}
+
+		const std::vector<ScratchBatch> batches = PlanScratchBatches(sizes, kBudget, kAlignment);
+		std::vector<uint32_t> placedCounts(sizes.size(), 0);
+		for (const ScratchBatch& batch : batches)
+		{
+			CHECK(batch.scratchSizeInBytes <= kBudget);
+			REQUIRE(batch.requests.size() == batch.scratchOffsets.size());
+
+			// Aligned regions following each other without overlapping
+			uint64_t end = 0;
+			for (size_t i = 0; i < batch.requests.size(); i++)
+			{
+				CHECK_EQ(batch.scratchOffsets[i] % kAlignment, 0u);
+				CHECK_EQ(batch.scratchOffsets[i], end);
+				end += AlignUp(sizes[batch.requests[i]]);
+				placedCounts[batch.requests[i]]++;
+			}
+			CHECK_EQ(batch.scratchSizeInBytes, end);
+		}
+		for (uint32_t count : placedCounts)
+		{
+			CHECK_EQ(count, 1u);
+		}
+	}
+}
+
+UNIT_TEST(ScratchBatchPlanner, PlansTheSameBatchesForTheSameSizes)
+{
+	// Requests of the same size keep the order they were enqueued in
+	const std::vector<uint64_t> sizes = { 512, 2048, 512, 2048, 512, 1024 };
+	const std::vector<ScratchBatch> batches = PlanScratchBatches(sizes, 4096, kAlignment);
+	REQUIRE(batches.size() == 2);
+	CHECK(batches[0].requests == std::vector<size_t>({ 1, 3 }));
+	CHECK(batches[1].requests == std::vector<size_t>({ 5, 0, 2, 4 }));
+
+	for (uint32_t i = 0; i < 10; i++)
+	{
+		const std::vector<ScratchBatch> again = PlanScratchBatches(sizes, 4096, kAlignment);
+		REQUIRE(again.size() == batches.size());
+		for (size_t b = 0; b < batches.size(); b++)
+		{
+			CHECK(again[b].requests == batches[b].requests);
+			CHECK(again[b].scratchOffsets == batches[b].scratchOffsets);
+			CHECK_EQ(again[b].scratchSizeInBytes, batches[b].scratchSizeInBytes);
+		}
+	}
+}
@@ -0,0 +1,87 @@
+#include "ShaderBindingTableLayout.h"
+#include "UnitTest.h"
+#include <stdexcept>
+
+using NvHelpers::ShaderBindingTableLayout;
+using Section = ShaderBindingTableLayout::Section;
+
+UNIT_TEST(ShaderBindingTableLayout, AlignsSectionsOnTableBoundaries)
+{
+	ShaderBindingTableLayout layout;
+	layout.AddRecord(Section::HitGroup, 1);
+	layout.AddRecord(Section::RayGen, 1);
+	layout.AddRecord(Section::Miss, 0);
+	CHECK_EQ(layout.AddRecord(Section::HitGroup, 0), 1u);
+	CHECK_EQ(layout.Compute(), 256u);
+
+	CHECK_EQ(layout.GetSectionOffset(Section::RayGen), 0u);
+	CHECK_EQ(layout.GetRecordStride(Section::RayGen), 64u);
+	CHECK_EQ(layout.GetSectionOffset(Section::Miss), 64u);
+	CHECK_EQ(layout.GetRecordStride(Section::Miss), 32u);
+	// The miss section ends at 96, the hit groups start on the next 64-byte boundary rather
+	// than right after it
+	CHECK_EQ(layout.GetSectionOffset(Section::Miss) + layout.GetSectionSize(Section::Miss), 96u);
+	CHECK_EQ(layout.GetSectionOffset(Section::HitGroup), 128u);
+	CHECK_EQ(layout.GetRecordStride(Section::HitGroup), 64u);
+	CHECK_EQ(layout.GetRecordOffset(Section::HitGroup, 1), 192u);
+}
+
+UNIT_TEST(ShaderBindingTableLayout, SizesRecordsByTheLargestOfTheirSection)
+{
+	ShaderBindingTableLayout layout;
+	layout.AddRecord(Section::RayGen, 0);
+	layout.AddRecord(Section::HitGroup, 0);
+	layout.AddRecord(Section::HitGroup, 3);
+	layout.Compute();
+
+	// 32 bytes of identifier and 3 arguments of 8 bytes, aligned on 32 bytes
+	CHECK_EQ(layout.GetRecordStride(Section::HitGroup), 64u);
+	CHECK_EQ(layout.GetArgumentCapacity(Section::HitGroup), 4u);
+	CHECK_EQ(layout.GetArgumentCapacity(Section::RayGen), 0u);
+	CHECK_EQ(layout.GetRecordArgumentCount(Section::HitGroup, 0), 0u);
+	CHECK_EQ(layout.GetRecordCount(Section::Miss), 0u);
+	CHECK_EQ(layout.GetTotalSize() % ShaderBindingTableLayout::kSizeAlignment, 0u);
+}
+
+UNIT_TEST(ShaderBindingTableLayout, RequiresComputeAfterChanges)
+{
+	ShaderBindingTableLayout layout;
+	layout.AddRecord(Section::RayGen, 1);
+	CHECK_THROWS(layout.GetTotalSize(), std::logic_error);
+	layout.Compute();
+	CHECK(layout.IsComputed());
+
+	layout.AddRecord(Section::Miss, 0);
+	CHECK(!layout.IsComputed());
+	CHECK_THROWS(layout.GetSectionOffset(Section::Miss), std::logic_error);
+	layout.Compute();
+	CHECK_THROWS(layout.GetRecordOffset(Section::Miss, 1), std::out_of_range);
+
+	layout.Reset();
+	CHECK_EQ(layout.Compute(), 0u);
+}
+
+UNIT_TEST(ShaderBindingTableLayout, KeepsEverySectionAligned)
+{
+	for (uint32_t missCount = 0; missCount < 8; missCount++)
+	{
+		for (uint32_t argumentCount = 0; argumentCount < 6; argumentCount++)
+		{
+			ShaderBindingTableLayout layout;
+			layout.AddRecord(Section::RayGen, argumentCount);
+			for (uint32_t i = 0; i < missCount; i++)
+			{
+				layout.AddRecord(Section::Miss, argumentCount);
+			}
+			layout.AddRecord(Section::HitGroup, argumentCount);
+			layout.Compute();
+			for (Section section : { Section::RayGen, Section::Miss, Section::HitGroup })
+			{
+				CHECK_EQ(layout.GetSectionOffset(section) % ShaderBindingTableLayout::kTableAlignment, 0u);
+				CHECK_EQ(layout.GetRecordStride(section) % ShaderBindingTableLayout::kRecordAlignment, 0u);
+			}
+			CHECK(layout.GetSectionOffset(Section::HitGroup) >=
+				layout.GetSectionOffset(Section::Miss) + layout.GetSectionSize(Section::Miss));
+		}
+	}
+}
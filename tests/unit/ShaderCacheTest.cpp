@@ -0,0 +1,196 @@
+#include "ShaderCache.h"
+#include "UnitTest.h"
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using RaytracingImplementation::FindIncludes;
+using RaytracingImplementation::ShaderCache;
+
+namespace
+{
+	// Directory of a test, removed with its content when the test ends
+	class TemporaryDirectory
+	{
+	public:
+		explicit TemporaryDirectory(const char* name) :
+			m_path(std::filesystem::temp_directory_path() / (std::string("ShaderCacheTest_") + name + "_" +
+				std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())))
+		{
+			std::filesystem::create_directories(m_path);
+		}
+
+		~TemporaryDirectory()
+		{
+			std::error_code error;
+			std::filesystem::remove_all(m_path, error);
+		}
+
+		inline const std::filesystem::path& GetPath() const { return m_path; }
+
+	private:
+		std::filesystem::path m_path;
+	};
+
+	void WriteFile(const std::filesystem::path& path, const std::string& content)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write(content.data(), static_cast<std::streamsize>(content.size()));
+	}
+
+	std::vector<std::filesystem::path> ListFiles(const std::filesystem::path& directory)
+	{
+		std::vector<std::filesystem::path> files;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(directory))
+		{
+			files.push_back(entry.path());
+		}
+		return files;
+	}
+
+	bool HasContent(const ShaderCache::Entry& entry, const std::string& content)
+	{
+		return entry.GetSize() == content.size() && std::memcmp(entry.GetData(), content.data(), content.size()) == 0;
+	}
+}
+
+UNIT_TEST(ShaderCache, LoadsTheStoredEntry)
+{
+	TemporaryDirectory directory("Load");
+	const std::string code = "compiled library";
+	{
+		ShaderCache cache(directory.GetPath() / "cache");
+		CHECK(cache.Load(1) == nullptr);
+		REQUIRE(cache.Store(1, code.data(), code.size()));
+
+		const std::shared_ptr<const ShaderCache::Entry> entry = cache.Load(1);
+		REQUIRE(entry != nullptr);
+		CHECK(HasContent(*entry, code));
+		CHECK(cache.Load(2) == nullptr);
+		CHECK_EQ(cache.GetHitCount(), 1u);
+		CHECK_EQ(cache.GetMissCount(), 2u);
+	}
+
+	// The entry outlives the cache which stored it, as on the next run
+	ShaderCache cache(directory.GetPath() / "cache");
+	const std::shared_ptr<const ShaderCache::Entry> entry = cache.Load(1);
+	REQUIRE(entry != nullptr);
+	CHECK(HasContent(*entry, code));
+}
+
+UNIT_TEST(ShaderCache, StoresThroughATemporaryFile)
+{
+	TemporaryDirectory directory("Store");
+	ShaderCache cache(directory.GetPath());
+	const std::string first = "first version";
+	const std::string second = "second, longer version";
+	REQUIRE(cache.Store(7, first.data(), first.size()));
+
+	// Only the renamed entry is left
+	std::vector<std::filesystem::path> files = ListFiles(directory.GetPath());
+	REQUIRE(files.size() == 1);
+	CHECK_EQ(files[0].extension().string(), std::string(".dxil"));
+
+	// Storing the key again replaces the entry as a whole
+	REQUIRE(cache.Store(7, second.data(), second.size()));
+	files = ListFiles(directory.GetPath());
+	CHECK_EQ(files.size(), 1u);
+	const std::shared_ptr<const ShaderCache::Entry> entry = cache.Load(7);
+	REQUIRE(entry != nullptr);
+	CHECK(HasContent(*entry, second));
+
+	// A directory which cannot be created only fails the store
+	WriteFile(directory.GetPath() / "file", "not a directory");
+	ShaderCache invalid(directory.GetPath() / "file" / "cache");
+	CHECK(!invalid.Store(7, first.data(), first.size()));
+	CHECK(invalid.Load(7) == nullptr);
+}
+
+UNIT_TEST(ShaderCache, RejectsTruncatedOrCorruptEntries)
+{
+	TemporaryDirectory directory("Corrupt");
+	ShaderCache cache(directory.GetPath());
+	const std::string code = "compiled library";
+
+	REQUIRE(cache.Store(3, code.data(), code.size()));
+	const std::filesystem::path path = ListFiles(directory.GetPath())[0];
+	const uintmax_t size = std::filesystem::file_size(path);
+	std::filesystem::resize_file(path, size - 1);
+	CHECK(cache.Load(3) == nullptr);
+	std::filesystem::resize_file(path, 4);
+	CHECK(cache.Load(3) == nullptr);
+	std::filesystem::resize_file(path, 0);
+	CHECK(cache.Load(3) == nullptr);
+
+	// Same size, with the magic number overwritten
+	REQUIRE(cache.Store(3, code.data(), code.size()));
+	{
+		std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+		file.put('X');
+	}
+	CHECK_EQ(std::filesystem::file_size(path), size);
+	CHECK(cache.Load(3) == nullptr);
+
+	// A valid entry stored under another key
+	REQUIRE(cache.Store(4, code.data(), code.size()));
+	REQUIRE(cache.Store(3, code.data(), code.size()));
+	std::filesystem::path otherPath;
+	for (const std::filesystem::path& file : ListFiles(directory.GetPath()))
+	{
+		otherPath = file != path ? file : otherPath;
+	}
+	std::filesystem::copy_file(otherPath, path, std::filesystem::copy_options::overwrite_existing);
+	CHECK(cache.Load(3) == nullptr);
+	CHECK(cache.Load(4) != nullptr);
+}
+
+UNIT_TEST(ShaderCache, KeysEverythingTheCodeDependsOn)
+{
+	TemporaryDirectory directory("Key");
+	const std::filesystem::path sourcePath = directory.GetPath() / "Hit.hlsl";
+	const std::string source = "#include \"Common.hlsl\"\nvoid ClosestHit() {}\n";
+	std::filesystem::create_directories(directory.GetPath() / "include");
+	WriteFile(directory.GetPath() / "Common.hlsl", "#include \"include/Payload.hlsl\"\nstatic const float k = 1;\n");
+	WriteFile(directory.GetPath() / "include" / "Payload.hlsl", "struct Payload { float4 color; };\n");
+	WriteFile(sourcePath, source);
+
+	ShaderCache cache(directory.GetPath() / "cache");
+	const uint64_t key = cache.ComputeKey(sourcePath, source, L"lib_6_3", L"", 1);
+	CHECK_EQ(cache.ComputeKey(sourcePath, source, L"lib_6_3", L"", 1), key);
+
+	CHECK(cache.ComputeKey(sourcePath, source, L"lib_6_6", L"", 1) != key);
+	CHECK(cache.ComputeKey(sourcePath, source, L"lib_6_3", L"-Od", 1) != key);
+	CHECK(cache.ComputeKey(sourcePath, source, L"lib_6_3", L"", 2) != key);
+	CHECK(cache.ComputeKey(sourcePath, source + "\n", L"lib_6_3", L"", 1) != key);
+
+	// Changing an include, even one included by an include, invalidates the key
+	WriteFile(directory.GetPath() / "Common.hlsl", "#include \"include/Payload.hlsl\"\nstatic const float k = 2;\n");
+	const uint64_t commonChangedKey = cache.ComputeKey(sourcePath, source, L"lib_6_3", L"", 1);
+	CHECK(commonChangedKey != key);
+	WriteFile(directory.GetPath() / "include" / "Payload.hlsl", "struct Payload { float3 color; };\n");
+	CHECK(cache.ComputeKey(sourcePath, source, L"lib_6_3", L"", 1) != commonChangedKey);
+
+	// The key only depends on the content, not on when the files were written
+	WriteFile(directory.GetPath() / "Common.hlsl", "#include \"include/Payload.hlsl\"\nstatic const float k = 1;\n");
+	WriteFile(directory.GetPath() / "include" / "Payload.hlsl", "struct Payload { float4 color; };\n");
+	CHECK_EQ(cache.ComputeKey(sourcePath, source, L"lib_6_3", L"", 1), key);
+}
+
+UNIT_TEST(ShaderCache, FindsEachIncludeOnce)
+{
+	TemporaryDirectory directory("Includes");
+	std::filesystem::create_directories(directory.GetPath() / "include");
+	WriteFile(directory.GetPath() / "Common.hlsl", "  #  include <include/Payload.hlsl>\n");
+	WriteFile(directory.GetPath() / "include" / "Payload.hlsl", "#include \"../Common.hlsl\"\n");
+	const std::string source = "#include \"Common.hlsl\"\n// #include \"Comment.hlsl\"\n"
+		"#include \"Missing.hlsl\"\n#include \"Common.hlsl\"\n";
+
+	const std::vector<std::filesystem::path> includes = FindIncludes(directory.GetPath() / "Hit.hlsl", source);
+	REQUIRE(includes.size() == 3);
+	CHECK(includes[0] == (directory.GetPath() / "Common.hlsl").lexically_normal());
+	CHECK(includes[1] == (directory.GetPath() / "include" / "Payload.hlsl").lexically_normal());
+	CHECK(includes[2] == (directory.GetPath() / "Missing.hlsl").lexically_normal());
+}
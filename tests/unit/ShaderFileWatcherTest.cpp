@@ -0,0 +1,140 @@
+#include "ShaderFileWatcher.h"
+#include "UnitTest.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using RaytracingImplementation::ShaderFileWatcher;
+using namespace std::chrono_literals;
+
+namespace
+{
+	// Directory of a test, removed with its content when the test ends
+	class TemporaryDirectory
+	{
+	public:
+		explicit TemporaryDirectory(const char* name) :
+			m_path(std::filesystem::temp_directory_path() / (std::string("ShaderFileWatcherTest_") + name + "_" +
+				std::to_string(std::chrono::steady_clock::now().time_since_epoch().count())))
+		{
+			std::filesystem::create_directories(m_path);
+		}
+
+		~TemporaryDirectory()
+		{
+			std::error_code error;
+			std::filesystem::remove_all(m_path, error);
+		}
+
+		inline std::filesystem::path operator/(const char* name) const { return (m_path / name).lexically_normal(); }
+
+	private:
+		std::filesystem::path m_path;
+	};
+
+	// Write a file with an explicit modification time, so that the tests do not depend on the
+	// resolution of the file system times
+	void WriteFile(const std::filesystem::path& path, const std::string& content, int seconds)
+	{
+		{
+			std::ofstream file(path, std::ios::binary | std::ios::trunc);
+			file.write(content.data(), static_cast<std::streamsize>(content.size()));
+		}
+		static const std::filesystem::file_time_type origin = std::filesystem::file_time_type::clock::now();
+		std::filesystem::last_write_time(path, origin + std::chrono::seconds(seconds));
+	}
+}
+
+UNIT_TEST(ShaderFileWatcher, ReportsTheShadersIncludingAModifiedFile)
+{
+	TemporaryDirectory directory("Includes");
+	WriteFile(directory / "Common.hlsl", "struct HitInfo { float4 color; };\n", 0);
+	WriteFile(directory / "Hit.hlsl", "#include \"Common.hlsl\"\n", 0);
+	WriteFile(directory / "Miss.hlsl", "#include \"Common.hlsl\"\n", 0);
+	WriteFile(directory / "RayGen.hlsl", "void RayGen() {}\n", 0);
+
+	ShaderFileWatcher watcher(0ms);
+	watcher.Watch(directory / "Miss.hlsl");
+	watcher.Watch(directory / "RayGen.hlsl");
+	watcher.Watch(directory / "Hit.hlsl");
+	CHECK_EQ(watcher.GetShaderCount(), 3u);
+	CHECK_EQ(watcher.GetFileCount(), 4u);
+	CHECK(watcher.Poll().empty());
+
+	// Both shaders including the file, in the order they were watched, and only once
+	WriteFile(directory / "Common.hlsl", "struct HitInfo { float3 color; };\n", 1);
+	const std::vector<std::filesystem::path> affected = watcher.Poll();
+	REQUIRE(affected.size() == 2);
+	CHECK(affected[0] == directory / "Miss.hlsl");
+	CHECK(affected[1] == directory / "Hit.hlsl");
+	CHECK(watcher.Poll().empty());
+
+	WriteFile(directory / "RayGen.hlsl", "void RayGen() { }\n", 1);
+	REQUIRE(watcher.Poll().size() == 1);
+
+	// An include added by a modification is watched from then on, a removed one is dropped
+	WriteFile(directory / "Payload.hlsl", "struct Payload { bool isHit; };\n", 0);
+	WriteFile(directory / "RayGen.hlsl", "#include \"Payload.hlsl\"\n", 2);
+	CHECK_EQ(watcher.Poll().size(), 1u);
+	CHECK_EQ(watcher.GetFileCount(), 5u);
+	WriteFile(directory / "Payload.hlsl", "struct Payload { float isHit; };\n", 1);
+	REQUIRE(watcher.Poll().size() == 1);
+	WriteFile(directory / "RayGen.hlsl", "void RayGen() {}\n", 3);
+	CHECK_EQ(watcher.Poll().size(), 1u);
+	CHECK_EQ(watcher.GetFileCount(), 4u);
+}
+
+UNIT_TEST(ShaderFileWatcher, DetectsChangesOfTimeOrSize)
+{
+	TemporaryDirectory directory("TimeAndSize");
+	WriteFile(directory / "Hit.hlsl", "void ClosestHit() {}\n", 10);
+	ShaderFileWatcher watcher(0ms);
+	watcher.Watch(directory / "Hit.hlsl");
+
+	// A write within the resolution of the file times keeps the time
+	WriteFile(directory / "Hit.hlsl", "void ClosestHit() { return; }\n", 10);
+	CHECK_EQ(watcher.Poll().size(), 1u);
+
+	// Same size, newer and then restored older time
+	WriteFile(directory / "Hit.hlsl", "void ClosestHit() { retur_; }\n", 11);
+	CHECK_EQ(watcher.Poll().size(), 1u);
+	WriteFile(directory / "Hit.hlsl", "void ClosestHit() { return; }\n", 10);
+	CHECK_EQ(watcher.Poll().size(), 1u);
+
+	// A file being replaced is reported once it is back
+	std::filesystem::remove(directory / "Hit.hlsl");
+	CHECK_EQ(watcher.Poll().size(), 1u);
+	WriteFile(directory / "Hit.hlsl", "void ClosestHit() { return; }\n", 12);
+	CHECK_EQ(watcher.Poll().size(), 1u);
+	CHECK(watcher.Poll().empty());
+}
+
+UNIT_TEST(ShaderFileWatcher, ReportsAChangeOnceItHasSettled)
+{
+	TemporaryDirectory directory("Settle");
+	WriteFile(directory / "Common.hlsl", "static const float k = 1;\n", 0);
+	WriteFile(directory / "Hit.hlsl", "#include \"Common.hlsl\"\n", 0);
+	ShaderFileWatcher watcher(100ms);
+	watcher.Watch(directory / "Hit.hlsl");
+	const ShaderFileWatcher::Clock::time_point start = ShaderFileWatcher::Clock::now();
+
+	// A file saved in several writes is reported once, after the last one
+	WriteFile(directory / "Common.hlsl", "static const float k", 1);
+	CHECK(watcher.Poll(start).empty());
+	WriteFile(directory / "Common.hlsl", "static const float k = 2;\n", 2);
+	CHECK(watcher.Poll(start + 60ms).empty());
+	CHECK(watcher.Poll(start + 120ms).empty());
+	CHECK_EQ(watcher.Poll(start + 160ms).size(), 1u);
+	CHECK(watcher.Poll(start + 1000ms).empty());
+
+	// Changes of the shader and of its include settling at different times each report it
+	WriteFile(directory / "Hit.hlsl", "#include \"Common.hlsl\"\n\n", 1);
+	CHECK(watcher.Poll(start + 2000ms).empty());
+	WriteFile(directory / "Common.hlsl", "static const float k = 3;\n", 3);
+	CHECK(watcher.Poll(start + 2050ms).empty());
+	CHECK_EQ(watcher.Poll(start + 2100ms).size(), 1u);
+	CHECK_EQ(watcher.Poll(start + 2150ms).size(), 1u);
+	CHECK(watcher.Poll(start + 3000ms).empty());
+}
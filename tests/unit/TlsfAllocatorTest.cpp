@@ -0,0 +1,104 @@
+#include "TlsfAllocator.h"
+#include "UnitTest.h"
+#include <iterator>
+#include <map>
+#include <random>
+
+using RaytracingImplementation::TlsfAllocator;
+
+UNIT_TEST(TlsfAllocator, AllocatesAlignedBlocks)
+{
+	TlsfAllocator allocator(1024 * 1024);
+	const uint64_t small = allocator.Allocate(100);
+	const uint64_t placed = allocator.Allocate(1000, 64 * 1024);
+	REQUIRE(small != TlsfAllocator::kInvalidOffset);
+	REQUIRE(placed != TlsfAllocator::kInvalidOffset);
+	CHECK_EQ(small % TlsfAllocator::kMinAlignment, 0u);
+	CHECK_EQ(placed % (64 * 1024), 0u);
+	CHECK_EQ(allocator.GetAllocationSize(small), TlsfAllocator::kMinAlignment);
+	CHECK_EQ(allocator.GetAllocationSize(placed), 1024u);
+}
+
+UNIT_TEST(TlsfAllocator, FailsWhenNoBlockIsLargeEnough)
+{
+	TlsfAllocator allocator(64 * 1024);
+	CHECK_EQ(allocator.Allocate(128 * 1024), TlsfAllocator::kInvalidOffset);
+	REQUIRE(allocator.Allocate(48 * 1024) != TlsfAllocator::kInvalidOffset);
+	CHECK_EQ(allocator.Allocate(32 * 1024), TlsfAllocator::kInvalidOffset);
+}
+
+UNIT_TEST(TlsfAllocator, MergesNeighboursOnFree)
+{
+	TlsfAllocator allocator(4096);
+	const uint64_t a = allocator.Allocate(1024);
+	const uint64_t b = allocator.Allocate(1024);
+	const uint64_t c = allocator.Allocate(1024);
+	const uint64_t d = allocator.Allocate(1024);
+	CHECK_EQ(allocator.Allocate(256), TlsfAllocator::kInvalidOffset);
+
+	allocator.Free(b);
+	allocator.Free(c);
+	// b and c form a single block of 2KB, which a 2KB allocation reuses
+	CHECK_EQ(allocator.GetStatistics().freeBlockCount, 1u);
+	CHECK_EQ(allocator.Allocate(2048), b);
+
+	allocator.Free(a);
+	allocator.Free(b);
+	allocator.Free(d);
+	const TlsfAllocator::Statistics statistics = allocator.GetStatistics();
+	CHECK(allocator.IsEmpty());
+	CHECK_EQ(statistics.freeBlockCount, 1u);
+	CHECK_EQ(statistics.largestFreeBlock, 4096u);
+	CHECK_EQ(statistics.GetFragmentation(), 0.0);
+}
+
+UNIT_TEST(TlsfAllocator, RandomAllocationsNeverOverlap)
+{
+	const uint64_t size = 64ull * 1024 * 1024;
+	TlsfAllocator allocator(size);
+	std::mt19937_64 random(1);
+	// Size of the live blocks by offset
+	std::map<uint64_t, uint64_t> blocks;
+	for (uint32_t i = 0; i < 50000; i++)
+	{
+		if (blocks.empty() || random() % 3 != 0)
+		{
+			const uint64_t blockSize = 1 + random() % (random() % 4 == 0 ? 4 * 1024 * 1024 : 70000);
+			const uint64_t alignment = random() % 4 == 0 ? 64 * 1024 : TlsfAllocator::kMinAlignment;
+			const uint64_t offset = allocator.Allocate(blockSize, alignment);
+			if (offset == TlsfAllocator::kInvalidOffset)
+			{
+				continue;
+			}
+			REQUIRE(offset % alignment == 0);
+			REQUIRE(offset + blockSize <= size);
+			const auto next = blocks.lower_bound(offset);
+			REQUIRE(next == blocks.end() || offset + allocator.GetAllocationSize(offset) <= next->first);
+			REQUIRE(next == blocks.begin() || std::prev(next)->first + std::prev(next)->second <= offset);
+			blocks[offset] = allocator.GetAllocationSize(offset);
+		}
+		else
+		{
+			auto block = blocks.begin();
+			std::advance(block, random() % blocks.size());
+			allocator.Free(block->first);
+			blocks.erase(block);
+		}
+	}
+
+	uint64_t usedSize = 0;
+	for (const auto& block : blocks)
+	{
+		usedSize += block.second;
+	}
+	CHECK_EQ(allocator.GetStatistics().usedSize, usedSize);
+	CHECK_EQ(allocator.GetStatistics().allocationCount, blocks.size());
+
+	for (const auto& block : blocks)
+	{
+		allocator.Free(block.first);
+	}
+	CHECK(allocator.IsEmpty());
+	CHECK_EQ(allocator.GetStatistics().freeBlockCount, 1u);
+	CHECK_EQ(allocator.Allocate(size), 0u);
+}
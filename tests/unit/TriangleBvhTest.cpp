@@ -0,0 +1,184 @@
+#include "TraversalHeatmap.h"
+#include "TriangleBvh.h"
+#include "UnitTest.h"
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using RaytracingImplementation::NoTraversalStatistics;
+using RaytracingImplementation::TraversalCounters;
+using RaytracingImplementation::TraversalHeatmap;
+using RaytracingImplementation::TraversalStatistics;
+using RaytracingImplementation::TriangleBvh;
+
+namespace
+{
+	using Vector3 = TriangleBvh::Vector3;
+	using Ray = TriangleBvh::Ray;
+
+	// Two triangles facing the z axis, one above the other, each in a leaf of its own
+	TriangleBvh MakeStackedScene()
+	{
+		const std::vector<Vector3> vertices = {
+			{ 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+			{ 0.0f, 0.0f, -5.0f }, { 1.0f, 0.0f, -5.0f }, { 0.0f, 1.0f, -5.0f } };
+		TriangleBvh::BuildOptions options;
+		options.builder = TriangleBvh::Builder::kObjectMedian;
+		options.maxLeafSize = 1;
+		return TriangleBvh(vertices, options);
+	}
+
+	Ray MakeRay(Vector3 origin, float directionZ, float tMin = 0.0f)
+	{
+		return { origin, { 0.0f, 0.0f, directionZ }, tMin, 100.0f };
+	}
+
+	void CheckCounters(const TraversalCounters& counters, uint32_t nodes, uint32_t boxes, uint32_t triangles,
+		uint32_t stackDepth)
+	{
+		CHECK_EQ(counters.nodesVisited, nodes);
+		CHECK_EQ(counters.boxesTested, boxes);
+		CHECK_EQ(counters.trianglesTested, triangles);
+		CHECK_EQ(counters.maxStackDepth, stackDepth);
+	}
+
+	// Random triangles of various sizes in a unit cube, so that the boxes overlap
+	std::vector<Vector3> MakeTriangleSoup(uint32_t triangleCount)
+	{
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> position(0.0f, 1.0f);
+		std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+		std::vector<Vector3> vertices;
+		for (uint32_t i = 0; i < triangleCount; i++)
+		{
+			const Vector3 center = { position(random), position(random), position(random) };
+			for (uint32_t v = 0; v < 3; v++)
+			{
+				vertices.push_back({ center.x + offset(random), center.y + offset(random), center.z + offset(random) });
+			}
+		}
+		return vertices;
+	}
+}
+
+UNIT_TEST(TriangleBvh, CountsTheNodesVisitedInAKnownScene)
+{
+	const TriangleBvh bvh = MakeStackedScene();
+	REQUIRE(bvh.GetNodes().size() == 3);
+	CHECK_EQ(bvh.GetNodes()[0].count, 0u);
+	CHECK_EQ(bvh.GetTriangleCount(), 2u);
+
+	// From above: root and upper leaf, the lower one pushed and dropped behind the hit
+	TriangleBvh::Hit hit;
+	TraversalStatistics statistics;
+	REQUIRE(bvh.Intersect(MakeRay({ 0.25f, 0.25f, 10.0f }, -1.0f), hit, statistics));
+	CHECK_EQ(hit.triangle, 0u);
+	CHECK_EQ(hit.t, 10.0f);
+	CheckCounters(statistics.counters, 2, 3, 1, 1);
+
+	// From below, the other leaf is the nearer one
+	statistics = TraversalStatistics();
+	REQUIRE(bvh.Intersect(MakeRay({ 0.25f, 0.25f, -10.0f }, 1.0f), hit, statistics));
+	CHECK_EQ(hit.triangle, 1u);
+	CHECK_EQ(hit.t, 5.0f);
+	CheckCounters(statistics.counters, 2, 3, 1, 1);
+
+	// Starting past the upper leaf, only the lower one is entered
+	statistics = TraversalStatistics();
+	REQUIRE(bvh.Intersect(MakeRay({ 0.25f, 0.25f, 10.0f }, -1.0f, 12.0f), hit, statistics));
+	CHECK_EQ(hit.triangle, 1u);
+	CheckCounters(statistics.counters, 2, 3, 1, 0);
+
+	// Inside both boxes but outside both triangles, every node is visited
+	statistics = TraversalStatistics();
+	CHECK(!bvh.Intersect(MakeRay({ 0.9f, 0.9f, 10.0f }, -1.0f), hit, statistics));
+	CheckCounters(statistics.counters, 3, 3, 2, 1);
+
+	// Missing the root box stops after its test
+	statistics = TraversalStatistics();
+	CHECK(!bvh.Intersect(MakeRay({ 5.0f, 5.0f, 10.0f }, -1.0f), hit, statistics));
+	CheckCounters(statistics.counters, 0, 1, 0, 0);
+}
+
+UNIT_TEST(TriangleBvh, FindsTheSameHitsWithAndWithoutTheHeatmap)
+{
+	const std::vector<Vector3> vertices = MakeTriangleSoup(500);
+	constexpr uint32_t kSize = 32;
+	for (uint32_t builder = 0; builder < uint32_t(TriangleBvh::Builder::kCount); builder++)
+	{
+		TriangleBvh::BuildOptions options;
+		options.builder = TriangleBvh::Builder(builder);
+		const TriangleBvh bvh(vertices, options);
+
+		// Orthographic rays through the cube, one per pixel
+		TraversalHeatmap heatmap(kSize, kSize);
+		uint64_t nodesVisited = 0;
+		uint32_t hitCount = 0;
+		for (uint32_t y = 0; y < kSize; y++)
+		{
+			for (uint32_t x = 0; x < kSize; x++)
+			{
+				const Ray ray = MakeRay({ (x + 0.5f) / kSize, (y + 0.5f) / kSize, -1.0f }, 1.0f);
+				TriangleBvh::Hit hit = {};
+				TriangleBvh::Hit instrumentedHit = {};
+				TraversalStatistics statistics;
+				const bool found = bvh.Intersect(ray, hit);
+				CHECK_EQ(bvh.Intersect(ray, instrumentedHit, statistics), found);
+				heatmap.Record(x, y, statistics.counters);
+				nodesVisited += statistics.counters.nodesVisited;
+				if (found)
+				{
+					hitCount++;
+					CHECK_EQ(instrumentedHit.t, hit.t);
+					CHECK_EQ(instrumentedHit.triangle, hit.triangle);
+					CHECK_EQ(instrumentedHit.u, hit.u);
+					CHECK_EQ(instrumentedHit.v, hit.v);
+				}
+
+				// The statistics policy with empty functions gives the same hit as well
+				TriangleBvh::Hit uninstrumentedHit = {};
+				NoTraversalStatistics noStatistics;
+				CHECK_EQ(bvh.Intersect(ray, uninstrumentedHit, noStatistics), found);
+				CHECK_EQ(uninstrumentedHit.t, hit.t);
+			}
+		}
+		CHECK(hitCount > 0u);
+		CHECK_EQ(heatmap.GetRayCount(), uint64_t(kSize * kSize));
+		CHECK_EQ(heatmap.GetAggregate(TraversalHeatmap::kNodesVisited).total, nodesVisited);
+	}
+}
+
+UNIT_TEST(TraversalHeatmap, AccumulatesTheCountersOfEachPixel)
+{
+	const TriangleBvh bvh = MakeStackedScene();
+	TraversalHeatmap heatmap(2, 1);
+	const Ray rays[] = {
+		MakeRay({ 0.25f, 0.25f, 10.0f }, -1.0f),
+		MakeRay({ 0.25f, 0.25f, 10.0f }, -1.0f, 12.0f),
+		MakeRay({ 5.0f, 5.0f, 10.0f }, -1.0f) };
+	const uint32_t pixels[] = { 0, 0, 1 };
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		TriangleBvh::Hit hit;
+		TraversalStatistics statistics;
+		bvh.Intersect(rays[i], hit, statistics);
+		heatmap.Record(pixels[i], 0, statistics.counters);
+	}
+
+	// Two rays summed in the first pixel, the stack depth keeping its maximum
+	CHECK_EQ(heatmap.GetRayCount(), 3u);
+	CHECK_EQ(heatmap.GetValue(TraversalHeatmap::kNodesVisited, 0, 0), 4u);
+	CHECK_EQ(heatmap.GetValue(TraversalHeatmap::kBoxesTested, 0, 0), 6u);
+	CHECK_EQ(heatmap.GetValue(TraversalHeatmap::kTrianglesTested, 0, 0), 2u);
+	CHECK_EQ(heatmap.GetValue(TraversalHeatmap::kStackDepth, 0, 0), 1u);
+	CHECK_EQ(heatmap.GetValue(TraversalHeatmap::kNodesVisited, 1, 0), 0u);
+	CHECK_EQ(heatmap.GetValue(TraversalHeatmap::kBoxesTested, 1, 0), 1u);
+
+	const TraversalHeatmap::Aggregate boxes = heatmap.GetAggregate(TraversalHeatmap::kBoxesTested);
+	CHECK_EQ(boxes.total, 7u);
+	CHECK_EQ(boxes.max, 6u);
+	CHECK_EQ(boxes.mean, 3.5);
+
+	CHECK_THROWS(heatmap.Record(2, 0, TraversalCounters()), std::logic_error);
+	CHECK_THROWS(heatmap.GetValue(TraversalHeatmap::kNodesVisited, 0, 1), std::out_of_range);
+}
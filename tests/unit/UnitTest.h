@@ -0,0 +1,86 @@
+#ifndef UNIT_TEST_GUARD
+#define UNIT_TEST_GUARD
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Minimal test registry, so that the tests build with nothing but the standard library.
+// A test is a function defined with UNIT_TEST; the CHECK macros report the failed
+// expression and let the test go on, REQUIRE stops it.
+namespace UnitTest
+{
+	struct Test
+	{
+		const char* suite;
+		const char* name;
+		std::function<void()> function;
+	};
+
+	inline std::vector<Test>& GetTests()
+	{
+		static std::vector<Test> tests;
+		return tests;
+	}
+
+	inline uint32_t& GetFailureCount()
+	{
+		static uint32_t failureCount = 0;
+		return failureCount;
+	}
+
+	struct Registration
+	{
+		Registration(const char* suite, const char* name, std::function<void()> function)
+		{
+			GetTests().push_back({ suite, name, std::move(function) });
+		}
+	};
+
+	// Thrown by REQUIRE to leave the current test
+	struct Abort {};
+
+	inline void Fail(const char* file, int line, const std::string& message)
+	{
+		GetFailureCount()++;
+		std::cout << file << ':' << line << ": " << message << '\n';
+	}
+}
+
+#define UNIT_TEST(suite, name) \
+	static void suite##_##name(); \
+	static const UnitTest::Registration suite##_##name##_registration(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) UnitTest::Fail(__FILE__, __LINE__, "CHECK(" #condition ") failed"); } while (false)
+
+#define CHECK_EQ(actual, expected) \
+	do { \
+		const auto& unitTestActual = (actual); \
+		const auto& unitTestExpected = (expected); \
+		if (!(unitTestActual == unitTestExpected)) \
+			UnitTest::Fail(__FILE__, __LINE__, "CHECK_EQ(" #actual ", " #expected ") failed"); \
+	} while (false)
+
+#define CHECK_THROWS(expression, exception) \
+	do { \
+		bool unitTestThrown = false; \
+		try { expression; } catch (const exception&) { unitTestThrown = true; } \
+		if (!unitTestThrown) UnitTest::Fail(__FILE__, __LINE__, #expression " did not throw " #exception); \
+	} while (false)
+
+#define REQUIRE(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			UnitTest::Fail(__FILE__, __LINE__, "REQUIRE(" #condition ") failed"); \
+			throw UnitTest::Abort(); \
+		} \
+	} while (false)
+
+#endif // !UNIT_TEST_GUARD
@@ -0,0 +1,40 @@
+#include "UnitTest.h"
+#include <cstring>
+#include <exception>
+
+// Runs every registered test, or only those whose "suite.name" contains the first argument
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : "";
+	uint32_t testCount = 0;
+	uint32_t failedTestCount = 0;
+	for (const UnitTest::Test& test : UnitTest::GetTests())
+	{
+		const std::string fullName = std::string(test.suite) + '.' + test.name;
+		if (fullName.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		testCount++;
+		const uint32_t failureCount = UnitTest::GetFailureCount();
+		try
+		{
+			test.function();
+		}
+		catch (const UnitTest::Abort&)
+		{
+		}
+		catch (const std::exception& exception)
+		{
+			UnitTest::Fail(test.suite, 0, std::string("unexpected exception: ") + exception.what());
+		}
+
+		const bool failed = UnitTest::GetFailureCount() != failureCount;
+		failedTestCount += failed ? 1 : 0;
+		std::cout << (failed ? "[FAILED] " : "[  OK  ] ") << fullName << '\n';
+	}
+
+	std::cout << testCount - failedTestCount << '/' << testCount << " tests passed\n";
+	return failedTestCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+#include "UploadRing.h"
+#include "UnitTest.h"
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using RaytracingImplementation::UploadRing;
+
+UNIT_TEST(UploadRing, ReclaimsSpaceOnlyOnceTheFenceIsReached)
+{
+	UploadRing ring(1024);
+	CHECK_EQ(ring.Allocate(512, 256), 0u);
+	CHECK_EQ(ring.Allocate(512, 256), 512u);
+	ring.Close(1);
+	CHECK_EQ(ring.Allocate(1, 1), UploadRing::kInvalidOffset);
+
+	ring.Retire(0);
+	CHECK_EQ(ring.GetUsedSize(), 1024u);
+	ring.Retire(1);
+	CHECK_EQ(ring.GetUsedSize(), 0u);
+	CHECK_EQ(ring.GetPendingSubmissionCount(), 0u);
+	CHECK_EQ(ring.Allocate(1024, 1), 0u);
+}
+
+UNIT_TEST(UploadRing, WrapsAroundSkippingTheEnd)
+{
+	UploadRing ring(1024);
+	CHECK_EQ(ring.Allocate(400, 1), 0u);
+	ring.Close(1);
+	CHECK_EQ(ring.Allocate(400, 1), 400u);
+	ring.Close(2);
+	ring.Retire(1);
+
+	// 224 bytes are left at the end, the allocation goes to the beginning and the end
+	// is retired along with it
+	CHECK_EQ(ring.Allocate(300, 1), 0u);
+	CHECK_EQ(ring.GetUsedSize(), 400u + 224u + 300u);
+	ring.Close(3);
+	ring.Retire(3);
+	CHECK_EQ(ring.GetUsedSize(), 0u);
+}
+
+UNIT_TEST(UploadRing, RejectsDecreasingFenceValues)
+{
+	UploadRing ring(1024);
+	ring.Allocate(16, 16);
+	ring.Close(5);
+	ring.Allocate(16, 16);
+	CHECK_THROWS(ring.Close(5), std::logic_error);
+	CHECK_THROWS(ring.Allocate(16, 3), std::logic_error);
+}
+
+// Drives the ring like Dx12Api does, with a simulated GPU completing the submissions
+// some time after they are closed: allocations never overlap the ones still in flight
+UNIT_TEST(UploadRing, SimulatedFenceNeverOverwritesInFlightData)
+{
+	const uint64_t capacity = 64 * 1024;
+	UploadRing ring(capacity);
+	std::mt19937_64 random(3);
+
+	struct Allocation
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint64_t fenceValue;
+	};
+	std::vector<Allocation> inFlight;
+	std::vector<Allocation> open;
+	uint64_t signaledFenceValue = 0;
+	uint64_t completedFenceValue = 0;
+	uint32_t failedAllocationCount = 0;
+
+	const auto overlaps = [](const Allocation& a, const Allocation& b)
+	{
+		return a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+	};
+
+	for (uint32_t i = 0; i < 100000; i++)
+	{
+		const uint32_t operation = random() % 10;
+		if (operation < 6)
+		{
+			const uint64_t size = 1 + random() % 5000;
+			const uint64_t alignment = 1ull << (random() % 9);
+			const uint64_t offset = ring.Allocate(size, alignment);
+			if (offset == UploadRing::kInvalidOffset)
+			{
+				failedAllocationCount++;
+				continue;
+			}
+			const Allocation allocation = { offset, size, 0 };
+			REQUIRE(offset % alignment == 0);
+			REQUIRE(offset + size <= capacity);
+			for (const Allocation& other : inFlight)
+			{
+				REQUIRE(!overlaps(allocation, other));
+			}
+			for (const Allocation& other : open)
+			{
+				REQUIRE(!overlaps(allocation, other));
+			}
+			open.push_back(allocation);
+		}
+		else if (operation < 8)
+		{
+			// Submission, followed by the signal of the fence
+			ring.Close(++signaledFenceValue);
+			for (Allocation& allocation : open)
+			{
+				allocation.fenceValue = signaledFenceValue;
+				inFlight.push_back(allocation);
+			}
+			open.clear();
+		}
+		else if (completedFenceValue < signaledFenceValue)
+		{
+			// The GPU progresses by a random number of submissions
+			completedFenceValue += 1 + random() % (signaledFenceValue - completedFenceValue);
+			ring.Retire(completedFenceValue);
+			std::vector<Allocation> remaining;
+			for (const Allocation& allocation : inFlight)
+			{
+				if (allocation.fenceValue > completedFenceValue)
+				{
+					remaining.push_back(allocation);
+				}
+			}
+			inFlight.swap(remaining);
+		}
+	}
+	// The ring was full at times, which is when the GPU stalls the uploads
+	CHECK(failedAllocationCount > 0);
+
+	ring.Close(++signaledFenceValue);
+	ring.Retire(signaledFenceValue);
+	CHECK_EQ(ring.GetUsedSize(), 0u);
+	CHECK_EQ(ring.GetPendingSubmissionCount(), 0u);
+	CHECK_EQ(ring.Allocate(capacity, 1), 0u);
+}
@@ -0,0 +1,142 @@
+#include "WorkerPool.h"
+#include "UnitTest.h"
+#include <atomic>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using RaytracingImplementation::WorkerPool;
+
+UNIT_TEST(WorkerPool, RunsEveryTaskOnce)
+{
+	WorkerPool pool(3);
+	CHECK_EQ(pool.GetConcurrency(), 4u);
+
+	std::vector<std::atomic<uint32_t>> counts(1000);
+	pool.Run(counts.size(), [&](size_t task) { counts[task]++; });
+	for (const std::atomic<uint32_t>& count : counts)
+	{
+		CHECK_EQ(count.load(), 1u);
+	}
+}
+
+UNIT_TEST(WorkerPool, ReusesThreadsAcrossLoops)
+{
+	WorkerPool pool(2);
+	std::atomic<uint64_t> sum = 0;
+	for (uint32_t loop = 0; loop < 200; loop++)
+	{
+		pool.Run(8, [&](size_t task) { sum += task; });
+	}
+	CHECK_EQ(sum.load(), 200u * 28u);
+}
+
+UNIT_TEST(WorkerPool, RunsOnCallingThreadWithoutWorkers)
+{
+	WorkerPool pool(0);
+	CHECK_EQ(pool.GetConcurrency(), 1u);
+
+	const std::thread::id caller = std::this_thread::get_id();
+	std::set<std::thread::id> threads;
+	pool.Run(16, [&](size_t) { threads.insert(std::this_thread::get_id()); });
+	CHECK_EQ(threads, std::set<std::thread::id>{ caller });
+}
+
+UNIT_TEST(WorkerPool, RethrowsOnceEveryTaskCompleted)
+{
+	WorkerPool pool(3);
+	std::atomic<uint32_t> completed = 0;
+	CHECK_THROWS(pool.Run(64, [&](size_t task)
+		{
+			completed++;
+			if (task % 8 == 0)
+			{
+				throw std::runtime_error("task failed");
+			}
+		}), std::runtime_error);
+	CHECK_EQ(completed.load(), 64u);
+
+	// The pool stays usable after a failed loop
+	completed = 0;
+	pool.Run(64, [&](size_t) { completed++; });
+	CHECK_EQ(completed.load(), 64u);
+}
+
+UNIT_TEST(WorkerPool, SerializesConcurrentLoops)
+{
+	WorkerPool pool(2);
+	std::atomic<int32_t> running = 0;
+	std::atomic<bool> overlapped = false;
+	const auto runLoops = [&]()
+	{
+		for (uint32_t loop = 0; loop < 50; loop++)
+		{
+			pool.Run(4, [&](size_t)
+				{
+					// Every task of a loop adds 1, so more than 4 running tasks means two loops overlap
+					if (++running > 4)
+					{
+						overlapped = true;
+					}
+					running--;
+				});
+		}
+	};
+	std::thread other(runLoops);
+	runLoops();
+	other.join();
+	CHECK(!overlapped.load());
+}
+
+UNIT_TEST(WorkerPool, RunsNestedLoopsInline)
+{
+	WorkerPool pool(3);
+	std::atomic<uint32_t> completed = 0;
+	pool.Run(8, [&](size_t)
+		{
+			// Would wait forever for the outer loop if it waited for its turn
+			const std::thread::id thread = std::this_thread::get_id();
+			pool.Run(4, [&](size_t)
+				{
+					CHECK(std::this_thread::get_id() == thread);
+					completed++;
+				});
+		});
+	CHECK_EQ(completed.load(), 32u);
+
+	// A nested failure reaches the outer loop once the nested tasks have completed
+	completed = 0;
+	CHECK_THROWS(pool.Run(2, [&](size_t)
+		{
+			pool.Run(4, [&](size_t index)
+				{
+					completed++;
+					if (index == 0)
+					{
+						throw std::runtime_error("nested");
+					}
+				});
+		}), std::runtime_error);
+	CHECK_EQ(completed.load(), 8u);
+
+	// Loops of another pool started from a task still spread over its threads, whose tasks
+	// may come back to the first pool
+	WorkerPool other(2);
+	completed = 0;
+	pool.Run(1, [&](size_t)
+		{
+			std::atomic<uint32_t> started = 0;
+			other.Run(2, [&](size_t)
+				{
+					// Both tasks run at once, so one of them is on a worker of the other pool
+					started++;
+					while (started.load() < 2)
+					{
+						std::this_thread::yield();
+					}
+					pool.Run(2, [&](size_t) { completed++; });
+				});
+		});
+	CHECK_EQ(completed.load(), 4u);
+}